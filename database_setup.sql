@@ -5,16 +5,28 @@
 CREATE TABLE IF NOT EXISTS alarms (
     id SERIAL PRIMARY KEY,
     device_id VARCHAR(255) NOT NULL,
+    local_id INTEGER, -- The device's id for an alarm created on it, so a repeated insert is skipped
     time TIME NOT NULL,
     days_of_week INTEGER[] NOT NULL, -- Array of day numbers: [0=Sunday, 1=Monday, ..., 6=Saturday]
     is_enabled BOOLEAN DEFAULT true,
     brightness_level INTEGER DEFAULT 255 CHECK (brightness_level >= 0 AND brightness_level <= 255),
     duration_minutes INTEGER DEFAULT 30 CHECK (duration_minutes > 0),
-    color_preset VARCHAR(50) DEFAULT 'sunrise' CHECK (color_preset IN ('sunrise', 'ocean', 'forest', 'lavender', 'custom')),
+    color_preset VARCHAR(50) DEFAULT 'sunrise', -- A built-in preset or a name from color_presets
+    zone SMALLINT DEFAULT 0 CHECK (zone >= 0 AND zone <= 255), -- 0 for the whole strip, else an entry of LED_ZONES
     created_at TIMESTAMP WITH TIME ZONE DEFAULT NOW(),
     updated_at TIMESTAMP WITH TIME ZONE DEFAULT NOW()
 );
 
+-- Older schemas limited color_preset to the built-in names
+ALTER TABLE alarms DROP CONSTRAINT IF EXISTS alarms_color_preset_check;
+
+-- Older schemas have no zones; their alarms light the whole strip
+ALTER TABLE alarms ADD COLUMN IF NOT EXISTS zone SMALLINT DEFAULT 0 CHECK (zone >= 0 AND zone <= 255);
+
+-- Older schemas have no local_id; alarms created on a device could be inserted twice
+ALTER TABLE alarms ADD COLUMN IF NOT EXISTS local_id INTEGER;
+CREATE UNIQUE INDEX IF NOT EXISTS idx_alarms_device_local_id ON alarms(device_id, local_id);
+
 -- Create indexes for better performance
 CREATE INDEX IF NOT EXISTS idx_alarms_device_id ON alarms(device_id);
 CREATE INDEX IF NOT EXISTS idx_alarms_enabled ON alarms(device_id, is_enabled) WHERE is_enabled = true;
@@ -68,6 +80,124 @@ CREATE TRIGGER update_alarms_updated_at
     FOR EACH ROW 
     EXECUTE FUNCTION update_updated_at_column();
 
+-- Publish row changes to Supabase Realtime so awake devices receive edits immediately
+DO $$
+BEGIN
+    IF NOT EXISTS (
+        SELECT 1 FROM pg_publication_tables
+        WHERE pubname = 'supabase_realtime' AND schemaname = 'public' AND tablename = 'alarms'
+    ) THEN
+        ALTER PUBLICATION supabase_realtime ADD TABLE alarms;
+    END IF;
+END $$;
+
+-- Create the alarm_events table (what alarms actually did, uploaded in batches by the device)
+CREATE TABLE IF NOT EXISTS alarm_events (
+    id BIGSERIAL PRIMARY KEY,
+    device_id VARCHAR(255) NOT NULL,
+    sequence BIGINT NOT NULL, -- Per-device counter; retried uploads are deduplicated on (device_id, sequence)
+    alarm_id INTEGER NOT NULL,
+    event_type VARCHAR(20) NOT NULL CHECK (event_type IN ('fired', 'completed', 'dismissed', 'missed', 'snoozed')),
+    occurred_at TIMESTAMP WITH TIME ZONE, -- NULL if the device clock was not synced yet
+    sunrise_seconds INTEGER CHECK (sunrise_seconds >= 0),
+    dismiss_source VARCHAR(20) CHECK (dismiss_source IN ('web', 'button')),
+    received_at TIMESTAMP WITH TIME ZONE DEFAULT NOW(),
+    UNIQUE (device_id, sequence)
+);
+
+-- Older schemas had no snoozed events
+ALTER TABLE alarm_events DROP CONSTRAINT IF EXISTS alarm_events_event_type_check;
+ALTER TABLE alarm_events ADD CONSTRAINT alarm_events_event_type_check
+    CHECK (event_type IN ('fired', 'completed', 'dismissed', 'missed', 'snoozed'));
+
+CREATE INDEX IF NOT EXISTS idx_alarm_events_device_time ON alarm_events(device_id, occurred_at);
+
+ALTER TABLE alarm_events ENABLE ROW LEVEL SECURITY;
+
+DROP POLICY IF EXISTS "Device access policy" ON alarm_events;
+DROP POLICY IF EXISTS "API key access policy" ON alarm_events;
+
+CREATE POLICY "Device access policy" ON alarm_events
+    FOR ALL
+    USING (
+        device_id = auth.jwt() ->> 'device_id' OR
+        device_id = current_setting('request.headers.device-id', true) OR
+        auth.role() = 'service_role'
+    )
+    WITH CHECK (
+        device_id = auth.jwt() ->> 'device_id' OR
+        device_id = current_setting('request.headers.device-id', true) OR
+        auth.role() = 'service_role'
+    );
+
+CREATE POLICY "API key access policy" ON alarm_events
+    FOR ALL
+    USING (true)
+    WITH CHECK (true);
+
+-- Create the color_presets table (custom sunrise presets, compiled and cached by the device)
+-- Every insert and update takes a new version from the sequence, so a device only
+-- downloads a preset whose version differs from the copy it has in flash.
+CREATE SEQUENCE IF NOT EXISTS color_preset_versions;
+
+CREATE TABLE IF NOT EXISTS color_presets (
+    id SERIAL PRIMARY KEY,
+    device_id VARCHAR(255) NOT NULL,
+    name VARCHAR(15) NOT NULL CHECK (
+        name ~ '^[a-z0-9_-]+$' AND name NOT IN ('sunrise', 'ocean', 'forest', 'lavender')
+    ),
+    -- [{"color": "#RRGGBB", "duration_percent": 0.25}, ...]; durations are fractions of the
+    -- sunrise and the last stage is the color it ends on
+    stages JSONB NOT NULL CHECK (
+        jsonb_typeof(stages) = 'array' AND jsonb_array_length(stages) BETWEEN 2 AND 6
+    ),
+    effects TEXT[] NOT NULL DEFAULT '{}' CHECK (effects <@ ARRAY['breathing', 'sparkle', 'warmth', 'wave']),
+    version BIGINT NOT NULL DEFAULT nextval('color_preset_versions'),
+    created_at TIMESTAMP WITH TIME ZONE DEFAULT NOW(),
+    updated_at TIMESTAMP WITH TIME ZONE DEFAULT NOW(),
+    UNIQUE (device_id, name)
+);
+
+ALTER TABLE color_presets ENABLE ROW LEVEL SECURITY;
+
+DROP POLICY IF EXISTS "Device access policy" ON color_presets;
+DROP POLICY IF EXISTS "API key access policy" ON color_presets;
+
+CREATE POLICY "Device access policy" ON color_presets
+    FOR ALL
+    USING (
+        device_id = auth.jwt() ->> 'device_id' OR
+        device_id = current_setting('request.headers.device-id', true) OR
+        auth.role() = 'service_role'
+    )
+    WITH CHECK (
+        device_id = auth.jwt() ->> 'device_id' OR
+        device_id = current_setting('request.headers.device-id', true) OR
+        auth.role() = 'service_role'
+    );
+
+CREATE POLICY "API key access policy" ON color_presets
+    FOR ALL
+    USING (true)
+    WITH CHECK (true);
+
+DROP FUNCTION IF EXISTS bump_color_preset_version() CASCADE;
+CREATE OR REPLACE FUNCTION bump_color_preset_version()
+RETURNS TRIGGER AS $$
+BEGIN
+    NEW.version = nextval('color_preset_versions');
+    NEW.updated_at = NOW();
+    RETURN NEW;
+END;
+$$ language 'plpgsql';
+
+DROP TRIGGER IF EXISTS bump_color_presets_version ON color_presets;
+
+CREATE TRIGGER bump_color_presets_version
+    BEFORE UPDATE ON color_presets
+    FOR EACH ROW
+    EXECUTE FUNCTION bump_color_preset_version();
+
 -- Create a view for easier device-specific queries
 CREATE OR REPLACE VIEW device_alarms AS
 SELECT 
@@ -80,7 +210,8 @@ SELECT
     duration_minutes,
     color_preset,
     created_at,
-    updated_at
+    updated_at,
+    zone
 FROM alarms
 WHERE is_enabled = true;
 
@@ -88,6 +219,84 @@ WHERE is_enabled = true;
 GRANT ALL ON device_alarms TO anon;
 GRANT ALL ON device_alarms TO authenticated;
 
+-- A device's alarms packed for AlarmManager::fetch_schedule(), so the device reads
+-- fixed-size records instead of JSON rows. Called with GET /rest/v1/rpc/device_schedule.
+-- Returns the payload in base64, or '' when p_version names the current schedule.
+-- Big-endian layout (see SCHEDULE_FORMAT_VERSION in alarm_manager.h):
+--   header   u8 format, u8 alarm count, u8 preset count, u8 0, u32 version
+--   presets  u8 length, name (cut to 15 bytes)
+--   alarms   u32 id, u32 updated_at (epoch s), u16 duration_minutes, u16 minute of the day,
+--            u8 days (bit n = day n), u8 flags (1 = enabled), u8 brightness, u8 zone, u8 preset
+-- The version is the first 4 bytes of the md5 of everything after the header.
+-- Rows the device would skip as invalid are left out.
+DROP FUNCTION IF EXISTS device_schedule(TEXT, TEXT, INTEGER);
+CREATE OR REPLACE FUNCTION device_schedule(p_device_id TEXT, p_version TEXT DEFAULT '', p_limit INTEGER DEFAULT 10)
+RETURNS TEXT AS $$
+DECLARE
+    v_presets BYTEA[] := '{}';
+    v_names BYTEA := ''::BYTEA;
+    v_records BYTEA := ''::BYTEA;
+    v_count INTEGER := 0;
+    v_name BYTEA;
+    v_preset INTEGER;
+    v_days INTEGER;
+    v_body BYTEA;
+    v_version TEXT;
+    r RECORD;
+BEGIN
+    FOR r IN
+        SELECT id, time, days_of_week, is_enabled, brightness_level, duration_minutes, color_preset, zone, updated_at
+        FROM alarms
+        WHERE device_id = p_device_id
+          AND COALESCE(brightness_level, 255) BETWEEN 0 AND 255
+          AND COALESCE(duration_minutes, 30) BETWEEN 1 AND 1440
+        ORDER BY is_enabled DESC, updated_at DESC, id
+        LIMIT p_limit
+    LOOP
+        v_name := substring(convert_to(COALESCE(r.color_preset, 'sunrise'), 'UTF8') FROM 1 FOR 15);
+        v_preset := array_position(v_presets, v_name);
+        IF v_preset IS NULL THEN
+            v_presets := array_append(v_presets, v_name);
+            v_preset := array_length(v_presets, 1);
+            v_names := v_names || set_byte('\x00'::BYTEA, 0, octet_length(v_name)) || v_name;
+        END IF;
+
+        SELECT COALESCE(bit_or(1 << day), 0) INTO v_days
+        FROM unnest(r.days_of_week) AS day
+        WHERE day BETWEEN 0 AND 6;
+
+        v_records := v_records
+            || int4send(r.id)
+            || substring(int8send(COALESCE(EXTRACT(EPOCH FROM r.updated_at)::BIGINT, 0)) FROM 5)
+            || substring(int4send(COALESCE(r.duration_minutes, 30)) FROM 3)
+            || substring(int4send((EXTRACT(HOUR FROM r.time) * 60 + EXTRACT(MINUTE FROM r.time))::INTEGER) FROM 3)
+            || set_byte('\x00'::BYTEA, 0, v_days)
+            || set_byte('\x00'::BYTEA, 0, CASE WHEN COALESCE(r.is_enabled, true) THEN 1 ELSE 0 END)
+            || set_byte('\x00'::BYTEA, 0, COALESCE(r.brightness_level, 255))
+            || set_byte('\x00'::BYTEA, 0, COALESCE(r.zone, 0))
+            || set_byte('\x00'::BYTEA, 0, v_preset - 1);
+        v_count := v_count + 1;
+    END LOOP;
+
+    v_body := v_names || v_records;
+    v_version := left(md5(v_body), 8);
+    IF v_version = p_version THEN
+        RETURN '';
+    END IF;
+
+    RETURN replace(encode(
+        '\x01'::BYTEA
+        || set_byte('\x00'::BYTEA, 0, v_count)
+        || set_byte('\x00'::BYTEA, 0, COALESCE(array_length(v_presets, 1), 0))
+        || '\x00'::BYTEA
+        || decode(v_version, 'hex')
+        || v_body, 'base64'), E'\n', '');
+END;
+$$ language 'plpgsql' STABLE;
+
+GRANT EXECUTE ON FUNCTION device_schedule(TEXT, TEXT, INTEGER) TO anon;
+GRANT EXECUTE ON FUNCTION device_schedule(TEXT, TEXT, INTEGER) TO authenticated;
+
 -- Sample data for testing (replace MAC address with your ESP32's actual MAC)
 INSERT INTO alarms (device_id, time, days_of_week, is_enabled, brightness_level, duration_minutes, color_preset) 
 VALUES 
@@ -96,6 +305,14 @@ VALUES
     ('24:0A:C4:XX:XX:XX', '06:30:00', ARRAY[1,2,3,4,5], false, 255, 25, 'forest')
 ON CONFLICT DO NOTHING;
 
+INSERT INTO color_presets (device_id, name, stages, effects)
+VALUES
+    ('24:0A:C4:XX:XX:XX', 'ember',
+     '[{"color": "#200000", "duration_percent": 0.3}, {"color": "#802000", "duration_percent": 0.4},
+       {"color": "#FF6010", "duration_percent": 0.3}, {"color": "#FFB060", "duration_percent": 0}]',
+     ARRAY['breathing', 'warmth'])
+ON CONFLICT DO NOTHING;
+
 -- Instructions for setting up device authentication:
 -- 1. Get your ESP32 MAC address from the serial monitor
 -- 2. Update the sample data above with your actual MAC address
@@ -105,4 +322,10 @@ ON CONFLICT DO NOTHING;
 COMMENT ON TABLE alarms IS 'Stores alarm configurations for sunrise alarm devices';
 COMMENT ON COLUMN alarms.device_id IS 'ESP32 MAC address - used for device identification and access control';
 COMMENT ON COLUMN alarms.days_of_week IS 'Array of integers representing days: 0=Sunday, 1=Monday, etc.';
-COMMENT ON COLUMN alarms.color_preset IS 'Predefined color scheme for the sunrise animation';
\ No newline at end of file
+COMMENT ON COLUMN alarms.color_preset IS 'Color scheme for the sunrise animation: sunrise, ocean, forest, lavender or a color_presets name';
+COMMENT ON COLUMN alarms.zone IS 'Part of the strip the sunrise plays on: 0 for the whole strip, n for entry n of the device''s LED_ZONES';
+COMMENT ON TABLE alarm_events IS 'Alarm executions reported by the devices: fired, completed, dismissed and missed';
+COMMENT ON COLUMN alarm_events.sunrise_seconds IS 'How long the sunrise animation ran before it completed or was dismissed';
+COMMENT ON TABLE color_presets IS 'Custom sunrise color presets, compiled by the device once per version';
+COMMENT ON COLUMN color_presets.version IS 'Taken from color_preset_versions on every insert and update; devices redownload a preset only when it changes';
+COMMENT ON FUNCTION device_schedule(TEXT, TEXT, INTEGER) IS 'A device''s alarms packed into fixed-size records; empty when p_version is still current';
@@ -3,6 +3,23 @@
 
 #include <Arduino.h>
 #include <FastLED.h>
+#include <ArduinoJson.h>
+
+struct SunriseInstance; // sunrise_compositor.h
+struct SunriseLut;      // sunrise_curve.h
+
+// Columns of the alarms table the device reads
+#define ALARM_COLUMNS "id,local_id,time,days_of_week,is_enabled,brightness_level,duration_minutes,color_preset,zone,updated_at"
+
+// Payload of the device_schedule() function in database_setup.sql, which
+// documents the layout: a header, the preset names the alarms use and one
+// fixed-size record per alarm, all big-endian
+#define SCHEDULE_FORMAT_VERSION 1
+#define SCHEDULE_HEADER_SIZE 8
+#define SCHEDULE_RECORD_SIZE 17
+
+#define PRESET_MAX_STAGES 6
+#define PRESET_NAME_LENGTH 15
 
 struct Alarm
 {
@@ -13,7 +30,9 @@ struct Alarm
     bool enabled;
     int brightness;
     int duration;
-    String color_preset;
+    char color_preset[PRESET_NAME_LENGTH + 1]; // Longer names are cut off
+    int zone;                                  // 0 for the whole strip, else an entry of LED_ZONES
+    uint32_t updated_at;
 };
 
 struct SunriseStage
@@ -22,22 +41,73 @@ struct SunriseStage
     float duration_percent;
 };
 
+// Effects drawn over a preset's sunrise, stored as bit flags
+enum PresetEffect : uint8_t
+{
+    PRESET_EFFECT_BREATHING = 1,
+    PRESET_EFFECT_SPARKLE = 2,
+    PRESET_EFFECT_WARMTH = 4,
+    PRESET_EFFECT_WAVE = 8
+};
+
 struct ColorPreset
 {
-    SunriseStage stages[6];
+    SunriseStage stages[PRESET_MAX_STAGES];
     int stage_count;
-    String name;
+    char name[PRESET_NAME_LENGTH + 1];
+    uint8_t effects;
+    int32_t version; // color_presets row version; 0 for the built-in presets
+};
+
+// Result of a dry run of the alarm ingestion path, see benchmark_parse()
+struct ParseBenchmark
+{
+    int rows;
+    int skipped;
+    int total_rows;
+    uint32_t micros;
+    size_t bytes_allocated;
+    int32_t heap_leaked;
+    const char *error;
+
+    ParseBenchmark() : rows(0), skipped(0), total_rows(0), micros(0), bytes_allocated(0), heap_leaked(0), error(nullptr) {}
+};
+
+enum AlarmEditResult
+{
+    ALARM_EDIT_OK,
+    ALARM_EDIT_NOT_FOUND,
+    ALARM_EDIT_INVALID,
+    ALARM_EDIT_FULL
 };
 
 class AlarmManager
 {
 public:
-    static void fetch_alarms_from_db();
-    static void parse_alarms(const String &json_response);
+    static void load_cached_alarms();
+    static bool fetch_alarms_from_db();
     static void check_alarms();
     static bool has_alarms() { return alarm_count > 0; }
     static int get_alarm_count() { return alarm_count; }
-    static time_t calculate_next_alarm_time();
+    static time_t next_alarm_after(time_t after);
+    static time_t get_snooze_time();
+
+    static void alarms_to_json(JsonArray out);
+    static AlarmEditResult create_alarm(JsonObjectConst fields, int &new_id);
+    static AlarmEditResult update_alarm(int id, JsonObjectConst fields);
+    static AlarmEditResult delete_alarm(int id);
+
+    // Incremental updates from the realtime subscription and delta polling
+    static void apply_remote_row(JsonObjectConst row);
+    static void remove_remote_alarm(int id);
+    static void retain_remote_ids(JsonArrayConst rows);
+    static uint32_t get_latest_update();
+
+    static bool benchmark_parse(const char *json, size_t length, int iterations, ParseBenchmark &result);
+    static bool benchmark_schedule(const char *text, size_t length, int iterations, ParseBenchmark &result);
+    static bool is_builtin_preset(const char *name) { return find_color_preset(name) != nullptr; }
+    static const ColorPreset *builtin_preset(int index) { return index < color_preset_count ? &color_presets[index] : nullptr; }
+    static void resolve_preset(const char *name, ColorPreset &preset, SunriseLut &curve);
 
 private:
     static Alarm alarms[10];
@@ -45,9 +115,34 @@ private:
     static ColorPreset color_presets[];
     static int color_preset_count;
 
-    static void parse_time(const String &time_str, int &hour, int &minute);
-    static void trigger_sunrise_alarm(Alarm &alarm);
-    static ColorPreset *find_color_preset(const String &name);
+    static bool fetch_schedule();
+    static bool fetch_remote_rows(JsonDocument &rows);
+    static bool push_pending_changes(JsonArrayConst remote);
+    static void apply_rows(JsonArrayConst rows);
+    static int decode_rows(JsonArrayConst rows, Alarm out[], int max_count, int &skipped);
+    static bool unwrap_schedule(const char *text, size_t length, uint8_t *out, size_t capacity, size_t &out_length);
+    static int decode_schedule(const uint8_t *data, size_t length, Alarm out[], int max_count, int &skipped,
+                               uint32_t &version);
+    static void reset_alarm(Alarm &alarm);
+    static bool read_alarm_fields(JsonObjectConst json, Alarm &alarm);
+    static void write_alarm_fields(const Alarm &alarm, JsonObject json);
+    static String alarm_to_row_json(const Alarm &alarm);
+    static bool is_valid_alarm(const Alarm &alarm);
+    static int find_alarm_index(int id);
+    static uint32_t current_epoch();
+    static uint32_t parse_timestamp(const char *iso_time);
+
+    static bool parse_time(const char *text, int &hour, int &minute);
+    static void record_missed_alarms(uint32_t now);
+    static void start_due_alarms(uint32_t now, const struct tm &timeinfo);
+    static bool start_alarm(const Alarm &alarm, int duration_minutes);
+    static void run_sunrises();
+    static void finish_alarm(const SunriseInstance &sunrise);
+    static void snooze_alarm(int id, uint32_t until);
+    static ColorPreset *find_color_preset(const char *name);
+
+    // The fuzz target in native/fuzz calls the decoders directly
+    friend struct AlarmParserFuzz;
 };
 
 #endif
@@ -0,0 +1,43 @@
+#ifndef ALARM_STORE_H
+#define ALARM_STORE_H
+
+#include <Arduino.h>
+#include "alarm_manager.h"
+
+enum PendingOp : uint8_t
+{
+    PENDING_CREATE = 1,
+    PENDING_UPDATE = 2,
+    PENDING_DELETE = 3
+};
+
+struct PendingChange
+{
+    int32_t alarm_id;
+    uint8_t op;
+    uint32_t changed_at;
+};
+
+// On-device copy of the alarm table and the queue of local edits that still
+// have to be pushed to Supabase. Both live in NVS so they survive deep sleep
+// and power loss.
+class AlarmStore
+{
+public:
+    static int load_alarms(Alarm alarms[], int max_count);
+    static bool save_alarms(const Alarm alarms[], int count);
+
+    static int load_pending(PendingChange changes[], int max_count);
+    static bool queue_change(PendingOp op, int alarm_id, uint32_t changed_at);
+    static void drop_pushed(const PendingChange pushed[], int count);
+    static int get_pending_count();
+    static bool find_pending(int alarm_id, PendingChange &change);
+    static bool has_pending(int alarm_id);
+
+    static int next_local_id();
+
+private:
+    static bool write_if_changed(const char *key, const void *data, size_t length);
+};
+
+#endif
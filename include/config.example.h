@@ -8,16 +8,50 @@
 // Supabase Configuration - Replace with your Supabase project details
 #define SUPABASE_URL "https://your-project.supabase.co"
 #define SUPABASE_KEY "your_supabase_anon_key"
+#define DB_TIMEOUT_MS 5000      // Connect and read timeout per request
+#define DB_MAX_RETRIES 2        // Extra attempts after timeouts, 429 and 5xx responses
+#define DB_RETRY_BACKOFF_MS 250 // Doubled for each further retry
+#define TLS_SESSION_CACHE_SIZE 2048 // RTC bytes for the resumable TLS session; too small disables resumption
+
+// Realtime alarm updates while awake (Supabase Realtime, needs the alarms table in the supabase_realtime publication)
+#define REALTIME_ENABLED true
+#define REALTIME_HEARTBEAT_MS 25000
+#define REALTIME_RECONNECT_MS 5000
+#define REALTIME_POLL_INTERVAL_MS 30000 // Delta polling interval while the socket is down
 
 // Hardware Configuration
 #define LED_PIN 4
 #define NUM_LEDS 60
 #define LED_TYPE WS2812B
 #define COLOR_ORDER GRB
+#define LED_ROWS 1                               // Rows when the strip is folded into a serpentine panel, first row at the bottom
+#define SUNRISE_ORIGIN SUNRISE_ORIGIN_UNIFORM    // Or SUNRISE_ORIGIN_START, _END, _CENTER for light rising from that point
+#define SUNRISE_SPREAD 0.4f                      // Share of the sunrise by which the farthest LEDs trail the origin
+#define SUNRISE_SCENE_FILE "/scene.bin"          // Installed with PUT /api/scene; the built-in scene plays without it
+#define SCENE_MAX_FILE_SIZE 65536                // Largest scene accepted by PUT /api/scene
+#define DITHER_MAX_LEVEL 48                      // Frames whose brightest channel is below this are temporally dithered
+#define DITHER_REFRESH_MS 4                      // Pause between dithered refreshes, on top of the strip's write time
+#define DITHER_BUDGET_US 1000                    // Longest dither pass allowed before an alarm falls back to rounding
+
+// Zones let alarms share the strip, e.g. one per side of a bed. An alarm's zone 0 is the whole
+// strip and zone n is entry n - 1 here: {first LED, LED count, SUNRISE_ORIGIN_... of its sunrise}.
+// Zones may overlap; where they do, the light of both sunrises adds up.
+#define LED_ZONES {{0, NUM_LEDS / 2, SUNRISE_ORIGIN_END}, {NUM_LEDS / 2, NUM_LEDS - NUM_LEDS / 2, SUNRISE_ORIGIN_START}}
+#define MAX_CONCURRENT_SUNRISES 8                // Sunrises played at once; each slot keeps a 1.5 KB curve once used
+#define FRAME_RECORD_FILE "/frames.bin"          // Where the sunrise after POST /api/debug/frames/record is recorded
+#define FRAME_RECORD_MAX_BYTES 262144            // Recording stops at this size
+#define FRAME_RECORD_SEED 1337                   // random8()/random16() seed of recordings without ?seed=
 
 // Button Configuration
 #define BUTTON_PIN 0 // GPIO0 (BOOT button on most ESP32 boards)
 #define BUTTON_DEBOUNCE_MS 50
+#define BUTTON_LONG_PRESS_MS 800   // Held this long: snooze
+#define BUTTON_DOUBLE_PRESS_MS 300 // Pressed again this soon after a release: sync now
+#define INPUT_POLL_MS 5            // Period of the timer that debounces and recognizes presses
+#define INPUT_QUEUE_SIZE 32        // Button edges buffered for that timer; a power of two
+#define INPUT_LATENCY_BUDGET_MS 50 // Presses answered later than this are counted on /metrics
+#define SNOOZE_MINUTES 9
+#define SNOOZE_SUNRISE_MINUTES 1   // Sunrise length when a snoozed alarm comes back
 
 // NTP Configuration
 #define NTP_SERVER "pool.ntp.org"
@@ -25,23 +59,61 @@
 #define DAYLIGHT_OFFSET_SEC 3600 // Adjust for daylight saving
 
 // Power Management
-#define DEEP_SLEEP_DURATION 3600000000ULL // 1 hour in microseconds
+#define SYNC_INTERVAL_S 21600     // Freshness SLA: longest time between Supabase syncs (6 h)
+#define SYNC_BEFORE_ALARM_S 900   // Extra sync this long before each alarm, 0 to disable
+#define SYNC_RETRY_S 1800         // Next sync attempt after WiFi or Supabase failed
+#define WAKE_RADIO_ESTIMATE_S 6   // WiFi-on time per sync assumed until one has been measured
 #define ALARM_CHECK_INTERVAL 60000000ULL  // 1 minute in microseconds
 
+// OTA updates over HTTP (POST /api/ota from tools/ota_upload.py)
+#define OTA_PROGRESS_INTERVAL_MS 250 // Shortest time between redraws of the progress bar
+#define OTA_RESTART_DELAY_MS 1000    // Time for the upload's response to reach the client before restarting
+
 // Alarm Configuration
 #define MAX_ALARMS 10
 #define DEFAULT_SUNRISE_DURATION 30 // minutes
 #define DEFAULT_BRIGHTNESS 255
+#define MAX_PENDING_CHANGES 16 // Local API edits waiting to be pushed to Supabase
+#define SCHEDULE_RETRY_SYNCS 8 // Syncs that fetch rows before device_schedule() is tried again after a 404
+#define PARSE_BENCH_MAX_BODY 16384 // Largest response body accepted by /api/debug/parse_alarms
+#define MAX_CUSTOM_PRESETS 8 // color_presets rows kept compiled in LittleFS, about 1.6 KB each
+
+// Alarm event telemetry (alarm_events table, uploaded only while WiFi is up anyway)
+#define EVENT_RTC_CAPACITY 32     // Events kept in RTC memory before spilling to LittleFS
+#define EVENT_FILE_MAX_EVENTS 512 // Oldest events are dropped beyond this
+#define EVENT_BATCH_SIZE 32       // Rows per bulk insert
+#define EVENT_RETRY_BASE_S 60     // Upload backoff after the first failure, doubled per further failure
+#define EVENT_RETRY_MAX_S 21600
+#define EVENT_SEQUENCE_BLOCK 64   // Sequence numbers reserved in NVS per write
+
+// Energy model (estimates for /metrics and the native build's simulate command)
+#define ENERGY_ACTIVE_MW 165.0f    // ESP32 awake with WiFi off, about 50 mA at 3.3 V
+#define ENERGY_WIFI_MW 330.0f      // Added while WiFi is on, averaged over transmit and receive
+#define ENERGY_DEEP_SLEEP_MW 0.05f // Board in deep sleep; add the LED strip's idle draw if it stays powered
+
+// Memory
+#define SCRATCH_BLOCK_SIZE 16384 // Largest page, /metrics text or Supabase response body
+#define SCRATCH_BLOCKS 3         // Scratch blocks allocated at boot; requests finding none free get 503
+
+// Logging
+#define LOG_ARENA_SIZE 8192 // Bytes reserved for log records, must be a power of two
+#define LOG_MAX_MESSAGE 160 // Longer messages are truncated
+#define LOG_INDEX_SIZE 256  // Most recent records reachable by sequence number, must be a power of two
+#define LOG_DRAIN_INTERVAL_MS 20
+#define LOG_DRAIN_STACK_SIZE 3072
+#define LOG_RTC_BUFFER_SIZE 2048 // Records kept in RTC memory across deep sleep before a flash batch
+#define LOG_FILE_MAX_SIZE 32768  // Log file size in LittleFS before rotation
+#define LOG_PAGE_SIZE 50         // Records per /logs page
+#define LOG_BENCH_RING_ENTRIES 100 // Size of the String ring Logger::benchmark() compares the arena with
 
-// Debug Mode
-#define DEBUG_MODE 1
+// Stall monitor
+#define STALL_SAMPLE_MS 10            // How often heartbeats are checked; shorter stalls can go unseen
+#define STALL_BUDGET_MS 50            // A heartbeat this much later than due is a stall
+#define STALL_LOG_MS 1000             // Stalls at least this long are logged
+#define STALL_MONITOR_STACK_SIZE 3072
 
-#if DEBUG_MODE
-#define DEBUG_PRINT(x) Serial.print(x)
-#define DEBUG_PRINTLN(x) Serial.println(x)
-#else
-#define DEBUG_PRINT(x)
-#define DEBUG_PRINTLN(x)
-#endif
+// Log levels: LOG_LEVEL_TRACE, LOG_LEVEL_DEBUG, LOG_LEVEL_INFO, LOG_LEVEL_WARN, LOG_LEVEL_ERROR
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG // Calls below this level are compiled out entirely
+#define LOG_DEFAULT_LEVEL LOG_LEVEL_DEBUG // Initial runtime threshold per module, adjustable via /api/log_levels
 
 #endif // CONFIG_H
\ No newline at end of file
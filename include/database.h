@@ -1,13 +1,46 @@
-#include <ESPSupabase.h>
 #ifndef DATABASE_H
 #define DATABASE_H
 
+#include <Arduino.h>
+#include "text_writer.h"
+
+struct DatabaseStats
+{
+    uint32_t requests;
+    uint32_t handshakes;
+    uint32_t resumed_handshakes;
+    uint32_t handshake_ms;
+    uint32_t request_ms; // Excluding handshakes
+};
+
+// Minimal PostgREST client for the Supabase REST API. SUPABASE_URL may also
+// point at a plain http:// stand-in such as tools/mock_postgrest.py.
+// The connection is kept alive between requests until close() is called.
+// Response bodies are read into a TextWriter, usually a ScratchPool block;
+// a body that does not fit fails the request.
 class Database
 {
 public:
     static void init();
+    static void init(const char *url); // Instead of SUPABASE_URL
+    static void close();
+    static const DatabaseStats &get_stats() { return stats; }
+    static void append_metrics(TextWriter &out);
+    static int select_rows(const String &table, const String &query, TextWriter &response);
+    static int call_function(const String &name, const String &query, TextWriter &response);
+    static int insert_rows(const String &table, const String &json_array, const char *on_conflict);
+    static bool update_row(const String &table, int id, const String &json);
+    static bool delete_row(const String &table, int id);
+
+private:
+    static String base_url;
+    static DatabaseStats stats;
 
-    static Supabase db;
+    static int request(const char *method, const String &path, const String &body, TextWriter &response,
+                       const char *prefer = nullptr);
+    static int send_once(const char *method, const String &url, const String &body, TextWriter &response,
+                         const char *prefer);
+    static bool is_retryable(const char *method, const String &path, int status);
 };
 
-#endif
\ No newline at end of file
+#endif
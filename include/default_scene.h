@@ -0,0 +1,15 @@
+#ifndef DEFAULT_SCENE_H
+#define DEFAULT_SCENE_H
+
+#include <Arduino.h>
+
+// Generated by tools/compile_scene.py from tools/scenes/default.json; played when no scene file is installed
+static const uint8_t default_scene[] = {
+    0x53, 0x43, 0x4E, 0x31, 0x01, 0x00, 0x03, 0x00, 0x10, 0x27, 0x00, 0x00,
+    0x00, 0x00, 0x03, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x01, 0x00, 0xE0, 0x93,
+    0x04, 0x00, 0xE8, 0x03, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x01, 0x05,
+    0x00, 0x19, 0x00, 0x00, 0x32, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0x00,
+    0x00,
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef ENERGY_MODEL_H
+#define ENERGY_MODEL_H
+
+#include <Arduino.h>
+#include "text_writer.h"
+
+// Estimates the energy used per boot, per sunrise and per day from the time
+// spent awake, with WiFi on and in deep sleep, plus the LED strip's power
+// computed from every frame with FastLED's power model. The ENERGY_*
+// constants in config.h describe the board. The native build's simulate
+// command reports this model's numbers over simulated weeks.
+class EnergyModel
+{
+public:
+    static void begin(esp_sleep_wakeup_cause_t cause);
+    static void set_led_power(uint32_t milliwatts);
+    static void begin_sunrise();
+    static void end_sunrise();
+    static void end_boot(uint64_t sleep_us);
+
+    static float get_boot_mwh();
+    static float get_per_day_mwh();
+    static void append_metrics(TextWriter &out);
+
+private:
+    static uint32_t led_mw;
+    static unsigned long led_since;
+    static float led_mwh;
+    static float sunrise_start_mwh;
+
+    static void integrate_led();
+};
+
+#endif
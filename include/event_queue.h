@@ -0,0 +1,50 @@
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+#include <Arduino.h>
+#include "text_writer.h"
+
+enum AlarmEventType : uint8_t
+{
+    ALARM_EVENT_FIRED = 1,
+    ALARM_EVENT_COMPLETED = 2,
+    ALARM_EVENT_DISMISSED = 3,
+    ALARM_EVENT_MISSED = 4,
+    ALARM_EVENT_SNOOZED = 5
+};
+
+struct AlarmEvent
+{
+    uint32_t sequence;
+    uint32_t occurred_at; // Unix time, 0 if the clock was not synced
+    int32_t alarm_id;
+    uint16_t sunrise_seconds;
+    uint8_t type;
+    uint8_t dismiss_source;
+};
+
+// Records what alarms actually did and uploads it to the alarm_events table.
+// Events are queued in RTC memory and spill to LittleFS when that fills up.
+// They are sent oldest first in bulk inserts, but only while WiFi is already
+// connected for other reasons. Failed uploads back off exponentially.
+class EventQueue
+{
+public:
+    static void record(AlarmEventType type, int alarm_id, uint16_t sunrise_seconds = 0, uint8_t dismiss_source = 0);
+    static void upload_if_online();
+    static int get_depth();
+    static void append_metrics(TextWriter &out);
+
+private:
+    static void restore_after_power_loss();
+    static void reserve_sequences();
+    static bool spill_to_flash();
+    static int peek_batch(AlarmEvent batch[], int max_count, int &from_flash);
+    static void drop_uploaded(int count, int from_flash);
+    static bool rewrite_file_from(int first);
+    static String batch_to_json(const AlarmEvent batch[], int count);
+    static const char *type_name(uint8_t type);
+    static bool mount();
+};
+
+#endif
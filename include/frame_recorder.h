@@ -0,0 +1,99 @@
+#ifndef FRAME_RECORDER_H
+#define FRAME_RECORDER_H
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+// Recordings are read by tools/frame_diff.py. All numbers are little endian:
+//
+//   header  u32 magic "SFR1", u8 format version, u8 flags, u16 LED count,
+//           u16 random seed
+//   frame   varint milliseconds since the previous frame, u8 brightness,
+//           runs until every LED is covered
+//   run     u8 op | (LED count - 1), then for FRAME_OP_FILL one color and
+//           for FRAME_OP_COPY one color per LED, 3 bytes r, g, b
+//
+// Varints take 7 bits per byte, low bits first, the top bit set on every
+// byte but the last. The first frame is relative to an all-black frame at
+// the start of the sunrise. A sunrise mostly changes slowly and evenly, so most frames are a
+// few skip and fill runs.
+#define FRAME_MAGIC 0x31524653 // "SFR1"
+#define FRAME_FORMAT_VERSION 1
+#define FRAME_HEADER_SIZE 10
+#define FRAME_RUN_MAX 64
+
+enum FrameOp : uint8_t
+{
+    FRAME_OP_SKIP = 0x00, // LEDs unchanged since the previous frame
+    FRAME_OP_FILL = 0x40, // LEDs all of one color
+    FRAME_OP_COPY = 0x80  // A color per LED
+};
+
+enum FrameRecordingFlag : uint8_t
+{
+    FRAME_RECORDING_RENDERED = 1 // Rendered on a virtual clock, one frame per composited frame
+};
+
+struct FrameEncoder
+{
+    CRGB *previous;
+    int num_leds;
+    uint32_t last_ms;
+};
+
+// Records what the strip shows, for comparing the output of two firmware
+// builds frame by frame. Recording and rendering seed random8()/random16(),
+// so sparkles and the dither's starting error are the same in every run
+// with the same seed; alarms that are not recorded get fresh entropy. A
+// render keeps a random16 state of its own, so an alarm that starts while
+// it streams does not change it (see RandomScope).
+//
+// A recorded alarm writes every show() to FRAME_RECORD_FILE, dithered
+// refreshes included, on the real clock. A rendered sunrise is produced
+// without the strip on a virtual clock that jumps by each frame's hold, so
+// it comes out bit for bit the same on every run and takes seconds instead
+// of the whole sunrise.
+class FrameRecorder
+{
+public:
+    static size_t write_header(uint8_t *out, int num_leds, uint16_t seed, uint8_t flags);
+    static void begin_encoder(FrameEncoder &encoder, int num_leds);
+    static void free_encoder(FrameEncoder &encoder);
+    static size_t max_frame_size(int num_leds);
+    static size_t encode(FrameEncoder &encoder, uint32_t at_ms, uint8_t brightness, const CRGB *leds, uint8_t *out);
+
+    // The next sunrise is recorded; see LEDController::start_sunrise()
+    static void arm(uint16_t seed);
+    static void start(int num_leds);
+    static void record(uint32_t at_ms, uint8_t brightness, const CRGB *leds);
+    static void stop();
+    static bool is_recording() { return recording; }
+    static bool has_recording();
+
+    // GET /api/debug/frames/render streams a rendered sunrise through read_render()
+    static bool begin_render(const char *preset, int duration_minutes, int brightness, int zone, uint16_t seed);
+    static size_t read_render(uint8_t *buffer, size_t length);
+    static void end_render();
+
+private:
+    static bool armed;
+    static bool recording;
+    static uint16_t armed_seed;
+
+    static size_t write_varint(uint8_t *out, uint32_t value);
+    static uint8_t *write_color(uint8_t *out, const CRGB &color);
+    static bool render_frame();
+    static bool mount();
+};
+
+// FastLED keeps one random16 state. Sunrises draw from it on the loop task
+// and a render on the web server's task, so both hold a RandomScope while
+// they draw; the render swaps its own state in and out under it.
+class RandomScope
+{
+public:
+    RandomScope();
+    ~RandomScope();
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "text_writer.h"
+
+enum HeapSubsystem : uint8_t
+{
+    HEAP_WEB,      // Pages and API responses
+    HEAP_SYNC,     // Alarm and color preset downloads
+    HEAP_REALTIME, // Realtime messages and delta polls
+    HEAP_SUBSYSTEM_COUNT
+};
+
+// Heap health for /metrics: free heap, the lowest it has ever been, the
+// largest free block and how much of the free heap is scattered in smaller
+// pieces. A HeapScope around a unit of work records what it left allocated
+// and how much it shrank the largest free block, per subsystem. Work running
+// in another task at the same time is attributed to the scope too.
+class HeapMonitor
+{
+public:
+    static void begin();
+    static void sample();
+    static void append_metrics(TextWriter &out);
+    static void to_json(JsonObject out);
+    static const char *subsystem_name(HeapSubsystem subsystem);
+
+private:
+    friend class HeapScope;
+
+    static void record_scope(HeapSubsystem subsystem, size_t free_before, size_t largest_before, size_t blocks_before);
+    static void alloc_failed(size_t size, uint32_t caps, const char *function_name);
+};
+
+class HeapScope
+{
+public:
+    explicit HeapScope(HeapSubsystem subsystem);
+    ~HeapScope();
+
+private:
+    HeapSubsystem subsystem;
+    size_t free_before;
+    size_t largest_before;
+    size_t blocks_before;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef INPUT_ENGINE_H
+#define INPUT_ENGINE_H
+
+#include <Arduino.h>
+#include "text_writer.h"
+
+enum InputGesture : uint8_t
+{
+    GESTURE_NONE = 0,
+    GESTURE_SHORT = 1,  // dismiss
+    GESTURE_LONG = 2,   // snooze for SNOOZE_MINUTES
+    GESTURE_DOUBLE = 3  // sync now
+};
+
+// Button input. button_isr() only timestamps edges into a lock-free queue;
+// an esp_timer drains it every INPUT_POLL_MS in its own task, so input is
+// handled while the sunrise blocks the loop task. The first edge of a
+// bounce is taken at once and later ones are dropped for
+// BUTTON_DEBOUNCE_MS, after which the pin is read again in case the bounce
+// hid a release. Presses are then told apart: held for BUTTON_LONG_PRESS_MS
+// is long, pressed again within BUTTON_DOUBLE_PRESS_MS of a release is
+// double, anything else is short once that window has passed.
+//
+// During a sunrise short and long presses dismiss and snooze the alarm from
+// the timer task. Other gestures wait for take_gesture(). Because a short
+// press is only known after the double press window, whoever shows
+// LEDs answers each press as soon as it goes down (take_press()), and the
+// time from the edge to that answer is measured.
+class InputEngine
+{
+public:
+    static void begin();
+    static bool is_pressed() { return stable_pressed; }
+    static bool take_press(uint32_t &pressed_at_us);
+    static void record_reaction(uint32_t pressed_at_us);
+    static InputGesture take_gesture();
+    static bool wait(uint32_t timeout_ms);
+    static void append_metrics(TextWriter &out);
+    static const char *gesture_name(InputGesture gesture);
+
+private:
+    static volatile bool stable_pressed;
+    static TaskHandle_t notify_task;
+
+    static void button_isr();
+    static void poll(void *argument);
+    static void change_state(bool pressed, uint32_t at_us);
+    static void emit(InputGesture gesture);
+};
+
+#endif
@@ -4,6 +4,24 @@
 #include <FastLED.h>
 #include <Arduino.h>
 #include "alarm_manager.h"
+#include "sunrise_curve.h"
+#include "sunrise_compositor.h"
+#include "text_writer.h"
+
+struct RenderBenchmark
+{
+    uint32_t layout_us;
+    float frame_us;
+    float dither_us;
+    int bands;
+};
+
+struct CompositeBenchmark
+{
+    int lit_leds;
+    float frame_us;
+    float ns_per_lit_led;
+};
 
 class LEDController
 {
@@ -11,27 +29,39 @@ public:
     static void init();
     static void clear();
     static void show_status_indicator();
-    static void show_button_feedback();
+    static void show_button_feedback(uint32_t pressed_at_us);
     static void show_ota_progress(unsigned int progress, unsigned int total);
     static void show_ota_error();
     static void run_test_animation();
-    static void run_sunrise_animation(ColorPreset &preset, int duration_ms, int max_brightness);
     static bool is_initialized() { return initialized; }
+
+    // Sunrises: claim a slot, fill in its alarm and preset, start it, then
+    // call play_frame() until it returns false, collecting the sunrises
+    // that ended with take_ended_sunrise() after every frame
+    static SunriseInstance *claim_sunrise();
+    static void start_sunrise(SunriseInstance &sunrise);
+    static bool play_frame();
+    static SunriseInstance *take_ended_sunrise();
     static bool is_alarm_running() { return alarm_running; }
-    static void dismiss_alarm();
+    static void dismiss_alarm(DismissSource source, int zone = -1);
+
+    static void benchmark_render(int count, int rows, int origin, int frames, RenderBenchmark &result);
+    static void benchmark_composite(int count, int zones, int lit, bool overlap, int frames, CompositeBenchmark &result);
+    static void append_metrics(TextWriter &out);
 
 private:
     static CRGB *leds;
+    static CRGB16 *frame;
+    static uint16_t *dither_error;
     static int num_leds;
     static bool initialized;
     static bool alarm_running;
-    static bool dismiss_requested;
+    static bool dither_enabled;
+    static Composition composition;
 
-    static CRGB blend_multiple_colors(SunriseStage stages[], int stage_count, float progress);
-    static void add_sparkle_effect(CRGB base_color, float intensity);
-    static void add_breathing_effect(float progress, float &brightness_multiplier);
-    static void add_warmth_gradient(float progress);
-    static void add_wave_effect(CRGB base_color, float progress);
+    static void show();
+    static void present();
+    static void output_frame(uint32_t hold_ms);
 };
 
 #endif
@@ -0,0 +1,46 @@
+#ifndef LOG_STORE_H
+#define LOG_STORE_H
+
+#include <Arduino.h>
+#include "logger.h"
+#include "text_writer.h"
+
+// Bump whenever StoredLogHeader changes. Stored records in another format,
+// e.g. written by the firmware before an OTA update, are discarded.
+#define LOG_STORE_FORMAT 2
+
+struct __attribute__((packed)) StoredLogHeader
+{
+    uint32_t sequence;
+    uint32_t wall_time;
+    uint16_t boot;
+    uint8_t level;
+    uint8_t module;
+    uint8_t length;
+};
+
+// Keeps log records across deep sleep. Before sleeping, the records of the
+// current boot are appended to a buffer in RTC slow memory; only when that
+// buffer is full is it written to LittleFS in one batch, which keeps flash
+// wear and wake time low. Files are rotated once they reach LOG_FILE_MAX_SIZE.
+class LogStore
+{
+public:
+    static uint32_t restore_sequence();
+    static void persist(int boot);
+    static void log_last_persist_stats();
+    static void build_page_html(TextWriter &html, uint32_t before);
+
+private:
+    static uint32_t boot_first_sequence;
+
+    static bool mount();
+    static bool flush_rtc_to_flash();
+    static void drop_oldest_rtc(size_t needed);
+    static void append_record(const StoredLogHeader &header, const char *text);
+    static void render_stored(const uint8_t *data, size_t length, uint32_t first, uint32_t before, TextWriter &html);
+    static void render_file(const char *path, uint32_t first, uint32_t before, TextWriter &html);
+    static void render_line(const StoredLogHeader &header, time_t wall_time, const char *text, TextWriter &html);
+};
+
+#endif
@@ -3,24 +3,126 @@
 
 #include <Arduino.h>
 #include <time.h>
+#include "config.h"
 
+enum LogLevel : uint8_t
+{
+    LOG_LEVEL_TRACE,
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR
+};
+
+enum LogReadResult
+{
+    LOG_READ_OK,
+    LOG_READ_PENDING,
+    LOG_READ_LOST
+};
+
+enum LogModule : uint8_t
+{
+    LOG_MODULE_SYSTEM,
+    LOG_MODULE_NETWORK,
+    LOG_MODULE_ALARM,
+    LOG_MODULE_LED,
+    LOG_MODULE_WEB,
+    LOG_MODULE_STORAGE,
+    LOG_MODULE_COUNT
+};
+
+struct LogEntry
+{
+    uint32_t sequence;
+    int64_t timestamp_us;
+    uint8_t level;
+    uint8_t module;
+    char text[LOG_MAX_MESSAGE + 1];
+};
+
+// Heap and speed of one logger in Logger::benchmark(). The heap figures are
+// taken after the last message, with everything the logger holds still held.
+struct LogBenchmarkRun
+{
+    float logs_per_s;
+    int32_t heap_held;        // Free heap lost to the logger
+    int32_t blocks_held;      // Heap blocks the logger keeps allocated
+    int32_t largest_block_lost;
+    float fragmentation_before; // Share of the free heap outside the largest free block
+    float fragmentation_after;
+};
+
+struct LogBenchmark
+{
+    int messages;
+    LogBenchmarkRun arena;
+    LogBenchmarkRun string_ring; // The String-per-entry ring the arena replaced
+};
+
+// Levels below LOG_COMPILE_LEVEL are constant-false at every call site, so the
+// compiler drops the call and the arguments are never evaluated
+template <uint8_t level>
+struct LogLevelCompiled
+{
+    static constexpr bool value = level >= LOG_COMPILE_LEVEL;
+};
+
+// Log records are kept in a fixed byte arena as variable-length binary
+// entries (sequence, timestamp, level, message bytes). Writers reserve
+// space with a single compare-and-swap, so logging is lock-free and safe
+// from any task or ISR. Nothing is allocated while logging; timestamps are
+// only formatted when the logs are read, and Serial output is written by a
+// low-priority drain task instead of the caller.
 class Logger
 {
 public:
-    static void init(int max_entries);
-    static void log(const String &message);
-    static String getLogsHtml();
+    static void init(uint32_t first_sequence);
+    static void logf(LogLevel level, LogModule module, const char *format, ...) __attribute__((format(printf, 3, 4)));
+    static void log_isr(LogModule module, const char *format, unsigned long arg);
+    static bool is_enabled(LogLevel level, LogModule module) { return level >= module_levels[module]; }
+    static void set_module_level(LogModule module, LogLevel level) { module_levels[module] = level; }
+    static LogLevel get_module_level(LogModule module) { return (LogLevel)module_levels[module]; }
+    static const char *module_name(uint8_t module);
+    static const char *level_name(uint8_t level);
+    static bool parse_module(const char *name, LogModule &module);
+    static bool parse_level(const char *name, LogLevel &level);
+    static void flush();
+    static LogReadResult read_record(uint32_t sequence, LogEntry &entry);
+    static uint32_t get_next_sequence();
+    static time_t to_wall_time(int64_t timestamp_us);
     static int getLogCount();
+    static void benchmark(int messages, LogBenchmark &result);
 
 private:
-    static String *log_buffer;
-    static int log_index;
-    static bool buffer_full;
-    static int max_entries;
+    static uint8_t module_levels[LOG_MODULE_COUNT];
+    static TaskHandle_t drain_task_handle;
+    static uint32_t drained_sequence;
 
-    static String getTimestamp();
+    static void append(uint8_t level, uint8_t module, uint8_t type, const void *payload, size_t length);
+    static void drain();
+    static void drain_task(void *parameter);
 };
 
-#define WEB_LOG(x) Logger::log(x)
+#define LOG_AT(level, module, ...)                                                      \
+    do                                                                                  \
+    {                                                                                   \
+        if (LogLevelCompiled<level>::value && Logger::is_enabled(level, module))        \
+            Logger::logf(level, module, __VA_ARGS__);                                   \
+    } while (0)
+
+#define LOG_TRACE(module, ...) LOG_AT(LOG_LEVEL_TRACE, module, __VA_ARGS__)
+#define LOG_DEBUG(module, ...) LOG_AT(LOG_LEVEL_DEBUG, module, __VA_ARGS__)
+#define LOG_INFO(module, ...) LOG_AT(LOG_LEVEL_INFO, module, __VA_ARGS__)
+#define LOG_WARN(module, ...) LOG_AT(LOG_LEVEL_WARN, module, __VA_ARGS__)
+#define LOG_ERROR(module, ...) LOG_AT(LOG_LEVEL_ERROR, module, __VA_ARGS__)
+
+// format must be a string literal taking a single %lu; it is stored by pointer and formatted on read
+#define LOG_ISR(module, format, arg)                                                    \
+    do                                                                                  \
+    {                                                                                   \
+        if (LogLevelCompiled<LOG_LEVEL_INFO>::value && Logger::is_enabled(LOG_LEVEL_INFO, module)) \
+            Logger::log_isr(module, format, arg);                                       \
+    } while (0)
 
 #endif
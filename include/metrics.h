@@ -0,0 +1,26 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include "text_writer.h"
+
+// Helpers for the Prometheus text format served at /metrics. Each module
+// appends its own samples through an append_metrics(TextWriter &) function.
+// A labeled metric is one family() followed by a sample() per label value,
+// and a histogram one family() of type "histogram" and a histogram() per
+// label value.
+class Metrics
+{
+public:
+    static void gauge(TextWriter &out, const char *name, const char *help, double value);
+    static void counter(TextWriter &out, const char *name, const char *help, double value);
+    static void family(TextWriter &out, const char *name, const char *type, const char *help);
+    static void sample(TextWriter &out, const char *name, const char *label, const char *label_value, double value);
+    static void histogram(TextWriter &out, const char *name, const char *label, const char *label_value,
+                          const uint32_t *bounds, const uint32_t *counts, int bound_count, double sum);
+
+private:
+    static void append_value(TextWriter &out, double value);
+};
+
+#endif
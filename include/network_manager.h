@@ -3,7 +3,6 @@
 
 #include <WiFi.h>
 #include <ArduinoOTA.h>
-#include <ESPSupabase.h>
 #include <Arduino.h>
 
 class NetworkManager
@@ -14,12 +13,17 @@ public:
     static void setup_ota();
     static void handle_ota();
     static void sync_time();
+    static void apply_timezone();
     static String get_device_id();
+    static uint32_t get_radio_on_ms();
 
     static bool wifi_connected;
 
 private:
     static bool ota_initialized;
+    static bool radio_on;
+    static unsigned long radio_on_since;
+    static uint32_t radio_on_ms;
 };
 
 #endif
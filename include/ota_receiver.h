@@ -0,0 +1,41 @@
+#ifndef OTA_RECEIVER_H
+#define OTA_RECEIVER_H
+
+#include <Arduino.h>
+
+// Firmware updates over HTTP (POST /api/ota from tools/ota_upload.py), for
+// when pushing the full image with ArduinoOTA takes too long. The body is
+// either a plain image or a gzip member without optional header fields, as
+// written by the tool or `gzip -n`. It is inflated with the ROM's miniz while
+// it streams into the inactive app partition, so the compressed image never
+// has to fit anywhere. Chunks are written on the web server's task; the loop
+// draws the progress and restarts once the image is complete.
+class OtaReceiver
+{
+public:
+    static bool begin(size_t image_size, size_t body_size, const char *md5, const char *signature);
+    static bool write(const uint8_t *data, size_t length);
+    static bool end();
+    static void abort();
+    static bool is_receiving() { return receiving; }
+    static bool get_progress(uint32_t &progress, uint32_t &total);
+    static bool should_restart();
+    static bool take_failure();
+    static const char *get_error() { return error; }
+
+private:
+    static volatile bool receiving;
+    static volatile uint32_t received;
+    static uint32_t body_size;
+    static uint32_t written;
+    static uint32_t started_at;
+    static uint32_t completed_at;
+    static const char *error;
+    static volatile bool failed;
+
+    static bool inflate(const uint8_t *data, size_t length);
+    static bool fail(const char *reason);
+    static void release();
+};
+
+#endif
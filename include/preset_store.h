@@ -0,0 +1,34 @@
+#ifndef PRESET_STORE_H
+#define PRESET_STORE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "alarm_manager.h"
+#include "sunrise_curve.h"
+#include "text_writer.h"
+
+// Color presets from the Supabase color_presets table. A preset is validated
+// and compiled into its sunrise curve once per version, and the result is kept
+// in LittleFS as /presets/<name>.bin. A sync lists only names and versions and
+// downloads the rows whose version is not in flash. An alarm reads the stored
+// curve as is, so rendering never parses JSON or recompiles.
+class PresetStore
+{
+public:
+    static bool sync();
+    static bool load(const char *name, ColorPreset &preset, SunriseLut &lut);
+    static int get_cached_count();
+    static void append_metrics(TextWriter &out);
+
+private:
+    static bool mount();
+    static String path_for(const char *name);
+    static int32_t cached_version(const char *name);
+    static void remove_deleted(JsonArrayConst listing);
+    static bool read_row(JsonObjectConst row, ColorPreset &preset);
+    static bool save(const ColorPreset &preset, const SunriseLut &lut);
+    static bool is_valid_name(const char *name);
+    static bool parse_color(const char *text, CRGB &color);
+};
+
+#endif
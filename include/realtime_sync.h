@@ -0,0 +1,38 @@
+#ifndef REALTIME_SYNC_H
+#define REALTIME_SYNC_H
+
+#include <Arduino.h>
+#include <WebSocketsClient.h>
+
+// Keeps the local alarm table current while the device is awake. Subscribes to
+// Supabase Realtime (Postgres changes on the alarms table for this device) and
+// falls back to polling PostgREST for rows newer than the last seen updated_at
+// while the socket is down.
+class RealtimeSync
+{
+public:
+    static void start();
+    static void stop();
+    static void loop();
+    static bool is_active() { return active; }
+    static bool is_subscribed() { return joined; }
+
+private:
+    static bool active;
+    static bool joined;
+    static uint32_t message_ref;
+    static String join_ref;
+    static String topic;
+    static unsigned long last_heartbeat;
+    static unsigned long last_poll;
+    static char watermark[40];
+
+    static void on_event(WStype_t type, uint8_t *payload, size_t length);
+    static void handle_message(const uint8_t *payload, size_t length);
+    static void send_join();
+    static void send_heartbeat();
+    static void poll_changes();
+    static void advance_watermark(const char *updated_at);
+};
+
+#endif
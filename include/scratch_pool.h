@@ -0,0 +1,44 @@
+#ifndef SCRATCH_POOL_H
+#define SCRATCH_POOL_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "heap_monitor.h"
+#include "text_writer.h"
+
+// SCRATCH_BLOCKS buffers of SCRATCH_BLOCK_SIZE bytes, allocated together at
+// boot before anything else can fragment the heap. Pages, /metrics and
+// Supabase response bodies are written into a block and the block is handed
+// back afterwards, so the largest per-request buffers never come from the
+// heap. acquire() and release() may be called from any task.
+class ScratchPool
+{
+public:
+    static void init();
+    static char *acquire(HeapSubsystem owner);
+    static void release(char *block, size_t used);
+    static size_t block_size();
+    static void append_metrics(TextWriter &out);
+    static void to_json(JsonObject out);
+
+private:
+    static char *blocks;
+};
+
+// A block held for the lifetime of the object, for work that finishes
+// before the function returns. ok() is false when the pool was empty.
+class ScratchText
+{
+public:
+    explicit ScratchText(HeapSubsystem owner);
+    ~ScratchText();
+
+    bool ok() const { return block != nullptr; }
+    TextWriter &text() { return writer; }
+
+private:
+    char *block;
+    TextWriter writer;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef STALL_MONITOR_H
+#define STALL_MONITOR_H
+
+#include <Arduino.h>
+#include "text_writer.h"
+
+enum StallSource : uint8_t
+{
+    STALL_LOOP,   // The Arduino loop task, which also runs setup() and the sunrise
+    STALL_RENDER, // Sunrise frames, due one hold after the last
+    STALL_ASYNC,  // The AsyncTCP task, while a handler in a StallScope runs
+    STALL_SOURCE_COUNT
+};
+
+enum StallTag : uint8_t
+{
+    STALL_TAG_NONE,
+    STALL_TAG_CONNECT_WIFI,
+    STALL_TAG_SYNC_TIME,
+    STALL_TAG_BUTTON_FEEDBACK,
+    STALL_TAG_OTA,
+    STALL_TAG_OTA_ERROR,
+    STALL_TAG_LOOP_WAIT,
+    STALL_TAG_WEB_LED,
+    STALL_TAG_COUNT
+};
+
+struct Heartbeat
+{
+    volatile uint32_t beats;
+    volatile uint32_t expected_ms; // When the next beat is due
+    volatile uint32_t resumed_ms;  // Last beat that came more than STALL_BUDGET_MS late
+    volatile bool paused;          // Not expected to beat until its next beat()
+    volatile StallTag tag;
+};
+
+// Finds where the firmware blocks. The loop, the sunrise and the web server
+// beat a heartbeat, each saying when the next beat is due. A task of its own
+// samples the heartbeats every STALL_SAMPLE_MS; a beat more than
+// STALL_BUDGET_MS late is a stall, timed from when the beat was due to when
+// it came. Stalls go into a histogram per source on /metrics and are counted
+// against the StallScope the blocked task was in for most of the stall.
+// Stalls of STALL_LOG_MS or more are logged, so they reach the persisted log.
+class StallMonitor
+{
+public:
+    static void begin();
+    static void beat(StallSource source, uint32_t allowance_ms = 0);
+    static void pause(StallSource source);
+    static void append_metrics(TextWriter &out);
+    static const char *source_name(StallSource source);
+    static const char *tag_name(StallTag tag);
+
+private:
+    friend class StallScope;
+
+    static Heartbeat heartbeats[STALL_SOURCE_COUNT];
+    static TaskHandle_t task_handle;
+
+    static void monitor_task(void *parameter);
+    static void check(StallSource source, uint32_t now);
+    static void record(StallSource source, uint32_t duration_ms, StallTag tag);
+};
+
+// Names the blocking call the current task is in. Entering and leaving the
+// scope are heartbeats, so a stall before it is not blamed on it. A scope on
+// a paused source, such as the web server between requests, has it beat only
+// for the scope's lifetime.
+class StallScope
+{
+public:
+    StallScope(StallSource source, StallTag tag);
+    ~StallScope();
+
+private:
+    StallSource source;
+    StallTag previous;
+    bool was_paused;
+};
+
+#endif
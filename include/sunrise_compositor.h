@@ -0,0 +1,112 @@
+#ifndef SUNRISE_COMPOSITOR_H
+#define SUNRISE_COMPOSITOR_H
+
+#include <Arduino.h>
+#include "alarm_manager.h"
+#include "sunrise_curve.h"
+#include "sunrise_scene.h"
+#include "config.h"
+
+enum DismissSource : uint8_t
+{
+    DISMISS_NONE = 0,
+    DISMISS_WEB = 1,
+    DISMISS_BUTTON = 2,
+    DISMISS_SNOOZE = 3 // Long press; the alarm comes back after SNOOZE_MINUTES
+};
+
+#define SUNRISE_NO_OWNER 0xFF
+
+// A range of the strip with the layout its sunrises are drawn with
+struct SunriseZone
+{
+    int first;
+    int count;
+    SunriseLayout layout;
+};
+
+enum SunriseState : uint8_t
+{
+    SUNRISE_IDLE,
+    SUNRISE_PLAYING,
+    SUNRISE_ENDED // Waiting for take_ended() to hand it back to the alarm
+};
+
+// One alarm's sunrise, with its own preset, curve and place in the scene
+struct SunriseInstance
+{
+    SunriseState state;
+    volatile DismissSource dismiss;
+    bool exclusive; // No other sunrise shares its LEDs, so it draws straight into the frame
+    bool segment_done;
+    int alarm_id;
+    int zone;
+    int duration_ms;
+    int max_brightness;
+    uint32_t started;
+    ColorPreset preset;
+    SunriseLut *curve; // Kept with the slot, so a preset it played last time is not compiled again
+    SceneCursor scene;
+    SceneSegment segment;
+    int segment_index;
+    uint32_t segment_started;
+    uint32_t segment_length;
+    uint8_t effects;
+    bool shimmer;
+    CRGB16 from;
+    CRGB16 to;
+};
+
+struct Composition
+{
+    CRGB16 *frame;
+    CRGB16 *layer;  // Where sunrises that share LEDs are drawn before they are added to the frame
+    uint8_t *owner; // Lowest playing instance on each LED, SUNRISE_NO_OWNER on dark ones
+    int num_leds;
+    SunriseZone *zones;
+    int zone_count;
+    int zone_capacity;
+    SunriseInstance instances[MAX_CONCURRENT_SUNRISES];
+};
+
+// Plays several sunrises on one strip, each in its own zone and at its own
+// point of the scene, and composites them into one 16-bit frame.
+//
+// Which instance owns each LED is worked out only when a sunrise starts or
+// ends. A frame then draws each playing instance over its own zone and
+// nothing else: an instance alone on its LEDs draws straight into the frame,
+// one that shares LEDs draws into the layer and is stored on the LEDs it owns
+// and added to the rest. A frame costs one pass over the lit LEDs, plus the
+// band samples of each instance, however many zones are playing, and LEDs no
+// sunrise covers are not touched at all.
+class SunriseCompositor
+{
+public:
+    static void begin(Composition &composition, CRGB16 *frame, int num_leds, int zone_capacity);
+    static void begin_strip(Composition &composition, CRGB16 *frame, int num_leds);
+    static void release(Composition &composition);
+    static bool add_zone(Composition &composition, int first, int count, int rows, int origin);
+
+    static SunriseInstance *claim(Composition &composition);
+    static void start(Composition &composition, SunriseInstance &instance, uint32_t now);
+    static uint32_t render(Composition &composition, uint32_t now);
+    static SunriseInstance *take_ended(Composition &composition);
+    static void dismiss(Composition &composition, DismissSource source, int zone);
+
+    static bool is_playing(const Composition &composition);
+    static bool dismiss_pending(const Composition &composition);
+    static int lit_leds(const Composition &composition);
+
+private:
+    static bool next_segment(SunriseInstance &instance, uint32_t now);
+    static void end(Composition &composition, SunriseInstance &instance);
+    static void update_coverage(Composition &composition);
+    static uint32_t draw(SunriseInstance &instance, const SunriseZone &zone, CRGB16 *pixels, uint32_t now);
+    static void blend(Composition &composition, uint8_t index, const SunriseZone &zone);
+    static void add_sparkle_effect(CRGB16 *pixels, int count, float intensity, uint8_t level);
+    static void add_breathing_effect(float progress, uint32_t now, float &brightness_multiplier);
+    static void add_warmth_gradient(CRGB16 *pixels, int count, float progress);
+    static void add_wave_effect(CRGB16 *pixels, int count, float progress, uint32_t now);
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef SUNRISE_CURVE_H
+#define SUNRISE_CURVE_H
+
+#include <FastLED.h>
+#include <Arduino.h>
+#include "alarm_manager.h"
+
+#define SUNRISE_LUT_SIZE 256 // Entries over the animation; frames interpolate between neighbours
+#define SUNRISE_MAX_BANDS 256
+
+// Values for SUNRISE_ORIGIN in config.h
+#define SUNRISE_ORIGIN_UNIFORM 0 // The whole strip shows the same color
+#define SUNRISE_ORIGIN_START 1   // Light rises from the first LED's end
+#define SUNRISE_ORIGIN_END 2
+#define SUNRISE_ORIGIN_CENTER 3
+
+// Linear-light color with 16 bits per channel
+struct CRGB16
+{
+    uint16_t r;
+    uint16_t g;
+    uint16_t b;
+};
+
+// A compiled preset, identified by name and version so a custom preset is
+// recompiled only when its row changes
+struct SunriseLut
+{
+    CRGB16 entries[SUNRISE_LUT_SIZE];
+    char name[PRESET_NAME_LENGTH + 1];
+    int32_t version;
+};
+
+// Position of each LED in a spatial sunrise. LEDs at the same distance from
+// the origin share a band; band 0 lights first and the last band trails by
+// SUNRISE_SPREAD of the animation.
+struct SunriseLayout
+{
+    uint8_t *band;
+    int num_leds;
+    int band_count;
+};
+
+// Compiles a preset into the colors of its sunrise, brightness ramp
+// included. Stage colors are the strip's own PWM values, which are linear
+// light; they are blended in Oklab so a transition keeps its hue instead of
+// passing through grey. Entries keep 16 bits per channel until the frame is
+// scaled to the alarm's brightness, so dim frames are rounded only once.
+// program curves in the native build dumps the curves for reviewing them.
+//
+// render() samples the curve once per band and copies band colors to the
+// frame, so a frame costs SUNRISE_MAX_BANDS samples plus one byte lookup per
+// LED however long the strip is. Frames stay in 16 bits, already scaled to
+// the brightness; TemporalDither turns them into the strip's 8 bits.
+class SunriseCurve
+{
+public:
+    static void compile(const ColorPreset &preset, SunriseLut &lut);
+    static bool is_compiled(const SunriseLut &lut, const ColorPreset &preset);
+    static CRGB16 sample(const SunriseLut &lut, float progress);
+    static CRGB16 scale(CRGB16 color, uint8_t brightness);
+
+    static void build_layout(int num_leds, int rows, int origin, SunriseLayout &layout);
+    static void free_layout(SunriseLayout &layout);
+    static void render(const SunriseLut &lut, const SunriseLayout &layout, float progress, uint8_t brightness, CRGB16 *frame);
+    static void linear_to_oklab(const float rgb[3], float lab[3]);
+
+private:
+    static void oklab_to_linear(const float lab[3], float rgb[3]);
+    static float ease_in_out_quad(float t);
+};
+
+#endif
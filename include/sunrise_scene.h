@@ -0,0 +1,107 @@
+#ifndef SUNRISE_SCENE_H
+#define SUNRISE_SCENE_H
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include <LittleFS.h>
+
+// Scene files are written by tools/compile_scene.py. All numbers are little endian:
+//
+//   header   u32 magic "SCN1", u8 format version, u8 palette size, u16 segment count
+//   palette  palette size x (u8 r, u8 g, u8 b)
+//   segment  u32 duration, u16 frame_ms, u8 flags, u8 easing, u8 from color,
+//            u8 to color, u8 from level, u8 to level, u8 effect count,
+//            effect count x u8 opcode
+//
+// Durations are milliseconds, or ten-thousandths of the alarm's sunrise
+// duration with SCENE_SEGMENT_SCALED. Colors are palette indexes or
+// SCENE_COLOR_CURVE_END. Levels scale the alarm's brightness.
+#define SCENE_MAGIC 0x314E4353 // "SCN1"
+#define SCENE_FORMAT_VERSION 1
+#define SCENE_MAX_EFFECTS 8
+#define SCENE_COLOR_CURVE_END 0xFF // Last color of the preset's sunrise curve
+
+enum SceneSegmentFlag : uint8_t
+{
+    SCENE_SEGMENT_SCALED = 1, // duration is relative to the alarm's duration
+    SCENE_SEGMENT_CURVE = 2   // colors come from the preset's curve instead of from/to
+};
+
+enum SceneEasing : uint8_t
+{
+    SCENE_EASE_LINEAR,
+    SCENE_EASE_IN,
+    SCENE_EASE_OUT,
+    SCENE_EASE_IN_OUT,
+    SCENE_EASE_HOLD, // stays at the start values for the whole segment
+    SCENE_EASE_COUNT
+};
+
+enum SceneEffect : uint8_t
+{
+    SCENE_EFFECT_PRESET,    // the effects selected by the alarm's color preset
+    SCENE_EFFECT_BREATHING,
+    SCENE_EFFECT_SPARKLE,
+    SCENE_EFFECT_WARMTH,
+    SCENE_EFFECT_WAVE,
+    SCENE_EFFECT_SHIMMER,   // slow brightness and warmth drift of the daylight phase
+    SCENE_EFFECT_COUNT
+};
+
+struct SceneSegment
+{
+    uint32_t duration;
+    uint16_t frame_ms; // 0 paces frames like the sunrise: slow at the ends, fast in the middle
+    uint8_t flags;
+    uint8_t easing;
+    uint8_t from_color;
+    uint8_t to_color;
+    uint8_t from_level;
+    uint8_t to_level;
+    uint8_t effect_count;
+    uint8_t effects[SCENE_MAX_EFFECTS];
+    CRGB from; // Palette colors, resolved when the segment is read
+    CRGB to;
+};
+
+// Reads a scene one segment at a time from a LittleFS file or from the
+// built-in default scene. Only the header and the current segment are held
+// in RAM, so a scene's length does not change what playing it costs.
+struct SceneCursor
+{
+    File file;
+    const uint8_t *data;
+    size_t size;
+    size_t position;
+    size_t palette_offset;
+    uint8_t palette_size;
+    uint16_t segment_count;
+    uint16_t next_segment;
+};
+
+class SunriseScene
+{
+public:
+    static void open(SceneCursor &cursor);
+    static bool open_file(const char *path, SceneCursor &cursor);
+    static bool next(SceneCursor &cursor, SceneSegment &segment);
+    static void close(SceneCursor &cursor);
+    static bool validate_file(const char *path, int &segment_count);
+
+    // PUT /api/scene: the body is written to a temporary file chunk by chunk
+    // and replaces SUNRISE_SCENE_FILE only if the whole scene is valid
+    static bool append_upload(size_t index, const uint8_t *data, size_t length);
+    static bool install_upload(int &segment_count);
+    static bool uninstall();
+
+    static float ease(uint8_t easing, float t);
+    static uint32_t segment_length_ms(const SceneSegment &segment, uint32_t sunrise_ms);
+
+private:
+    static bool mount();
+    static bool read(SceneCursor &cursor, size_t offset, uint8_t *buffer, size_t length);
+    static bool read_header(SceneCursor &cursor);
+    static bool read_color(SceneCursor &cursor, uint8_t index, CRGB &color);
+};
+
+#endif
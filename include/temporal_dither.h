@@ -0,0 +1,25 @@
+#ifndef TEMPORAL_DITHER_H
+#define TEMPORAL_DITHER_H
+
+#include <FastLED.h>
+#include <Arduino.h>
+#include "sunrise_curve.h"
+
+// Turns 16-bit frames into the strip's 8 bits. At the start of a sunrise a
+// channel spends minutes between two 8-bit values, and each step from one to
+// the next is a visible jump. dither() keeps what rounding throws away per
+// LED and channel and adds it to the next refresh (first-order delta-sigma),
+// so a channel at 3.4 shows 3 and 4 in a 60:40 mix that the eye averages.
+// This only works when refreshes come much faster than the eye integrates,
+// so LEDController refreshes every DITHER_REFRESH_MS while the frame's
+// brightest channel is below DITHER_MAX_LEVEL, and rounds otherwise.
+class TemporalDither
+{
+public:
+    static void reset(uint16_t *error, int count);
+    static void quantize(const CRGB16 *frame, CRGB *leds, int count);
+    static void dither(const CRGB16 *frame, uint16_t *error, CRGB *leds, int count);
+    static uint8_t peak_level(const CRGB16 *frame, int count);
+};
+
+#endif
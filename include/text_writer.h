@@ -0,0 +1,36 @@
+#ifndef TEXT_WRITER_H
+#define TEXT_WRITER_H
+
+#include <Arduino.h>
+
+// Appends text to a buffer the caller owns, usually a ScratchPool block,
+// without allocating. Text beyond the capacity is cut off and overflowed()
+// is set; the buffer always holds a terminated string.
+class TextWriter
+{
+public:
+    TextWriter(char *buffer, size_t capacity);
+
+    void append(const char *text);
+    void append(const char *text, size_t length);
+    void appendf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    void clear();
+
+    // Lets serializeJson() write straight into the buffer
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *data, size_t length);
+
+    char *data() { return buffer; }
+    const char *c_str() const { return buffer; }
+    size_t length() const { return used; }
+    size_t capacity() const { return size; }
+    bool overflowed() const { return overflow; }
+
+private:
+    char *buffer;
+    size_t size;
+    size_t used;
+    bool overflow;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef TLS_CLIENT_H
+#define TLS_CLIENT_H
+
+#include <WiFi.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+
+// WiFiClient that runs TLS itself on top of the plain TCP socket of its base
+// class. Unlike WiFiClientSecure it keeps the negotiated session in RTC memory,
+// so the first connection after deep sleep resumes it with an abbreviated
+// handshake instead of a full key exchange and certificate transfer.
+// Where bio_recv() is in the server's plaintext handshake records
+struct HandshakeTrace
+{
+    uint8_t record_type;
+    uint8_t record_header_length;
+    uint16_t record_remaining;
+    uint8_t message_header_length;
+    uint32_t message_remaining;
+    bool certificate_seen;
+    bool cipher_changed;
+};
+
+class TlsClient : public WiFiClient
+{
+public:
+    TlsClient();
+    ~TlsClient();
+
+    int connect(IPAddress ip, uint16_t port);
+    int connect(IPAddress ip, uint16_t port, int32_t timeout);
+    int connect(const char *host, uint16_t port);
+    int connect(const char *host, uint16_t port, int32_t timeout);
+    size_t write(uint8_t data);
+    size_t write(const uint8_t *buf, size_t size);
+    int available();
+    int read();
+    int read(uint8_t *buf, size_t size);
+    int peek();
+    void flush();
+    void stop();
+    uint8_t connected();
+
+    // Handshake duration of the connection opened since the last call, 0 if the connection was reused
+    uint32_t take_handshake_us();
+    bool was_resumed() const { return last_resumed; }
+
+    static void forget_session();
+
+private:
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config conf;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_entropy_context entropy;
+    bool configured;
+    bool tls_connected;
+    int peeked;
+    uint32_t handshake_us;
+    bool last_resumed;
+    bool tracing;
+    HandshakeTrace trace;
+
+    bool configure();
+    bool handshake(const char *host, int32_t timeout);
+    bool restore_session(const char *host);
+    void save_session(const char *host);
+
+    static int bio_send(void *ctx, const unsigned char *buf, size_t len);
+    static int bio_recv(void *ctx, unsigned char *buf, size_t len);
+    void trace_records(const unsigned char *buf, size_t len);
+};
+
+#endif
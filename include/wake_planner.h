@@ -0,0 +1,41 @@
+#ifndef WAKE_PLANNER_H
+#define WAKE_PLANNER_H
+
+#include <Arduino.h>
+#include "text_writer.h"
+
+enum WakeKind : uint8_t
+{
+    WAKE_COLD_BOOT = 0,
+    WAKE_ALARM = 1,
+    WAKE_SYNC = 2,
+    WAKE_BUTTON = 3
+};
+
+// Chooses when to wake from deep sleep and whether a wake needs WiFi. Alarm
+// wakes run on the alarms cached in NVS with the radio off. Sync wakes keep
+// the cache no older than SYNC_INTERVAL_S and refresh it SYNC_BEFORE_ALARM_S
+// before each alarm, so a periodic sync that would fall in between is merged
+// into that one. The plan survives deep sleep in RTC memory.
+class WakePlanner
+{
+public:
+    static void begin(esp_sleep_wakeup_cause_t cause);
+    static WakeKind get_wake_kind() { return wake_kind; }
+    static bool needs_radio() { return radio_needed; }
+    static void record_sync(bool success);
+    static uint64_t plan_sleep_us();
+
+    static void estimate_daily(float &wakeups, float &radio_seconds);
+    static void append_metrics(TextWriter &out);
+    static const char *kind_name(WakeKind kind);
+
+private:
+    static WakeKind wake_kind;
+    static bool radio_needed;
+
+    static time_t next_wake(time_t now, time_t sync_at, WakeKind &kind);
+    static bool clock_valid(time_t now) { return now > 1600000000; }
+};
+
+#endif
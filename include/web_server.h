@@ -3,6 +3,8 @@
 
 #include <ESPAsyncWebServer.h>
 #include <Arduino.h>
+#include "alarm_manager.h"
+#include "text_writer.h"
 
 class WebServerManager
 {
@@ -18,8 +20,13 @@ private:
     static bool initialized;
 
     static void setup_routes();
-    static String build_dashboard_html();
-    static String build_logs_html();
+    template <typename Builder>
+    static void send_scratch(AsyncWebServerRequest *request, int code, const char *content_type, Builder build);
+    static void build_dashboard_html(TextWriter &html);
+    static void build_logs_html(TextWriter &html, uint32_t before);
+    static void build_metrics_text(TextWriter &out);
+    static int get_alarm_id_param(AsyncWebServerRequest *request);
+    static void send_alarm_edit_result(AsyncWebServerRequest *request, AlarmEditResult result, int id);
 };
 
 #endif
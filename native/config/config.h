@@ -0,0 +1,13 @@
+// config.h for the native build when include/config.h does not exist: the
+// example values, plus the settings the example leaves to each device
+#include "config.example.h"
+
+#ifndef OTA_HOSTNAME
+#define OTA_HOSTNAME "sunrise-alarm"
+#endif
+#ifndef OTA_PASSWORD
+#define OTA_PASSWORD ""
+#endif
+#ifndef WEB_SERVER_PORT
+#define WEB_SERVER_PORT 80
+#endif
@@ -0,0 +1,511 @@
+// Database for the native build: the same retry loop and statistics as
+// src/database.cpp, with send_once() answering from a FakeSupabase instead of
+// HTTP. The queries understood are the ones the firmware sends.
+
+#include "database.h"
+#include "config.h"
+#include "logger.h"
+#include "metrics.h"
+#include "alarm_manager.h"
+#include "fake_supabase.h"
+#include <ArduinoJson.h>
+#include <mbedtls/base64.h>
+#include <algorithm>
+#include <time.h>
+
+// HTTPClient's codes for the failures the fake produces
+static const int HTTPC_ERROR_CONNECTION_REFUSED = -1;
+static const int HTTPC_ERROR_TOO_LESS_RAM = -8;
+static const int HTTPC_ERROR_READ_TIMEOUT = -11;
+
+String Database::base_url;
+DatabaseStats Database::stats;
+
+static FakeSupabase *fake = nullptr;
+
+void FakeSupabaseHost::attach(FakeSupabase *database)
+{
+    fake = database;
+}
+
+FakeSupabase *FakeSupabaseHost::get()
+{
+    return fake;
+}
+
+int FakeSupabaseHost::count_events(const FakeSupabase &database, const char *event_type)
+{
+    int count = 0;
+    for (int i = 0; i < database.event_count; i++)
+    {
+        if (strcmp(database.events[i].event_type, event_type) == 0)
+            count++;
+    }
+    return count;
+}
+
+void Database::init()
+{
+    base_url = "fake://supabase/rest/v1/";
+}
+
+void Database::init(const char *)
+{
+    init();
+}
+
+void Database::close()
+{
+    if (stats.requests > 0)
+    {
+        LOG_INFO(LOG_MODULE_NETWORK, "Supabase: %lu requests, avg %lu ms", (unsigned long)stats.requests,
+                 (unsigned long)(stats.request_ms / stats.requests));
+    }
+}
+
+int Database::select_rows(const String &table, const String &query, TextWriter &response)
+{
+    return request("GET", table + "?" + query, "", response);
+}
+
+int Database::call_function(const String &name, const String &query, TextWriter &response)
+{
+    return request("GET", "rpc/" + name + "?" + query, "", response);
+}
+
+int Database::insert_rows(const String &table, const String &json_array, const char *on_conflict)
+{
+    char buffer[128];
+    TextWriter response(buffer, sizeof(buffer));
+    return request("POST", table + "?on_conflict=" + on_conflict, json_array, response);
+}
+
+bool Database::update_row(const String &table, int id, const String &json)
+{
+    char buffer[128];
+    TextWriter response(buffer, sizeof(buffer));
+    int code = request("PATCH", table + "?id=eq." + String(id), json, response);
+    return code >= 200 && code < 300;
+}
+
+bool Database::delete_row(const String &table, int id)
+{
+    char buffer[128];
+    TextWriter response(buffer, sizeof(buffer));
+    int code = request("DELETE", table + "?id=eq." + String(id), "", response);
+    return code >= 200 && code < 300;
+}
+
+void Database::append_metrics(TextWriter &out)
+{
+    Metrics::counter(out, "sunrise_db_requests_total", "Supabase REST requests", stats.requests);
+    Metrics::counter(out, "sunrise_db_request_ms_total", "Time spent in Supabase requests excluding TLS handshakes", stats.request_ms);
+}
+
+int Database::request(const char *method, const String &path, const String &body, TextWriter &response,
+                      const char *prefer)
+{
+    int status = 0;
+    for (int attempt = 0; attempt <= DB_MAX_RETRIES; attempt++)
+    {
+        if (attempt > 0)
+        {
+            LOG_WARN(LOG_MODULE_NETWORK, "%s %s failed (%d), retry %d", method, path.c_str(), status, attempt);
+            delay(DB_RETRY_BACKOFF_MS << (attempt - 1));
+        }
+
+        uint32_t start = micros();
+        status = send_once(method, base_url + path, body, response, prefer);
+        stats.requests++;
+        stats.request_ms += (micros() - start) / 1000;
+
+        if (!is_retryable(method, path, status))
+            break;
+    }
+    return status;
+}
+
+bool Database::is_retryable(const char *method, const String &path, int status)
+{
+    if (strcmp(method, "POST") == 0 && path.indexOf("on_conflict=") < 0)
+        return false;
+    return (status <= 0 && status != HTTPC_ERROR_TOO_LESS_RAM) || status == 429 || status >= 500;
+}
+
+// The value of name in a query string, "" when it is missing
+static String query_param(const String &query, const char *name)
+{
+    String key = String(name) + "=";
+    int at = query.startsWith(key) ? 0 : query.indexOf("&" + key);
+    if (at < 0)
+        return "";
+    if (at > 0)
+        at++;
+    int end = query.indexOf('&', at);
+    return query.substring(at + key.length(), end < 0 ? query.length() : end);
+}
+
+static void format_timestamp(uint32_t epoch, char *out, size_t size)
+{
+    time_t at = epoch;
+    struct tm utc;
+    gmtime_r(&at, &utc);
+    strftime(out, size, "%Y-%m-%dT%H:%M:%S+00:00", &utc);
+}
+
+// "2026-01-05T20:00:00+00:00" or with fractional seconds; offsets other than UTC are not used here
+static uint32_t parse_timestamp(const char *text)
+{
+    struct tm utc = {};
+    if (sscanf(text, "%d-%d-%dT%d:%d:%d", &utc.tm_year, &utc.tm_mon, &utc.tm_mday, &utc.tm_hour, &utc.tm_min,
+               &utc.tm_sec) != 6)
+        return 0;
+    utc.tm_year -= 1900;
+    utc.tm_mon -= 1;
+    return (uint32_t)timegm(&utc);
+}
+
+// PostgREST's order=is_enabled.desc,updated_at.desc, ties by id
+static void sorted_alarms(FakeAlarmRow *out, int &count)
+{
+    count = fake->alarm_count;
+    memcpy(out, fake->alarms, count * sizeof(FakeAlarmRow));
+    std::stable_sort(out, out + count, [](const FakeAlarmRow &a, const FakeAlarmRow &b)
+                     {
+        if (a.enabled != b.enabled)
+            return a.enabled;
+        if (a.updated_at != b.updated_at)
+            return a.updated_at > b.updated_at;
+        return a.id < b.id; });
+}
+
+static void write_alarm_rows(const String &query, TextWriter &response)
+{
+    FakeAlarmRow rows[FAKE_SUPABASE_MAX_ALARMS];
+    int count;
+    sorted_alarms(rows, count);
+
+    uint32_t since = 0;
+    String updated_after = query_param(query, "updated_at");
+    if (updated_after.startsWith("gt."))
+        since = parse_timestamp(updated_after.c_str() + 3);
+    String limit_text = query_param(query, "limit");
+    int limit = limit_text.length() > 0 ? limit_text.toInt() : count;
+
+    JsonDocument doc;
+    JsonArray out = doc.to<JsonArray>();
+    for (int i = 0; i < count && (int)out.size() < limit; i++)
+    {
+        const FakeAlarmRow &alarm = rows[i];
+        if (alarm.updated_at <= since)
+            continue;
+
+        JsonObject row = out.add<JsonObject>();
+        char text[32];
+        row["id"] = alarm.id;
+        if (alarm.local_id != 0)
+            row["local_id"] = alarm.local_id;
+        else
+            row["local_id"] = nullptr;
+        snprintf(text, sizeof(text), "%02d:%02d:00", alarm.hour, alarm.minute);
+        row["time"] = text;
+        JsonArray days = row["days_of_week"].to<JsonArray>();
+        for (int day = 0; day < 7; day++)
+        {
+            if (alarm.days_mask & (1 << day))
+                days.add(day);
+        }
+        row["is_enabled"] = alarm.enabled;
+        row["brightness_level"] = alarm.brightness;
+        row["duration_minutes"] = alarm.duration_minutes;
+        row["color_preset"] = alarm.color_preset;
+        row["zone"] = alarm.zone;
+        format_timestamp(alarm.updated_at, text, sizeof(text));
+        row["updated_at"] = text;
+    }
+    serializeJson(doc, response);
+}
+
+static uint32_t fnv1a(const uint8_t *data, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// device_schedule() as in database_setup.sql, with FNV-1a standing in for md5
+// as the version: the device only hands it back
+static void write_schedule(const String &query, TextWriter &response)
+{
+    FakeAlarmRow rows[FAKE_SUPABASE_MAX_ALARMS];
+    int count;
+    sorted_alarms(rows, count);
+    String limit_text = query_param(query, "p_limit");
+    if (limit_text.length() > 0)
+        count = min(count, (int)limit_text.toInt());
+
+    uint8_t payload[SCHEDULE_HEADER_SIZE + FAKE_SUPABASE_MAX_ALARMS * (SCHEDULE_RECORD_SIZE + 1 + PRESET_NAME_LENGTH)];
+    const char *presets[FAKE_SUPABASE_MAX_ALARMS];
+    int preset_count = 0;
+    size_t length = SCHEDULE_HEADER_SIZE;
+    uint8_t preset_index[FAKE_SUPABASE_MAX_ALARMS];
+    for (int i = 0; i < count; i++)
+    {
+        const char *name = rows[i].color_preset[0] != '\0' ? rows[i].color_preset : "sunrise";
+        int index = 0;
+        while (index < preset_count && strcmp(presets[index], name) != 0)
+            index++;
+        if (index == preset_count)
+        {
+            presets[preset_count++] = name;
+            size_t name_length = min(strlen(name), (size_t)PRESET_NAME_LENGTH);
+            payload[length++] = name_length;
+            memcpy(payload + length, name, name_length);
+            length += name_length;
+        }
+        preset_index[i] = index;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        const FakeAlarmRow &alarm = rows[i];
+        uint8_t *record = payload + length;
+        uint16_t minute_of_day = alarm.hour * 60 + alarm.minute;
+        record[0] = alarm.id >> 24;
+        record[1] = alarm.id >> 16;
+        record[2] = alarm.id >> 8;
+        record[3] = alarm.id;
+        record[4] = alarm.updated_at >> 24;
+        record[5] = alarm.updated_at >> 16;
+        record[6] = alarm.updated_at >> 8;
+        record[7] = alarm.updated_at;
+        record[8] = alarm.duration_minutes >> 8;
+        record[9] = alarm.duration_minutes;
+        record[10] = minute_of_day >> 8;
+        record[11] = minute_of_day;
+        record[12] = alarm.days_mask;
+        record[13] = alarm.enabled ? 1 : 0;
+        record[14] = alarm.brightness;
+        record[15] = alarm.zone;
+        record[16] = preset_index[i];
+        length += SCHEDULE_RECORD_SIZE;
+    }
+
+    uint32_t version = fnv1a(payload + SCHEDULE_HEADER_SIZE, length - SCHEDULE_HEADER_SIZE);
+    char version_text[9];
+    snprintf(version_text, sizeof(version_text), "%08lx", (unsigned long)version);
+    if (query_param(query, "p_version") == version_text)
+    {
+        response.append("\"\"");
+        return;
+    }
+
+    payload[0] = SCHEDULE_FORMAT_VERSION;
+    payload[1] = count;
+    payload[2] = preset_count;
+    payload[3] = 0;
+    payload[4] = version >> 24;
+    payload[5] = version >> 16;
+    payload[6] = version >> 8;
+    payload[7] = version;
+
+    unsigned char encoded[sizeof(payload) * 4 / 3 + 4];
+    size_t encoded_length = 0;
+    mbedtls_base64_encode(encoded, sizeof(encoded), &encoded_length, payload, length);
+    response.append("\"");
+    response.append((const char *)encoded, encoded_length);
+    response.append("\"");
+}
+
+static FakeAlarmRow *find_alarm(int id)
+{
+    for (int i = 0; i < fake->alarm_count; i++)
+    {
+        if (fake->alarms[i].id == id)
+            return &fake->alarms[i];
+    }
+    return nullptr;
+}
+
+// The columns alarm_to_row_json() writes
+static void read_alarm_row(JsonObjectConst row, FakeAlarmRow &alarm)
+{
+    int hour, minute;
+    if (sscanf(row["time"] | "", "%d:%d", &hour, &minute) == 2)
+    {
+        alarm.hour = hour;
+        alarm.minute = minute;
+    }
+    if (row["days_of_week"].is<JsonArrayConst>())
+    {
+        alarm.days_mask = 0;
+        for (JsonVariantConst day : row["days_of_week"].as<JsonArrayConst>())
+            alarm.days_mask |= 1 << ((day.as<int>()) & 7);
+    }
+    alarm.enabled = row["is_enabled"] | alarm.enabled;
+    alarm.brightness = row["brightness_level"] | alarm.brightness;
+    alarm.duration_minutes = row["duration_minutes"] | alarm.duration_minutes;
+    alarm.zone = row["zone"] | alarm.zone;
+    strlcpy(alarm.color_preset, row["color_preset"] | (const char *)alarm.color_preset, sizeof(alarm.color_preset));
+    alarm.updated_at = time(nullptr);
+}
+
+static bool has_local_id(int local_id)
+{
+    if (local_id == 0)
+        return false;
+    for (int i = 0; i < fake->alarm_count; i++)
+    {
+        if (fake->alarms[i].local_id == local_id)
+            return true;
+    }
+    return false;
+}
+
+static int insert_alarm(JsonObjectConst row, bool ignore_duplicates)
+{
+    int local_id = row["local_id"] | 0;
+    if (ignore_duplicates && has_local_id(local_id))
+        return 201;
+    if (fake->alarm_count >= FAKE_SUPABASE_MAX_ALARMS)
+        return 507;
+
+    FakeAlarmRow &alarm = fake->alarms[fake->alarm_count++];
+    memset(&alarm, 0, sizeof(alarm));
+    alarm.id = row["id"] | fake->next_id;
+    alarm.local_id = local_id;
+    fake->next_id = max(fake->next_id, alarm.id + 1);
+    alarm.enabled = true;
+    alarm.brightness = 255;
+    alarm.duration_minutes = 30;
+    read_alarm_row(row, alarm);
+    return 201;
+}
+
+// A row or an array of rows. With on_conflict=device_id,local_id a row whose
+// local_id is stored already is skipped, like resolution=ignore-duplicates.
+static int insert_alarms(const String &query, const String &body)
+{
+    JsonDocument doc;
+    if (deserializeJson(doc, body.c_str(), body.length()))
+        return 400;
+    bool ignore_duplicates = query_param(query, "on_conflict") == "device_id,local_id";
+    if (doc.is<JsonObject>())
+        return insert_alarm(doc.as<JsonObjectConst>(), ignore_duplicates);
+    if (!doc.is<JsonArray>())
+        return 400;
+
+    for (JsonObjectConst row : doc.as<JsonArrayConst>())
+    {
+        int status = insert_alarm(row, ignore_duplicates);
+        if (status != 201)
+            return status;
+    }
+    return 201;
+}
+
+static int write_alarm(const char *method, int id, const String &body)
+{
+    JsonDocument doc;
+    if (strcmp(method, "DELETE") != 0 && (deserializeJson(doc, body.c_str(), body.length()) || !doc.is<JsonObject>()))
+        return 400;
+
+    FakeAlarmRow *alarm = find_alarm(id);
+    if (alarm == nullptr)
+        return 204;
+    if (strcmp(method, "PATCH") == 0)
+    {
+        read_alarm_row(doc.as<JsonObjectConst>(), *alarm);
+        return 204;
+    }
+    int index = alarm - fake->alarms;
+    memmove(alarm, alarm + 1, (fake->alarm_count - index - 1) * sizeof(FakeAlarmRow));
+    fake->alarm_count--;
+    return 204;
+}
+
+// Rows whose sequence is already stored are skipped, like on_conflict=device_id,sequence
+static int insert_events(const String &body)
+{
+    JsonDocument doc;
+    if (deserializeJson(doc, body.c_str(), body.length()) || !doc.is<JsonArray>())
+        return 400;
+    for (JsonObjectConst row : doc.as<JsonArrayConst>())
+    {
+        uint32_t sequence = row["sequence"] | 0u;
+        bool duplicate = false;
+        for (int i = 0; i < fake->event_count && !duplicate; i++)
+            duplicate = fake->events[i].sequence == sequence;
+        if (duplicate || fake->event_count >= FAKE_SUPABASE_MAX_EVENTS)
+            continue;
+
+        FakeEventRow &event = fake->events[fake->event_count++];
+        event.sequence = sequence;
+        event.alarm_id = row["alarm_id"] | 0;
+        strlcpy(event.event_type, row["event_type"] | "", sizeof(event.event_type));
+        event.occurred_at = parse_timestamp(row["occurred_at"] | "");
+        event.sunrise_seconds = row["sunrise_seconds"] | 0;
+    }
+    return 201;
+}
+
+int Database::send_once(const char *method, const String &url, const String &body, TextWriter &response, const char *)
+{
+    response.clear();
+    if (fake == nullptr)
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    delay(fake->request_ms);
+    fake->requests++;
+    if (fake->failing)
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+
+    String path = url.substring(base_url.length());
+    int separator = path.indexOf('?');
+    String resource = separator < 0 ? path : path.substring(0, separator);
+    String query = separator < 0 ? "" : path.substring(separator + 1);
+    String id_filter = query_param(query, "id");
+    int id = id_filter.startsWith("eq.") ? id_filter.substring(3).toInt() : 0;
+
+    int status = 404;
+    if (resource == "alarms" && strcmp(method, "GET") == 0)
+    {
+        write_alarm_rows(query, response);
+        fake->alarm_reads++;
+        status = 200;
+    }
+    else if (resource == "alarms" && strcmp(method, "POST") == 0)
+    {
+        status = insert_alarms(query, body);
+    }
+    else if (resource == "alarms")
+    {
+        status = write_alarm(method, id, body);
+    }
+    else if (resource == "rpc/device_schedule" && fake->schedule_function)
+    {
+        write_schedule(query, response);
+        fake->alarm_reads++;
+        status = 200;
+    }
+    else if (resource == "color_presets")
+    {
+        response.append("[]");
+        status = 200;
+    }
+    else if (resource == "alarm_events" && strcmp(method, "POST") == 0)
+    {
+        status = insert_events(body);
+    }
+
+    if (fake->requests == fake->lost_request)
+    {
+        response.clear();
+        return HTTPC_ERROR_READ_TIMEOUT;
+    }
+    if (response.overflowed() && status < 300 && strcmp(method, "GET") == 0)
+        return HTTPC_ERROR_TOO_LESS_RAM;
+    return status;
+}
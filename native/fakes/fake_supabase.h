@@ -0,0 +1,62 @@
+#ifndef FAKE_SUPABASE_H
+#define FAKE_SUPABASE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FAKE_SUPABASE_MAX_ALARMS 32
+#define FAKE_SUPABASE_MAX_EVENTS 4096
+
+struct FakeAlarmRow
+{
+    int32_t id;
+    int32_t local_id; // The device's id for an alarm it created, else 0 for NULL
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t days_mask; // Bit 0 = Sunday, like tm_wday
+    bool enabled;
+    uint8_t brightness;
+    uint16_t duration_minutes;
+    uint8_t zone;
+    char color_preset[16];
+    uint32_t updated_at;
+};
+
+struct FakeEventRow
+{
+    uint32_t sequence;
+    int32_t alarm_id;
+    char event_type[12];
+    uint32_t occurred_at;
+    uint16_t sunrise_seconds;
+};
+
+// The alarms and alarm_events tables behind the native build's Database.
+// Plain data, so a driver can keep it in memory shared with the forked boots
+// and edit it between them.
+struct FakeSupabase
+{
+    FakeAlarmRow alarms[FAKE_SUPABASE_MAX_ALARMS];
+    int alarm_count;
+    int32_t next_id;
+    FakeEventRow events[FAKE_SUPABASE_MAX_EVENTS];
+    int event_count;
+
+    bool failing;           // Every request fails like an unreachable host
+    uint32_t lost_request;  // This request (counting from 1) is carried out, then times out before the answer
+    bool schedule_function; // Whether device_schedule() exists, else it answers 404
+    uint32_t request_ms;    // Round trip of each request
+    uint32_t requests;
+    uint32_t alarm_reads; // Successful reads of the alarm table or schedule
+};
+
+namespace FakeSupabaseHost
+{
+    void attach(FakeSupabase *database);
+    FakeSupabase *get();
+
+    // Counts the uploaded events of this type ("fired", "missed", ...)
+    int count_events(const FakeSupabase &database, const char *event_type);
+}
+
+#endif
@@ -0,0 +1,58 @@
+// Uploads arrive through the web server, which the native build does not
+// run, so no upload is ever in progress
+
+#include "ota_receiver.h"
+
+volatile bool OtaReceiver::receiving = false;
+volatile uint32_t OtaReceiver::received = 0;
+uint32_t OtaReceiver::body_size = 0;
+uint32_t OtaReceiver::written = 0;
+uint32_t OtaReceiver::started_at = 0;
+uint32_t OtaReceiver::completed_at = 0;
+const char *OtaReceiver::error = nullptr;
+volatile bool OtaReceiver::failed = false;
+
+bool OtaReceiver::begin(size_t, size_t, const char *, const char *)
+{
+    return fail("not supported by the native build");
+}
+
+bool OtaReceiver::write(const uint8_t *, size_t)
+{
+    return false;
+}
+
+bool OtaReceiver::end()
+{
+    return false;
+}
+
+void OtaReceiver::abort()
+{
+}
+
+bool OtaReceiver::get_progress(uint32_t &progress, uint32_t &total)
+{
+    progress = received;
+    total = body_size;
+    return receiving;
+}
+
+bool OtaReceiver::should_restart()
+{
+    return false;
+}
+
+bool OtaReceiver::take_failure()
+{
+    bool was_failed = failed;
+    failed = false;
+    return was_failed;
+}
+
+bool OtaReceiver::fail(const char *reason)
+{
+    failed = true;
+    error = reason;
+    return false;
+}
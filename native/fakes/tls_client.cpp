@@ -0,0 +1,89 @@
+// TlsClient for the host build, which has no mbedTLS: every https:// request
+// is refused, so only a plain http:// SUPABASE_URL such as
+// tools/mock_postgrest.py is reachable. The rest is the plain WiFiClient.
+
+#include "tls_client.h"
+
+TlsClient::TlsClient()
+    : configured(false), tls_connected(false), peeked(-1), handshake_us(0), last_resumed(false), tracing(false)
+{
+}
+
+TlsClient::~TlsClient()
+{
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port)
+{
+    return connect(ip, port, 3000);
+}
+
+int TlsClient::connect(IPAddress, uint16_t, int32_t)
+{
+    fprintf(stderr, "TlsClient: no TLS in the host build, use an http:// SUPABASE_URL\n");
+    return 0;
+}
+
+int TlsClient::connect(const char *host, uint16_t port)
+{
+    return connect(host, port, 3000);
+}
+
+int TlsClient::connect(const char *host, uint16_t port, int32_t)
+{
+    fprintf(stderr, "TlsClient: no TLS in the host build, cannot reach %s:%u\n", host, (unsigned)port);
+    return 0;
+}
+
+size_t TlsClient::write(uint8_t data)
+{
+    return WiFiClient::write(data);
+}
+
+size_t TlsClient::write(const uint8_t *buf, size_t size)
+{
+    return WiFiClient::write(buf, size);
+}
+
+int TlsClient::available()
+{
+    return WiFiClient::available();
+}
+
+int TlsClient::read()
+{
+    return WiFiClient::read();
+}
+
+int TlsClient::read(uint8_t *buf, size_t size)
+{
+    return WiFiClient::read(buf, size);
+}
+
+int TlsClient::peek()
+{
+    return WiFiClient::peek();
+}
+
+void TlsClient::flush()
+{
+}
+
+void TlsClient::stop()
+{
+    WiFiClient::stop();
+}
+
+uint8_t TlsClient::connected()
+{
+    return WiFiClient::connected();
+}
+
+uint32_t TlsClient::take_handshake_us()
+{
+    return 0;
+}
+
+void TlsClient::forget_session()
+{
+}
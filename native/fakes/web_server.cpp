@@ -0,0 +1,31 @@
+// The web server needs ESPAsyncWebServer and lwIP, so the native build serves
+// nothing. The activity window keeps src/web_server.cpp's logic, since
+// should_stay_awake() depends on it.
+
+#include "web_server.h"
+
+AsyncWebServer *WebServerManager::server = nullptr;
+unsigned long WebServerManager::last_web_request = 0;
+bool WebServerManager::initialized = false;
+
+void WebServerManager::init()
+{
+    initialized = true;
+}
+
+void WebServerManager::track_activity()
+{
+    last_web_request = millis();
+}
+
+// last_web_request starts at 0, which would otherwise count the first minute
+// after every boot as activity and keep each wake up with WiFi on
+bool WebServerManager::has_recent_activity()
+{
+    return last_web_request != 0 && millis() - last_web_request < 60000;
+}
+
+unsigned long WebServerManager::get_last_activity_time()
+{
+    return last_web_request;
+}
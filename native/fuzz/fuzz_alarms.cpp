@@ -0,0 +1,119 @@
+// Fuzz target for the alarm ingestion path: a PostgREST alarms body through
+// ArduinoJson and AlarmManager::decode_rows(), the same bytes as a time string
+// through parse_time() and as a device_schedule() result through
+// unwrap_schedule() and decode_schedule(). Seed it with tools/corpus/alarms,
+// see "Parser Fuzzing" in README.md.
+
+#include <ArduinoJson.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alarm_manager.h"
+#include "config.h"
+#include "native_host.h"
+
+// Aborts like a sanitizer finding, so libFuzzer saves the input
+#define FUZZ_CHECK(condition)                                                         \
+    do                                                                                \
+    {                                                                                 \
+        if (!(condition))                                                             \
+        {                                                                             \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            abort();                                                                  \
+        }                                                                             \
+    } while (0)
+
+struct AlarmParserFuzz
+{
+    static void check_decoded(const Alarm alarms[], int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            FUZZ_CHECK(alarms[i].id != 0);
+            FUZZ_CHECK(AlarmManager::is_valid_alarm(alarms[i]));
+            FUZZ_CHECK(memchr(alarms[i].color_preset, '\0', sizeof(alarms[i].color_preset)) != nullptr);
+        }
+    }
+
+    static void rows(const uint8_t *data, size_t size)
+    {
+        JsonDocument doc;
+        if (deserializeJson(doc, (const char *)data, size) || !doc.is<JsonArrayConst>())
+            return;
+
+        JsonArrayConst rows = doc.as<JsonArrayConst>();
+        Alarm alarms[MAX_ALARMS];
+        int skipped = -1;
+        int count = AlarmManager::decode_rows(rows, alarms, MAX_ALARMS, skipped);
+
+        FUZZ_CHECK(count >= 0 && count <= MAX_ALARMS);
+        FUZZ_CHECK(skipped >= 0 && count + skipped <= (int)rows.size());
+        // Only a full table stops the loop early
+        FUZZ_CHECK(count == MAX_ALARMS || count + skipped == (int)rows.size());
+        check_decoded(alarms, count);
+    }
+
+    static void time_string(const uint8_t *data, size_t size)
+    {
+        char *text = (char *)calloc(size + 1, 1);
+        if (size > 0)
+            memcpy(text, data, size);
+
+        int hour = -1;
+        int minute = -1;
+        if (AlarmManager::parse_time(text, hour, minute))
+        {
+            FUZZ_CHECK(hour >= 0 && hour <= 23 && minute >= 0 && minute <= 59);
+
+            // What was accepted must come back the same in the canonical form
+            char canonical[8];
+            int again_hour = -1;
+            int again_minute = -1;
+            snprintf(canonical, sizeof(canonical), "%02d:%02d", hour, minute);
+            FUZZ_CHECK(AlarmManager::parse_time(canonical, again_hour, again_minute));
+            FUZZ_CHECK(again_hour == hour && again_minute == minute);
+        }
+        free(text);
+    }
+
+    static void schedule(const uint8_t *data, size_t size)
+    {
+        Alarm alarms[MAX_ALARMS];
+        int skipped = -1;
+        uint32_t version = 0;
+
+        int count = AlarmManager::decode_schedule(data, size, alarms, MAX_ALARMS, skipped, version);
+        FUZZ_CHECK(count >= -1 && count <= MAX_ALARMS);
+        if (count > 0)
+            check_decoded(alarms, count);
+
+        // The function's JSON string result, wrapping the payload in base64
+        size_t capacity = size * 3 / 4 + 1;
+        uint8_t *payload = (uint8_t *)malloc(capacity);
+        size_t payload_length = 0;
+        if (AlarmManager::unwrap_schedule((const char *)data, size, payload, capacity, payload_length))
+        {
+            FUZZ_CHECK(payload_length <= capacity);
+            count = AlarmManager::decode_schedule(payload, payload_length, alarms, MAX_ALARMS, skipped, version);
+            FUZZ_CHECK(count >= -1 && count <= MAX_ALARMS);
+            if (count > 0)
+                check_decoded(alarms, count);
+        }
+        free(payload);
+    }
+};
+
+extern "C" int LLVMFuzzerInitialize(int *, char ***)
+{
+    // Skipped rows log a warning each, which would drown the fuzzer's output
+    NativeHost::set_serial(nullptr);
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    AlarmParserFuzz::rows(data, size);
+    AlarmParserFuzz::time_string(data, size);
+    AlarmParserFuzz::schedule(data, size);
+    return 0;
+}
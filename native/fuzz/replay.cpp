@@ -0,0 +1,119 @@
+// Stand-in for libFuzzer's main() on hosts without clang (the native_fuzz_replay
+// environment): runs the fuzz target once on each file given, or on each file
+// of a directory, under the sanitizers the environment was built with. Alarm
+// tables are also timed through AlarmManager::benchmark_parse(), which gives
+// the corpus's rows/s and bytes allocated per row on the host.
+
+#ifndef NATIVE_LIBFUZZER
+
+#include <algorithm>
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include "alarm_manager.h"
+#include "native_host.h"
+
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv);
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static bool read_file(const char *path, std::vector<uint8_t> &data)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+        return false;
+
+    uint8_t buffer[4096];
+    size_t length;
+    data.clear();
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        data.insert(data.end(), buffer, buffer + length);
+    fclose(file);
+    return true;
+}
+
+static void list_inputs(const char *path, std::vector<std::string> &inputs)
+{
+    struct stat info;
+    if (stat(path, &info) != 0 || !S_ISDIR(info.st_mode))
+    {
+        inputs.push_back(path);
+        return;
+    }
+
+    DIR *dir = opendir(path);
+    if (dir == nullptr)
+        return;
+    std::vector<std::string> names;
+    while (struct dirent *entry = readdir(dir))
+    {
+        if (entry->d_name[0] != '.')
+            names.push_back(std::string(path) + "/" + entry->d_name);
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    inputs.insert(inputs.end(), names.begin(), names.end());
+}
+
+static void benchmark(const char *path, const std::vector<uint8_t> &data, int iterations)
+{
+    ParseBenchmark result;
+    if (!AlarmManager::benchmark_parse((const char *)data.data(), data.size(), iterations, result))
+    {
+        printf("%-40s %s\n", path, result.error);
+        return;
+    }
+
+    double seconds = result.micros / 1e6;
+    double rows_per_s = seconds > 0 ? result.total_rows * (double)iterations / seconds : 0;
+    printf("%-40s %5d rows %4d skipped %10.0f rows/s %6.1f B/row\n", path, result.total_rows, result.skipped,
+           rows_per_s, result.total_rows ? (double)result.bytes_allocated / result.total_rows : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = 100;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else if (argv[i][0] == '-')
+        {
+            fprintf(stderr, "usage: program [--iterations N] file|directory...\n");
+            return 2;
+        }
+        else
+            list_inputs(argv[i], inputs);
+    }
+    if (inputs.empty())
+    {
+        fprintf(stderr, "usage: program [--iterations N] file|directory...\n");
+        return 2;
+    }
+
+    LLVMFuzzerInitialize(&argc, &argv);
+    NativeHost::use_host_clock(true);
+
+    int failed = 0;
+    for (const std::string &path : inputs)
+    {
+        std::vector<uint8_t> data;
+        if (!read_file(path.c_str(), data))
+        {
+            fprintf(stderr, "%s: cannot read\n", path.c_str());
+            failed++;
+            continue;
+        }
+        // A finding aborts inside the target, like under libFuzzer
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+        benchmark(path.c_str(), data, iterations > 0 ? iterations : 1);
+    }
+    return failed ? 1 : 0;
+}
+
+#endif
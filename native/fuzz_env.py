@@ -0,0 +1,11 @@
+# PlatformIO pre-script for the fuzz environments. The sanitizers named by
+# custom_sanitizers have to reach the linker as well as the compiler, which
+# build_flags does not do; libFuzzer also needs clang.
+Import("env")
+
+sanitizers = env.GetProjectOption("custom_sanitizers", "")
+if "fuzzer" in sanitizers.split(","):
+    env.Replace(CC="clang", CXX="clang++")
+
+flags = ["-fsanitize=" + sanitizers, "-fno-omit-frame-pointer", "-g"]
+env.Append(CCFLAGS=flags, LINKFLAGS=flags)
@@ -0,0 +1,9 @@
+# PlatformIO pre-script for the native environments: without an
+# include/config.h the build falls back to native/config/config.h, which
+# takes the values from config.example.h
+import os
+
+Import("env")
+
+if not os.path.exists(os.path.join(env["PROJECT_DIR"], "include", "config.h")):
+    env.Prepend(CPPPATH=[os.path.join(env["PROJECT_DIR"], "native", "config")])
@@ -0,0 +1,129 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// The parts of the ESP32 Arduino core the firmware uses, for building it on
+// the host (PlatformIO's native platform). Time is virtual and tasks are
+// coroutines on one thread; see native_host.h.
+
+#include <algorithm>
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "WString.h"
+#include "native_host.h"
+#include "esp_sleep.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#if !defined(__ELF__)
+#error "The native build keeps RTC_DATA_ATTR variables in an ELF section; build it on Linux"
+#endif
+
+// Variables that survive deep sleep sit together, so the host can save and
+// restore them as one block around each simulated sleep
+#define RTC_DATA_ATTR __attribute__((section("rtc_data")))
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+using std::max;
+using std::min;
+
+#define LOW 0x0
+#define HIGH 0x1
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define PULLUP 0x04
+#define INPUT_PULLUP 0x05
+#define PULLDOWN 0x08
+#define INPUT_PULLDOWN 0x09
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+// newlib has it, glibc only from 2.38
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char *destination, const char *source, size_t size);
+#endif
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+#define digitalPinToInterrupt(pin) (pin)
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t pin);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+void configTime(long gmt_offset_sec, int daylight_offset_sec, const char *server1, const char *server2 = nullptr,
+                const char *server3 = nullptr);
+bool getLocalTime(struct tm *info, uint32_t ms = 5000);
+
+// Stream as far as HTTPClient::writeToStream() writes to one
+class Stream
+{
+public:
+    virtual ~Stream() {}
+    virtual size_t write(uint8_t data) = 0;
+    virtual size_t write(const uint8_t *data, size_t size) = 0;
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() = 0;
+};
+
+class HardwareSerial
+{
+public:
+    void begin(unsigned long) {}
+    void end() {}
+    int available() { return 0; }
+    int read() { return -1; }
+    void flush();
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *data, size_t length);
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    size_t print(const char *text);
+    size_t print(const String &text) { return print(text.c_str()); }
+    size_t print(long value);
+    size_t println(const char *text = "");
+    size_t println(const String &text) { return println(text.c_str()); }
+    size_t println(long value);
+    operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+class EspClass
+{
+public:
+    uint32_t getHeapSize();
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+    [[noreturn]] void restart();
+};
+
+extern EspClass ESP;
+
+#endif
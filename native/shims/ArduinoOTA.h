@@ -0,0 +1,48 @@
+#ifndef ARDUINOOTA_H
+#define ARDUINOOTA_H
+
+#include <Arduino.h>
+#include <functional>
+
+#define U_FLASH 0
+#define U_SPIFFS 100
+
+typedef enum
+{
+    OTA_AUTH_ERROR,
+    OTA_BEGIN_ERROR,
+    OTA_CONNECT_ERROR,
+    OTA_RECEIVE_ERROR,
+    OTA_END_ERROR
+} ota_error_t;
+
+// Nothing ever connects, so the handlers are kept but never called
+class ArduinoOTAClass
+{
+public:
+    typedef std::function<void(void)> THandlerFunction;
+    typedef std::function<void(ota_error_t)> THandlerFunction_Error;
+    typedef std::function<void(unsigned int, unsigned int)> THandlerFunction_Progress;
+
+    ArduinoOTAClass &setHostname(const char *) { return *this; }
+    ArduinoOTAClass &setPassword(const char *) { return *this; }
+    ArduinoOTAClass &setPort(uint16_t) { return *this; }
+    ArduinoOTAClass &onStart(THandlerFunction handler);
+    ArduinoOTAClass &onEnd(THandlerFunction handler);
+    ArduinoOTAClass &onError(THandlerFunction_Error handler);
+    ArduinoOTAClass &onProgress(THandlerFunction_Progress handler);
+    void begin() {}
+    void end() {}
+    void handle() {}
+    int getCommand() { return U_FLASH; }
+
+private:
+    THandlerFunction start_handler;
+    THandlerFunction end_handler;
+    THandlerFunction_Error error_handler;
+    THandlerFunction_Progress progress_handler;
+};
+
+extern ArduinoOTAClass ArduinoOTA;
+
+#endif
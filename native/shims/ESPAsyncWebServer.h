@@ -0,0 +1,9 @@
+#ifndef ESPASYNCWEBSERVER_H
+#define ESPASYNCWEBSERVER_H
+
+// The web server is replaced by native/fakes/web_server.cpp; web_server.h
+// only needs the names
+class AsyncWebServer;
+class AsyncWebServerRequest;
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef FS_H
+#define FS_H
+
+#include <Arduino.h>
+#include <memory>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+enum SeekMode
+{
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+};
+
+namespace fs
+{
+    class FileImpl;
+
+    // A file or directory below the flash directory; copies share the handle
+    class File
+    {
+    public:
+        File() {}
+        explicit File(std::shared_ptr<FileImpl> impl) : impl(impl) {}
+
+        size_t write(uint8_t c);
+        size_t write(const uint8_t *data, size_t length);
+        int available();
+        int read();
+        size_t read(uint8_t *buffer, size_t length);
+        int peek();
+        void flush();
+        bool seek(uint32_t position, SeekMode mode = SeekSet);
+        size_t position() const;
+        size_t size() const;
+        void close();
+        operator bool() const;
+        const char *path() const;
+        const char *name() const;
+        bool isDirectory() const;
+        File openNextFile(const char *mode = FILE_READ);
+        void rewindDirectory();
+
+    private:
+        std::shared_ptr<FileImpl> impl;
+    };
+
+    // Paths are absolute within the file system, as on the device
+    class FS
+    {
+    public:
+        explicit FS(const char *subdirectory) : subdirectory(subdirectory) {}
+
+        File open(const char *path, const char *mode = FILE_READ, bool create = false);
+        File open(const String &path, const char *mode = FILE_READ, bool create = false)
+        {
+            return open(path.c_str(), mode, create);
+        }
+        bool exists(const char *path);
+        bool exists(const String &path) { return exists(path.c_str()); }
+        bool remove(const char *path);
+        bool remove(const String &path) { return remove(path.c_str()); }
+        bool rename(const char *from, const char *to);
+        bool rename(const String &from, const String &to) { return rename(from.c_str(), to.c_str()); }
+        bool mkdir(const char *path);
+        bool mkdir(const String &path) { return mkdir(path.c_str()); }
+        bool rmdir(const char *path);
+        bool rmdir(const String &path) { return rmdir(path.c_str()); }
+
+        // The host path of path
+        String host_path(const char *path) const;
+
+    protected:
+        const char *subdirectory;
+        bool mounted = false;
+    };
+}
+
+using fs::File;
+using fs::FS;
+
+#endif
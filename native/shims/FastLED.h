@@ -0,0 +1,234 @@
+#ifndef FASTLED_H
+#define FASTLED_H
+
+// The parts of FastLED the firmware uses. The 8-bit math and the random
+// generator are FastLED's own formulas, so frames match the device bit for
+// bit; show() hands the frame to the NativeEnvironment and takes as long as
+// writing the strip would.
+
+#include <stdint.h>
+#include <string.h>
+
+typedef uint8_t fract8;
+
+enum EOrder
+{
+    RGB = 0012,
+    RBG = 0021,
+    GRB = 0102,
+    GBR = 0120,
+    BRG = 0201,
+    BGR = 0210,
+};
+
+struct CRGB
+{
+    union
+    {
+        struct
+        {
+            uint8_t r;
+            uint8_t g;
+            uint8_t b;
+        };
+        uint8_t raw[3];
+    };
+
+    typedef enum : uint32_t
+    {
+        Black = 0x000000,
+        Blue = 0x0000FF,
+        Green = 0x008000,
+        Orange = 0xFFA500,
+        Red = 0xFF0000,
+        White = 0xFFFFFF,
+        Yellow = 0xFFFF00,
+    } HTMLColorCode;
+
+    CRGB() = default;
+    constexpr CRGB(uint8_t ir, uint8_t ig, uint8_t ib) : r(ir), g(ig), b(ib) {}
+    constexpr CRGB(uint32_t colorcode) : r((colorcode >> 16) & 0xFF), g((colorcode >> 8) & 0xFF), b(colorcode & 0xFF) {}
+    constexpr CRGB(HTMLColorCode colorcode) : CRGB((uint32_t)colorcode) {}
+
+    uint8_t &operator[](uint8_t index) { return raw[index]; }
+    const uint8_t &operator[](uint8_t index) const { return raw[index]; }
+
+    CRGB &nscale8(uint8_t scale);
+    CRGB &fadeToBlackBy(uint8_t amount) { return nscale8(255 - amount); }
+    CRGB &operator+=(const CRGB &other);
+    explicit operator bool() const { return r || g || b; }
+};
+
+inline bool operator==(const CRGB &left, const CRGB &right)
+{
+    return left.r == right.r && left.g == right.g && left.b == right.b;
+}
+
+inline bool operator!=(const CRGB &left, const CRGB &right)
+{
+    return !(left == right);
+}
+
+struct CHSV
+{
+    uint8_t h;
+    uint8_t s;
+    uint8_t v;
+
+    CHSV() = default;
+    constexpr CHSV(uint8_t ih, uint8_t is, uint8_t iv) : h(ih), s(is), v(iv) {}
+};
+
+// FastLED's scale8 with FASTLED_SCALE8_FIXED, its default
+inline uint8_t scale8(uint8_t i, fract8 scale)
+{
+    return ((uint16_t)i * (1 + (uint16_t)scale)) >> 8;
+}
+
+inline uint8_t scale8_video(uint8_t i, fract8 scale)
+{
+    return (((int)i * (int)scale) >> 8) + ((i && scale) ? 1 : 0);
+}
+
+inline uint8_t qadd8(uint8_t i, uint8_t j)
+{
+    unsigned int t = i + j;
+    return t > 255 ? 255 : t;
+}
+
+inline uint8_t qsub8(uint8_t i, uint8_t j)
+{
+    return i > j ? i - j : 0;
+}
+
+inline uint8_t ease8InOutQuad(uint8_t i)
+{
+    uint8_t j = i;
+    if (j & 0x80)
+        j = 255 - j;
+    uint8_t jj = scale8(j, j);
+    uint8_t jj2 = jj << 1;
+    if (i & 0x80)
+        jj2 = 255 - jj2;
+    return jj2;
+}
+
+inline CRGB &CRGB::nscale8(uint8_t scale)
+{
+    r = scale8(r, scale);
+    g = scale8(g, scale);
+    b = scale8(b, scale);
+    return *this;
+}
+
+inline CRGB &CRGB::operator+=(const CRGB &other)
+{
+    r = qadd8(r, other.r);
+    g = qadd8(g, other.g);
+    b = qadd8(b, other.b);
+    return *this;
+}
+
+#define FASTLED_RAND16_2053 ((uint16_t)(2053))
+#define FASTLED_RAND16_13849 ((uint16_t)(13849))
+
+extern uint16_t rand16seed;
+
+inline uint8_t random8()
+{
+    rand16seed = (rand16seed * FASTLED_RAND16_2053) + FASTLED_RAND16_13849;
+    return (uint8_t)(((uint8_t)(rand16seed & 0xFF)) + ((uint8_t)(rand16seed >> 8)));
+}
+
+inline uint8_t random8(uint8_t lim)
+{
+    uint8_t r = random8();
+    r = (r * lim) >> 8;
+    return r;
+}
+
+inline uint8_t random8(uint8_t min, uint8_t lim)
+{
+    uint8_t delta = lim - min;
+    return random8(delta) + min;
+}
+
+inline uint16_t random16()
+{
+    rand16seed = (rand16seed * FASTLED_RAND16_2053) + FASTLED_RAND16_13849;
+    return rand16seed;
+}
+
+inline uint16_t random16(uint16_t lim)
+{
+    uint16_t r = random16();
+    uint32_t p = (uint32_t)lim * (uint32_t)r;
+    return p >> 16;
+}
+
+inline uint16_t random16(uint16_t min, uint16_t lim)
+{
+    uint16_t delta = lim - min;
+    return random16(delta) + min;
+}
+
+inline void random16_set_seed(uint16_t seed) { rand16seed = seed; }
+inline uint16_t random16_get_seed() { return rand16seed; }
+inline void random16_add_entropy(uint16_t entropy) { rand16seed += entropy; }
+
+void fill_solid(CRGB *leds, int count, const CRGB &color);
+void fill_rainbow(CRGB *leds, int count, uint8_t initial_hue, uint8_t delta_hue = 5);
+void nscale8(CRGB *leds, uint16_t count, uint8_t scale);
+void hsv2rgb_rainbow(const CHSV &hsv, CRGB &rgb);
+uint32_t calculate_unscaled_power_mW(const CRGB *leds, uint16_t count);
+
+// Chipsets only name the strip; every one is written the same way here
+template <uint8_t DATA_PIN, EOrder RGB_ORDER>
+class WS2812B
+{
+};
+template <uint8_t DATA_PIN, EOrder RGB_ORDER>
+class WS2812
+{
+};
+template <uint8_t DATA_PIN, EOrder RGB_ORDER>
+class WS2811
+{
+};
+template <uint8_t DATA_PIN, EOrder RGB_ORDER>
+class WS2813
+{
+};
+template <uint8_t DATA_PIN, EOrder RGB_ORDER>
+class SK6812
+{
+};
+
+class CFastLED
+{
+public:
+    template <template <uint8_t DATA_PIN, EOrder RGB_ORDER> class CHIPSET, uint8_t DATA_PIN, EOrder RGB_ORDER>
+    CFastLED &addLeds(CRGB *data, int count, int offset = 0)
+    {
+        return add_strip(data + offset, count);
+    }
+
+    void setBrightness(uint8_t scale) { brightness = scale; }
+    uint8_t getBrightness() const { return brightness; }
+    void show() { show(brightness); }
+    void show(uint8_t scale);
+    void clear(bool write_data = false);
+    int size() const { return count; }
+    CRGB *leds() { return data; }
+
+private:
+    CRGB *data = nullptr;
+    int count = 0;
+    uint8_t brightness = 255;
+
+    CFastLED &add_strip(CRGB *leds, int led_count);
+};
+
+extern CFastLED FastLED;
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef HTTPCLIENT_H
+#define HTTPCLIENT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+// The ESP32 core's codes for requests that got no HTTP status
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_STREAM (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM (-8)
+#define HTTPC_ERROR_ENCODING (-9)
+#define HTTPC_ERROR_STREAM_WRITE (-10)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+// HTTP/1.1 over a WiFiClient, as far as Database uses the ESP32 core's
+// HTTPClient: keep-alive between requests to the same host, a connect and a
+// read timeout, and bodies sized by Content-Length, chunked or ended by the
+// server closing the connection. The host's TlsClient refuses https://, see
+// native/fakes/tls_client.cpp.
+class HTTPClient
+{
+public:
+    bool begin(WiFiClient &client, const String &url);
+    void end();
+    void setReuse(bool reuse) { this->reuse = reuse; }
+    void setConnectTimeout(int32_t timeout) { connect_timeout = timeout; }
+    void setTimeout(uint16_t timeout) { read_timeout = timeout; }
+    void addHeader(const String &name, const String &value);
+    int sendRequest(const char *type, const String &payload);
+    int writeToStream(Stream *stream);
+
+private:
+    WiFiClient *client = nullptr;
+    String host;
+    uint16_t port = 80;
+    String uri;
+    String headers;
+    String connected_to; // host:port the open connection leads to
+    bool reuse = false;
+    int32_t connect_timeout = 5000;
+    uint16_t read_timeout = 5000;
+
+    // The response being read
+    int content_length = -1;
+    bool chunked = false;
+    bool keep_alive = false;
+    bool body_read = false;
+
+    int read_line(String &line);
+    int read_bytes(Stream *stream, size_t count);
+    int wait_for_data();
+};
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef LITTLEFS_H
+#define LITTLEFS_H
+
+#include "FS.h"
+
+namespace fs
+{
+    // LittleFS kept in the fs/ directory of NativeHost::flash_dir()
+    class LittleFSFS : public FS
+    {
+    public:
+        LittleFSFS() : FS("fs") {}
+
+        bool begin(bool format_on_fail = false, const char *base_path = "/littlefs", uint8_t max_open_files = 10,
+                   const char *partition_label = "spiffs");
+        void end() { mounted = false; }
+        bool format();
+        size_t totalBytes();
+        size_t usedBytes();
+    };
+}
+
+extern fs::LittleFSFS LittleFS;
+
+#endif
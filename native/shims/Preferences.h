@@ -0,0 +1,33 @@
+#ifndef PREFERENCES_H
+#define PREFERENCES_H
+
+#include <Arduino.h>
+
+// NVS with one file per key in nvs/<namespace>/ of NativeHost::flash_dir().
+// Names and keys are limited to 15 characters as on the device.
+class Preferences
+{
+public:
+    bool begin(const char *name, bool read_only = false, const char *partition_label = nullptr);
+    void end();
+    bool clear();
+    bool remove(const char *key);
+    bool isKey(const char *key);
+
+    size_t putUInt(const char *key, uint32_t value);
+    size_t putInt(const char *key, int32_t value);
+    size_t putBytes(const char *key, const void *value, size_t length);
+    uint32_t getUInt(const char *key, uint32_t default_value = 0);
+    int32_t getInt(const char *key, int32_t default_value = 0);
+    size_t getBytesLength(const char *key);
+    size_t getBytes(const char *key, void *buffer, size_t max_length);
+
+private:
+    char directory[512] = "";
+    bool started = false;
+    bool read_only = false;
+
+    bool key_path(const char *key, char *path, size_t size);
+};
+
+#endif
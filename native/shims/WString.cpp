@@ -0,0 +1,374 @@
+#include "WString.h"
+#include "native_host.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void format_integer(char *out, size_t size, unsigned long long value, bool negative, unsigned char base)
+{
+    char digits[66];
+    int count = 0;
+    do
+    {
+        int digit = value % base;
+        digits[count++] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+        value /= base;
+    } while (value > 0);
+
+    size_t at = 0;
+    if (negative && at + 1 < size)
+        out[at++] = '-';
+    while (count > 0 && at + 1 < size)
+        out[at++] = digits[--count];
+    out[at] = '\0';
+}
+
+static void format_signed(char *out, size_t size, long long value, unsigned char base)
+{
+    if (base == 10 && value < 0)
+        format_integer(out, size, -(unsigned long long)value, true, base);
+    else
+        format_integer(out, size, (unsigned long long)value, false, base);
+}
+
+String::String(const char *text) : buffer(nullptr), capacity(0), len(0)
+{
+    if (text != nullptr)
+        assign(text, strlen(text));
+}
+
+String::String(const char *text, size_t length) : buffer(nullptr), capacity(0), len(0)
+{
+    assign(text, length);
+}
+
+String::String(const String &other) : buffer(nullptr), capacity(0), len(0)
+{
+    assign(other.c_str(), other.len);
+}
+
+String::String(String &&other) : buffer(other.buffer), capacity(other.capacity), len(other.len)
+{
+    other.buffer = nullptr;
+    other.capacity = 0;
+    other.len = 0;
+}
+
+String::String(char c) : buffer(nullptr), capacity(0), len(0)
+{
+    assign(&c, 1);
+}
+
+String::String(int value, unsigned char base) : String((long long)value, base) {}
+String::String(unsigned int value, unsigned char base) : String((unsigned long long)value, base) {}
+String::String(long value, unsigned char base) : String((long long)value, base) {}
+String::String(unsigned long value, unsigned char base) : String((unsigned long long)value, base) {}
+
+String::String(long long value, unsigned char base) : buffer(nullptr), capacity(0), len(0)
+{
+    char text[68];
+    format_signed(text, sizeof(text), value, base);
+    assign(text, strlen(text));
+}
+
+String::String(unsigned long long value, unsigned char base) : buffer(nullptr), capacity(0), len(0)
+{
+    char text[68];
+    format_integer(text, sizeof(text), value, false, base);
+    assign(text, strlen(text));
+}
+
+String::String(float value, unsigned int decimals) : String((double)value, decimals) {}
+
+String::String(double value, unsigned int decimals) : buffer(nullptr), capacity(0), len(0)
+{
+    char text[64];
+    snprintf(text, sizeof(text), "%.*f", (int)decimals, value);
+    assign(text, strlen(text));
+}
+
+String::~String()
+{
+    NativeHost::heap_free(buffer);
+}
+
+String &String::operator=(const String &other)
+{
+    if (this != &other)
+        assign(other.c_str(), other.len);
+    return *this;
+}
+
+String &String::operator=(String &&other)
+{
+    if (this != &other)
+    {
+        NativeHost::heap_free(buffer);
+        buffer = other.buffer;
+        capacity = other.capacity;
+        len = other.len;
+        other.buffer = nullptr;
+        other.capacity = 0;
+        other.len = 0;
+    }
+    return *this;
+}
+
+// A null pointer empties the string, which ArduinoJson relies on
+String &String::operator=(const char *text)
+{
+    if (text == nullptr)
+    {
+        NativeHost::heap_free(buffer);
+        buffer = nullptr;
+        capacity = 0;
+        len = 0;
+        return *this;
+    }
+    assign(text, strlen(text));
+    return *this;
+}
+
+bool String::reserve(size_t size)
+{
+    if (buffer != nullptr && capacity >= size)
+        return true;
+    char *grown = (char *)NativeHost::heap_realloc(buffer, size + 1);
+    if (grown == nullptr)
+        return false;
+    if (buffer == nullptr)
+        grown[0] = '\0';
+    buffer = grown;
+    capacity = size;
+    return true;
+}
+
+void String::assign(const char *text, size_t length)
+{
+    if (!reserve(length))
+        return;
+    memmove(buffer, text, length);
+    buffer[length] = '\0';
+    len = length;
+}
+
+bool String::concat(const char *text, size_t length)
+{
+    if (text == nullptr)
+        return false;
+    if (length == 0)
+        return true;
+    // The text may be part of this string
+    size_t offset = buffer != nullptr && text >= buffer && text < buffer + len ? text - buffer : SIZE_MAX;
+    if (!reserve(len + length))
+        return false;
+    memcpy(buffer + len, offset != SIZE_MAX ? buffer + offset : text, length);
+    len += length;
+    buffer[len] = '\0';
+    return true;
+}
+
+bool String::concat(const String &other) { return concat(other.c_str(), other.len); }
+bool String::concat(const char *text) { return text != nullptr && concat(text, strlen(text)); }
+bool String::concat(char c) { return concat(&c, 1); }
+bool String::concat(int value) { return concat(String(value)); }
+bool String::concat(unsigned int value) { return concat(String(value)); }
+bool String::concat(long value) { return concat(String(value)); }
+bool String::concat(unsigned long value) { return concat(String(value)); }
+bool String::concat(long long value) { return concat(String(value)); }
+bool String::concat(unsigned long long value) { return concat(String(value)); }
+bool String::concat(float value) { return concat(String(value)); }
+bool String::concat(double value) { return concat(String(value)); }
+
+bool String::equals(const String &other) const
+{
+    return len == other.len && memcmp(c_str(), other.c_str(), len) == 0;
+}
+
+bool String::equals(const char *text) const
+{
+    return strcmp(c_str(), text != nullptr ? text : "") == 0;
+}
+
+bool String::operator<(const String &other) const
+{
+    return strcmp(c_str(), other.c_str()) < 0;
+}
+
+bool String::equalsIgnoreCase(const String &other) const
+{
+    return len == other.len && strcasecmp(c_str(), other.c_str()) == 0;
+}
+
+bool String::startsWith(const String &prefix) const
+{
+    return prefix.len <= len && memcmp(c_str(), prefix.c_str(), prefix.len) == 0;
+}
+
+bool String::endsWith(const String &suffix) const
+{
+    return suffix.len <= len && memcmp(c_str() + len - suffix.len, suffix.c_str(), suffix.len) == 0;
+}
+
+char String::charAt(unsigned int index) const
+{
+    return index < len ? buffer[index] : '\0';
+}
+
+char &String::operator[](unsigned int index)
+{
+    static char dummy;
+    if (index >= len)
+    {
+        dummy = '\0';
+        return dummy;
+    }
+    return buffer[index];
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+    if (from >= len)
+        return -1;
+    const char *found = (const char *)memchr(buffer + from, c, len - from);
+    return found != nullptr ? found - buffer : -1;
+}
+
+int String::indexOf(const String &text, unsigned int from) const
+{
+    if (from > len)
+        return -1;
+    const char *found = strstr(c_str() + from, text.c_str());
+    return found != nullptr ? found - c_str() : -1;
+}
+
+int String::lastIndexOf(char c) const
+{
+    const char *found = len > 0 ? strrchr(buffer, c) : nullptr;
+    return found != nullptr ? found - buffer : -1;
+}
+
+int String::lastIndexOf(const String &text) const
+{
+    int found = -1;
+    for (int at = indexOf(text); at >= 0; at = indexOf(text, at + 1))
+        found = at;
+    return found;
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+    if (from > to)
+    {
+        unsigned int swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from >= len)
+        return String();
+    if (to > len)
+        to = len;
+    return String(buffer + from, to - from);
+}
+
+void String::replace(char find, char replacement)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        if (buffer[i] == find)
+            buffer[i] = replacement;
+    }
+}
+
+void String::replace(const String &find, const String &replacement)
+{
+    if (find.len == 0)
+        return;
+    String result;
+    size_t at = 0;
+    for (int found = indexOf(find); found >= 0; found = indexOf(find, at))
+    {
+        result.concat(buffer + at, found - at);
+        result.concat(replacement);
+        at = found + find.len;
+    }
+    result.concat(c_str() + at, len - at);
+    *this = static_cast<String &&>(result);
+}
+
+void String::remove(unsigned int index)
+{
+    remove(index, (unsigned int)-1);
+}
+
+void String::remove(unsigned int index, unsigned int count)
+{
+    if (index >= len)
+        return;
+    if (count > len - index)
+        count = len - index;
+    memmove(buffer + index, buffer + index + count, len - index - count + 1);
+    len -= count;
+}
+
+void String::toLowerCase()
+{
+    for (size_t i = 0; i < len; i++)
+        buffer[i] = tolower((unsigned char)buffer[i]);
+}
+
+void String::toUpperCase()
+{
+    for (size_t i = 0; i < len; i++)
+        buffer[i] = toupper((unsigned char)buffer[i]);
+}
+
+void String::trim()
+{
+    size_t first = 0;
+    while (first < len && isspace((unsigned char)buffer[first]))
+        first++;
+    size_t last = len;
+    while (last > first && isspace((unsigned char)buffer[last - 1]))
+        last--;
+    if (first > 0 || last < len)
+        assign(c_str() + first, last - first);
+}
+
+long String::toInt() const { return atol(c_str()); }
+float String::toFloat() const { return atof(c_str()); }
+double String::toDouble() const { return atof(c_str()); }
+
+StringSumHelper operator+(const StringSumHelper &left, const String &right)
+{
+    StringSumHelper sum(left);
+    sum.concat(right);
+    return sum;
+}
+
+StringSumHelper operator+(const StringSumHelper &left, const char *right)
+{
+    StringSumHelper sum(left);
+    sum.concat(right);
+    return sum;
+}
+
+StringSumHelper operator+(const StringSumHelper &left, char right)
+{
+    StringSumHelper sum(left);
+    sum.concat(right);
+    return sum;
+}
+
+StringSumHelper operator+(const StringSumHelper &left, int right) { return left + String(right); }
+StringSumHelper operator+(const StringSumHelper &left, unsigned int right) { return left + String(right); }
+StringSumHelper operator+(const StringSumHelper &left, long right) { return left + String(right); }
+StringSumHelper operator+(const StringSumHelper &left, unsigned long right) { return left + String(right); }
+
+StringSumHelper operator+(const char *left, const String &right)
+{
+    StringSumHelper sum(left);
+    sum.concat(right);
+    return sum;
+}
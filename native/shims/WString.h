@@ -0,0 +1,120 @@
+#ifndef WSTRING_H
+#define WSTRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Arduino's String, allocated from the device heap like the core's
+class String
+{
+public:
+    String(const char *text = "");
+    String(const char *text, size_t length);
+    String(const String &other);
+    String(String &&other);
+    explicit String(char c);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(long long value, unsigned char base = 10);
+    explicit String(unsigned long long value, unsigned char base = 10);
+    explicit String(float value, unsigned int decimals = 2);
+    explicit String(double value, unsigned int decimals = 2);
+    ~String();
+
+    String &operator=(const String &other);
+    String &operator=(String &&other);
+    String &operator=(const char *text);
+
+    bool reserve(size_t size);
+    size_t length() const { return len; }
+    bool isEmpty() const { return len == 0; }
+    const char *c_str() const { return buffer ? buffer : ""; }
+    char *begin() { return buffer; }
+    char *end() { return buffer + len; }
+
+    bool concat(const String &other);
+    bool concat(const char *text);
+    bool concat(const char *text, size_t length);
+    bool concat(char c);
+    bool concat(int value);
+    bool concat(unsigned int value);
+    bool concat(long value);
+    bool concat(unsigned long value);
+    bool concat(long long value);
+    bool concat(unsigned long long value);
+    bool concat(float value);
+    bool concat(double value);
+
+    template <typename T>
+    String &operator+=(const T &value)
+    {
+        concat(value);
+        return *this;
+    }
+
+    bool equals(const String &other) const;
+    bool equals(const char *text) const;
+    bool operator==(const String &other) const { return equals(other); }
+    bool operator==(const char *text) const { return equals(text); }
+    bool operator!=(const String &other) const { return !equals(other); }
+    bool operator!=(const char *text) const { return !equals(text); }
+    bool operator<(const String &other) const;
+    bool equalsIgnoreCase(const String &other) const;
+    bool startsWith(const String &prefix) const;
+    bool endsWith(const String &suffix) const;
+
+    char charAt(unsigned int index) const;
+    char operator[](unsigned int index) const { return charAt(index); }
+    char &operator[](unsigned int index);
+
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const String &text, unsigned int from = 0) const;
+    int lastIndexOf(char c) const;
+    int lastIndexOf(const String &text) const;
+    String substring(unsigned int from) const { return substring(from, len); }
+    String substring(unsigned int from, unsigned int to) const;
+
+    void replace(char find, char replacement);
+    void replace(const String &find, const String &replacement);
+    void remove(unsigned int index);
+    void remove(unsigned int index, unsigned int count);
+    void toLowerCase();
+    void toUpperCase();
+    void trim();
+
+    long toInt() const;
+    float toFloat() const;
+    double toDouble() const;
+
+private:
+    char *buffer;
+    size_t capacity;
+    size_t len;
+
+    void assign(const char *text, size_t length);
+};
+
+// What operator+ returns, as in the core; ArduinoJson accepts it like a String
+class StringSumHelper : public String
+{
+public:
+    StringSumHelper(const String &text) : String(text) {}
+    StringSumHelper(String &&text) : String(static_cast<String &&>(text)) {}
+    StringSumHelper(const char *text) : String(text) {}
+};
+
+StringSumHelper operator+(const StringSumHelper &left, const String &right);
+StringSumHelper operator+(const StringSumHelper &left, const char *right);
+StringSumHelper operator+(const StringSumHelper &left, char right);
+StringSumHelper operator+(const StringSumHelper &left, int right);
+StringSumHelper operator+(const StringSumHelper &left, unsigned int right);
+StringSumHelper operator+(const StringSumHelper &left, long right);
+StringSumHelper operator+(const StringSumHelper &left, unsigned long right);
+StringSumHelper operator+(const char *left, const String &right);
+
+inline bool operator==(const char *left, const String &right) { return right.equals(left); }
+inline bool operator!=(const char *left, const String &right) { return !right.equals(left); }
+
+#endif
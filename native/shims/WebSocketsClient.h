@@ -0,0 +1,44 @@
+#ifndef WEBSOCKETSCLIENT_H
+#define WEBSOCKETSCLIENT_H
+
+#include <Arduino.h>
+#include <functional>
+
+typedef enum
+{
+    WStype_ERROR,
+    WStype_DISCONNECTED,
+    WStype_CONNECTED,
+    WStype_TEXT,
+    WStype_BIN,
+    WStype_FRAGMENT_TEXT_START,
+    WStype_FRAGMENT_BIN_START,
+    WStype_FRAGMENT,
+    WStype_FRAGMENT_FIN,
+    WStype_PING,
+    WStype_PONG,
+} WStype_t;
+
+// The socket never opens on the host, so RealtimeSync falls back to polling
+class WebSocketsClient
+{
+public:
+    typedef std::function<void(WStype_t type, uint8_t *payload, size_t length)> WebSocketClientEvent;
+
+    void begin(const char *, uint16_t, const char * = "/", const char * = "arduino") {}
+    void beginSSL(const char *, uint16_t, const char * = "/", const char * = "",
+                  const char * = "arduino") {}
+    void onEvent(WebSocketClientEvent handler) { event_handler = handler; }
+    void setReconnectInterval(unsigned long) {}
+    void loop() {}
+    void disconnect() {}
+    bool isConnected() { return false; }
+    bool sendTXT(const char *) { return false; }
+    bool sendTXT(String &) { return false; }
+    bool sendPing() { return false; }
+
+private:
+    WebSocketClientEvent event_handler;
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef WIFI_H
+#define WIFI_H
+
+#include <Arduino.h>
+
+typedef enum
+{
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_SCAN_COMPLETED = 2,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6,
+} wl_status_t;
+
+typedef enum
+{
+    WIFI_OFF = 0,
+    WIFI_STA = 1,
+    WIFI_AP = 2,
+    WIFI_AP_STA = 3,
+} wifi_mode_t;
+
+class IPAddress
+{
+public:
+    IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : bytes{a, b, c, d} {}
+    uint8_t operator[](int index) const { return bytes[index]; }
+    String toString() const;
+
+private:
+    uint8_t bytes[4];
+};
+
+// Joins whatever NativeEnvironment::wifi_join() decides, after the time it says
+class WiFiClass
+{
+public:
+    wl_status_t begin(const char *ssid, const char *password);
+    wl_status_t status();
+    bool disconnect(bool wifi_off = false);
+    bool mode(wifi_mode_t mode);
+    bool isConnected() { return status() == WL_CONNECTED; }
+    IPAddress localIP();
+    int8_t RSSI() { return isConnected() ? -60 : 0; }
+    uint8_t *macAddress(uint8_t *mac);
+    String macAddress();
+    bool setSleep(bool) { return true; }
+
+private:
+    int64_t connected_at_us = -1;
+};
+
+extern WiFiClass WiFi;
+
+// A TCP connection over the host's sockets. Only the native_sync build uses
+// it, against a local stand-in such as tools/mock_postgrest.py; the joined
+// WiFi above is not consulted.
+class WiFiClient
+{
+public:
+    WiFiClient() : fd(-1) {}
+    virtual ~WiFiClient() { stop(); }
+
+    virtual int connect(const char *host, uint16_t port) { return connect(host, port, 3000); }
+    virtual int connect(const char *host, uint16_t port, int32_t timeout);
+    virtual size_t write(uint8_t data) { return write(&data, 1); }
+    virtual size_t write(const uint8_t *buf, size_t size);
+    virtual int available();
+    virtual int read();
+    virtual int read(uint8_t *buf, size_t size);
+    virtual int peek();
+    virtual void flush() {}
+    virtual void stop();
+    virtual uint8_t connected();
+
+protected:
+    int fd;
+};
+
+#endif
@@ -0,0 +1,273 @@
+// Serial, ESP, GPIO and SNTP of the Arduino core for the host build
+
+#include <Arduino.h>
+#include <soc/gpio_reg.h>
+
+#define GPIO_COUNT 40
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static FILE *serial_out = nullptr;
+static char flash_path[512] = "";
+
+static uint8_t pin_levels[GPIO_COUNT];
+static bool pin_levels_set = false;
+static void (*pin_handlers[GPIO_COUNT])(void);
+static int pin_handler_modes[GPIO_COUNT];
+
+static uint64_t random_state = 0x853c49e6748fea9bULL;
+
+extern char __start_rtc_data[];
+extern char __stop_rtc_data[];
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char *destination, const char *source, size_t size)
+{
+    size_t length = strlen(source);
+    if (size > 0)
+    {
+        size_t copied = min(length, size - 1);
+        memcpy(destination, source, copied);
+        destination[copied] = '\0';
+    }
+    return length;
+}
+#endif
+
+void NativeHost::set_serial(FILE *out)
+{
+    serial_out = out;
+}
+
+void NativeHost::set_flash_dir(const char *path)
+{
+    snprintf(flash_path, sizeof(flash_path), "%s", path);
+}
+
+// A fresh temporary directory unless one was set
+const char *NativeHost::flash_dir()
+{
+    if (flash_path[0] == '\0')
+    {
+        snprintf(flash_path, sizeof(flash_path), "/tmp/sunrise-native-XXXXXX");
+        if (mkdtemp(flash_path) == nullptr)
+            snprintf(flash_path, sizeof(flash_path), ".");
+    }
+    return flash_path;
+}
+
+void *NativeHost::rtc_memory()
+{
+    return __start_rtc_data;
+}
+
+size_t NativeHost::rtc_memory_size()
+{
+    return __stop_rtc_data - __start_rtc_data;
+}
+
+void HardwareSerial::flush()
+{
+    if (serial_out != nullptr)
+        fflush(serial_out);
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *data, size_t length)
+{
+    return serial_out != nullptr ? fwrite(data, 1, length, serial_out) : length;
+}
+
+size_t HardwareSerial::printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int length;
+    if (serial_out != nullptr)
+    {
+        length = vfprintf(serial_out, format, args);
+    }
+    else
+    {
+        length = vsnprintf(nullptr, 0, format, args);
+    }
+    va_end(args);
+    return length > 0 ? length : 0;
+}
+
+size_t HardwareSerial::print(const char *text)
+{
+    return write((const uint8_t *)text, strlen(text));
+}
+
+size_t HardwareSerial::print(long value)
+{
+    return printf("%ld", value);
+}
+
+size_t HardwareSerial::println(const char *text)
+{
+    return print(text) + print("\r\n");
+}
+
+size_t HardwareSerial::println(long value)
+{
+    return print(value) + print("\r\n");
+}
+
+[[noreturn]] void EspClass::restart()
+{
+    NativeHost::environment().restart();
+    exit(0);
+}
+
+uint32_t esp_random()
+{
+    // xorshift64*
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return (uint32_t)((random_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+long random(long max)
+{
+    return max > 0 ? esp_random() % max : 0;
+}
+
+long random(long min, long max)
+{
+    return max > min ? min + random(max - min) : min;
+}
+
+void randomSeed(unsigned long seed)
+{
+    if (seed != 0)
+        random_state = seed;
+}
+
+// Inputs idle high, like the BOOT button behind its pull-up
+static void init_pins()
+{
+    if (pin_levels_set)
+        return;
+    memset(pin_levels, HIGH, sizeof(pin_levels));
+    pin_levels_set = true;
+}
+
+void pinMode(uint8_t, uint8_t)
+{
+    init_pins();
+}
+
+int digitalRead(uint8_t pin)
+{
+    init_pins();
+    return pin < GPIO_COUNT ? pin_levels[pin] : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    init_pins();
+    if (pin < GPIO_COUNT)
+        pin_levels[pin] = value ? HIGH : LOW;
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode)
+{
+    if (pin >= GPIO_COUNT)
+        return;
+    pin_handlers[pin] = handler;
+    pin_handler_modes[pin] = mode;
+}
+
+void detachInterrupt(uint8_t pin)
+{
+    if (pin < GPIO_COUNT)
+        pin_handlers[pin] = nullptr;
+}
+
+uint32_t native_reg_read(uint32_t reg)
+{
+    init_pins();
+    int first = reg == GPIO_IN_REG ? 0 : reg == GPIO_IN1_REG ? 32 : -1;
+    uint32_t value = 0;
+    for (int i = 0; first >= 0 && i < 32 && first + i < GPIO_COUNT; i++)
+    {
+        if (pin_levels[first + i])
+            value |= 1UL << i;
+    }
+    return value;
+}
+
+void NativeHost::set_pin(int pin, int level)
+{
+    init_pins();
+    if (pin < 0 || pin >= GPIO_COUNT || pin_levels[pin] == (level ? HIGH : LOW))
+        return;
+    pin_levels[pin] = level ? HIGH : LOW;
+
+    int mode = pin_handler_modes[pin];
+    bool fire = mode == CHANGE || (mode == RISING && level) || (mode == FALLING && !level);
+    if (pin_handlers[pin] != nullptr && fire)
+        pin_handlers[pin]();
+}
+
+// The TZ string the core's configTime() sets
+static void set_time_zone(long offset, int daylight)
+{
+    // Sized for any long offset, so the names are never cut short
+    char standard[32] = {0};
+    char summer[32] = "DST";
+    char tz[64] = {0};
+
+    if (offset % 3600)
+        snprintf(standard, sizeof(standard), "UTC%ld:%02u:%02u", offset / 3600, (unsigned)abs((offset % 3600) / 60), (unsigned)abs(offset % 60));
+    else
+        snprintf(standard, sizeof(standard), "UTC%ld", offset / 3600);
+    if (daylight != 3600)
+    {
+        long dst_offset = offset - daylight;
+        if (dst_offset % 3600)
+            snprintf(summer, sizeof(summer), "DST%ld:%02u:%02u", dst_offset / 3600, (unsigned)abs((dst_offset % 3600) / 60), (unsigned)abs(dst_offset % 60));
+        else
+            snprintf(summer, sizeof(summer), "DST%ld", dst_offset / 3600);
+    }
+    snprintf(tz, sizeof(tz), "%s%s", standard, summer);
+    setenv("TZ", tz, 1);
+    tzset();
+}
+
+void configTime(long gmt_offset_sec, int daylight_offset_sec, const char *, const char *, const char *)
+{
+    // The SNTP client sets the clock in the background once the answer is in
+    NativeEnvironment &environment = NativeHost::environment();
+    int64_t answer_us = environment.ntp_time_us();
+    if (answer_us != 0)
+    {
+        int64_t delay_us = (int64_t)environment.ntp_delay_ms() * 1000;
+        NativeHost::set_clock_at(NativeHost::uptime_us() + delay_us, answer_us + delay_us);
+    }
+    set_time_zone(-gmt_offset_sec, daylight_offset_sec);
+}
+
+// As in the core: polls until the clock is past 2016
+bool getLocalTime(struct tm *info, uint32_t ms)
+{
+    uint32_t start = millis();
+    time_t now;
+    while ((millis() - start) <= ms)
+    {
+        time(&now);
+        localtime_r(&now, info);
+        if (info->tm_year > (2016 - 1900))
+            return true;
+        delay(10);
+    }
+    return false;
+}
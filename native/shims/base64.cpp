@@ -0,0 +1,135 @@
+// mbedtls's base64 for the host build, following its handling of line breaks,
+// spaces and padding so payloads the device rejects are rejected here too
+
+#include <mbedtls/base64.h>
+#include <stdint.h>
+
+static const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// 0-63 for digits, 64 for '=', 127 for anything else
+static unsigned char decode_value(unsigned char c)
+{
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+    if (c == '+')
+        return 62;
+    if (c == '/')
+        return 63;
+    if (c == '=')
+        return 64;
+    return 127;
+}
+
+int mbedtls_base64_encode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen)
+{
+    if (slen == 0)
+    {
+        *olen = 0;
+        return 0;
+    }
+    size_t n = (slen / 3 + (slen % 3 != 0)) * 4;
+    if (dst == nullptr || dlen < n + 1)
+    {
+        *olen = n + 1;
+        return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+    }
+
+    unsigned char *p = dst;
+    size_t i = 0;
+    for (; i + 2 < slen; i += 3)
+    {
+        uint32_t x = ((uint32_t)src[i] << 16) | ((uint32_t)src[i + 1] << 8) | src[i + 2];
+        *p++ = ALPHABET[(x >> 18) & 0x3F];
+        *p++ = ALPHABET[(x >> 12) & 0x3F];
+        *p++ = ALPHABET[(x >> 6) & 0x3F];
+        *p++ = ALPHABET[x & 0x3F];
+    }
+    if (i < slen)
+    {
+        uint32_t x = (uint32_t)src[i] << 16;
+        if (i + 1 < slen)
+            x |= (uint32_t)src[i + 1] << 8;
+        *p++ = ALPHABET[(x >> 18) & 0x3F];
+        *p++ = ALPHABET[(x >> 12) & 0x3F];
+        *p++ = i + 1 < slen ? ALPHABET[(x >> 6) & 0x3F] : '=';
+        *p++ = '=';
+    }
+    *olen = p - dst;
+    *p = 0;
+    return 0;
+}
+
+int mbedtls_base64_decode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen)
+{
+    size_t i, n, j, x;
+
+    // First pass: validate and count
+    for (i = n = j = 0; i < slen; i++)
+    {
+        // Spaces are allowed before a line break and at the end
+        x = 0;
+        while (i < slen && src[i] == ' ')
+        {
+            ++i;
+            ++x;
+        }
+        if (i == slen)
+            break;
+        if ((slen - i) >= 2 && src[i] == '\r' && src[i + 1] == '\n')
+            continue;
+        if (src[i] == '\n')
+            continue;
+        if (x != 0)
+            return MBEDTLS_ERR_BASE64_INVALID_CHARACTER;
+
+        if (src[i] == '=' && ++j > 2)
+            return MBEDTLS_ERR_BASE64_INVALID_CHARACTER;
+        unsigned char value = decode_value(src[i]);
+        if (value == 127)
+            return MBEDTLS_ERR_BASE64_INVALID_CHARACTER;
+        // Digits after padding
+        if (value < 64 && j != 0)
+            return MBEDTLS_ERR_BASE64_INVALID_CHARACTER;
+        n++;
+    }
+
+    if (n == 0)
+    {
+        *olen = 0;
+        return 0;
+    }
+
+    n = (6 * (n >> 3)) + ((6 * (n & 0x7) + 7) >> 3);
+    n -= j;
+    if (dst == nullptr || dlen < n)
+    {
+        *olen = n;
+        return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+    }
+
+    // Second pass: decode; a trailing partial quantum is dropped
+    unsigned char *p = dst;
+    for (j = 3, n = x = 0; i > 0; i--, src++)
+    {
+        if (*src == '\r' || *src == '\n' || *src == ' ')
+            continue;
+        j -= (*src == '=');
+        x = (x << 6) | (decode_value(*src) & 0x3F);
+        if (++n == 4)
+        {
+            n = 0;
+            if (j > 0)
+                *p++ = (unsigned char)(x >> 16);
+            if (j > 1)
+                *p++ = (unsigned char)(x >> 8);
+            if (j > 2)
+                *p++ = (unsigned char)x;
+        }
+    }
+    *olen = p - dst;
+    return 0;
+}
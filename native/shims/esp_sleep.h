@@ -0,0 +1,32 @@
+#ifndef ESP_SLEEP_H
+#define ESP_SLEEP_H
+
+#include <stdint.h>
+#include "esp_system.h"
+
+typedef enum
+{
+    ESP_SLEEP_WAKEUP_UNDEFINED,
+    ESP_SLEEP_WAKEUP_ALL,
+    ESP_SLEEP_WAKEUP_EXT0,
+    ESP_SLEEP_WAKEUP_EXT1,
+    ESP_SLEEP_WAKEUP_TIMER,
+    ESP_SLEEP_WAKEUP_TOUCHPAD,
+    ESP_SLEEP_WAKEUP_ULP,
+    ESP_SLEEP_WAKEUP_GPIO,
+    ESP_SLEEP_WAKEUP_UART,
+} esp_sleep_wakeup_cause_t;
+
+typedef enum
+{
+    GPIO_NUM_0 = 0,
+    GPIO_NUM_2 = 2,
+    GPIO_NUM_4 = 4,
+} gpio_num_t;
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause();
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us);
+esp_err_t esp_sleep_enable_ext0_wakeup(gpio_num_t gpio_num, int level);
+[[noreturn]] void esp_deep_sleep_start();
+
+#endif
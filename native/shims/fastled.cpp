@@ -0,0 +1,114 @@
+#include <Arduino.h>
+#include <FastLED.h>
+
+// FastLED's WS2812 timing: 30 us per LED plus the latch, and at most 400 frames a second
+#define STRIP_US_PER_LED 30
+#define STRIP_LATCH_US 50
+#define STRIP_MIN_FRAME_US 2500
+
+CFastLED FastLED;
+uint16_t rand16seed = 1337;
+
+static uint32_t last_show_us = 0;
+static bool shown = false;
+
+void fill_solid(CRGB *leds, int count, const CRGB &color)
+{
+    for (int i = 0; i < count; i++)
+        leds[i] = color;
+}
+
+// Not FastLED's hsv2rgb_rainbow; the hues are close enough for the test pattern
+void hsv2rgb_rainbow(const CHSV &hsv, CRGB &rgb)
+{
+    uint8_t region = hsv.h / 43;
+    uint8_t remainder = (hsv.h - region * 43) * 6;
+    uint8_t p = scale8(hsv.v, 255 - hsv.s);
+    uint8_t q = scale8(hsv.v, 255 - scale8(hsv.s, remainder));
+    uint8_t t = scale8(hsv.v, 255 - scale8(hsv.s, 255 - remainder));
+    switch (region)
+    {
+    case 0:
+        rgb = CRGB(hsv.v, t, p);
+        break;
+    case 1:
+        rgb = CRGB(q, hsv.v, p);
+        break;
+    case 2:
+        rgb = CRGB(p, hsv.v, t);
+        break;
+    case 3:
+        rgb = CRGB(p, q, hsv.v);
+        break;
+    case 4:
+        rgb = CRGB(t, p, hsv.v);
+        break;
+    default:
+        rgb = CRGB(hsv.v, p, q);
+        break;
+    }
+}
+
+void fill_rainbow(CRGB *leds, int count, uint8_t initial_hue, uint8_t delta_hue)
+{
+    CHSV hsv(initial_hue, 240, 255);
+    for (int i = 0; i < count; i++)
+    {
+        hsv2rgb_rainbow(hsv, leds[i]);
+        hsv.h += delta_hue;
+    }
+}
+
+void nscale8(CRGB *leds, uint16_t count, uint8_t scale)
+{
+    for (uint16_t i = 0; i < count; i++)
+        leds[i].nscale8(scale);
+}
+
+// FastLED's power model: mW per channel at full brightness, plus each LED's idle draw
+uint32_t calculate_unscaled_power_mW(const CRGB *leds, uint16_t count)
+{
+    static const uint8_t red_mW = 16 * 5;
+    static const uint8_t green_mW = 11 * 5;
+    static const uint8_t blue_mW = 15 * 5;
+    static const uint8_t dark_mW = 1 * 5;
+
+    uint32_t red = 0, green = 0, blue = 0;
+    for (uint16_t i = 0; i < count; i++)
+    {
+        red += leds[i].r;
+        green += leds[i].g;
+        blue += leds[i].b;
+    }
+    red = (red * red_mW) >> 8;
+    green = (green * green_mW) >> 8;
+    blue = (blue * blue_mW) >> 8;
+    return red + green + blue + dark_mW * count;
+}
+
+CFastLED &CFastLED::add_strip(CRGB *leds, int led_count)
+{
+    data = leds;
+    count = led_count;
+    return *this;
+}
+
+void CFastLED::show(uint8_t scale)
+{
+    uint32_t since = micros() - last_show_us;
+    if (shown && since < STRIP_MIN_FRAME_US)
+        delayMicroseconds(STRIP_MIN_FRAME_US - since);
+    last_show_us = micros();
+    shown = true;
+
+    NativeHost::environment().strip_shown(data, count, scale);
+    delayMicroseconds(count * STRIP_US_PER_LED + STRIP_LATCH_US);
+}
+
+void CFastLED::clear(bool write_data)
+{
+    if (data != nullptr)
+        fill_solid(data, count, CRGB::Black);
+    if (write_data)
+        show(0);
+}
@@ -0,0 +1,21 @@
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+// One tick per millisecond, as in the Arduino core's FreeRTOS configuration
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS 1
+#define portMAX_DELAY (TickType_t)0xFFFFFFFF
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+#endif
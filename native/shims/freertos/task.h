@@ -0,0 +1,26 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include "FreeRTOS.h"
+
+// Tasks are coroutines that switch only where FreeRTOS could block: delays,
+// notification waits, yield() and FastLED.show(). The loop is the first task.
+typedef struct NativeTask *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *parameter);
+
+#define tskIDLE_PRIORITY ((UBaseType_t)0)
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth, void *parameter,
+                                   UBaseType_t priority, TaskHandle_t *created_task, BaseType_t core_id);
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *parameter,
+                       UBaseType_t priority, TaskHandle_t *created_task);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken);
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait);
+
+#endif
@@ -0,0 +1,281 @@
+// A first-fit heap the size of the ESP32's, so fragmentation and leaks show up
+// on the host the way they would on the device. Blocks carry a header with
+// their size and the size of the block before them, so freeing coalesces with
+// both neighbours in constant time.
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <new>
+
+#ifndef NATIVE_HEAP_SIZE
+#define NATIVE_HEAP_SIZE (300 * 1024) // About what the ESP32's DRAM heap holds before WiFi starts
+#endif
+
+struct BlockHeader
+{
+    size_t size;      // Including this header; the low bit marks a used block
+    size_t prev_size; // 0 for the first block
+};
+
+static const size_t ALIGNMENT = 16;
+static const size_t HEADER_SIZE = sizeof(BlockHeader);
+static const size_t MIN_BLOCK = 2 * ALIGNMENT;
+
+alignas(ALIGNMENT) static uint8_t arena[NATIVE_HEAP_SIZE];
+static bool arena_ready = false;
+static bool device_heap = false;
+static size_t free_bytes = 0;
+static size_t minimum_free_bytes = 0;
+static size_t used_blocks = 0;
+static esp_alloc_failed_hook_t failed_alloc_hook = nullptr;
+
+static inline size_t block_size(const BlockHeader *block) { return block->size & ~(size_t)1; }
+static inline bool block_used(const BlockHeader *block) { return block->size & 1; }
+
+static inline BlockHeader *next_block(BlockHeader *block)
+{
+    return (BlockHeader *)((uint8_t *)block + block_size(block));
+}
+
+static inline BlockHeader *prev_block(BlockHeader *block)
+{
+    return (BlockHeader *)((uint8_t *)block - block->prev_size);
+}
+
+// The arena ends with a used header of size 0 so no walk runs past it
+static inline bool is_end(const BlockHeader *block)
+{
+    return block_size(block) == 0;
+}
+
+static void init_arena()
+{
+    if (arena_ready)
+        return;
+    BlockHeader *first = (BlockHeader *)arena;
+    first->size = sizeof(arena) - HEADER_SIZE;
+    first->prev_size = 0;
+    BlockHeader *end = next_block(first);
+    end->size = 1;
+    end->prev_size = block_size(first);
+    free_bytes = minimum_free_bytes = block_size(first) - HEADER_SIZE;
+    arena_ready = true;
+}
+
+static bool in_arena(const void *pointer)
+{
+    return pointer >= (const void *)arena && pointer < (const void *)(arena + sizeof(arena));
+}
+
+// Splits off what block does not need as a free block of its own
+static void split(BlockHeader *block, size_t size)
+{
+    size_t remainder = block_size(block) - size;
+    if (remainder < MIN_BLOCK)
+        return;
+    bool used = block_used(block);
+    block->size = size | used;
+    BlockHeader *rest = next_block(block);
+    rest->size = remainder;
+    rest->prev_size = size;
+    next_block(rest)->prev_size = remainder;
+    free_bytes += remainder - HEADER_SIZE;
+    // A free neighbour after the split-off part joins it
+    BlockHeader *after = next_block(rest);
+    if (!block_used(after))
+    {
+        free_bytes += HEADER_SIZE;
+        rest->size += block_size(after);
+        next_block(rest)->prev_size = block_size(rest);
+    }
+}
+
+static void *arena_alloc(size_t size)
+{
+    init_arena();
+    size_t needed = max(MIN_BLOCK, (size + HEADER_SIZE + ALIGNMENT - 1) & ~(ALIGNMENT - 1));
+    for (BlockHeader *block = (BlockHeader *)arena; !is_end(block); block = next_block(block))
+    {
+        if (block_used(block) || block_size(block) < needed)
+            continue;
+        free_bytes -= block_size(block) - HEADER_SIZE;
+        block->size |= 1;
+        split(block, needed);
+        used_blocks++;
+        minimum_free_bytes = min(minimum_free_bytes, free_bytes);
+        return (uint8_t *)block + HEADER_SIZE;
+    }
+    if (failed_alloc_hook != nullptr)
+        failed_alloc_hook(size, MALLOC_CAP_8BIT | MALLOC_CAP_DEFAULT, "heap_caps_malloc");
+    return nullptr;
+}
+
+static void arena_free(void *pointer)
+{
+    BlockHeader *block = (BlockHeader *)((uint8_t *)pointer - HEADER_SIZE);
+    block->size &= ~(size_t)1;
+    used_blocks--;
+    free_bytes += block_size(block) - HEADER_SIZE;
+
+    BlockHeader *after = next_block(block);
+    if (!block_used(after))
+    {
+        free_bytes += HEADER_SIZE;
+        block->size += block_size(after);
+    }
+    if (block->prev_size != 0 && !block_used(prev_block(block)))
+    {
+        free_bytes += HEADER_SIZE;
+        BlockHeader *before = prev_block(block);
+        before->size += block_size(block);
+        block = before;
+    }
+    next_block(block)->prev_size = block_size(block);
+}
+
+static void *arena_realloc(void *pointer, size_t size)
+{
+    BlockHeader *block = (BlockHeader *)((uint8_t *)pointer - HEADER_SIZE);
+    size_t needed = max(MIN_BLOCK, (size + HEADER_SIZE + ALIGNMENT - 1) & ~(ALIGNMENT - 1));
+    if (block_size(block) >= needed)
+    {
+        split(block, needed);
+        return pointer;
+    }
+
+    // Grows in place into a free block behind it
+    BlockHeader *after = next_block(block);
+    if (!block_used(after) && block_size(block) + block_size(after) >= needed)
+    {
+        free_bytes -= block_size(after) - HEADER_SIZE;
+        block->size += block_size(after);
+        next_block(block)->prev_size = block_size(block);
+        split(block, needed);
+        minimum_free_bytes = min(minimum_free_bytes, free_bytes);
+        return pointer;
+    }
+
+    void *moved = arena_alloc(size);
+    if (moved == nullptr)
+        return nullptr;
+    memcpy(moved, pointer, block_size(block) - HEADER_SIZE);
+    arena_free(pointer);
+    return moved;
+}
+
+void NativeHost::use_device_heap(bool enabled)
+{
+    init_arena();
+    device_heap = enabled;
+}
+
+void *NativeHost::heap_alloc(size_t size)
+{
+    return device_heap ? arena_alloc(size) : malloc(size);
+}
+
+void *NativeHost::heap_realloc(void *pointer, size_t size)
+{
+    if (pointer == nullptr)
+        return heap_alloc(size);
+    return in_arena(pointer) ? arena_realloc(pointer, size) : realloc(pointer, size);
+}
+
+void NativeHost::heap_free(void *pointer)
+{
+    if (pointer == nullptr)
+        return;
+    if (in_arena(pointer))
+        arena_free(pointer);
+    else
+        free(pointer);
+}
+
+void heap_caps_get_info(multi_heap_info_t *info, uint32_t)
+{
+    init_arena();
+    memset(info, 0, sizeof(*info));
+    for (BlockHeader *block = (BlockHeader *)arena; !is_end(block); block = next_block(block))
+    {
+        size_t payload = block_size(block) - HEADER_SIZE;
+        if (block_used(block))
+        {
+            info->total_allocated_bytes += payload;
+        }
+        else
+        {
+            info->free_blocks++;
+            info->largest_free_block = max(info->largest_free_block, payload);
+        }
+        info->total_blocks++;
+    }
+    info->total_free_bytes = free_bytes;
+    info->minimum_free_bytes = minimum_free_bytes;
+    info->allocated_blocks = used_blocks;
+}
+
+size_t heap_caps_get_free_size(uint32_t)
+{
+    init_arena();
+    return free_bytes;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t)
+{
+    init_arena();
+    return minimum_free_bytes;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, caps);
+    return info.largest_free_block;
+}
+
+esp_err_t heap_caps_register_failed_alloc_callback(esp_alloc_failed_hook_t callback)
+{
+    failed_alloc_hook = callback;
+    return ESP_OK;
+}
+
+uint32_t EspClass::getHeapSize()
+{
+    return sizeof(arena);
+}
+
+uint32_t EspClass::getFreeHeap()
+{
+    return heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+}
+
+uint32_t EspClass::getMinFreeHeap()
+{
+    return heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+}
+
+uint32_t EspClass::getMaxAllocHeap()
+{
+    return heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT);
+}
+
+void *operator new(size_t size)
+{
+    void *pointer = NativeHost::heap_alloc(size > 0 ? size : 1);
+    if (pointer == nullptr)
+    {
+        fprintf(stderr, "native: out of heap allocating %zu bytes\n", size);
+        abort();
+    }
+    return pointer;
+}
+
+void operator delete(void *pointer) noexcept
+{
+    NativeHost::heap_free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    NativeHost::heap_free(pointer);
+}
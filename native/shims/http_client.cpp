@@ -0,0 +1,218 @@
+// HTTPClient for the host build, see HTTPClient.h
+
+#include <HTTPClient.h>
+
+bool HTTPClient::begin(WiFiClient &client, const String &url)
+{
+    int scheme_end = url.indexOf("://");
+    String scheme = scheme_end < 0 ? String("") : url.substring(0, scheme_end);
+    if (scheme != "http" && scheme != "https")
+        return false;
+
+    String rest = url.substring(scheme_end + 3);
+    int path_start = rest.indexOf('/');
+    String authority = path_start < 0 ? rest : rest.substring(0, path_start);
+    uri = path_start < 0 ? String("/") : rest.substring(path_start);
+    int colon = authority.indexOf(':');
+    host = colon < 0 ? authority : authority.substring(0, colon);
+    port = colon >= 0 ? authority.substring(colon + 1).toInt() : scheme == "https" ? 443 : 80;
+
+    // A kept-alive connection only serves the host it was opened to
+    String target = host + ":" + String(port);
+    if (this->client != &client || connected_to != target)
+    {
+        client.stop();
+        connected_to = target;
+    }
+    this->client = &client;
+    headers = "";
+    return true;
+}
+
+void HTTPClient::end()
+{
+    if (client != nullptr && !(reuse && keep_alive && body_read))
+        client->stop();
+    headers = "";
+}
+
+void HTTPClient::addHeader(const String &name, const String &value)
+{
+    headers += name + ": " + value + "\r\n";
+}
+
+int HTTPClient::sendRequest(const char *type, const String &payload)
+{
+    if (client == nullptr)
+        return HTTPC_ERROR_NOT_CONNECTED;
+    if (!client->connected() && !client->connect(host.c_str(), port, connect_timeout))
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+
+    String request = String(type) + " " + uri + " HTTP/1.1\r\nHost: " + host;
+    if (port != 80)
+        request += ":" + String(port);
+    request += "\r\nUser-Agent: ESP32HTTPClient\r\n";
+    request += reuse ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    request += headers;
+    if (payload.length() > 0)
+        request += "Content-Length: " + String(payload.length()) + "\r\n";
+    request += "\r\n";
+
+    if (client->write((const uint8_t *)request.c_str(), request.length()) != request.length())
+        return HTTPC_ERROR_SEND_HEADER_FAILED;
+    if (payload.length() > 0 &&
+        client->write((const uint8_t *)payload.c_str(), payload.length()) != payload.length())
+        return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+
+    content_length = -1;
+    chunked = false;
+    keep_alive = reuse;
+    body_read = false;
+
+    String line;
+    int error = read_line(line);
+    if (error < 0)
+        return error;
+    if (!line.startsWith("HTTP/1."))
+        return HTTPC_ERROR_NO_HTTP_SERVER;
+    int status = line.substring(9, 12).toInt();
+    if (line.startsWith("HTTP/1.0"))
+        keep_alive = false;
+
+    while (true)
+    {
+        error = read_line(line);
+        if (error < 0)
+            return error;
+        if (line.length() == 0)
+            break;
+
+        int colon = line.indexOf(':');
+        if (colon < 0)
+            continue;
+        String name = line.substring(0, colon);
+        String value = line.substring(colon + 1);
+        name.toLowerCase();
+        value.trim();
+        value.toLowerCase();
+        if (name == "content-length")
+            content_length = value.toInt();
+        else if (name == "transfer-encoding" && value == "chunked")
+            chunked = true;
+        else if (name == "connection" && value == "close")
+            keep_alive = false;
+    }
+    return status;
+}
+
+// Returns the body's length, or a negative HTTPC_ERROR_ code when the
+// connection closed or went quiet before the end of the body
+int HTTPClient::writeToStream(Stream *stream)
+{
+    if (stream == nullptr)
+        return HTTPC_ERROR_NO_STREAM;
+
+    int total = 0;
+    if (chunked)
+    {
+        String line;
+        while (true)
+        {
+            int error = read_line(line);
+            if (error < 0)
+                return error;
+            int size = strtol(line.c_str(), nullptr, 16);
+            if (size == 0)
+            {
+                error = read_line(line);
+                if (error < 0)
+                    return error;
+                break;
+            }
+            int read = read_bytes(stream, size);
+            if (read < 0)
+                return read;
+            total += read;
+            error = read_line(line);
+            if (error < 0)
+                return error;
+        }
+    }
+    else if (content_length >= 0)
+    {
+        total = read_bytes(stream, content_length);
+        if (total < 0)
+            return total;
+    }
+    else
+    {
+        // Ends with the connection
+        keep_alive = false;
+        uint8_t buffer[1024];
+        while (wait_for_data() == 0)
+        {
+            int read = client->read(buffer, sizeof(buffer));
+            if (read <= 0)
+                break;
+            stream->write(buffer, read);
+            total += read;
+        }
+    }
+    body_read = true;
+    return total;
+}
+
+// 0 once data is waiting, else why none will come
+int HTTPClient::wait_for_data()
+{
+    uint32_t start = millis();
+    while (client->available() == 0)
+    {
+        if (!client->connected())
+            return HTTPC_ERROR_CONNECTION_LOST;
+        if (millis() - start >= read_timeout)
+        {
+            client->stop();
+            return HTTPC_ERROR_READ_TIMEOUT;
+        }
+        delay(1);
+    }
+    return 0;
+}
+
+int HTTPClient::read_line(String &line)
+{
+    line = "";
+    while (true)
+    {
+        int error = wait_for_data();
+        if (error < 0)
+            return error;
+        int data = client->read();
+        if (data < 0)
+            return HTTPC_ERROR_CONNECTION_LOST;
+        if (data == '\n')
+            break;
+        if (data != '\r')
+            line += (char)data;
+    }
+    return 0;
+}
+
+int HTTPClient::read_bytes(Stream *stream, size_t count)
+{
+    uint8_t buffer[1024];
+    size_t done = 0;
+    while (done < count)
+    {
+        int error = wait_for_data();
+        if (error < 0)
+            return error;
+        int read = client->read(buffer, min(sizeof(buffer), count - done));
+        if (read <= 0)
+            return HTTPC_ERROR_CONNECTION_LOST;
+        stream->write(buffer, read);
+        done += read;
+    }
+    return done;
+}
@@ -0,0 +1,280 @@
+#include <LittleFS.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+fs::LittleFSFS LittleFS;
+
+namespace fs
+{
+    class FileImpl
+    {
+    public:
+        String fs_path;
+        String host_path;
+        FILE *file = nullptr;
+        DIR *dir = nullptr;
+        String open_mode;
+
+        ~FileImpl() { close(); }
+
+        void close()
+        {
+            if (file != nullptr)
+                fclose(file);
+            if (dir != nullptr)
+                closedir(dir);
+            file = nullptr;
+            dir = nullptr;
+        }
+    };
+}
+
+static std::shared_ptr<fs::FileImpl> open_impl(const fs::FS &filesystem, const char *path, const char *mode)
+{
+    std::shared_ptr<fs::FileImpl> impl(new fs::FileImpl());
+    impl->fs_path = path;
+    impl->host_path = filesystem.host_path(path);
+    impl->open_mode = mode;
+
+    struct stat info;
+    if (stat(impl->host_path.c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+    {
+        impl->dir = opendir(impl->host_path.c_str());
+        return impl->dir != nullptr ? impl : nullptr;
+    }
+
+    const char *host_mode = strcmp(mode, FILE_WRITE) == 0 ? "w+b" : strcmp(mode, FILE_APPEND) == 0 ? "a+b" : "rb";
+    impl->file = fopen(impl->host_path.c_str(), host_mode);
+    return impl->file != nullptr ? impl : nullptr;
+}
+
+String fs::FS::host_path(const char *path) const
+{
+    String host = NativeHost::flash_dir();
+    host += "/";
+    host += subdirectory;
+    if (path[0] != '/')
+        host += "/";
+    host += path;
+    return host;
+}
+
+fs::File fs::FS::open(const char *path, const char *mode, bool)
+{
+    if (!mounted || path == nullptr || path[0] != '/')
+        return File();
+    std::shared_ptr<FileImpl> impl = open_impl(*this, path, mode);
+    return impl ? File(impl) : File();
+}
+
+bool fs::FS::exists(const char *path)
+{
+    struct stat info;
+    return mounted && stat(host_path(path).c_str(), &info) == 0;
+}
+
+bool fs::FS::remove(const char *path)
+{
+    return mounted && unlink(host_path(path).c_str()) == 0;
+}
+
+bool fs::FS::rename(const char *from, const char *to)
+{
+    return mounted && ::rename(host_path(from).c_str(), host_path(to).c_str()) == 0;
+}
+
+bool fs::FS::mkdir(const char *path)
+{
+    return mounted && (::mkdir(host_path(path).c_str(), 0755) == 0 || errno == EEXIST);
+}
+
+bool fs::FS::rmdir(const char *path)
+{
+    return mounted && ::rmdir(host_path(path).c_str()) == 0;
+}
+
+bool fs::LittleFSFS::begin(bool, const char *, uint8_t, const char *)
+{
+    String root = host_path("/");
+    ::mkdir(NativeHost::flash_dir(), 0755);
+    if (::mkdir(root.c_str(), 0755) != 0 && errno != EEXIST)
+        return false;
+    mounted = true;
+    return true;
+}
+
+static void remove_tree(const String &path)
+{
+    DIR *dir = opendir(path.c_str());
+    if (dir == nullptr)
+        return;
+    for (struct dirent *entry = readdir(dir); entry != nullptr; entry = readdir(dir))
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        String child = path + "/" + entry->d_name;
+        remove_tree(child);
+        ::remove(child.c_str());
+    }
+    closedir(dir);
+}
+
+bool fs::LittleFSFS::format()
+{
+    remove_tree(host_path("/"));
+    return true;
+}
+
+// The min_spiffs partition the device uses
+size_t fs::LittleFSFS::totalBytes()
+{
+    return 0x30000;
+}
+
+static size_t tree_size(const String &path)
+{
+    size_t total = 0;
+    DIR *dir = opendir(path.c_str());
+    if (dir == nullptr)
+        return 0;
+    for (struct dirent *entry = readdir(dir); entry != nullptr; entry = readdir(dir))
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        String child = path + "/" + entry->d_name;
+        struct stat info;
+        if (stat(child.c_str(), &info) == 0)
+            total += S_ISDIR(info.st_mode) ? tree_size(child) : info.st_size;
+    }
+    closedir(dir);
+    return total;
+}
+
+size_t fs::LittleFSFS::usedBytes()
+{
+    return tree_size(host_path("/"));
+}
+
+size_t fs::File::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t fs::File::write(const uint8_t *data, size_t length)
+{
+    if (!impl || impl->file == nullptr || impl->open_mode == FILE_READ)
+        return 0;
+    return fwrite(data, 1, length, impl->file);
+}
+
+int fs::File::available()
+{
+    return impl && impl->file != nullptr ? (int)(size() - position()) : 0;
+}
+
+int fs::File::read()
+{
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+size_t fs::File::read(uint8_t *buffer, size_t length)
+{
+    if (!impl || impl->file == nullptr)
+        return 0;
+    return fread(buffer, 1, length, impl->file);
+}
+
+int fs::File::peek()
+{
+    if (!impl || impl->file == nullptr)
+        return -1;
+    int c = fgetc(impl->file);
+    if (c != EOF)
+        ungetc(c, impl->file);
+    return c == EOF ? -1 : c;
+}
+
+void fs::File::flush()
+{
+    if (impl && impl->file != nullptr)
+        fflush(impl->file);
+}
+
+bool fs::File::seek(uint32_t position, SeekMode mode)
+{
+    if (!impl || impl->file == nullptr)
+        return false;
+    int whence = mode == SeekCur ? SEEK_CUR : mode == SeekEnd ? SEEK_END : SEEK_SET;
+    return fseek(impl->file, position, whence) == 0;
+}
+
+size_t fs::File::position() const
+{
+    return impl && impl->file != nullptr ? ftell(impl->file) : 0;
+}
+
+size_t fs::File::size() const
+{
+    if (!impl || impl->file == nullptr)
+        return 0;
+    fflush(impl->file);
+    struct stat info;
+    return fstat(fileno(impl->file), &info) == 0 ? info.st_size : 0;
+}
+
+void fs::File::close()
+{
+    if (impl)
+        impl->close();
+    impl.reset();
+}
+
+fs::File::operator bool() const
+{
+    return impl && (impl->file != nullptr || impl->dir != nullptr);
+}
+
+const char *fs::File::path() const
+{
+    return impl ? impl->fs_path.c_str() : nullptr;
+}
+
+const char *fs::File::name() const
+{
+    if (!impl)
+        return nullptr;
+    const char *path = impl->fs_path.c_str();
+    const char *slash = strrchr(path, '/');
+    return slash != nullptr ? slash + 1 : path;
+}
+
+bool fs::File::isDirectory() const
+{
+    return impl && impl->dir != nullptr;
+}
+
+fs::File fs::File::openNextFile(const char *mode)
+{
+    if (!impl || impl->dir == nullptr)
+        return File();
+    for (struct dirent *entry = readdir(impl->dir); entry != nullptr; entry = readdir(impl->dir))
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        String child = impl->fs_path;
+        if (!child.endsWith("/"))
+            child += "/";
+        child += entry->d_name;
+        return LittleFS.open(child.c_str(), mode);
+    }
+    return File();
+}
+
+void fs::File::rewindDirectory()
+{
+    if (impl && impl->dir != nullptr)
+        rewinddir(impl->dir);
+}
@@ -0,0 +1,13 @@
+#ifndef MBEDTLS_BASE64_H
+#define MBEDTLS_BASE64_H
+
+#include <stddef.h>
+
+#define MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL -0x002A
+#define MBEDTLS_ERR_BASE64_INVALID_CHARACTER -0x002C
+
+// Same contract as mbedtls: on a short buffer *olen is set to the size needed
+int mbedtls_base64_encode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen);
+int mbedtls_base64_decode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef MBEDTLS_SSL_H
+#define MBEDTLS_SSL_H
+
+// Only the types TlsClient keeps as members. The host build has no TLS, see
+// native/fakes/tls_client.cpp.
+typedef struct
+{
+    int unused;
+} mbedtls_ssl_context;
+
+typedef struct
+{
+    int unused;
+} mbedtls_ssl_config;
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef NATIVE_HOST_H
+#define NATIVE_HOST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+struct CRGB;
+
+// The world outside the board as the host build sees it. The shims ask it
+// whenever the firmware would reach past the ESP32: joining WiFi, asking an
+// NTP server, reading the button, lighting the strip and going to sleep.
+// Everything has a harmless default, so a benchmark can leave it unset.
+class NativeEnvironment
+{
+public:
+    virtual ~NativeEnvironment() {}
+
+    // WiFi.begin(): whether the access point answers and how long joining takes
+    virtual bool wifi_join(uint32_t &join_ms)
+    {
+        join_ms = 0;
+        return false;
+    }
+    // Microseconds since the epoch an NTP server would answer with, 0 when
+    // none answers, and how long the answer takes
+    virtual int64_t ntp_time_us() { return 0; }
+    virtual uint32_t ntp_delay_ms() { return 0; }
+
+    // Uptime of the next input change, such as a button edge, INT64_MAX for none
+    virtual int64_t next_event_us() { return INT64_MAX; }
+    virtual void run_event(int64_t) {}
+
+    // FastLED.show(): the frame as it reaches the strip
+    virtual void strip_shown(const CRGB *, int, uint8_t) {}
+
+    // esp_deep_sleep_start() and ESP.restart(); neither may return
+    virtual void deep_sleep(uint64_t timer_us, bool ext0_armed);
+    virtual void restart();
+};
+
+// Host side of the shims: the virtual clock, the button pin, RTC memory and
+// the directory standing in for flash
+namespace NativeHost
+{
+    void set_environment(NativeEnvironment *environment);
+    NativeEnvironment &environment();
+
+    // Microseconds since boot. The clock only moves while every task waits,
+    // straight to the next wakeup, unless use_host_clock() ties it to the
+    // host's monotonic clock for benchmarks.
+    int64_t uptime_us();
+    void use_host_clock(bool enabled);
+    // Runs setup() and then loop() forever on the main task
+    void run_firmware();
+
+    // The RTC's wall clock in microseconds since the epoch, 0 until set
+    int64_t clock_us();
+    void set_clock_us(int64_t epoch_us);
+    // Sets the clock to epoch_us once the uptime reaches uptime_us
+    void set_clock_at(int64_t uptime_us, int64_t epoch_us);
+
+    // What esp_sleep_get_wakeup_cause() reports (an esp_sleep_wakeup_cause_t)
+    void set_wakeup_cause(int cause);
+
+    // Drives a GPIO input and runs its interrupt handler on a change
+    void set_pin(int pin, int level);
+
+    // The RTC_DATA_ATTR variables as one block, to keep across a deep sleep
+    void *rtc_memory();
+    size_t rtc_memory_size();
+
+    // Directory holding LittleFS (fs/) and NVS (nvs/)
+    void set_flash_dir(const char *path);
+    const char *flash_dir();
+
+    // Where Serial writes, nullptr to drop it
+    void set_serial(FILE *out);
+
+    // Routes operator new and String through a first-fit heap the size of the
+    // ESP32's, so heap_caps_get_info() and ESP.getFreeHeap() report something
+    // real. Plain malloc() is not counted.
+    void use_device_heap(bool enabled);
+    void *heap_alloc(size_t size);
+    void *heap_realloc(void *pointer, size_t size);
+    void heap_free(void *pointer);
+}
+
+#endif
@@ -0,0 +1,88 @@
+// WiFi, ArduinoOTA and their helpers for the host build
+
+#include <WiFi.h>
+#include <ArduinoOTA.h>
+
+WiFiClass WiFi;
+ArduinoOTAClass ArduinoOTA;
+
+static const uint8_t MAC_ADDRESS[6] = {0x24, 0x6F, 0x28, 0x00, 0x5A, 0x1E};
+
+String IPAddress::toString() const
+{
+    char text[16];
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3]);
+    return String(text);
+}
+
+wl_status_t WiFiClass::begin(const char *, const char *)
+{
+    uint32_t join_ms;
+    connected_at_us = -1;
+    if (NativeHost::environment().wifi_join(join_ms))
+        connected_at_us = NativeHost::uptime_us() + (int64_t)join_ms * 1000;
+    return status();
+}
+
+wl_status_t WiFiClass::status()
+{
+    if (connected_at_us < 0)
+        return WL_DISCONNECTED;
+    return NativeHost::uptime_us() >= connected_at_us ? WL_CONNECTED : WL_IDLE_STATUS;
+}
+
+bool WiFiClass::disconnect(bool)
+{
+    connected_at_us = -1;
+    return true;
+}
+
+bool WiFiClass::mode(wifi_mode_t mode)
+{
+    if (mode == WIFI_OFF)
+        connected_at_us = -1;
+    return true;
+}
+
+IPAddress WiFiClass::localIP()
+{
+    return status() == WL_CONNECTED ? IPAddress(192, 168, 1, 50) : IPAddress();
+}
+
+uint8_t *WiFiClass::macAddress(uint8_t *mac)
+{
+    memcpy(mac, MAC_ADDRESS, sizeof(MAC_ADDRESS));
+    return mac;
+}
+
+String WiFiClass::macAddress()
+{
+    char text[18];
+    snprintf(text, sizeof(text), "%02X:%02X:%02X:%02X:%02X:%02X", MAC_ADDRESS[0], MAC_ADDRESS[1], MAC_ADDRESS[2],
+             MAC_ADDRESS[3], MAC_ADDRESS[4], MAC_ADDRESS[5]);
+    return String(text);
+}
+
+ArduinoOTAClass &ArduinoOTAClass::onStart(THandlerFunction handler)
+{
+    start_handler = handler;
+    return *this;
+}
+
+ArduinoOTAClass &ArduinoOTAClass::onEnd(THandlerFunction handler)
+{
+    end_handler = handler;
+    return *this;
+}
+
+ArduinoOTAClass &ArduinoOTAClass::onError(THandlerFunction_Error handler)
+{
+    error_handler = handler;
+    return *this;
+}
+
+ArduinoOTAClass &ArduinoOTAClass::onProgress(THandlerFunction_Progress handler)
+{
+    progress_handler = handler;
+    return *this;
+}
@@ -0,0 +1,132 @@
+#include <Preferences.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define NVS_KEY_NAME_MAX_SIZE 16
+
+bool Preferences::begin(const char *name, bool read_only, const char *)
+{
+    if (started || name == nullptr || strlen(name) >= NVS_KEY_NAME_MAX_SIZE)
+        return false;
+    char nvs[sizeof(directory) - NVS_KEY_NAME_MAX_SIZE];
+    if (snprintf(nvs, sizeof(nvs), "%s/nvs", NativeHost::flash_dir()) >= (int)sizeof(nvs) ||
+        snprintf(directory, sizeof(directory), "%s/%s", nvs, name) >= (int)sizeof(directory))
+        return false;
+
+    // Opening a namespace read-only fails until something was written to it
+    struct stat info;
+    if (stat(directory, &info) != 0)
+    {
+        if (read_only)
+            return false;
+        mkdir(NativeHost::flash_dir(), 0755);
+        mkdir(nvs, 0755);
+        if (mkdir(directory, 0755) != 0)
+            return false;
+    }
+    started = true;
+    this->read_only = read_only;
+    return true;
+}
+
+void Preferences::end()
+{
+    started = false;
+}
+
+bool Preferences::key_path(const char *key, char *path, size_t size)
+{
+    if (!started || key == nullptr || strlen(key) >= NVS_KEY_NAME_MAX_SIZE)
+        return false;
+    snprintf(path, size, "%s/%s", directory, key);
+    return true;
+}
+
+bool Preferences::clear()
+{
+    if (!started || read_only)
+        return false;
+    DIR *dir = opendir(directory);
+    if (dir == nullptr)
+        return false;
+    for (struct dirent *entry = readdir(dir); entry != nullptr; entry = readdir(dir))
+    {
+        char path[600];
+        if (entry->d_name[0] != '.' && key_path(entry->d_name, path, sizeof(path)))
+            unlink(path);
+    }
+    closedir(dir);
+    return true;
+}
+
+bool Preferences::remove(const char *key)
+{
+    char path[600];
+    return !read_only && key_path(key, path, sizeof(path)) && unlink(path) == 0;
+}
+
+bool Preferences::isKey(const char *key)
+{
+    char path[600];
+    struct stat info;
+    return key_path(key, path, sizeof(path)) && stat(path, &info) == 0;
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t length)
+{
+    char path[600];
+    if (read_only || !key_path(key, path, sizeof(path)))
+        return 0;
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr)
+        return 0;
+    size_t written = fwrite(value, 1, length, file);
+    fclose(file);
+    return written;
+}
+
+size_t Preferences::putUInt(const char *key, uint32_t value)
+{
+    return putBytes(key, &value, sizeof(value));
+}
+
+size_t Preferences::putInt(const char *key, int32_t value)
+{
+    return putBytes(key, &value, sizeof(value));
+}
+
+size_t Preferences::getBytesLength(const char *key)
+{
+    char path[600];
+    struct stat info;
+    if (!key_path(key, path, sizeof(path)) || stat(path, &info) != 0)
+        return 0;
+    return info.st_size;
+}
+
+size_t Preferences::getBytes(const char *key, void *buffer, size_t max_length)
+{
+    char path[600];
+    size_t length = getBytesLength(key);
+    if (length == 0 || length > max_length || !key_path(key, path, sizeof(path)))
+        return 0;
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+        return 0;
+    size_t read = fread(buffer, 1, length, file);
+    fclose(file);
+    return read;
+}
+
+uint32_t Preferences::getUInt(const char *key, uint32_t default_value)
+{
+    uint32_t value;
+    return getBytesLength(key) == sizeof(value) && getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : default_value;
+}
+
+int32_t Preferences::getInt(const char *key, int32_t default_value)
+{
+    int32_t value;
+    return getBytesLength(key) == sizeof(value) && getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : default_value;
+}
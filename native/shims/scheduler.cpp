@@ -0,0 +1,481 @@
+// Virtual clock, FreeRTOS tasks, esp_timer and deep sleep for the host build.
+// Every task is a ucontext coroutine on the one host thread. A task runs until
+// it waits; the scheduler then runs due timer callbacks and environment events
+// and resumes the highest-priority task that is due, moving the clock straight
+// to the earliest wakeup when none is.
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <vector>
+
+struct NativeTask
+{
+    ucontext_t context;
+    TaskFunction_t function;
+    void *parameter;
+    const char *name;
+    UBaseType_t priority;
+    int64_t wake_us; // INT64_MAX while waiting for a notification only
+    uint32_t notify_count;
+    bool waiting_notify;
+    bool finished;
+    void *stack;
+    size_t stack_size;
+};
+
+struct esp_timer
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    uint64_t period_us;
+    int64_t next_us;
+    bool armed;
+};
+
+// Host code needs far more stack than the firmware asks FreeRTOS for
+static const size_t TASK_STACK_SIZE = 512 * 1024;
+
+static std::vector<NativeTask *> tasks;
+static std::vector<esp_timer *> timers;
+static NativeTask *current = nullptr;
+static int64_t virtual_now_us = 0;
+static bool host_clock = false;
+static int64_t host_epoch_us = 0;
+static int64_t clock_base_us = 0; // Wall clock minus uptime, 0 while unset
+static int64_t clock_pending_at_us = -1;
+static int64_t clock_pending_us = 0;
+static esp_sleep_wakeup_cause_t wakeup_cause = ESP_SLEEP_WAKEUP_UNDEFINED;
+static uint64_t sleep_timer_us = 0;
+static bool sleep_ext0 = false;
+
+static NativeEnvironment default_environment;
+static NativeEnvironment *env = &default_environment;
+
+void setup();
+void loop();
+
+static int64_t host_monotonic_us()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static NativeTask *main_task()
+{
+    if (tasks.empty())
+    {
+        NativeTask *task = new NativeTask();
+        task->name = "loopTask";
+        task->priority = 1;
+        tasks.push_back(task);
+        current = task;
+    }
+    return tasks[0];
+}
+
+static void task_entry()
+{
+    current->function(current->parameter);
+    vTaskDelete(nullptr);
+}
+
+static void switch_to(NativeTask *next)
+{
+    if (next == current)
+        return;
+    NativeTask *previous = current;
+    current = next;
+    swapcontext(&previous->context, &next->context);
+}
+
+static void advance_to(int64_t at_us)
+{
+    if (!host_clock)
+    {
+        virtual_now_us = at_us;
+        return;
+    }
+    int64_t wait_us = at_us - NativeHost::uptime_us();
+    if (wait_us > 0)
+    {
+        struct timespec pause = {(time_t)(wait_us / 1000000), (long)(wait_us % 1000000) * 1000};
+        nanosleep(&pause, nullptr);
+    }
+}
+
+static esp_timer *earliest_timer()
+{
+    esp_timer *earliest = nullptr;
+    for (esp_timer *timer : timers)
+    {
+        if (timer->armed && (earliest == nullptr || timer->next_us < earliest->next_us))
+            earliest = timer;
+    }
+    return earliest;
+}
+
+// Runs what is due and switches to the task that should run next, which may
+// be the calling one
+static void reschedule()
+{
+    main_task();
+    while (true)
+    {
+        int64_t now = NativeHost::uptime_us();
+
+        esp_timer *timer = earliest_timer();
+        if (timer != nullptr && timer->next_us <= now)
+        {
+            if (timer->period_us > 0)
+                timer->next_us += timer->period_us;
+            else
+                timer->armed = false;
+            timer->callback(timer->arg);
+            continue;
+        }
+
+        int64_t event_us = env->next_event_us();
+        if (event_us <= now)
+        {
+            env->run_event(now);
+            continue;
+        }
+
+        // Highest priority first, then the one waiting longest
+        NativeTask *next = nullptr;
+        int64_t next_wake = INT64_MAX;
+        for (NativeTask *task : tasks)
+        {
+            if (task->finished || task->wake_us > now)
+                continue;
+            if (next == nullptr || task->priority > next->priority ||
+                (task->priority == next->priority && task->wake_us < next->wake_us))
+                next = task;
+        }
+        if (next != nullptr)
+        {
+            next->wake_us = INT64_MAX;
+            switch_to(next);
+            return;
+        }
+
+        for (NativeTask *task : tasks)
+        {
+            if (!task->finished)
+                next_wake = min(next_wake, task->wake_us);
+        }
+        if (timer != nullptr)
+            next_wake = min(next_wake, timer->next_us);
+        next_wake = min(next_wake, event_us);
+        if (next_wake == INT64_MAX)
+        {
+            fprintf(stderr, "native: every task waits forever\n");
+            abort();
+        }
+        advance_to(next_wake);
+    }
+}
+
+static void wait_until(int64_t wake_us)
+{
+    main_task();
+    current->wake_us = wake_us;
+    reschedule();
+}
+
+static void wait_for(int64_t duration_us)
+{
+    wait_until(NativeHost::uptime_us() + duration_us);
+}
+
+int64_t NativeHost::uptime_us()
+{
+    if (!host_clock)
+        return virtual_now_us;
+    return host_monotonic_us() - host_epoch_us;
+}
+
+void NativeHost::use_host_clock(bool enabled)
+{
+    if (enabled == host_clock)
+        return;
+    int64_t now = uptime_us();
+    host_clock = enabled;
+    if (enabled)
+        host_epoch_us = host_monotonic_us() - now;
+    else
+        virtual_now_us = now;
+}
+
+void NativeHost::set_environment(NativeEnvironment *environment)
+{
+    env = environment != nullptr ? environment : &default_environment;
+}
+
+NativeEnvironment &NativeHost::environment()
+{
+    return *env;
+}
+
+void NativeHost::run_firmware()
+{
+    main_task();
+    setup();
+    while (true)
+    {
+        loop();
+        yield();
+    }
+}
+
+int64_t NativeHost::clock_us()
+{
+    if (clock_pending_at_us >= 0 && uptime_us() >= clock_pending_at_us)
+    {
+        clock_base_us = clock_pending_us - clock_pending_at_us;
+        clock_pending_at_us = -1;
+    }
+    return clock_base_us != 0 ? clock_base_us + uptime_us() : 0;
+}
+
+void NativeHost::set_clock_us(int64_t epoch_us)
+{
+    clock_base_us = epoch_us != 0 ? epoch_us - uptime_us() : 0;
+}
+
+void NativeHost::set_clock_at(int64_t uptime_us, int64_t epoch_us)
+{
+    clock_pending_at_us = uptime_us;
+    clock_pending_us = epoch_us;
+}
+
+void NativeHost::set_wakeup_cause(int cause)
+{
+    wakeup_cause = (esp_sleep_wakeup_cause_t)cause;
+}
+
+// The firmware reads the wall clock with time(), so it is replaced for the
+// whole program. The host side uses its own clocks.
+extern "C" time_t time(time_t *out)
+{
+    time_t now = (time_t)(NativeHost::clock_us() / 1000000);
+    if (out != nullptr)
+        *out = now;
+    return now;
+}
+
+void NativeEnvironment::deep_sleep(uint64_t, bool)
+{
+    fflush(nullptr);
+    exit(0);
+}
+
+void NativeEnvironment::restart()
+{
+    fflush(nullptr);
+    exit(0);
+}
+
+unsigned long millis()
+{
+    return (unsigned long)(NativeHost::uptime_us() / 1000);
+}
+
+unsigned long micros()
+{
+    return (unsigned long)NativeHost::uptime_us();
+}
+
+void delay(uint32_t ms)
+{
+    wait_for((int64_t)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    wait_for(us);
+}
+
+void yield()
+{
+    wait_for(0);
+}
+
+int64_t esp_timer_get_time()
+{
+    return NativeHost::uptime_us();
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle)
+{
+    if (args == nullptr || args->callback == nullptr || out_handle == nullptr)
+        return ESP_ERR_INVALID_ARG;
+    esp_timer *timer = new esp_timer();
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    timers.push_back(timer);
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if (timer->armed)
+        return ESP_ERR_INVALID_STATE;
+    timer->period_us = 0;
+    timer->next_us = NativeHost::uptime_us() + timeout_us;
+    timer->armed = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    if (timer->armed)
+        return ESP_ERR_INVALID_STATE;
+    timer->period_us = period_us;
+    timer->next_us = NativeHost::uptime_us() + period_us;
+    timer->armed = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer->armed)
+        return ESP_ERR_INVALID_STATE;
+    timer->armed = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    for (size_t i = 0; i < timers.size(); i++)
+    {
+        if (timers[i] == timer)
+            timers.erase(timers.begin() + i);
+    }
+    delete timer;
+    return ESP_OK;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t, void *parameter,
+                                   UBaseType_t priority, TaskHandle_t *created_task, BaseType_t)
+{
+    main_task();
+    NativeTask *task = new NativeTask();
+    task->function = function;
+    task->parameter = parameter;
+    task->name = name;
+    task->priority = priority;
+    task->wake_us = NativeHost::uptime_us();
+    task->stack_size = TASK_STACK_SIZE;
+    task->stack = mmap(nullptr, task->stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (task->stack == MAP_FAILED)
+    {
+        delete task;
+        return pdFAIL;
+    }
+
+    getcontext(&task->context);
+    task->context.uc_stack.ss_sp = task->stack;
+    task->context.uc_stack.ss_size = task->stack_size;
+    task->context.uc_link = nullptr;
+    makecontext(&task->context, task_entry, 0);
+    tasks.push_back(task);
+
+    if (created_task != nullptr)
+        *created_task = task;
+    // A new task of higher priority runs right away, as on FreeRTOS
+    if (priority > current->priority)
+        yield();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *parameter,
+                       UBaseType_t priority, TaskHandle_t *created_task)
+{
+    return xTaskCreatePinnedToCore(function, name, stack_depth, parameter, priority, created_task, tskNO_AFFINITY);
+}
+
+// The stack of a deleted task is left mapped, since it may be the one running
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == nullptr)
+        task = xTaskGetCurrentTaskHandle();
+    task->finished = true;
+    if (task == current)
+        reschedule();
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    wait_for((int64_t)ticks * 1000 * portTICK_PERIOD_MS);
+}
+
+TickType_t xTaskGetTickCount()
+{
+    return (TickType_t)(NativeHost::uptime_us() / 1000 / portTICK_PERIOD_MS);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    main_task();
+    return current;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    task->notify_count++;
+    if (task->waiting_notify)
+        task->wake_us = min(task->wake_us, NativeHost::uptime_us());
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken)
+{
+    xTaskNotifyGive(task);
+    if (higher_priority_task_woken != nullptr)
+        *higher_priority_task_woken = pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait)
+{
+    main_task();
+    if (current->notify_count == 0 && ticks_to_wait > 0)
+    {
+        current->waiting_notify = true;
+        wait_until(ticks_to_wait == portMAX_DELAY ? INT64_MAX
+                                                  : NativeHost::uptime_us() + (int64_t)ticks_to_wait * 1000 * portTICK_PERIOD_MS);
+        current->waiting_notify = false;
+    }
+    uint32_t count = current->notify_count;
+    if (count > 0)
+        current->notify_count = clear_count_on_exit ? 0 : count - 1;
+    return count;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause()
+{
+    return wakeup_cause;
+}
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us)
+{
+    sleep_timer_us = time_in_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_ext0_wakeup(gpio_num_t, int)
+{
+    sleep_ext0 = true;
+    return ESP_OK;
+}
+
+void esp_deep_sleep_start()
+{
+    fflush(nullptr);
+    env->deep_sleep(sleep_timer_us, sleep_ext0);
+    exit(0);
+}
@@ -0,0 +1,9 @@
+#ifndef GPIO_REG_H
+#define GPIO_REG_H
+
+#include "soc.h"
+
+#define GPIO_IN_REG 0x3FF4403C
+#define GPIO_IN1_REG 0x3FF44040
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef SOC_H
+#define SOC_H
+
+#include <stdint.h>
+
+// Reads of the GPIO input register return the levels NativeHost::set_pin() drove
+uint32_t native_reg_read(uint32_t reg);
+
+#define REG_READ(reg) native_reg_read(reg)
+
+#endif
@@ -0,0 +1,138 @@
+// WiFiClient over the host's TCP sockets
+
+#include <WiFi.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+int WiFiClient::connect(const char *host, uint16_t port, int32_t timeout)
+{
+    stop();
+
+    char service[8];
+    snprintf(service, sizeof(service), "%u", (unsigned)port);
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *addresses = nullptr;
+    if (getaddrinfo(host, service, &hints, &addresses) != 0)
+        return 0;
+
+    // Non-blocking only while connecting, so the connect honors the timeout
+    for (struct addrinfo *address = addresses; address != nullptr && fd < 0; address = address->ai_next)
+    {
+        int candidate = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (candidate < 0)
+            continue;
+
+        int flags = fcntl(candidate, F_GETFL, 0);
+        fcntl(candidate, F_SETFL, flags | O_NONBLOCK);
+        int result = ::connect(candidate, address->ai_addr, address->ai_addrlen);
+        if (result != 0 && errno == EINPROGRESS)
+        {
+            struct pollfd waiting = {candidate, POLLOUT, 0};
+            int error = 0;
+            socklen_t length = sizeof(error);
+            if (poll(&waiting, 1, timeout) == 1 && getsockopt(candidate, SOL_SOCKET, SO_ERROR, &error, &length) == 0)
+                result = error == 0 ? 0 : -1;
+        }
+        if (result != 0)
+        {
+            close(candidate);
+            continue;
+        }
+
+        fcntl(candidate, F_SETFL, flags);
+        int one = 1;
+        setsockopt(candidate, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fd = candidate;
+    }
+    freeaddrinfo(addresses);
+    return fd >= 0 ? 1 : 0;
+}
+
+size_t WiFiClient::write(const uint8_t *buf, size_t size)
+{
+    if (fd < 0)
+        return 0;
+
+    size_t written = 0;
+    while (written < size)
+    {
+        ssize_t sent = send(fd, buf + written, size - written, MSG_NOSIGNAL);
+        if (sent <= 0)
+        {
+            stop();
+            break;
+        }
+        written += sent;
+    }
+    return written;
+}
+
+int WiFiClient::available()
+{
+    int count = 0;
+    if (fd < 0 || ioctl(fd, FIONREAD, &count) != 0)
+        return 0;
+    return count;
+}
+
+int WiFiClient::read()
+{
+    uint8_t data;
+    return read(&data, 1) == 1 ? data : -1;
+}
+
+// Like lwIP's client, only returns what has arrived already
+int WiFiClient::read(uint8_t *buf, size_t size)
+{
+    if (fd < 0)
+        return -1;
+    ssize_t received = recv(fd, buf, size, MSG_DONTWAIT);
+    if (received < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    return received;
+}
+
+int WiFiClient::peek()
+{
+    uint8_t data;
+    if (fd < 0 || recv(fd, &data, 1, MSG_PEEK | MSG_DONTWAIT) != 1)
+        return -1;
+    return data;
+}
+
+void WiFiClient::stop()
+{
+    if (fd >= 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+}
+
+// Unread data counts as connected, as on the ESP32; after that a peer that
+// has closed its end is noticed here
+uint8_t WiFiClient::connected()
+{
+    if (fd < 0)
+        return 0;
+    if (available() > 0)
+        return 1;
+
+    uint8_t data;
+    ssize_t received = recv(fd, &data, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+    {
+        stop();
+        return 0;
+    }
+    return 1;
+}
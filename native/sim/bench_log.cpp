@@ -0,0 +1,63 @@
+// Runs Logger::benchmark() on the host: the arena logger against the
+// String-per-entry ring it replaced, on the host's clock and a first-fit
+// heap the size of the ESP32's (see NativeHost::use_device_heap()). The
+// same benchmark runs on the device at GET /api/debug/log_benchmark.
+//
+//     .pio/build/native/program bench-log --messages 10000
+
+#include <Arduino.h>
+#include <getopt.h>
+#include "logger.h"
+#include "native_host.h"
+#include "sim.h"
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: program bench-log [options]\n"
+            "  --messages N   messages logged by each logger (10000)\n");
+}
+
+static void print_run(const char *name, const LogBenchmarkRun &run)
+{
+    printf("%-12s %12.0f %10ld %8ld %10ld %7.3f -> %.3f\n", name, run.logs_per_s, (long)run.heap_held,
+           (long)run.blocks_held, (long)run.largest_block_lost, run.fragmentation_before, run.fragmentation_after);
+}
+
+int bench_log_main(int argc, char **argv)
+{
+    static const struct option long_options[] = {
+        {"messages", required_argument, nullptr, 'm'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}};
+
+    int messages = 10000;
+    int option;
+    while ((option = getopt_long(argc, argv, "", long_options, nullptr)) != -1)
+    {
+        switch (option)
+        {
+        case 'm': messages = atoi(optarg); break;
+        case 'h': usage(); return 0;
+        default: usage(); return 2;
+        }
+    }
+    if (messages <= 0)
+    {
+        usage();
+        return 2;
+    }
+
+    NativeHost::set_serial(nullptr);
+    NativeHost::use_host_clock(true);
+    NativeHost::use_device_heap(true);
+
+    LogBenchmark result;
+    Logger::benchmark(messages, result);
+
+    printf("%d messages\n", result.messages);
+    printf("%-12s %12s %10s %8s %10s %s\n", "logger", "logs/s", "heap held", "blocks", "largest -", "fragmentation");
+    print_run("arena", result.arena);
+    print_run("string ring", result.string_ring);
+    return 0;
+}
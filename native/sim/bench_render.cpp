@@ -0,0 +1,92 @@
+// Runs LEDController::benchmark_render() on the host: SunriseCurve::render()
+// of the compiled Oklab curve for strips of 60 to 2000 LEDs, lit all at once
+// and in spatial bands from the center, then TemporalDither::dither() of the
+// frame, on the host's clock. It fails if rendering and dithering a 1000-LED
+// frame takes FRAME_BUDGET_US or more, the figure README.md commits to.
+// Each run is repeated and the fastest kept, so a run the host's scheduler
+// interrupted does not fail the check. The same benchmark runs on the device
+// at GET /api/debug/render_benchmark (tools/sunrise_curves.py --bench).
+//
+//     .pio/build/native/program bench-render
+
+#include <Arduino.h>
+#include <getopt.h>
+#include "led_controller.h"
+#include "native_host.h"
+#include "sim.h"
+#include "sunrise_curve.h"
+
+static const float FRAME_BUDGET_US = 1000.0f;
+static const int BUDGET_LEDS = 1000;
+static const int REPEATS = 5;
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: program bench-render [options]\n"
+            "  --frames N   frames timed per run (200)\n");
+}
+
+int bench_render_main(int argc, char **argv)
+{
+    static const struct option long_options[] = {
+        {"frames", required_argument, nullptr, 'f'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}};
+
+    int frames = 200;
+    int option;
+    while ((option = getopt_long(argc, argv, "", long_options, nullptr)) != -1)
+    {
+        switch (option)
+        {
+        case 'f': frames = atoi(optarg); break;
+        case 'h': usage(); return 0;
+        default: usage(); return 2;
+        }
+    }
+    if (frames <= 0)
+    {
+        usage();
+        return 2;
+    }
+
+    NativeHost::set_serial(nullptr);
+    NativeHost::use_host_clock(true);
+    NativeHost::use_device_heap(true);
+
+    static const struct
+    {
+        int leds;
+        int rows;
+    } strips[] = {{60, 1}, {300, 1}, {1000, 1}, {1000, 20}, {2000, 1}};
+    static const struct
+    {
+        int origin;
+        const char *name;
+    } origins[] = {{SUNRISE_ORIGIN_UNIFORM, "uniform"}, {SUNRISE_ORIGIN_CENTER, "center"}};
+
+    bool slow = false;
+    printf("%6s %5s %-8s %6s %10s %9s %10s\n", "leds", "rows", "origin", "bands", "layout us", "frame us",
+           "dither us");
+    for (const auto &strip : strips)
+    {
+        for (const auto &origin : origins)
+        {
+            RenderBenchmark result;
+            for (int run = 0; run < REPEATS; run++)
+            {
+                RenderBenchmark attempt;
+                LEDController::benchmark_render(strip.leds, strip.rows, origin.origin, frames, attempt);
+                if (run == 0 || attempt.frame_us + attempt.dither_us < result.frame_us + result.dither_us)
+                    result = attempt;
+            }
+            printf("%6d %5d %-8s %6d %10lu %9.1f %10.1f\n", strip.leds, strip.rows, origin.name, result.bands,
+                   (unsigned long)result.layout_us, result.frame_us, result.dither_us);
+            slow = slow || (strip.leds == BUDGET_LEDS && result.frame_us + result.dither_us >= FRAME_BUDGET_US);
+        }
+    }
+    if (slow)
+        printf("rendering and dithering a %d-LED frame took %.0f us or more\n", BUDGET_LEDS, FRAME_BUDGET_US);
+    return slow ? 1 : 0;
+}
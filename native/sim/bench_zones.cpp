@@ -0,0 +1,112 @@
+// Runs LEDController::benchmark_composite() on the host: up to --zones
+// sunrises playing at once in their own zones, side by side and overlapping,
+// over a strip of --leds LEDs, on the host's clock. It fails if 8 zones cost
+// more than twice what one zone costs over the same lit LEDs, or if lighting
+// an eighth of the strip costs more than half of lighting all of it, as
+// either means frames scale with zones or with the strip rather than with the
+// lit LEDs. Each run is repeated and the fastest kept, so a run the host's
+// scheduler interrupted does not fail the check. The same benchmark runs on
+// the device at GET /api/debug/zone_benchmark (tools/sunrise_curves.py
+// --bench --zones 8).
+//
+//     .pio/build/native/program bench-zones --zones 8
+
+#include <Arduino.h>
+#include <getopt.h>
+#include "config.h"
+#include "led_controller.h"
+#include "native_host.h"
+#include "sim.h"
+
+static const int REPEATS = 5;
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: program bench-zones [options]\n"
+            "  --zones N    most sunrises playing at once (%d)\n"
+            "  --leds N     strip length (960)\n"
+            "  --frames N   frames timed per run (200)\n",
+            MAX_CONCURRENT_SUNRISES);
+}
+
+int bench_zones_main(int argc, char **argv)
+{
+    static const struct option long_options[] = {
+        {"zones", required_argument, nullptr, 'z'},
+        {"leds", required_argument, nullptr, 'l'},
+        {"frames", required_argument, nullptr, 'f'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}};
+
+    int max_zones = MAX_CONCURRENT_SUNRISES;
+    int leds = 960;
+    int frames = 200;
+    int option;
+    while ((option = getopt_long(argc, argv, "", long_options, nullptr)) != -1)
+    {
+        switch (option)
+        {
+        case 'z': max_zones = atoi(optarg); break;
+        case 'l': leds = atoi(optarg); break;
+        case 'f': frames = atoi(optarg); break;
+        case 'h': usage(); return 0;
+        default: usage(); return 2;
+        }
+    }
+    if (max_zones < 1 || max_zones > MAX_CONCURRENT_SUNRISES || leds < 8 * max_zones || frames <= 0)
+    {
+        usage();
+        return 2;
+    }
+
+    NativeHost::set_serial(nullptr);
+    NativeHost::use_host_clock(true);
+    NativeHost::use_device_heap(true);
+
+    // Indexed [eighth or full strip lit][zones][overlap]
+    static CompositeBenchmark results[2][MAX_CONCURRENT_SUNRISES + 1][2];
+    printf("%6s %8s %6s %9s %11s\n", "zones", "overlap", "lit", "frame us", "ns/lit LED");
+    for (int full = 0; full < 2; full++)
+    {
+        // 1, 2, 4 ... zones, then max_zones
+        for (int zones = 1; zones <= max_zones; zones = zones == max_zones ? zones + 1 : min(zones * 2, max_zones))
+        {
+            for (int overlap = 0; overlap < 2; overlap++)
+            {
+                CompositeBenchmark &result = results[full][zones][overlap];
+                for (int run = 0; run < REPEATS; run++)
+                {
+                    CompositeBenchmark attempt;
+                    LEDController::benchmark_composite(leds, zones, full ? leds : leds / 8, overlap, frames, attempt);
+                    if (run == 0 || attempt.frame_us < result.frame_us)
+                        result = attempt;
+                }
+                printf("%6d %8s %6d %9.1f %11.1f\n", zones, overlap ? "yes" : "no", result.lit_leds,
+                       result.frame_us, result.ns_per_lit_led);
+            }
+        }
+    }
+
+    bool failed = false;
+    const CompositeBenchmark &one = results[1][1][0];
+    const CompositeBenchmark &many = results[1][max_zones][0];
+    if (many.frame_us > 2 * one.frame_us)
+    {
+        printf("%d zones take %.1f us per frame, one zone over the same LEDs %.1f us\n", max_zones, many.frame_us,
+               one.frame_us);
+        failed = true;
+    }
+    for (int zones : {1, max_zones})
+    {
+        const CompositeBenchmark &eighth = results[0][zones][0];
+        const CompositeBenchmark &all = results[1][zones][0];
+        if (eighth.frame_us > all.frame_us / 2)
+        {
+            printf("%d zones over %d LEDs take %.1f us, over %d LEDs %.1f us\n", zones, eighth.lit_leds,
+                   eighth.frame_us, all.lit_leds, all.frame_us);
+            failed = true;
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,269 @@
+// Dumps the sunrise curves the firmware compiles from its color presets, for
+// reviewing a curve before flashing it. Everything goes through
+// SunriseCurve and TemporalDither as compiled for the device; the frames
+// are sampled at evenly spaced progress without the scene's effects.
+//
+// Without --csv or --spatial it prints a summary per preset: distinct LED
+// outputs over the sunrise, the largest perceived step between consecutive
+// lit frames (Oklab distance of the light the strip emits) and how long the
+// strip stays dark. "rounded" is each frame shown once; "dither" is the
+// light the eye averages over EYE_REFRESHES dithered refreshes, for frames
+// dim enough that LEDController dithers them.
+//
+//     .pio/build/native/program curves
+//     .pio/build/native/program curves --preset ocean --brightness 40 --csv ocean.csv
+//     .pio/build/native/program curves --preset sunrise --spatial rise.csv --origin center --leds 120
+//
+// tools/sunrise_curves.py draws a dump as a PNG.
+
+#include <Arduino.h>
+#include <getopt.h>
+#include <algorithm>
+#include <array>
+#include <vector>
+#include "config.h"
+#include "alarm_manager.h"
+#include "native_host.h"
+#include "sim.h"
+#include "sunrise_curve.h"
+#include "temporal_dither.h"
+
+static const int EYE_REFRESHES = 8; // About 50 ms of refreshes at DITHER_REFRESH_MS plus the write time of 60 LEDs
+static const int SPATIAL_MOMENTS = 200;
+
+struct CurveFrame
+{
+    float progress;
+    CRGB16 lut;
+    float rounded[3];
+    float dithered[3];
+};
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: program curves [options]\n"
+            "  --preset NAME      only this built-in preset (all)\n"
+            "  --brightness N     alarm brightness_level (255)\n"
+            "  --frames N         frames sampled over the sunrise (1000)\n"
+            "  --csv FILE         write the frames of --preset to FILE\n"
+            "  --spatial FILE     write --preset over a strip, one line per moment, to FILE\n"
+            "  --leds N           strip length for --spatial (60)\n"
+            "  --rows N           LED_ROWS for --spatial (1)\n"
+            "  --origin NAME      uniform, start, end or center for --spatial (center)\n");
+}
+
+static int parse_origin(const char *name)
+{
+    static const char *const names[] = {"uniform", "start", "end", "center"};
+    for (int i = 0; i < 4; i++)
+    {
+        if (strcmp(name, names[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static void sample_frames(const SunriseLut &lut, int brightness, int frames, std::vector<CurveFrame> &out)
+{
+    uint16_t error[3];
+    TemporalDither::reset(error, 1);
+    out.resize(frames);
+    for (int i = 0; i < frames; i++)
+    {
+        CurveFrame &frame = out[i];
+        frame.progress = (float)i / (frames - 1);
+        frame.lut = SunriseCurve::sample(lut, frame.progress);
+        CRGB16 scaled = SunriseCurve::scale(frame.lut, brightness);
+
+        CRGB rounded;
+        TemporalDither::quantize(&scaled, &rounded, 1);
+        for (int channel = 0; channel < 3; channel++)
+        {
+            frame.rounded[channel] = rounded[channel];
+            frame.dithered[channel] = rounded[channel];
+        }
+        if (TemporalDither::peak_level(&scaled, 1) >= DITHER_MAX_LEVEL)
+            continue;
+
+        int sums[3] = {0, 0, 0};
+        for (int refresh = 0; refresh < EYE_REFRESHES; refresh++)
+        {
+            CRGB shown;
+            TemporalDither::dither(&scaled, error, &shown, 1);
+            for (int channel = 0; channel < 3; channel++)
+                sums[channel] += shown[channel];
+        }
+        for (int channel = 0; channel < 3; channel++)
+            frame.dithered[channel] = (float)sums[channel] / EYE_REFRESHES;
+    }
+}
+
+// Oklab of the light emitted for 8-bit PWM values, which are linear in light
+static void perceived(const float pwm[3], float lab[3])
+{
+    float rgb[3] = {pwm[0] / 255.0f, pwm[1] / 255.0f, pwm[2] / 255.0f};
+    SunriseCurve::linear_to_oklab(rgb, lab);
+}
+
+static void print_stats(const char *preset, const char *output, const std::vector<CurveFrame> &frames, bool dithered)
+{
+    std::vector<std::array<int, 3>> levels;
+    int dark = 0;
+    float largest = 0.0f;
+    float previous[3];
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        const float *pwm = dithered ? frames[i].dithered : frames[i].rounded;
+        levels.push_back({(int)lroundf(pwm[0] * 100), (int)lroundf(pwm[1] * 100), (int)lroundf(pwm[2] * 100)});
+        bool lit = pwm[0] > 0 || pwm[1] > 0 || pwm[2] > 0;
+        if (!lit)
+            dark++;
+
+        float current[3];
+        perceived(pwm, current);
+        const float *before = i > 0 ? (dithered ? frames[i - 1].dithered : frames[i - 1].rounded) : nullptr;
+        // The step out of darkness is set by the 8-bit PWM floor, not by the curve
+        if (before != nullptr && (before[0] > 0 || before[1] > 0 || before[2] > 0))
+        {
+            float step = sqrtf((current[0] - previous[0]) * (current[0] - previous[0]) +
+                               (current[1] - previous[1]) * (current[1] - previous[1]) +
+                               (current[2] - previous[2]) * (current[2] - previous[2]));
+            largest = max(largest, step);
+        }
+        memcpy(previous, current, sizeof(previous));
+    }
+    std::sort(levels.begin(), levels.end());
+    int distinct = std::unique(levels.begin(), levels.end()) - levels.begin();
+    printf("%-10s %-8s %8d %9.4f %5.1f%%\n", preset, output, distinct, largest, 100.0f * dark / frames.size());
+}
+
+static bool write_csv(const char *path, const std::vector<CurveFrame> &frames)
+{
+    FILE *file = fopen(path, "w");
+    if (file == nullptr)
+    {
+        perror(path);
+        return false;
+    }
+    fprintf(file, "progress,lut_r,lut_g,lut_b,rounded_r,rounded_g,rounded_b,dithered_r,dithered_g,dithered_b\n");
+    for (const CurveFrame &frame : frames)
+    {
+        fprintf(file, "%.4f,%u,%u,%u,%.0f,%.0f,%.0f,%.3f,%.3f,%.3f\n", frame.progress, frame.lut.r, frame.lut.g,
+                frame.lut.b, frame.rounded[0], frame.rounded[1], frame.rounded[2], frame.dithered[0],
+                frame.dithered[1], frame.dithered[2]);
+    }
+    fclose(file);
+    return true;
+}
+
+// One line per moment of the sunrise, with the 8-bit PWM of every LED as
+// SunriseCurve::render() lays the bands out with SUNRISE_SPREAD
+static bool write_spatial(const char *path, const SunriseLut &lut, int brightness, int leds, int rows, int origin)
+{
+    FILE *file = fopen(path, "w");
+    if (file == nullptr)
+    {
+        perror(path);
+        return false;
+    }
+    SunriseLayout layout = {nullptr, leds, 1};
+    SunriseCurve::build_layout(leds, rows, origin, layout);
+    std::vector<CRGB16> frame(leds);
+    std::vector<CRGB> pwm(leds);
+
+    fprintf(file, "progress");
+    for (int i = 0; i < leds; i++)
+        fprintf(file, ",r%d,g%d,b%d", i, i, i);
+    fprintf(file, "\n");
+    for (int moment = 0; moment < SPATIAL_MOMENTS; moment++)
+    {
+        float progress = (float)moment / (SPATIAL_MOMENTS - 1);
+        SunriseCurve::render(lut, layout, progress, brightness, frame.data());
+        TemporalDither::quantize(frame.data(), pwm.data(), leds);
+        fprintf(file, "%.4f", progress);
+        for (int i = 0; i < leds; i++)
+            fprintf(file, ",%u,%u,%u", pwm[i].r, pwm[i].g, pwm[i].b);
+        fprintf(file, "\n");
+    }
+    SunriseCurve::free_layout(layout);
+    fclose(file);
+    return true;
+}
+
+int curves_main(int argc, char **argv)
+{
+    static const struct option long_options[] = {
+        {"preset", required_argument, nullptr, 'p'},
+        {"brightness", required_argument, nullptr, 'b'},
+        {"frames", required_argument, nullptr, 'f'},
+        {"csv", required_argument, nullptr, 'c'},
+        {"spatial", required_argument, nullptr, 's'},
+        {"leds", required_argument, nullptr, 'l'},
+        {"rows", required_argument, nullptr, 'r'},
+        {"origin", required_argument, nullptr, 'o'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}};
+
+    const char *preset = nullptr;
+    int brightness = 255;
+    int frames = 1000;
+    const char *csv = nullptr;
+    const char *spatial = nullptr;
+    int leds = 60;
+    int rows = 1;
+    int origin = SUNRISE_ORIGIN_CENTER;
+
+    int option;
+    while ((option = getopt_long(argc, argv, "", long_options, nullptr)) != -1)
+    {
+        switch (option)
+        {
+        case 'p': preset = optarg; break;
+        case 'b': brightness = atoi(optarg); break;
+        case 'f': frames = atoi(optarg); break;
+        case 'c': csv = optarg; break;
+        case 's': spatial = optarg; break;
+        case 'l': leds = atoi(optarg); break;
+        case 'r': rows = atoi(optarg); break;
+        case 'o': origin = parse_origin(optarg); break;
+        case 'h': usage(); return 0;
+        default: usage(); return 2;
+        }
+    }
+    if (brightness < 0 || brightness > 255 || frames < 2 || leds < 1 || rows < 1 || origin < 0 ||
+        ((csv != nullptr || spatial != nullptr) && preset == nullptr))
+    {
+        usage();
+        return 2;
+    }
+    if (preset != nullptr && !AlarmManager::is_builtin_preset(preset))
+    {
+        fprintf(stderr, "curves: unknown preset %s\n", preset);
+        return 2;
+    }
+
+    NativeHost::set_serial(nullptr);
+
+    SunriseLut *lut = new SunriseLut;
+    std::vector<CurveFrame> samples;
+    bool written = true;
+    printf("%-10s %-8s %8s %9s %6s\n", "preset", "output", "distinct", "max step", "dark");
+    const ColorPreset *builtin;
+    for (int i = 0; (builtin = AlarmManager::builtin_preset(i)) != nullptr; i++)
+    {
+        if (preset != nullptr && strcmp(builtin->name, preset) != 0)
+            continue;
+        SunriseCurve::compile(*builtin, *lut);
+        sample_frames(*lut, brightness, frames, samples);
+        print_stats(builtin->name, "rounded", samples, false);
+        print_stats(builtin->name, "dither", samples, true);
+
+        if (csv != nullptr)
+            written = write_csv(csv, samples) && written;
+        if (spatial != nullptr)
+            written = write_spatial(spatial, *lut, brightness, leds, rows, origin) && written;
+    }
+    delete lut;
+    return written ? 0 : 1;
+}
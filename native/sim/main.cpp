@@ -0,0 +1,42 @@
+// Entry point of the native build. Each subcommand drives the firmware
+// compiled for the host against the shims in native/shims.
+
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+
+static void usage()
+{
+    fprintf(stderr, "usage: program <command> [options]\n\n"
+                    "  simulate      boot the firmware through days of deep sleep on a virtual clock\n"
+                    "  render        render a seeded sunrise into a frame recording for tools/frame_diff.py\n"
+                    "  curves        dump the compiled sunrise curves for tools/sunrise_curves.py\n"
+                    "  bench-log     compare the arena logger with the String ring it replaced\n"
+                    "  bench-zones   time the compositor with up to 8 sunrises playing at once\n"
+                    "  bench-render  time rendering and dithering 60 to 2000 LEDs against the 1 ms budget\n\n"
+                    "Run a command with --help for its options.\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        usage();
+        return 2;
+    }
+    if (strcmp(argv[1], "simulate") == 0)
+        return simulate_main(argc - 1, argv + 1);
+    if (strcmp(argv[1], "render") == 0)
+        return render_main(argc - 1, argv + 1);
+    if (strcmp(argv[1], "curves") == 0)
+        return curves_main(argc - 1, argv + 1);
+    if (strcmp(argv[1], "bench-log") == 0)
+        return bench_log_main(argc - 1, argv + 1);
+    if (strcmp(argv[1], "bench-zones") == 0)
+        return bench_zones_main(argc - 1, argv + 1);
+    if (strcmp(argv[1], "bench-render") == 0)
+        return bench_render_main(argc - 1, argv + 1);
+
+    usage();
+    return 2;
+}
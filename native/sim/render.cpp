@@ -0,0 +1,102 @@
+// Renders a sunrise into a frame recording on the host, through the same
+// FrameRecorder::begin_render() and read_render() as GET
+// /api/debug/frames/render on the device. The render is seeded and runs on a
+// virtual clock, so one build gives the same bytes on every run and two
+// builds can be compared with tools/frame_diff.py:
+//
+//     .pio/build/native/program render --preset sunrise --minutes 30 -o after.sfr
+//     python3 tools/frame_diff.py diff before.sfr after.sfr
+
+#include <Arduino.h>
+#include <getopt.h>
+#include "config.h"
+#include "frame_recorder.h"
+#include "native_host.h"
+#include "sim.h"
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: program render -o FILE [options]\n"
+            "  -o, --output FILE   where the recording goes, - for stdout\n"
+            "  --preset NAME       (sunrise)\n"
+            "  --minutes N         sunrise duration (30)\n"
+            "  --brightness N      (255)\n"
+            "  --zone N            0 for the whole strip, else an entry of LED_ZONES (0)\n"
+            "  --seed N            random8()/random16() seed (FRAME_RECORD_SEED)\n"
+            "  --serial            copy the firmware's serial output to stderr\n");
+}
+
+int render_main(int argc, char **argv)
+{
+    static const struct option long_options[] = {
+        {"output", required_argument, nullptr, 'o'},
+        {"preset", required_argument, nullptr, 'p'},
+        {"minutes", required_argument, nullptr, 'm'},
+        {"brightness", required_argument, nullptr, 'b'},
+        {"zone", required_argument, nullptr, 'z'},
+        {"seed", required_argument, nullptr, 's'},
+        {"serial", no_argument, nullptr, 'S'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}};
+
+    const char *output = nullptr;
+    const char *preset = "sunrise";
+    int minutes = 30;
+    int brightness = 255;
+    int zone = 0;
+    uint16_t seed = FRAME_RECORD_SEED;
+    bool serial = false;
+
+    int option;
+    while ((option = getopt_long(argc, argv, "o:", long_options, nullptr)) != -1)
+    {
+        switch (option)
+        {
+        case 'o': output = optarg; break;
+        case 'p': preset = optarg; break;
+        case 'm': minutes = atoi(optarg); break;
+        case 'b': brightness = atoi(optarg); break;
+        case 'z': zone = atoi(optarg); break;
+        case 's': seed = atoi(optarg); break;
+        case 'S': serial = true; break;
+        case 'h': usage(); return 0;
+        default: usage(); return 2;
+        }
+    }
+    // The same limits as the endpoint
+    if (output == nullptr || minutes < 1 || minutes > 24 * 60 || brightness < 0 || brightness > 255)
+    {
+        usage();
+        return 2;
+    }
+
+    NativeHost::set_serial(serial ? stderr : nullptr);
+    bool to_stdout = strcmp(output, "-") == 0;
+    FILE *file = to_stdout ? stdout : fopen(output, "wb");
+    if (file == nullptr)
+    {
+        perror(output);
+        return 2;
+    }
+
+    if (!FrameRecorder::begin_render(preset, minutes, brightness, zone, seed))
+    {
+        fprintf(stderr, "render: cannot start the render\n");
+        return 1;
+    }
+    uint8_t buffer[4096];
+    size_t length;
+    size_t total = 0;
+    while ((length = FrameRecorder::read_render(buffer, sizeof(buffer))) > 0)
+    {
+        fwrite(buffer, 1, length, file);
+        total += length;
+    }
+    FrameRecorder::end_render();
+
+    if (!to_stdout)
+        fclose(file);
+    fprintf(stderr, "%u bytes, %d LEDs, seed %u\n", (unsigned)total, NUM_LEDS, (unsigned)seed);
+    return 0;
+}
@@ -0,0 +1,12 @@
+#ifndef SIM_H
+#define SIM_H
+
+// Subcommands of the native program; argv[0] is the subcommand's name
+int simulate_main(int argc, char **argv);
+int render_main(int argc, char **argv);
+int curves_main(int argc, char **argv);
+int bench_log_main(int argc, char **argv);
+int bench_zones_main(int argc, char **argv);
+int bench_render_main(int argc, char **argv);
+
+#endif
@@ -0,0 +1,789 @@
+// Whole-device simulation: the firmware's own setup(), loop() and deep sleep
+// run on the virtual clock against simulated WiFi, NTP, Supabase, the BOOT
+// button and the LED strip. Every boot is a forked child of a process that
+// never ran firmware code, so each starts from power-on globals; RTC memory
+// is copied in from the previous boot's deep sleep and LittleFS and NVS stay
+// in one flash directory. A power loss boots without the RTC copy and with
+// the clock unset. A month takes about ten seconds:
+//
+//     .pio/build/native/program simulate --days 30
+//
+// Faults make the interesting cases reachable: WiFi and Supabase failures,
+// RTC drift during deep sleep, remote alarm edits and power loss. The report
+// lists due alarms that did not start on time, wakeups per kind, WiFi-on
+// time and energy from the firmware's EnergyModel. Configuration is compiled
+// in, so comparing two settings means building twice with different
+// include/config.h values.
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <ftw.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "config.h"
+#include "energy_model.h"
+#include "led_controller.h"
+#include "network_manager.h"
+#include "wake_planner.h"
+#include "fake_supabase.h"
+#include "sim.h"
+
+#define SIM_RTC_CAPACITY 16384
+#define SIM_MAX_SUNRISES 256
+#define SIM_WATCHDOG_US (12LL * 3600 * 1000000) // A boot awake this long is stuck
+#define SIM_PRESS_MS 150
+
+struct SimOptions
+{
+    int days = 30;
+    std::vector<String> alarms;
+    uint64_t seed = 1;
+    double wifi_failure_rate = 0.02;
+    double fetch_failure_rate = 0.02;
+    double rtc_drift_ppm = 150;
+    double button_per_day = 0.1;
+    double dismiss_rate = 0.5;
+    int edit_every_days = 0;
+    std::vector<int> power_loss_days;
+    double boot_s = 0.3;
+    double wifi_connect_s = 2.5;
+    double ntp_s = 0.5;
+    double request_s = 0.3;
+    bool schedule_function = true;
+    bool serial = false;
+    bool json = false;
+};
+
+struct SimSunrise
+{
+    int64_t started_us; // True time
+    float mwh;
+};
+
+// One boot's inputs and results, in memory shared with the child running it
+struct SimBoot
+{
+    // Set by the parent
+    int64_t started_us; // True time at reset
+    int64_t device_clock_us;
+    int cause;
+    bool restore_rtc;
+    uint64_t seed;
+    bool wifi_fails;
+
+    // Set by the child
+    bool finished;
+    bool restarted;
+    int64_t uptime_us;
+    uint64_t sleep_us;
+    int64_t device_clock_at_end_us;
+    float boot_mwh;
+    uint32_t radio_ms;
+    uint8_t wake_kind;
+    bool radio_needed;
+    float planned_wakeups;
+    float planned_radio_s;
+    int dismissed;
+    int sunrise_count;
+    SimSunrise sunrises[SIM_MAX_SUNRISES];
+};
+
+struct SimWorld
+{
+    FakeSupabase supabase;
+    SimBoot boot;
+    size_t rtc_size;
+    uint8_t rtc[SIM_RTC_CAPACITY];
+};
+
+struct SimAlarm
+{
+    int id;
+    int hour;
+    int minute;
+    uint8_t days_mask;
+};
+
+static SimOptions options;
+static SimWorld *world = nullptr;
+
+// The device side, living in the child of one boot
+class SimEnvironment : public NativeEnvironment
+{
+public:
+    bool wifi_join(uint32_t &join_ms) override
+    {
+        join_ms = (uint32_t)(options.wifi_connect_s * 1000);
+        return !world->boot.wifi_fails;
+    }
+
+    int64_t ntp_time_us() override
+    {
+        return world->boot.started_us + NativeHost::uptime_us();
+    }
+
+    uint32_t ntp_delay_ms() override
+    {
+        return (uint32_t)(options.ntp_s * 1000);
+    }
+
+    int64_t next_event_us() override
+    {
+        int64_t next = SIM_WATCHDOG_US;
+        for (const PinEvent &event : pin_events)
+            next = min(next, event.at_us);
+        return next;
+    }
+
+    void run_event(int64_t uptime_us) override
+    {
+        if (uptime_us >= SIM_WATCHDOG_US)
+        {
+            fprintf(stderr, "simulate: boot still awake after %lld h\n", (long long)(SIM_WATCHDOG_US / 3600000000LL));
+            fflush(nullptr);
+            _exit(3);
+        }
+        for (size_t i = 0; i < pin_events.size(); i++)
+        {
+            if (pin_events[i].at_us > uptime_us)
+                continue;
+            PinEvent event = pin_events[i];
+            pin_events.erase(pin_events.begin() + i);
+            if (event.dismiss && !LEDController::is_alarm_running())
+                return;
+            if (event.dismiss)
+                world->boot.dismissed++;
+            NativeHost::set_pin(BUTTON_PIN, event.level);
+            return;
+        }
+    }
+
+    void strip_shown(const CRGB *, int, uint8_t) override
+    {
+        bool running = LEDController::is_alarm_running();
+        if (running && !in_sunrise)
+            begin_sunrise();
+        else if (!running && in_sunrise)
+            end_sunrise();
+    }
+
+    void deep_sleep(uint64_t timer_us, bool) override
+    {
+        finish(false);
+        world->boot.sleep_us = timer_us;
+        fflush(nullptr);
+        _exit(0);
+    }
+
+    void restart() override
+    {
+        finish(true);
+        fflush(nullptr);
+        _exit(0);
+    }
+
+    // The BOOT button, held from the reset it caused
+    void press_at_boot()
+    {
+        NativeHost::set_pin(BUTTON_PIN, LOW);
+        pin_events.push_back({SIM_PRESS_MS * 1000LL, HIGH, false});
+    }
+
+    std::mt19937_64 random;
+
+private:
+    struct PinEvent
+    {
+        int64_t at_us;
+        int level;
+        bool dismiss;
+    };
+
+    std::vector<PinEvent> pin_events;
+    bool in_sunrise = false;
+    float sunrise_start_mwh = 0;
+
+    void begin_sunrise()
+    {
+        in_sunrise = true;
+        sunrise_start_mwh = EnergyModel::get_boot_mwh();
+        SimBoot &boot = world->boot;
+        if (boot.sunrise_count < SIM_MAX_SUNRISES)
+            boot.sunrises[boot.sunrise_count] = {boot.started_us + NativeHost::uptime_us(), 0};
+
+        // Dismissed with a short press somewhere in the second two thirds of the sunrise
+        if (std::uniform_real_distribution<double>(0, 1)(random) < options.dismiss_rate)
+        {
+            double share = std::uniform_real_distribution<double>(0.3, 1.0)(random);
+            int64_t at = NativeHost::uptime_us() + (int64_t)(share * DEFAULT_SUNRISE_DURATION * 60e6);
+            pin_events.push_back({at, LOW, true});
+            pin_events.push_back({at + SIM_PRESS_MS * 1000LL, HIGH, false});
+        }
+    }
+
+    void end_sunrise()
+    {
+        in_sunrise = false;
+        SimBoot &boot = world->boot;
+        if (boot.sunrise_count < SIM_MAX_SUNRISES)
+            boot.sunrises[boot.sunrise_count++].mwh = EnergyModel::get_boot_mwh() - sunrise_start_mwh;
+    }
+
+    void finish(bool restarted)
+    {
+        if (in_sunrise)
+            end_sunrise();
+        SimBoot &boot = world->boot;
+        boot.finished = true;
+        boot.restarted = restarted;
+        boot.uptime_us = NativeHost::uptime_us();
+        boot.device_clock_at_end_us = NativeHost::clock_us();
+        boot.boot_mwh = EnergyModel::get_boot_mwh();
+        boot.radio_ms = NetworkManager::get_radio_on_ms();
+        boot.wake_kind = WakePlanner::get_wake_kind();
+        boot.radio_needed = WakePlanner::needs_radio();
+        WakePlanner::estimate_daily(boot.planned_wakeups, boot.planned_radio_s);
+        memcpy(world->rtc, NativeHost::rtc_memory(), world->rtc_size);
+    }
+};
+
+static void run_boot()
+{
+    SimBoot &boot = world->boot;
+    SimEnvironment environment;
+    environment.random.seed(boot.seed);
+    NativeHost::set_environment(&environment);
+    NativeHost::set_serial(options.serial ? stderr : nullptr);
+    NativeHost::use_device_heap(true);
+    randomSeed((unsigned long)boot.seed);
+    rand16seed = (uint16_t)(boot.seed >> 16);
+
+    if (boot.restore_rtc)
+        memcpy(NativeHost::rtc_memory(), world->rtc, world->rtc_size);
+    NativeHost::set_wakeup_cause(boot.cause);
+    if (boot.device_clock_us != 0)
+        NativeHost::set_clock_us(boot.device_clock_us);
+    if (boot.cause == ESP_SLEEP_WAKEUP_EXT0)
+        environment.press_at_boot();
+
+    // ROM and bootloader, before the core starts setup()
+    delay((uint32_t)(options.boot_s * 1000));
+    NativeHost::run_firmware();
+}
+
+// The parent side: the true clock, the alarms table's history and the tally
+class Simulator
+{
+public:
+    void run();
+    int report(double elapsed_s);
+
+private:
+    struct History
+    {
+        int64_t changed_us;
+        std::vector<SimAlarm> alarms;
+    };
+
+    std::mt19937_64 random;
+    int64_t start_us = 0;
+    int64_t end_us = 0;
+    int64_t now_us = 0;
+    int64_t device_clock_us = 0; // 0 until the first NTP sync
+    std::vector<History> history;
+    std::vector<std::pair<int64_t, int>> pending; // (true time, event)
+    std::vector<SimSunrise> sunrises;
+    std::vector<float> boot_mwh;
+    uint32_t wakeups[4] = {};
+    int radio_wakeups = 0;
+    int64_t radio_ms = 0;
+    int64_t awake_us = 0;
+    int64_t sleep_us = 0;
+    int dismissed = 0;
+    int power_losses = 0;
+    int boots = 0;
+    float planned_wakeups = 0;
+    float planned_radio_s = 0;
+
+    enum
+    {
+        EVENT_BUTTON,
+        EVENT_EDIT,
+        EVENT_POWER_LOSS
+    };
+
+    bool boot(int cause, bool restore_rtc);
+    void sleep_until(int64_t at_us);
+    void apply_edit();
+    void store_alarms(const std::vector<SimAlarm> &alarms);
+    double uniform() { return std::uniform_real_distribution<double>(0, 1)(random); }
+    int64_t local_time_us(int day, int hour, int minute);
+};
+
+static bool parse_alarm(const String &text, int id, SimAlarm &alarm)
+{
+    int slash = text.indexOf('/');
+    String clock = slash < 0 ? text : text.substring(0, slash);
+    alarm.id = id;
+    if (sscanf(clock.c_str(), "%d:%d", &alarm.hour, &alarm.minute) != 2 || alarm.hour < 0 || alarm.hour > 23 ||
+        alarm.minute < 0 || alarm.minute > 59)
+        return false;
+    if (slash < 0)
+    {
+        alarm.days_mask = 0x7F;
+        return true;
+    }
+    alarm.days_mask = 0;
+    String days = text.substring(slash + 1);
+    for (int at = 0; at < (int)days.length();)
+    {
+        int comma = days.indexOf(',', at);
+        int day = days.substring(at, comma < 0 ? days.length() : comma).toInt();
+        if (day < 0 || day > 6)
+            return false;
+        alarm.days_mask |= 1 << day;
+        at = comma < 0 ? days.length() : comma + 1;
+    }
+    return true;
+}
+
+// Midnight of the first day is 2026-01-05, a Monday, in the device's time zone
+int64_t Simulator::local_time_us(int day, int hour, int minute)
+{
+    struct tm local = {};
+    local.tm_year = 2026 - 1900;
+    local.tm_mon = 0;
+    local.tm_mday = 5 + day;
+    local.tm_hour = hour;
+    local.tm_min = minute;
+    local.tm_isdst = -1;
+    return (int64_t)mktime(&local) * 1000000;
+}
+
+void Simulator::store_alarms(const std::vector<SimAlarm> &alarms)
+{
+    FakeSupabase &supabase = world->supabase;
+    uint32_t updated_at = (uint32_t)(now_us / 1000000);
+    for (const SimAlarm &alarm : alarms)
+    {
+        FakeAlarmRow *row = nullptr;
+        for (int i = 0; i < supabase.alarm_count; i++)
+        {
+            if (supabase.alarms[i].id == alarm.id)
+                row = &supabase.alarms[i];
+        }
+        if (row == nullptr)
+        {
+            row = &supabase.alarms[supabase.alarm_count++];
+            memset(row, 0, sizeof(*row));
+            row->id = alarm.id;
+            row->enabled = true;
+            row->brightness = DEFAULT_BRIGHTNESS;
+            row->duration_minutes = DEFAULT_SUNRISE_DURATION;
+            strlcpy(row->color_preset, "sunrise", sizeof(row->color_preset));
+            supabase.next_id = max(supabase.next_id, alarm.id + 1);
+        }
+        row->hour = alarm.hour;
+        row->minute = alarm.minute;
+        row->days_mask = alarm.days_mask;
+        row->updated_at = updated_at;
+    }
+    history.push_back({now_us, alarms});
+}
+
+// Alternately moves the first alarm 20 minutes earlier and back
+void Simulator::apply_edit()
+{
+    std::vector<SimAlarm> alarms = history.back().alarms;
+    if (alarms.empty())
+        return;
+    int shift = history.size() % 2 ? -20 : 20;
+    int total = (alarms[0].hour * 60 + alarms[0].minute + shift + 1440) % 1440;
+    alarms[0].hour = total / 60;
+    alarms[0].minute = total % 60;
+    store_alarms(alarms);
+}
+
+// Deep sleep: the RTC slow clock drifts, awake time runs on the crystal
+void Simulator::sleep_until(int64_t at_us)
+{
+    int64_t slept = max((int64_t)0, at_us - now_us);
+    now_us += slept;
+    sleep_us += slept;
+    if (device_clock_us != 0)
+        device_clock_us += (int64_t)(slept * (1 + options.rtc_drift_ppm / 1e6));
+}
+
+// Runs one boot in a child until it sleeps or restarts
+bool Simulator::boot(int cause, bool restore_rtc)
+{
+    SimBoot &boot = world->boot;
+    memset(&boot, 0, sizeof(boot));
+    boot.started_us = now_us;
+    boot.device_clock_us = device_clock_us;
+    boot.cause = cause;
+    boot.restore_rtc = restore_rtc;
+    boot.seed = random();
+    boot.wifi_fails = uniform() < options.wifi_failure_rate;
+    world->supabase.failing = uniform() < options.fetch_failure_rate;
+
+    fflush(nullptr);
+    pid_t child = fork();
+    if (child < 0)
+    {
+        perror("simulate: fork");
+        return false;
+    }
+    if (child == 0)
+    {
+        run_boot();
+        _exit(4);
+    }
+    int status;
+    waitpid(child, &status, 0);
+    boots++;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || !boot.finished)
+    {
+        fprintf(stderr, "simulate: boot %d at +%.0f s did not reach deep sleep (status %d)\n", boots,
+                (now_us - start_us) / 1e6, status);
+        return false;
+    }
+
+    now_us += boot.uptime_us;
+    awake_us += boot.uptime_us;
+    device_clock_us = boot.device_clock_at_end_us;
+    boot_mwh.push_back(boot.boot_mwh);
+    radio_ms += boot.radio_ms;
+    if (boot.wake_kind < 4)
+        wakeups[boot.wake_kind]++;
+    if (boot.radio_needed)
+        radio_wakeups++;
+    dismissed += boot.dismissed;
+    planned_wakeups = boot.planned_wakeups;
+    planned_radio_s = boot.planned_radio_s;
+    for (int i = 0; i < boot.sunrise_count; i++)
+        sunrises.push_back(boot.sunrises[i]);
+    return true;
+}
+
+void Simulator::run()
+{
+    random.seed(options.seed);
+    start_us = local_time_us(0, 0, 0);
+    end_us = local_time_us(options.days, 0, 0);
+    now_us = start_us;
+
+    FakeSupabase &supabase = world->supabase;
+    supabase.next_id = 1;
+    supabase.schedule_function = options.schedule_function;
+    supabase.request_ms = (uint32_t)(options.request_s * 1000);
+    std::vector<SimAlarm> alarms;
+    for (size_t i = 0; i < options.alarms.size(); i++)
+    {
+        SimAlarm alarm;
+        if (!parse_alarm(options.alarms[i], i + 1, alarm))
+        {
+            fprintf(stderr, "simulate: bad alarm %s\n", options.alarms[i].c_str());
+            exit(2);
+        }
+        alarms.push_back(alarm);
+    }
+    store_alarms(alarms);
+
+    double rate = options.button_per_day / 86400e6;
+    for (int64_t at = start_us; rate > 0;)
+    {
+        at += (int64_t)std::exponential_distribution<double>(rate)(random);
+        if (at >= end_us)
+            break;
+        pending.push_back({at, EVENT_BUTTON});
+    }
+    for (int day = options.edit_every_days; options.edit_every_days > 0 && day < options.days; day += options.edit_every_days)
+        pending.push_back({local_time_us(day, 20, 0), EVENT_EDIT});
+    for (int day : options.power_loss_days)
+        pending.push_back({local_time_us(day, 3, 0), EVENT_POWER_LOSS});
+    std::sort(pending.begin(), pending.end());
+
+    int cause = ESP_SLEEP_WAKEUP_UNDEFINED;
+    bool restore_rtc = false;
+    while (now_us < end_us)
+    {
+        if (!boot(cause, restore_rtc))
+            exit(2);
+        restore_rtc = true;
+
+        // Edits made while the device was awake reach Supabase all the same
+        while (!pending.empty() && pending[0].first <= now_us)
+        {
+            if (pending[0].second == EVENT_EDIT)
+                apply_edit();
+            pending.erase(pending.begin());
+        }
+        if (world->boot.restarted)
+        {
+            cause = ESP_SLEEP_WAKEUP_UNDEFINED;
+            continue;
+        }
+
+        // A timer of sleep_us device time takes longer or shorter in true time
+        int64_t timer_at = now_us + (int64_t)(world->boot.sleep_us / (1 + options.rtc_drift_ppm / 1e6));
+        cause = ESP_SLEEP_WAKEUP_TIMER;
+        while (!pending.empty() && pending[0].first < min(timer_at, end_us))
+        {
+            int64_t at = pending[0].first;
+            int event = pending[0].second;
+            pending.erase(pending.begin());
+            sleep_until(at);
+            if (event == EVENT_EDIT)
+            {
+                apply_edit();
+                continue;
+            }
+            if (event == EVENT_BUTTON)
+            {
+                cause = ESP_SLEEP_WAKEUP_EXT0;
+            }
+            else
+            {
+                power_losses++;
+                restore_rtc = false;
+                device_clock_us = 0;
+                cause = ESP_SLEEP_WAKEUP_UNDEFINED;
+            }
+            break;
+        }
+        if (cause == ESP_SLEEP_WAKEUP_TIMER)
+            sleep_until(min(timer_at, end_us));
+    }
+}
+
+static double median(std::vector<float> values)
+{
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    size_t middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+}
+
+int Simulator::report(double elapsed_s)
+{
+    // Every occurrence the user expected, as configured in Supabase when it came up
+    int due = 0, on_time = 0, off_time = 0, missed = 0;
+    for (size_t version = 0; version < history.size(); version++)
+    {
+        int64_t from = max(history[version].changed_us, start_us);
+        int64_t until = version + 1 < history.size() ? history[version + 1].changed_us : end_us;
+        for (int day = 0; day <= options.days; day++)
+        {
+            for (const SimAlarm &alarm : history[version].alarms)
+            {
+                int64_t at = local_time_us(day, alarm.hour, alarm.minute);
+                time_t seconds = at / 1000000;
+                struct tm local;
+                localtime_r(&seconds, &local);
+                if (!(alarm.days_mask & (1 << local.tm_wday)) || at < from || at >= until)
+                    continue;
+
+                // A sunrise within an hour but outside the alarm's minute came from drift or a stale alarm
+                due++;
+                int64_t closest = INT64_MAX;
+                for (const SimSunrise &sunrise : sunrises)
+                    closest = min(closest, (int64_t)llabs(sunrise.started_us - at));
+                if (closest < 60000000LL)
+                    on_time++;
+                else if (closest < 3600000000LL)
+                    off_time++;
+                else
+                    missed++;
+            }
+        }
+    }
+
+    const FakeSupabase &supabase = world->supabase;
+    int total_wakeups = wakeups[WAKE_COLD_BOOT] + wakeups[WAKE_ALARM] + wakeups[WAKE_SYNC] + wakeups[WAKE_BUTTON];
+    double days = options.days;
+    double sleep_mwh = sleep_us / 3.6e9 * ENERGY_DEEP_SLEEP_MW;
+    double energy_mwh = sleep_mwh;
+    for (float mwh : boot_mwh)
+        energy_mwh += mwh;
+    double sunrise_mwh = 0;
+    for (const SimSunrise &sunrise : sunrises)
+        sunrise_mwh += sunrise.mwh;
+    if (!sunrises.empty())
+        sunrise_mwh /= sunrises.size();
+    int reported_missed = FakeSupabaseHost::count_events(supabase, "missed");
+    int reported_dismissed = FakeSupabaseHost::count_events(supabase, "dismissed");
+
+    if (options.json)
+    {
+        printf("{\n");
+        printf("  \"days\": %d,\n", options.days);
+        printf("  \"boots\": %d,\n", boots);
+        printf("  \"wakeups\": %d,\n", total_wakeups);
+        printf("  \"wakeups_per_day\": %.3f,\n", total_wakeups / days);
+        printf("  \"wakeups_by_kind\": {\"cold boot\": %u, \"alarm\": %u, \"sync\": %u, \"button\": %u},\n",
+               wakeups[WAKE_COLD_BOOT], wakeups[WAKE_ALARM], wakeups[WAKE_SYNC], wakeups[WAKE_BUTTON]);
+        printf("  \"radio_wakeups\": %d,\n", radio_wakeups);
+        printf("  \"radio_s\": %.3f,\n", radio_ms / 1000.0);
+        printf("  \"radio_s_per_day\": %.3f,\n", radio_ms / 1000.0 / days);
+        printf("  \"awake_s_per_day\": %.3f,\n", awake_us / 1e6 / days);
+        printf("  \"alarm_reads\": %u,\n", supabase.alarm_reads);
+        printf("  \"requests\": %u,\n", supabase.requests);
+        printf("  \"alarms_due\": %d,\n", due);
+        printf("  \"alarms_on_time\": %d,\n", on_time);
+        printf("  \"alarms_off_time\": %d,\n", off_time);
+        printf("  \"alarms_missed\": %d,\n", missed);
+        printf("  \"alarms_dismissed\": %d,\n", dismissed);
+        printf("  \"reported_missed\": %d,\n", reported_missed);
+        printf("  \"reported_dismissed\": %d,\n", reported_dismissed);
+        printf("  \"events_uploaded\": %d,\n", supabase.event_count);
+        printf("  \"power_losses\": %d,\n", power_losses);
+        printf("  \"planned_wakeups_per_day\": %.3f,\n", planned_wakeups);
+        printf("  \"planned_radio_s_per_day\": %.3f,\n", planned_radio_s);
+        printf("  \"energy_mwh_per_day\": %.3f,\n", energy_mwh / days);
+        printf("  \"energy_mwh_per_boot\": %.3f,\n", median(boot_mwh));
+        printf("  \"energy_mwh_per_sunrise\": %.3f,\n", sunrise_mwh);
+        printf("  \"energy_mwh_deep_sleep_per_day\": %.3f\n", sleep_mwh / days);
+        printf("}\n");
+    }
+    else
+    {
+        printf("Simulated %d days in %.2f s (seed %llu)\n", options.days, elapsed_s, (unsigned long long)options.seed);
+        printf("Wakeups:   %d (%.1f/day): cold boot %u, alarm %u, sync %u, button %u\n", total_wakeups,
+               total_wakeups / days, wakeups[WAKE_COLD_BOOT], wakeups[WAKE_ALARM], wakeups[WAKE_SYNC],
+               wakeups[WAKE_BUTTON]);
+        printf("Radio on:  %.0f s (%.1f s/day) on %d wakes, %u alarm reads in %u requests\n", radio_ms / 1000.0,
+               radio_ms / 1000.0 / days, radio_wakeups, supabase.alarm_reads, supabase.requests);
+        printf("Awake:     %.0f s/day\n", awake_us / 1e6 / days);
+        printf("Alarms:    %d due, %d on time, %d off by over a minute, %d missed "
+               "(device reported %d missed, %d dismissed of %d presses)\n",
+               due, on_time, off_time, missed, reported_missed, reported_dismissed, dismissed);
+        printf("Events:    %d uploaded\n", supabase.event_count);
+        printf("Plan:      %.1f wakeups/day, %.1f radio-s/day expected at the end\n", planned_wakeups, planned_radio_s);
+        printf("Energy:    %.1f mWh/day (%.2f in deep sleep), median boot %.2f mWh, sunrise %.0f mWh\n",
+               energy_mwh / days, sleep_mwh / days, median(boot_mwh), sunrise_mwh);
+    }
+    return missed > 0 || off_time > 0 ? 1 : 0;
+}
+
+static int remove_entry(const char *path, const struct stat *, int, struct FTW *)
+{
+    return remove(path);
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: program simulate [options]\n"
+            "  --days N                 days to simulate (30)\n"
+            "  --alarm HH:MM[/D,D]      alarm, days with 0=Sunday, repeatable (07:00/1,2,3,4,5 and 08:30/0,6)\n"
+            "  --seed N                 (1)\n"
+            "  --wifi-failure-rate P    (0.02)\n"
+            "  --fetch-failure-rate P   share of boots on which Supabase is unreachable (0.02)\n"
+            "  --rtc-drift-ppm X        deep sleep clock error, positive runs fast (150)\n"
+            "  --button-per-day X       button wakes per day (0.1)\n"
+            "  --dismiss-rate P         share of sunrises dismissed early (0.5)\n"
+            "  --edit-every-days N      move the first alarm by 20 minutes in Supabase every N days at 20:00\n"
+            "  --power-loss-day N       cut power at 03:00 on this day, repeatable\n"
+            "  --boot-s S               reset to setup() (0.3)\n"
+            "  --wifi-connect-s S       (2.5)\n"
+            "  --ntp-s S                (0.5)\n"
+            "  --request-s S            Supabase round trip per request (0.3)\n"
+            "  --no-schedule-function   Supabase without device_schedule(), so alarms are read as rows\n"
+            "  --serial                 copy the firmware's serial output to stderr\n"
+            "  --json                   print the report as JSON\n");
+}
+
+int simulate_main(int argc, char **argv)
+{
+    static const struct option long_options[] = {
+        {"days", required_argument, nullptr, 'd'},
+        {"alarm", required_argument, nullptr, 'a'},
+        {"seed", required_argument, nullptr, 's'},
+        {"wifi-failure-rate", required_argument, nullptr, 'w'},
+        {"fetch-failure-rate", required_argument, nullptr, 'f'},
+        {"rtc-drift-ppm", required_argument, nullptr, 'r'},
+        {"button-per-day", required_argument, nullptr, 'b'},
+        {"dismiss-rate", required_argument, nullptr, 'D'},
+        {"edit-every-days", required_argument, nullptr, 'e'},
+        {"power-loss-day", required_argument, nullptr, 'p'},
+        {"boot-s", required_argument, nullptr, 'B'},
+        {"wifi-connect-s", required_argument, nullptr, 'W'},
+        {"ntp-s", required_argument, nullptr, 'n'},
+        {"request-s", required_argument, nullptr, 'R'},
+        {"no-schedule-function", no_argument, nullptr, 'N'},
+        {"serial", no_argument, nullptr, 'S'},
+        {"json", no_argument, nullptr, 'j'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}};
+
+    int option;
+    while ((option = getopt_long(argc, argv, "", long_options, nullptr)) != -1)
+    {
+        switch (option)
+        {
+        case 'd': options.days = atoi(optarg); break;
+        case 'a': options.alarms.push_back(optarg); break;
+        case 's': options.seed = strtoull(optarg, nullptr, 10); break;
+        case 'w': options.wifi_failure_rate = atof(optarg); break;
+        case 'f': options.fetch_failure_rate = atof(optarg); break;
+        case 'r': options.rtc_drift_ppm = atof(optarg); break;
+        case 'b': options.button_per_day = atof(optarg); break;
+        case 'D': options.dismiss_rate = atof(optarg); break;
+        case 'e': options.edit_every_days = atoi(optarg); break;
+        case 'p': options.power_loss_days.push_back(atoi(optarg)); break;
+        case 'B': options.boot_s = atof(optarg); break;
+        case 'W': options.wifi_connect_s = atof(optarg); break;
+        case 'n': options.ntp_s = atof(optarg); break;
+        case 'R': options.request_s = atof(optarg); break;
+        case 'N': options.schedule_function = false; break;
+        case 'S': options.serial = true; break;
+        case 'j': options.json = true; break;
+        case 'h': usage(); return 0;
+        default: usage(); return 2;
+        }
+    }
+    if (options.alarms.empty())
+    {
+        options.alarms.push_back("07:00/1,2,3,4,5");
+        options.alarms.push_back("08:30/0,6");
+    }
+    if (options.days <= 0 || options.alarms.size() > FAKE_SUPABASE_MAX_ALARMS)
+    {
+        usage();
+        return 2;
+    }
+
+    world = (SimWorld *)mmap(nullptr, sizeof(SimWorld), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (world == MAP_FAILED)
+    {
+        perror("simulate: mmap");
+        return 2;
+    }
+    world->rtc_size = NativeHost::rtc_memory_size();
+    if (world->rtc_size > SIM_RTC_CAPACITY)
+    {
+        fprintf(stderr, "simulate: %u bytes of RTC memory, SIM_RTC_CAPACITY is %d\n", (unsigned)world->rtc_size,
+                SIM_RTC_CAPACITY);
+        return 2;
+    }
+    FakeSupabaseHost::attach(&world->supabase);
+    // The device's time zone, for judging alarms in local time
+    NetworkManager::apply_timezone();
+    String flash = NativeHost::flash_dir();
+
+    Simulator simulator;
+    struct timespec started, finished;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    simulator.run();
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    int result = simulator.report(finished.tv_sec - started.tv_sec + (finished.tv_nsec - started.tv_nsec) / 1e9);
+
+    nftw(flash.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    return result;
+}
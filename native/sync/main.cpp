@@ -0,0 +1,364 @@
+// Runs the firmware's alarm sync on the host against a PostgREST stand-in
+// over real HTTP: AlarmManager::fetch_alarms_from_db() through
+// src/database.cpp, the HTTPClient shim and the host's sockets. Times the
+// sync for 10, 100 and 1000 rows seeded for this device, with the packed
+// device_schedule() and with the alarm rows a database without it serves,
+// then checks that 5xx responses, bodies cut short and a server that stops
+// answering fail the sync, keep the cached alarms and leave the next sync
+// working.
+//
+//     python3 tools/mock_postgrest.py serve --quiet &
+//     pio run -e native_sync && .pio/build/native_sync/program
+//
+// Every scenario runs in a forked child, so each starts from power-on RTC
+// memory and an empty flash.
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <esp_timer.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <ftw.h>
+#include <algorithm>
+#include <vector>
+#include "config.h"
+#include "alarm_manager.h"
+#include "database.h"
+#include "heap_monitor.h"
+#include "logger.h"
+#include "native_host.h"
+#include "network_manager.h"
+#include "scratch_pool.h"
+
+struct SyncOptions
+{
+    const char *url = "http://127.0.0.1:54321";
+    int iterations = 20;
+    float latency_ms = 0;
+    bool failures = true;
+    bool serial = false;
+    bool json = false;
+};
+
+struct Scenario
+{
+    const char *name;
+    bool schedule_function;
+    int rows;
+    String fault; // Posted to /_mock/faults once a first sync succeeded, empty to time the sync
+};
+
+// Written by the child, in memory shared with the parent
+struct SyncResult
+{
+    bool finished;
+    bool passed;
+    int alarms;
+    float first_ms;  // After power-on: connecting and the whole table
+    float median_ms; // The syncs after it, on the kept-alive connection; the failing sync for a fault
+    float requests;  // Per sync, retries included
+    char error[96];
+};
+
+static SyncOptions options;
+
+static int remove_entry(const char *path, const struct stat *, int, struct FTW *)
+{
+    return remove(path);
+}
+
+static double median(std::vector<float> values)
+{
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    size_t middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+}
+
+class DiscardStream : public Stream
+{
+public:
+    size_t write(uint8_t) { return 1; }
+    size_t write(const uint8_t *, size_t size) { return size; }
+    int available() { return 0; }
+    int read() { return -1; }
+    int peek() { return -1; }
+    void flush() {}
+};
+
+// POSTs to one of the mock's /_mock/ endpoints
+static bool mock_control(const char *path, const String &json)
+{
+    WiFiClient client;
+    HTTPClient http;
+    if (!http.begin(client, String(options.url) + path))
+        return false;
+    http.addHeader("Content-Type", "application/json");
+    int status = http.sendRequest("POST", json);
+    if (status > 0)
+    {
+        DiscardStream body;
+        http.writeToStream(&body);
+    }
+    http.end();
+    return status == 200;
+}
+
+static String clear_faults(bool schedule_function)
+{
+    return "{\"latency_ms\":" + String(options.latency_ms) +
+           ",\"jitter_ms\":0,\"error_rate\":0,\"truncate_rate\":0,\"hang_rate\":0,\"schedule_function\":" +
+           (schedule_function ? "true" : "false") + "}";
+}
+
+static bool timed_sync(float &ms, uint32_t &requests)
+{
+    uint32_t requests_before = Database::get_stats().requests;
+    int64_t start = esp_timer_get_time();
+    bool synced = AlarmManager::fetch_alarms_from_db();
+    ms = (esp_timer_get_time() - start) / 1000.0f;
+    requests = Database::get_stats().requests - requests_before;
+    return synced;
+}
+
+static void run_scenario(const Scenario &scenario, SyncResult &result)
+{
+    NativeHost::set_serial(options.serial ? stderr : nullptr);
+    NativeHost::use_host_clock(true);
+    NativeHost::use_device_heap(true);
+    NativeHost::set_clock_us((int64_t)time(nullptr) * 1000000);
+
+    ScratchPool::init();
+    HeapMonitor::begin();
+    Logger::init(0);
+    NetworkManager::wifi_connected = true;
+    NetworkManager::apply_timezone();
+    AlarmManager::load_cached_alarms();
+    Database::init(options.url);
+
+    String seed = "{\"rows\":" + String(scenario.rows) + ",\"device_id\":\"" + NetworkManager::get_device_id() + "\"}";
+    if (!mock_control("/_mock/faults", clear_faults(scenario.schedule_function)) || !mock_control("/_mock/seed", seed))
+    {
+        snprintf(result.error, sizeof(result.error), "mock server did not take the setup");
+        return;
+    }
+
+    float ms;
+    uint32_t requests;
+    if (!timed_sync(ms, requests))
+    {
+        snprintf(result.error, sizeof(result.error), "first sync failed");
+        return;
+    }
+    result.first_ms = ms;
+    int expected = min(scenario.rows, MAX_ALARMS);
+
+    if (scenario.fault.length() == 0)
+    {
+        std::vector<float> times;
+        uint32_t total_requests = requests;
+        for (int i = 1; i < options.iterations; i++)
+        {
+            if (!timed_sync(ms, requests))
+            {
+                snprintf(result.error, sizeof(result.error), "sync %d failed", i + 1);
+                return;
+            }
+            times.push_back(ms);
+            total_requests += requests;
+        }
+        result.median_ms = median(times);
+        result.requests = (float)total_requests / options.iterations;
+        result.alarms = AlarmManager::get_alarm_count();
+        result.passed = result.alarms == expected;
+        if (!result.passed)
+            snprintf(result.error, sizeof(result.error), "%d alarms loaded, expected %d", result.alarms, expected);
+    }
+    else
+    {
+        int cached = AlarmManager::get_alarm_count();
+        if (!mock_control("/_mock/faults", scenario.fault))
+        {
+            snprintf(result.error, sizeof(result.error), "mock server did not take the fault");
+            return;
+        }
+        bool synced = timed_sync(ms, requests);
+        result.median_ms = ms;
+        result.requests = requests;
+        result.alarms = AlarmManager::get_alarm_count();
+
+        mock_control("/_mock/faults", clear_faults(scenario.schedule_function));
+        float recovery_ms;
+        bool recovered = timed_sync(recovery_ms, requests);
+
+        if (synced)
+            snprintf(result.error, sizeof(result.error), "sync succeeded despite the fault");
+        else if (result.alarms != cached)
+            snprintf(result.error, sizeof(result.error), "%d cached alarms became %d", cached, result.alarms);
+        else if (!recovered)
+            snprintf(result.error, sizeof(result.error), "sync after the fault cleared failed");
+        else
+            result.passed = true;
+    }
+
+    Database::close();
+    result.finished = true;
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: program [options]\n"
+            "  --url URL          the mock server (http://127.0.0.1:54321)\n"
+            "  --iterations N     syncs per row count (20)\n"
+            "  --latency-ms X     added by the mock to every request (0)\n"
+            "  --no-failures      only time the syncs\n"
+            "  --serial           copy the firmware's serial output to stderr\n"
+            "  --json             print the report as JSON\n"
+            "Start the server first: python3 tools/mock_postgrest.py serve --quiet\n");
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option long_options[] = {
+        {"url", required_argument, nullptr, 'u'},
+        {"iterations", required_argument, nullptr, 'i'},
+        {"latency-ms", required_argument, nullptr, 'l'},
+        {"no-failures", no_argument, nullptr, 'F'},
+        {"serial", no_argument, nullptr, 'S'},
+        {"json", no_argument, nullptr, 'j'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}};
+
+    int option;
+    while ((option = getopt_long(argc, argv, "", long_options, nullptr)) != -1)
+    {
+        switch (option)
+        {
+        case 'u': options.url = optarg; break;
+        case 'i': options.iterations = atoi(optarg); break;
+        case 'l': options.latency_ms = atof(optarg); break;
+        case 'F': options.failures = false; break;
+        case 'S': options.serial = true; break;
+        case 'j': options.json = true; break;
+        case 'h': usage(); return 0;
+        default: usage(); return 2;
+        }
+    }
+    if (options.iterations < 2 || options.latency_ms < 0)
+    {
+        usage();
+        return 2;
+    }
+
+    NativeHost::set_serial(nullptr);
+    if (!mock_control("/_mock/stats", ""))
+    {
+        fprintf(stderr, "sync: no mock server at %s\n", options.url);
+        usage();
+        return 2;
+    }
+
+    std::vector<Scenario> scenarios;
+    for (int rows : {10, 100, 1000})
+        scenarios.push_back({"schedule", true, rows, ""});
+    for (int rows : {10, 100, 1000})
+        scenarios.push_back({"rows", false, rows, ""});
+    if (options.failures)
+    {
+        // Longer than DB_TIMEOUT_MS, so every attempt times out
+        String hang = "{\"hang_rate\":1,\"hang_ms\":" + String(DB_TIMEOUT_MS + 1000) + "}";
+        scenarios.push_back({"503", true, 100, "{\"error_rate\":1,\"error_status\":503}"});
+        scenarios.push_back({"truncated", true, 100, "{\"truncate_rate\":1}"});
+        scenarios.push_back({"timeout", true, 100, hang});
+    }
+
+    SyncResult *results = (SyncResult *)mmap(nullptr, scenarios.size() * sizeof(SyncResult), PROT_READ | PROT_WRITE,
+                                             MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (results == MAP_FAILED)
+    {
+        perror("sync: mmap");
+        return 2;
+    }
+    memset(results, 0, scenarios.size() * sizeof(SyncResult));
+    String flash = NativeHost::flash_dir();
+
+    for (size_t i = 0; i < scenarios.size(); i++)
+    {
+        nftw(flash.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+        mkdir(flash.c_str(), 0700);
+
+        fflush(nullptr);
+        pid_t child = fork();
+        if (child < 0)
+        {
+            perror("sync: fork");
+            return 2;
+        }
+        if (child == 0)
+        {
+            run_scenario(scenarios[i], results[i]);
+            fflush(nullptr);
+            _exit(0);
+        }
+        int status;
+        waitpid(child, &status, 0);
+        if (!results[i].finished && results[i].error[0] == '\0')
+            snprintf(results[i].error, sizeof(results[i].error), "exited with status %d", status);
+    }
+    nftw(flash.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+    int failed = 0;
+    for (size_t i = 0; i < scenarios.size(); i++)
+    {
+        if (!results[i].passed)
+            failed++;
+    }
+
+    if (options.json)
+    {
+        printf("{\n  \"url\": \"%s\",\n  \"iterations\": %d,\n  \"latency_ms\": %.1f,\n  \"scenarios\": [\n",
+               options.url, options.iterations, options.latency_ms);
+        for (size_t i = 0; i < scenarios.size(); i++)
+        {
+            const SyncResult &result = results[i];
+            printf("    {\"name\": \"%s\", \"rows\": %d, \"fault\": %s, \"passed\": %s, \"alarms\": %d, "
+                   "\"first_ms\": %.2f, \"median_ms\": %.2f, \"requests\": %.2f, \"error\": \"%s\"}%s\n",
+                   scenarios[i].name, scenarios[i].rows, scenarios[i].fault.length() > 0 ? "true" : "false",
+                   result.passed ? "true" : "false", result.alarms, result.first_ms, result.median_ms,
+                   result.requests, result.error, i + 1 < scenarios.size() ? "," : "");
+        }
+        printf("  ]\n}\n");
+    }
+    else
+    {
+        printf("Alarm sync against %s, %d syncs per row count, %.1f ms added latency\n", options.url,
+               options.iterations, options.latency_ms);
+        printf("%-10s %6s %10s %10s %9s %7s\n", "source", "rows", "first ms", "median ms", "requests", "alarms");
+        for (size_t i = 0; i < scenarios.size(); i++)
+        {
+            const SyncResult &result = results[i];
+            if (scenarios[i].fault.length() > 0)
+                continue;
+            printf("%-10s %6d %10.2f %10.2f %9.1f %7d%s%s\n", scenarios[i].name, scenarios[i].rows,
+                   result.first_ms, result.median_ms, result.requests, result.alarms, result.passed ? "" : "  FAIL: ",
+                   result.error);
+        }
+        if (options.failures)
+        {
+            printf("\n%-10s %10s %9s  %s\n", "fault", "failed in", "requests", "result");
+            for (size_t i = 0; i < scenarios.size(); i++)
+            {
+                const SyncResult &result = results[i];
+                if (scenarios[i].fault.length() == 0)
+                    continue;
+                printf("%-10s %8.0f ms %9.0f  %s\n", scenarios[i].name, result.median_ms, result.requests,
+                       result.passed ? "failed, kept the cached alarms, next sync ok" : result.error);
+            }
+        }
+    }
+    return failed > 0 ? 1 : 0;
+}
@@ -1,8 +1,16 @@
 #include "alarm_manager.h"
+#include "alarm_store.h"
+#include "event_queue.h"
+#include "energy_model.h"
 #include "led_controller.h"
+#include "preset_store.h"
+#include "sunrise_curve.h"
+#include "scratch_pool.h"
 #include "config.h"
 #include <ArduinoJson.h>
+#include <mbedtls/base64.h>
 #include <time.h>
+#include <mutex>
 #include <logger.h>
 #include <network_manager.h>
 #include <database.h>
@@ -11,6 +19,29 @@
 Alarm AlarmManager::alarms[10];
 int AlarmManager::alarm_count = 0;
 
+// The table is read and edited by the loop and by the web server's task
+// (/api/alarms, /sync). Every access holds table_mutex, but only while the
+// table itself is touched, never across a request to Supabase or a sunrise.
+// sync_mutex keeps two syncs from pushing the same local edits twice.
+static std::recursive_mutex table_mutex;
+static std::mutex sync_mutex;
+typedef std::lock_guard<std::recursive_mutex> TableLock;
+
+// Time of the previous check_alarms(), so wakes that came too late can report missed alarms
+RTC_DATA_ATTR static uint32_t rtc_last_alarm_check = 0;
+
+// Snoozed alarms, each played again at its rtc_snoozed_until; 0 marks a free entry
+RTC_DATA_ATTR static uint32_t rtc_snoozed_until[MAX_CONCURRENT_SUNRISES] = {};
+RTC_DATA_ATTR static int32_t rtc_snoozed_alarm_id[MAX_CONCURRENT_SUNRISES] = {};
+
+// Version of the packed schedule the alarm table was last loaded from; 0 once
+// anything else changed the table, so the next sync downloads it again
+RTC_DATA_ATTR static uint32_t rtc_schedule_version = 0;
+RTC_DATA_ATTR static uint8_t rtc_schedule_skip_syncs = 0; // Syncs left before device_schedule() is tried again
+
+// A schedule of MAX_ALARMS alarms, each with a preset name of its own
+static const size_t SCHEDULE_MAX_SIZE = SCHEDULE_HEADER_SIZE + MAX_ALARMS * (SCHEDULE_RECORD_SIZE + 1 + PRESET_NAME_LENGTH);
+
 ColorPreset AlarmManager::color_presets[] = {
     {{{CRGB(32, 0, 0), 0.15f},
       {CRGB(80, 8, 0), 0.25f},
@@ -19,112 +50,539 @@ ColorPreset AlarmManager::color_presets[] = {
       {CRGB(255, 180, 80), 0.15f},
       {CRGB(255, 220, 180), 0.10f}},
      6,
-     "sunrise"},
+     "sunrise",
+     PRESET_EFFECT_BREATHING | PRESET_EFFECT_SPARKLE | PRESET_EFFECT_WARMTH,
+     0},
     {{{CRGB(0, 8, 32), 0.20f},
       {CRGB(0, 32, 80), 0.25f},
       {CRGB(0, 80, 160), 0.25f},
       {CRGB(32, 160, 255), 0.20f},
       {CRGB(80, 200, 255), 0.10f}},
      5,
-     "ocean"},
+     "ocean",
+     PRESET_EFFECT_BREATHING | PRESET_EFFECT_SPARKLE | PRESET_EFFECT_WARMTH | PRESET_EFFECT_WAVE,
+     0},
     {{{CRGB(8, 16, 0), 0.25f},
       {CRGB(16, 40, 8), 0.25f},
       {CRGB(40, 80, 16), 0.25f},
       {CRGB(80, 160, 40), 0.15f},
       {CRGB(120, 255, 80), 0.10f}},
      5,
-     "forest"},
+     "forest",
+     PRESET_EFFECT_BREATHING | PRESET_EFFECT_SPARKLE | PRESET_EFFECT_WARMTH,
+     0},
     {{{CRGB(32, 0, 32), 0.20f},
       {CRGB(80, 16, 80), 0.25f},
       {CRGB(160, 80, 160), 0.25f},
       {CRGB(200, 120, 180), 0.20f},
       {CRGB(255, 180, 220), 0.10f}},
      5,
-     "lavender"}};
+     "lavender",
+     PRESET_EFFECT_BREATHING | PRESET_EFFECT_SPARKLE | PRESET_EFFECT_WARMTH,
+     0}};
 
 int AlarmManager::color_preset_count = 4;
 
-void AlarmManager::fetch_alarms_from_db()
+void AlarmManager::load_cached_alarms()
+{
+    TableLock lock(table_mutex);
+    alarm_count = AlarmStore::load_alarms(alarms, MAX_ALARMS);
+    LOG_INFO(LOG_MODULE_ALARM, "Loaded %d cached alarms from flash", alarm_count);
+}
+
+bool AlarmManager::fetch_alarms_from_db()
 {
     if (!NetworkManager::wifi_connected)
     {
-        WEB_LOG("WiFi not connected, cannot fetch alarms");
-        return;
+        LOG_WARN(LOG_MODULE_ALARM, "WiFi not connected, cannot fetch alarms");
+        return false;
+    }
+
+    std::unique_lock<std::mutex> sync_lock(sync_mutex, std::try_to_lock);
+    if (!sync_lock.owns_lock())
+    {
+        LOG_INFO(LOG_MODULE_ALARM, "Alarm sync already running");
+        return false;
     }
 
-    WEB_LOG("Fetching alarms from Supabase...");
-    String result = Database::db.from("alarms")
-                        .select("*")
-                        .eq("device_id", NetworkManager::get_device_id())
-                        .eq("is_enabled", "true")
-                        .doSelect();
+    LOG_INFO(LOG_MODULE_ALARM, "Fetching alarms from Supabase...");
+    HeapScope heap_scope(HEAP_SYNC);
+    uint32_t start = millis();
 
-    if (result.length() > 0 && !result.startsWith("error"))
+    // Local edits are reconciled against the rows' updated_at, which needs the rows
+    if (AlarmStore::get_pending_count() == 0 && fetch_schedule())
     {
-        WEB_LOG("Alarms fetched successfully");
-        parse_alarms(result);
-        return;
+        if (!PresetStore::sync())
+            LOG_WARN(LOG_MODULE_ALARM, "Color preset sync failed, keeping cached presets");
+        LOG_INFO(LOG_MODULE_ALARM, "Alarms synced in %lu ms", (unsigned long)(millis() - start));
+        return true;
     }
-    else
+
+    JsonDocument rows;
+    if (!fetch_remote_rows(rows))
+        return false;
+
+    if (AlarmStore::get_pending_count() > 0)
     {
-        WEB_LOG("Supabase Error: " + result);
-        return;
+        if (!push_pending_changes(rows.as<JsonArrayConst>()))
+        {
+            LOG_WARN(LOG_MODULE_ALARM, "Pushing local alarm edits failed, keeping local alarms");
+            return false;
+        }
+
+        if (!fetch_remote_rows(rows))
+            return false;
     }
+
+    {
+        TableLock lock(table_mutex);
+        // An edit made through the local API while the rows were on their way
+        // would be overwritten; it is pushed by the next sync instead
+        if (AlarmStore::get_pending_count() > 0)
+        {
+            LOG_INFO(LOG_MODULE_ALARM, "Local alarm edits arrived during the sync, keeping local alarms");
+        }
+        else
+        {
+            apply_rows(rows.as<JsonArrayConst>());
+            AlarmStore::save_alarms(alarms, alarm_count);
+            rtc_schedule_version = 0;
+        }
+    }
+
+    // Alarms stay usable without their presets; an alarm whose preset is missing falls back to sunrise
+    if (!PresetStore::sync())
+        LOG_WARN(LOG_MODULE_ALARM, "Color preset sync failed, keeping cached presets");
+
+    LOG_INFO(LOG_MODULE_ALARM, "Alarms synced in %lu ms", (unsigned long)(millis() - start));
+    return true;
 }
 
-void AlarmManager::parse_alarms(const String &json_response)
+// Loads the alarm table packed by device_schedule() in database_setup.sql, or
+// nothing when the version the table was loaded from is still current. Returns
+// false when the rows have to be fetched instead: on errors, and for the next
+// SCHEDULE_RETRY_SYNCS syncs once the database turned out not to have the
+// function, so applying the migration later takes effect without a power cycle.
+bool AlarmManager::fetch_schedule()
 {
-    JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, json_response);
+    if (rtc_schedule_skip_syncs > 0)
+    {
+        rtc_schedule_skip_syncs--;
+        return false;
+    }
+
+    char version_text[9];
+    snprintf(version_text, sizeof(version_text), "%08lx", (unsigned long)rtc_schedule_version);
+    String query = "p_device_id=" + NetworkManager::get_device_id() + "&p_limit=" + String(MAX_ALARMS);
+    if (rtc_schedule_version != 0)
+        query += "&p_version=" + String(version_text);
+
+    ScratchText body(HEAP_SYNC);
+    if (!body.ok())
+        return false;
 
-    if (error)
+    int status = Database::call_function("device_schedule", query, body.text());
+    if (status == 404)
     {
-        DEBUG_PRINT("JSON parsing error: ");
-        DEBUG_PRINTLN(error.c_str());
-        return;
+        LOG_WARN(LOG_MODULE_ALARM, "No device_schedule() in the database, fetching alarm rows for %d syncs",
+                 SCHEDULE_RETRY_SYNCS);
+        rtc_schedule_skip_syncs = SCHEDULE_RETRY_SYNCS;
+        return false;
+    }
+    if (status != 200)
+    {
+        LOG_ERROR(LOG_MODULE_ALARM, "Supabase error %d: %.80s", status, body.text().c_str());
+        return false;
     }
 
-    alarm_count = 0;
-    JsonArray alarms_array = doc.as<JsonArray>();
+    uint8_t payload[SCHEDULE_MAX_SIZE];
+    size_t length = 0;
+    if (!unwrap_schedule(body.text().c_str(), body.text().length(), payload, sizeof(payload), length))
+    {
+        LOG_WARN(LOG_MODULE_ALARM, "Unreadable schedule (%u bytes)", (unsigned)body.text().length());
+        return false;
+    }
+    if (length == 0)
+    {
+        LOG_INFO(LOG_MODULE_ALARM, "Schedule %s unchanged", version_text);
+        return true;
+    }
 
-    for (JsonObject alarm : alarms_array)
+    Alarm decoded[MAX_ALARMS];
+    int skipped = 0;
+    uint32_t version = 0;
+    int count = decode_schedule(payload, length, decoded, MAX_ALARMS, skipped, version);
+    if (count < 0)
     {
-        if (alarm_count >= MAX_ALARMS)
-            break;
+        LOG_WARN(LOG_MODULE_ALARM, "Malformed schedule (%u bytes)", (unsigned)length);
+        return false;
+    }
+    if (skipped > 0)
+        LOG_WARN(LOG_MODULE_ALARM, "Skipped %d malformed alarm records", skipped);
 
-        alarms[alarm_count].id = alarm["id"];
-        String time_str = alarm["time"];
-        parse_time(time_str, alarms[alarm_count].hour, alarms[alarm_count].minute);
+    TableLock lock(table_mutex);
+    if (AlarmStore::get_pending_count() > 0)
+    {
+        LOG_INFO(LOG_MODULE_ALARM, "Local alarm edits arrived during the sync, keeping local alarms");
+        return true;
+    }
+    memcpy(alarms, decoded, count * sizeof(Alarm));
+    alarm_count = count;
+    AlarmStore::save_alarms(alarms, alarm_count);
+    rtc_schedule_version = version;
+    LOG_INFO(LOG_MODULE_ALARM, "Loaded %d alarms from schedule %08lx (%u bytes)", count, (unsigned long)version,
+             (unsigned)length);
+    return true;
+}
 
-        JsonArray days = alarm["days_of_week"];
-        for (int i = 0; i < 7; i++)
+bool AlarmManager::fetch_remote_rows(JsonDocument &rows)
+{
+    // Disabled alarms are fetched too: they can be re-enabled through the local API
+    // and their updated_at is needed to reconcile local edits. Only the columns the
+    // device uses are selected, and the limit keeps large tables from exhausting the heap.
+    // Enabled alarms come first, so recently edited disabled ones can never push them out.
+    String query = "select=" ALARM_COLUMNS "&device_id=eq." + NetworkManager::get_device_id() +
+                   "&order=is_enabled.desc,updated_at.desc&limit=" + String(MAX_ALARMS);
+
+    ScratchText body(HEAP_SYNC);
+    if (!body.ok())
+        return false;
+
+    for (int attempt = 0; attempt <= DB_MAX_RETRIES; attempt++)
+    {
+        int status = Database::select_rows("alarms", query, body.text());
+        if (status != 200)
+        {
+            LOG_ERROR(LOG_MODULE_ALARM, "Supabase error %d: %.80s", status, body.text().c_str());
+            return false;
+        }
+
+        // Bodies cut short fail in Database; a complete 200 that still is not an array is tried again
+        DeserializationError error = deserializeJson(rows, body.text().c_str(), body.text().length());
+        if (!error && rows.is<JsonArray>())
+            return true;
+
+        LOG_WARN(LOG_MODULE_ALARM, "Unreadable alarm rows (%s, %u bytes)", error.c_str(), (unsigned)body.text().length());
+    }
+    return false;
+}
+
+bool AlarmManager::push_pending_changes(JsonArrayConst remote)
+{
+    PendingChange changes[MAX_PENDING_CHANGES];
+    int count;
+    {
+        TableLock lock(table_mutex);
+        count = AlarmStore::load_pending(changes, MAX_PENDING_CHANGES);
+    }
+    int pushed = 0;
+
+    for (; pushed < count; pushed++)
+    {
+        PendingChange &change = changes[pushed];
+
+        // An alarm created on the device keeps its local id until the rows are
+        // applied, so once its insert went through its row is found by local_id
+        bool remote_exists = false;
+        int remote_id = change.alarm_id;
+        uint32_t remote_updated_at = 0;
+        for (JsonObjectConst row : remote)
+        {
+            if ((row["id"] | 0) == change.alarm_id || (change.alarm_id < 0 && (row["local_id"] | 0) == change.alarm_id))
+            {
+                remote_exists = true;
+                remote_id = row["id"] | 0;
+                remote_updated_at = parse_timestamp(row["updated_at"] | "");
+                break;
+            }
+        }
+
+        // Last writer wins: an upstream edit newer than the local one is kept as is
+        if (remote_exists && remote_updated_at > change.changed_at)
         {
-            alarms[alarm_count].days_of_week[i] = false;
+            LOG_INFO(LOG_MODULE_ALARM, "Alarm %d changed upstream after local edit, keeping remote", change.alarm_id);
+            continue;
         }
-        for (JsonVariant day : days)
+
+        bool ok = true;
+        if (change.op == PENDING_DELETE)
         {
-            int day_num = day.as<int>();
-            if (day_num >= 0 && day_num < 7)
+            if (remote_exists)
+                ok = Database::delete_row("alarms", remote_id);
+        }
+        else
+        {
+            String row;
+            {
+                TableLock lock(table_mutex);
+                int index = find_alarm_index(change.alarm_id);
+                if (index < 0)
+                    continue;
+                // The row carries every edit made until now, so the entry as it is now is what gets pushed
+                AlarmStore::find_pending(change.alarm_id, change);
+                row = alarm_to_row_json(alarms[index]);
+            }
+
+            // The row's local_id makes a repeated insert a no-op, so an insert
+            // whose response was lost is retried without creating a second alarm
+            if (remote_exists)
+            {
+                ok = Database::update_row("alarms", remote_id, row);
+            }
+            else if (change.op == PENDING_CREATE)
             {
-                alarms[alarm_count].days_of_week[day_num] = true;
+                int status = Database::insert_rows("alarms", "[" + row + "]", "device_id,local_id");
+                ok = status >= 200 && status < 300;
             }
         }
 
-        alarms[alarm_count].enabled = alarm["is_enabled"];
-        alarms[alarm_count].brightness = alarm["brightness_level"] | DEFAULT_BRIGHTNESS;
-        alarms[alarm_count].duration = alarm["duration_minutes"] | DEFAULT_SUNRISE_DURATION;
-        alarms[alarm_count].color_preset = alarm["color_preset"] | "sunrise";
+        if (!ok)
+            break;
+    }
+
+    {
+        TableLock lock(table_mutex);
+        AlarmStore::drop_pushed(changes, pushed);
+    }
+    LOG_INFO(LOG_MODULE_ALARM, "Pushed %d/%d local alarm edits", pushed, count);
+    return pushed == count;
+}
+
+void AlarmManager::apply_rows(JsonArrayConst rows)
+{
+    int skipped = 0;
+    alarm_count = decode_rows(rows, alarms, MAX_ALARMS, skipped);
+
+    for (int i = 0; i < alarm_count; i++)
+    {
+        LOG_DEBUG(LOG_MODULE_ALARM, "Loaded alarm: %d:%02d", alarms[i].hour, alarms[i].minute);
+    }
+    if (skipped > 0)
+        LOG_WARN(LOG_MODULE_ALARM, "Skipped %d malformed alarm rows", skipped);
+
+    LOG_DEBUG(LOG_MODULE_ALARM, "Total alarms loaded: %d", alarm_count);
+}
+
+// Rows that are not objects, lack an id or fail validation are skipped rather
+// than loaded with defaults, which would schedule an alarm at midnight
+int AlarmManager::decode_rows(JsonArrayConst rows, Alarm out[], int max_count, int &skipped)
+{
+    int count = 0;
+    skipped = 0;
+
+    for (JsonVariantConst row : rows)
+    {
+        if (count >= max_count)
+            break;
+
+        JsonObjectConst fields = row.as<JsonObjectConst>();
+        Alarm &alarm = out[count];
+        reset_alarm(alarm);
+        alarm.id = fields["id"] | 0;
+        if (alarm.id == 0 || !fields["time"].is<const char *>() || !read_alarm_fields(fields, alarm) || !is_valid_alarm(alarm))
+        {
+            skipped++;
+            continue;
+        }
+        alarm.updated_at = parse_timestamp(fields["updated_at"] | "");
+        count++;
+    }
+    return count;
+}
+
+// The function's text result is a JSON string holding the payload in base64;
+// an empty string means the schedule is unchanged
+bool AlarmManager::unwrap_schedule(const char *text, size_t length, uint8_t *out, size_t capacity, size_t &out_length)
+{
+    out_length = 0;
+    if (length < 2 || text[0] != '"' || text[length - 1] != '"')
+        return false;
+    return mbedtls_base64_decode(out, capacity, &out_length, (const unsigned char *)text + 1, length - 2) == 0;
+}
 
-        DEBUG_PRINT("Loaded alarm: ");
-        DEBUG_PRINT(alarms[alarm_count].hour);
-        DEBUG_PRINT(":");
-        DEBUG_PRINTLN(alarms[alarm_count].minute);
+static uint16_t read_u16(const uint8_t *data)
+{
+    return (data[0] << 8) | data[1];
+}
 
-        alarm_count++;
+static uint32_t read_u32(const uint8_t *data)
+{
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
+
+// Returns the number of alarms written to out, or -1 when the payload does not
+// add up. Records that fail is_valid_alarm() are skipped like malformed rows.
+int AlarmManager::decode_schedule(const uint8_t *data, size_t length, Alarm out[], int max_count, int &skipped,
+                                  uint32_t &version)
+{
+    skipped = 0;
+    if (length < SCHEDULE_HEADER_SIZE || data[0] != SCHEDULE_FORMAT_VERSION)
+        return -1;
+
+    int record_count = data[1];
+    int preset_count = data[2];
+    version = read_u32(data + 4);
+
+    // Offsets of the length-prefixed preset names
+    uint16_t preset_at[UINT8_MAX];
+    size_t position = SCHEDULE_HEADER_SIZE;
+    for (int i = 0; i < preset_count; i++)
+    {
+        if (position >= length)
+            return -1;
+        preset_at[i] = position;
+        position += 1 + data[position];
     }
+    if (position + record_count * SCHEDULE_RECORD_SIZE != length)
+        return -1;
+
+    int count = 0;
+    for (int i = 0; i < record_count && count < max_count; i++)
+    {
+        const uint8_t *record = data + position + i * SCHEDULE_RECORD_SIZE;
+        if (record[16] >= preset_count)
+            return -1;
+
+        Alarm &alarm = out[count];
+        alarm.id = (int32_t)read_u32(record);
+        alarm.updated_at = read_u32(record + 4);
+        alarm.duration = read_u16(record + 8);
+        int minute_of_day = read_u16(record + 10);
+        alarm.hour = minute_of_day / 60;
+        alarm.minute = minute_of_day % 60;
+        for (int day = 0; day < 7; day++)
+        {
+            alarm.days_of_week[day] = record[12] & (1 << day);
+        }
+        alarm.enabled = record[13] & 1;
+        alarm.brightness = record[14];
+        alarm.zone = record[15];
 
-    DEBUG_PRINT("Total alarms loaded: ");
-    DEBUG_PRINTLN(alarm_count);
+        const uint8_t *name = data + preset_at[record[16]];
+        size_t name_length = min((size_t)name[0], sizeof(alarm.color_preset) - 1);
+        memcpy(alarm.color_preset, name + 1, name_length);
+        alarm.color_preset[name_length] = '\0';
+
+        if (alarm.id == 0 || !is_valid_alarm(alarm))
+        {
+            skipped++;
+            continue;
+        }
+        count++;
+    }
+    return count;
+}
+
+// Decoded alarms of the parse benchmarks, which may hold more than the alarm table
+static Alarm bench_alarms[MAX_ALARMS * 4];
+
+namespace
+{
+    // Counts what ArduinoJson allocates for a document
+    struct CountingAllocator : ArduinoJson::Allocator
+    {
+        size_t bytes = 0;
+
+        void *allocate(size_t size) override
+        {
+            bytes += size;
+            return malloc(size);
+        }
+
+        void deallocate(void *pointer) override
+        {
+            free(pointer);
+        }
+
+        void *reallocate(void *pointer, size_t new_size) override
+        {
+            bytes += new_size;
+            return realloc(pointer, new_size);
+        }
+    };
+}
+
+// Runs the ingestion path (deserialize, decode, validate) on a response body
+// without touching the alarm table
+bool AlarmManager::benchmark_parse(const char *json, size_t length, int iterations, ParseBenchmark &result)
+{
+    const int capacity = sizeof(bench_alarms) / sizeof(bench_alarms[0]);
+
+    result = ParseBenchmark();
+    uint32_t heap_before = ESP.getFreeHeap();
+    uint32_t start = micros();
+
+    for (int i = 0; i < iterations; i++)
+    {
+        CountingAllocator allocator;
+        JsonDocument doc(&allocator);
+        DeserializationError error = deserializeJson(doc, json, length);
+        if (error)
+        {
+            result.error = error.c_str();
+            return false;
+        }
+        if (!doc.is<JsonArrayConst>())
+        {
+            result.error = "not an array";
+            return false;
+        }
+
+        JsonArrayConst rows = doc.as<JsonArrayConst>();
+        result.rows = decode_rows(rows, bench_alarms, capacity, result.skipped);
+        result.bytes_allocated = allocator.bytes;
+        result.total_rows = rows.size();
+    }
+
+    result.micros = micros() - start;
+    result.heap_leaked = (int32_t)heap_before - (int32_t)ESP.getFreeHeap();
+    return true;
+}
+
+// The same for a device_schedule() result, from the JSON string to decoded alarms
+bool AlarmManager::benchmark_schedule(const char *text, size_t length, int iterations, ParseBenchmark &result)
+{
+    const int capacity = sizeof(bench_alarms) / sizeof(bench_alarms[0]);
+
+    result = ParseBenchmark();
+    size_t capacity_bytes = length * 3 / 4 + 1;
+    uint8_t *payload = (uint8_t *)malloc(capacity_bytes);
+    if (payload == nullptr)
+    {
+        result.error = "out of memory";
+        return false;
+    }
+
+    uint32_t heap_before = ESP.getFreeHeap();
+    uint32_t start = micros();
+    bool ok = true;
+    for (int i = 0; i < iterations; i++)
+    {
+        size_t payload_length = 0;
+        uint32_t version = 0;
+        if (!unwrap_schedule(text, length, payload, capacity_bytes, payload_length))
+        {
+            result.error = "not a base64 string";
+            ok = false;
+            break;
+        }
+        if (payload_length == 0)
+            continue;
+
+        result.rows = decode_schedule(payload, payload_length, bench_alarms, capacity, result.skipped, version);
+        if (result.rows < 0)
+        {
+            result.error = "malformed schedule";
+            ok = false;
+            break;
+        }
+        result.total_rows = payload[1];
+    }
+
+    result.micros = micros() - start;
+    result.heap_leaked = (int32_t)heap_before - (int32_t)ESP.getFreeHeap();
+    free(payload);
+    return ok;
 }
 
 void AlarmManager::check_alarms()
@@ -132,49 +590,210 @@ void AlarmManager::check_alarms()
     struct tm timeinfo;
     if (!getLocalTime(&timeinfo))
     {
-        DEBUG_PRINTLN("Failed to get current time");
+        LOG_WARN(LOG_MODULE_ALARM, "Failed to get current time");
         return;
     }
 
-    int current_hour = timeinfo.tm_hour;
-    int current_minute = timeinfo.tm_min;
-    int current_weekday = timeinfo.tm_wday;
+    LOG_DEBUG(LOG_MODULE_ALARM, "Checking alarms at %d:%02d", timeinfo.tm_hour, timeinfo.tm_min);
 
-    DEBUG_PRINT("Checking alarms at ");
-    DEBUG_PRINT(current_hour);
-    DEBUG_PRINT(":");
-    DEBUG_PRINTLN(current_minute);
+    uint32_t now = current_epoch();
+    if (now != 0)
+    {
+        record_missed_alarms(now);
+        rtc_last_alarm_check = now;
+    }
 
-    for (int i = 0; i < alarm_count; i++)
+    start_due_alarms(now, timeinfo);
+    if (LEDController::is_alarm_running())
+        run_sunrises();
+    else
+        LOG_DEBUG(LOG_MODULE_ALARM, "No alarms to trigger");
+}
+
+// Starts every alarm due this minute and every snoozed alarm that is back.
+// Each plays in its own zone, alongside whatever sunrises are playing already.
+void AlarmManager::start_due_alarms(uint32_t now, const struct tm &timeinfo)
+{
+    // Copied out, as starting a sunrise loads and compiles its preset
+    Alarm due[MAX_CONCURRENT_SUNRISES + MAX_ALARMS];
+    int durations[MAX_CONCURRENT_SUNRISES + MAX_ALARMS];
+    int due_count = 0;
     {
-        if (alarms[i].enabled &&
-            alarms[i].hour == current_hour &&
-            alarms[i].minute == current_minute &&
-            alarms[i].days_of_week[current_weekday])
+        TableLock lock(table_mutex);
+        for (int i = 0; i < MAX_CONCURRENT_SUNRISES; i++)
         {
+            if (rtc_snoozed_until[i] == 0 || now < rtc_snoozed_until[i])
+                continue;
 
-            DEBUG_PRINTLN("Alarm triggered! Starting sunrise simulation...");
-            WebServerManager::init();
-            trigger_sunrise_alarm(alarms[i]);
-            return;
+            rtc_snoozed_until[i] = 0;
+            int index = find_alarm_index(rtc_snoozed_alarm_id[i]);
+            if (index >= 0)
+            {
+                LOG_INFO(LOG_MODULE_ALARM, "Snoozed alarm %d is back", alarms[index].id);
+                durations[due_count] = SNOOZE_SUNRISE_MINUTES;
+                due[due_count++] = alarms[index];
+            }
+        }
+
+        for (int i = 0; i < alarm_count; i++)
+        {
+            if (alarms[i].enabled &&
+                alarms[i].hour == timeinfo.tm_hour &&
+                alarms[i].minute == timeinfo.tm_min &&
+                alarms[i].days_of_week[timeinfo.tm_wday])
+            {
+                LOG_INFO(LOG_MODULE_ALARM, "Alarm %d triggered! Starting sunrise simulation...", alarms[i].id);
+                durations[due_count] = alarms[i].duration;
+                due[due_count++] = alarms[i];
+            }
         }
     }
 
-    DEBUG_PRINTLN("No alarms to trigger");
+    for (int i = 0; i < due_count; i++)
+    {
+        start_alarm(due[i], durations[i]);
+    }
 }
 
-time_t AlarmManager::calculate_next_alarm_time()
+bool AlarmManager::start_alarm(const Alarm &alarm, int duration_minutes)
 {
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo))
+    SunriseInstance *sunrise = LEDController::claim_sunrise();
+    if (sunrise == nullptr)
     {
-        DEBUG_PRINTLN("Failed to get time for next wake calculation");
-        return DEEP_SLEEP_DURATION / 1000000;
+        LOG_WARN(LOG_MODULE_ALARM, "%d sunrises are playing already, alarm %d is missed", MAX_CONCURRENT_SUNRISES, alarm.id);
+        EventQueue::record(ALARM_EVENT_MISSED, alarm.id);
+        return false;
     }
 
-    time_t now = mktime(&timeinfo);
-    time_t next_alarm = now + DEEP_SLEEP_DURATION / 1000000;
+    LOG_INFO(LOG_MODULE_ALARM, "Starting sunrise alarm in zone %d with preset: %s", alarm.zone, alarm.color_preset);
+    EventQueue::record(ALARM_EVENT_FIRED, alarm.id);
 
+    resolve_preset(alarm.color_preset, sunrise->preset, *sunrise->curve);
+    sunrise->alarm_id = alarm.id;
+    sunrise->zone = alarm.zone;
+    sunrise->duration_ms = duration_minutes * 60000;
+    sunrise->max_brightness = alarm.brightness;
+    LEDController::start_sunrise(*sunrise);
+    return true;
+}
+
+// Fills in the preset called name and its compiled curve. A curve that holds
+// the preset already, such as the one a sunrise slot played last, is not
+// compiled again.
+void AlarmManager::resolve_preset(const char *name, ColorPreset &preset, SunriseLut &curve)
+{
+    const ColorPreset *builtin = find_color_preset(name);
+    if (builtin != nullptr)
+    {
+        preset = *builtin;
+    }
+    else if (!PresetStore::load(name, preset, curve))
+    {
+        LOG_WARN(LOG_MODULE_ALARM, "Preset %s is not available, using sunrise", name);
+        preset = color_presets[0];
+    }
+    if (!SunriseCurve::is_compiled(curve, preset))
+        SunriseCurve::compile(preset, curve);
+}
+
+// Plays the sunrises until the last one has ended. Alarms that come due
+// meanwhile, such as a second sleeper's in another zone, join them.
+void AlarmManager::run_sunrises()
+{
+    if (NetworkManager::wifi_connected)
+        WebServerManager::init();
+
+    EnergyModel::begin_sunrise();
+    uint32_t checked_minute = current_epoch() / 60;
+    while (true)
+    {
+        bool playing = LEDController::play_frame();
+        SunriseInstance *ended;
+        while ((ended = LEDController::take_ended_sunrise()) != nullptr)
+        {
+            finish_alarm(*ended);
+        }
+        if (!playing)
+            break;
+
+        uint32_t now = current_epoch();
+        if (now != 0 && now / 60 != checked_minute)
+        {
+            checked_minute = now / 60;
+            rtc_last_alarm_check = now;
+            time_t local = now;
+            struct tm timeinfo;
+            localtime_r(&local, &timeinfo);
+            start_due_alarms(now, timeinfo);
+        }
+    }
+    EnergyModel::end_sunrise();
+}
+
+void AlarmManager::finish_alarm(const SunriseInstance &sunrise)
+{
+    uint16_t seconds = (millis() - sunrise.started) / 1000;
+    if (sunrise.dismiss == DISMISS_NONE)
+    {
+        EventQueue::record(ALARM_EVENT_COMPLETED, sunrise.alarm_id, seconds);
+    }
+    else if (sunrise.dismiss == DISMISS_SNOOZE)
+    {
+        EventQueue::record(ALARM_EVENT_SNOOZED, sunrise.alarm_id, seconds, DISMISS_BUTTON);
+        uint32_t now = current_epoch();
+        if (now != 0)
+            snooze_alarm(sunrise.alarm_id, now + SNOOZE_MINUTES * 60);
+    }
+    else
+    {
+        EventQueue::record(ALARM_EVENT_DISMISSED, sunrise.alarm_id, seconds, sunrise.dismiss);
+    }
+}
+
+void AlarmManager::snooze_alarm(int id, uint32_t until)
+{
+    int entry = -1;
+    for (int i = 0; i < MAX_CONCURRENT_SUNRISES; i++)
+    {
+        if (rtc_snoozed_until[i] != 0 && rtc_snoozed_alarm_id[i] == id)
+        {
+            entry = i;
+            break;
+        }
+        if (rtc_snoozed_until[i] == 0 && entry < 0)
+            entry = i;
+    }
+    if (entry < 0)
+    {
+        LOG_WARN(LOG_MODULE_ALARM, "Too many snoozed alarms, alarm %d is not snoozed", id);
+        return;
+    }
+
+    rtc_snoozed_alarm_id[entry] = id;
+    rtc_snoozed_until[entry] = until;
+    LOG_INFO(LOG_MODULE_ALARM, "Alarm %d snoozed for %d minutes", id, SNOOZE_MINUTES);
+}
+
+// The earliest snoozed alarm, 0 when nothing is snoozed
+time_t AlarmManager::get_snooze_time()
+{
+    uint32_t earliest = 0;
+    for (int i = 0; i < MAX_CONCURRENT_SUNRISES; i++)
+    {
+        if (rtc_snoozed_until[i] != 0 && (earliest == 0 || rtc_snoozed_until[i] < earliest))
+            earliest = rtc_snoozed_until[i];
+    }
+    return earliest;
+}
+
+// First enabled occurrence after the given time within the next week, 0 if there is none
+time_t AlarmManager::next_alarm_after(time_t after)
+{
+    struct tm start;
+    localtime_r(&after, &start);
+    time_t next_alarm = 0;
+
+    TableLock lock(table_mutex);
     for (int i = 0; i < alarm_count; i++)
     {
         if (!alarms[i].enabled)
@@ -182,66 +801,429 @@ time_t AlarmManager::calculate_next_alarm_time()
 
         for (int day = 0; day < 8; day++)
         {
-            struct tm alarm_time = timeinfo;
+            struct tm alarm_time = start;
             alarm_time.tm_mday += day;
             alarm_time.tm_hour = alarms[i].hour;
             alarm_time.tm_min = alarms[i].minute;
             alarm_time.tm_sec = 0;
+            alarm_time.tm_isdst = -1;
 
-            mktime(&alarm_time);
-
-            if (alarms[i].days_of_week[alarm_time.tm_wday])
+            time_t alarm_timestamp = mktime(&alarm_time);
+            if (alarms[i].days_of_week[alarm_time.tm_wday] && alarm_timestamp > after &&
+                (next_alarm == 0 || alarm_timestamp < next_alarm))
             {
-                time_t alarm_timestamp = mktime(&alarm_time);
-                if (alarm_timestamp > now && alarm_timestamp < next_alarm)
-                {
-                    next_alarm = alarm_timestamp;
-                }
+                next_alarm = alarm_timestamp;
             }
         }
     }
 
-    DEBUG_PRINT("Next wake in ");
-    DEBUG_PRINT((next_alarm - now));
-    DEBUG_PRINTLN(" seconds");
+    return next_alarm;
+}
 
-    return next_alarm - now;
+// Accepts "H:MM", "HH:MM" and Postgres "HH:MM:SS[.ffffff]". Anything else is
+// rejected, as toInt() used to turn garbage into an alarm at midnight.
+bool AlarmManager::parse_time(const char *text, int &hour, int &minute)
+{
+    int fields[3] = {0, 0, 0};
+    int count = 0;
+    const char *p = text;
+
+    while (count < 3)
+    {
+        int digits = 0;
+        int value = 0;
+        while (*p >= '0' && *p <= '9' && digits < 2)
+        {
+            value = value * 10 + (*p++ - '0');
+            digits++;
+        }
+        if (digits == 0)
+            return false;
+        fields[count++] = value;
+
+        if (*p != ':')
+            break;
+        p++;
+    }
+
+    if (count == 3 && *p == '.')
+    {
+        p++;
+        while (*p >= '0' && *p <= '9')
+            p++;
+    }
+    if (count < 2 || *p != '\0' || fields[0] > 23 || fields[1] > 59 || fields[2] > 59)
+        return false;
+
+    hour = fields[0];
+    minute = fields[1];
+    return true;
+}
+
+void AlarmManager::alarms_to_json(JsonArray out)
+{
+    TableLock lock(table_mutex);
+    for (int i = 0; i < alarm_count; i++)
+    {
+        JsonObject alarm = out.add<JsonObject>();
+        alarm["id"] = alarms[i].id;
+        write_alarm_fields(alarms[i], alarm);
+        alarm["updated_at"] = alarms[i].updated_at;
+    }
+}
+
+AlarmEditResult AlarmManager::create_alarm(JsonObjectConst fields, int &new_id)
+{
+    TableLock lock(table_mutex);
+    if (alarm_count >= MAX_ALARMS)
+        return ALARM_EDIT_FULL;
+
+    Alarm alarm;
+    reset_alarm(alarm);
+    if (!read_alarm_fields(fields, alarm) || !is_valid_alarm(alarm))
+        return ALARM_EDIT_INVALID;
+
+    alarm.id = AlarmStore::next_local_id();
+    alarm.updated_at = current_epoch();
+    if (!AlarmStore::queue_change(PENDING_CREATE, alarm.id, alarm.updated_at))
+        return ALARM_EDIT_FULL;
+
+    alarms[alarm_count++] = alarm;
+    AlarmStore::save_alarms(alarms, alarm_count);
+    new_id = alarm.id;
+    LOG_INFO(LOG_MODULE_ALARM, "Alarm %d created locally", alarm.id);
+    return ALARM_EDIT_OK;
 }
 
-void AlarmManager::parse_time(const String &time_str, int &hour, int &minute)
+AlarmEditResult AlarmManager::update_alarm(int id, JsonObjectConst fields)
 {
-    int colon_index = time_str.indexOf(':');
-    if (colon_index > 0)
+    TableLock lock(table_mutex);
+    int index = find_alarm_index(id);
+    if (index < 0)
+        return ALARM_EDIT_NOT_FOUND;
+
+    Alarm alarm = alarms[index];
+    if (!read_alarm_fields(fields, alarm) || !is_valid_alarm(alarm))
+        return ALARM_EDIT_INVALID;
+
+    alarm.updated_at = current_epoch();
+    if (!AlarmStore::queue_change(PENDING_UPDATE, id, alarm.updated_at))
+        return ALARM_EDIT_FULL;
+
+    alarms[index] = alarm;
+    AlarmStore::save_alarms(alarms, alarm_count);
+    LOG_INFO(LOG_MODULE_ALARM, "Alarm %d updated locally", id);
+    return ALARM_EDIT_OK;
+}
+
+AlarmEditResult AlarmManager::delete_alarm(int id)
+{
+    TableLock lock(table_mutex);
+    int index = find_alarm_index(id);
+    if (index < 0)
+        return ALARM_EDIT_NOT_FOUND;
+
+    if (!AlarmStore::queue_change(PENDING_DELETE, id, current_epoch()))
+        return ALARM_EDIT_FULL;
+
+    for (int i = index; i < alarm_count - 1; i++)
+    {
+        alarms[i] = alarms[i + 1];
+    }
+    alarm_count--;
+    AlarmStore::save_alarms(alarms, alarm_count);
+    LOG_INFO(LOG_MODULE_ALARM, "Alarm %d deleted locally", id);
+    return ALARM_EDIT_OK;
+}
+
+void AlarmManager::apply_remote_row(JsonObjectConst row)
+{
+    int id = row["id"] | 0;
+    // Local edits win until they have been pushed by the next full sync
+    TableLock lock(table_mutex);
+    if (id <= 0 || AlarmStore::has_pending(id))
+        return;
+
+    int index = find_alarm_index(id);
+    Alarm alarm;
+    if (!row["time"].is<const char *>())
+    {
+        LOG_WARN(LOG_MODULE_ALARM, "Ignoring remote alarm %d without a time", id);
+        return;
+    }
+    if (index >= 0)
     {
-        hour = time_str.substring(0, colon_index).toInt();
-        minute = time_str.substring(colon_index + 1).toInt();
+        alarm = alarms[index];
     }
     else
     {
-        hour = 0;
-        minute = 0;
+        reset_alarm(alarm);
+        alarm.id = id;
     }
+
+    if (!read_alarm_fields(row, alarm) || !is_valid_alarm(alarm))
+    {
+        LOG_WARN(LOG_MODULE_ALARM, "Ignoring malformed remote alarm %d", id);
+        return;
+    }
+    alarm.updated_at = parse_timestamp(row["updated_at"] | "");
+
+    if (index < 0)
+    {
+        if (alarm_count >= MAX_ALARMS)
+        {
+            LOG_WARN(LOG_MODULE_ALARM, "Alarm table full, ignoring remote alarm %d", id);
+            return;
+        }
+        index = alarm_count++;
+    }
+    alarms[index] = alarm;
+    AlarmStore::save_alarms(alarms, alarm_count);
+    rtc_schedule_version = 0;
+    LOG_INFO(LOG_MODULE_ALARM, "Alarm %d updated from Supabase: %d:%02d", id, alarms[index].hour, alarms[index].minute);
+}
+
+void AlarmManager::remove_remote_alarm(int id)
+{
+    TableLock lock(table_mutex);
+    int index = find_alarm_index(id);
+    if (index < 0 || AlarmStore::has_pending(id))
+        return;
+
+    for (int i = index; i < alarm_count - 1; i++)
+    {
+        alarms[i] = alarms[i + 1];
+    }
+    alarm_count--;
+    AlarmStore::save_alarms(alarms, alarm_count);
+    rtc_schedule_version = 0;
+    LOG_INFO(LOG_MODULE_ALARM, "Alarm %d deleted in Supabase", id);
+}
+
+// Deletes are invisible to an updated_at delta query, so polling compares id lists
+void AlarmManager::retain_remote_ids(JsonArrayConst rows)
+{
+    TableLock lock(table_mutex);
+    for (int i = alarm_count - 1; i >= 0; i--)
+    {
+        if (alarms[i].id <= 0)
+            continue;
+
+        bool found = false;
+        for (JsonObjectConst row : rows)
+        {
+            if ((row["id"] | 0) == alarms[i].id)
+            {
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+            remove_remote_alarm(alarms[i].id);
+    }
+}
+
+uint32_t AlarmManager::get_latest_update()
+{
+    TableLock lock(table_mutex);
+    uint32_t latest = 0;
+    for (int i = 0; i < alarm_count; i++)
+    {
+        if (alarms[i].id > 0 && alarms[i].updated_at > latest)
+            latest = alarms[i].updated_at;
+    }
+    return latest;
+}
+
+void AlarmManager::reset_alarm(Alarm &alarm)
+{
+    alarm.id = 0;
+    alarm.hour = 0;
+    alarm.minute = 0;
+    for (int i = 0; i < 7; i++)
+    {
+        alarm.days_of_week[i] = false;
+    }
+    alarm.enabled = true;
+    alarm.brightness = DEFAULT_BRIGHTNESS;
+    alarm.duration = DEFAULT_SUNRISE_DURATION;
+    strcpy(alarm.color_preset, "sunrise");
+    alarm.zone = 0;
+    alarm.updated_at = 0;
+}
+
+// Only fields present in json are applied, so the same mapping serves
+// full rows from Supabase and partial updates from the local API. Returns
+// false when the time is present but unreadable.
+bool AlarmManager::read_alarm_fields(JsonObjectConst json, Alarm &alarm)
+{
+    JsonVariantConst time = json["time"];
+    if (!time.isNull() && (!time.is<const char *>() || !parse_time(time.as<const char *>(), alarm.hour, alarm.minute)))
+    {
+        return false;
+    }
+
+    if (json["days_of_week"].is<JsonArrayConst>())
+    {
+        for (int i = 0; i < 7; i++)
+        {
+            alarm.days_of_week[i] = false;
+        }
+        for (JsonVariantConst day : json["days_of_week"].as<JsonArrayConst>())
+        {
+            int day_num = day.as<int>();
+            if (day.is<int>() && day_num >= 0 && day_num < 7)
+            {
+                alarm.days_of_week[day_num] = true;
+            }
+        }
+    }
+
+    alarm.enabled = json["is_enabled"] | alarm.enabled;
+    alarm.brightness = json["brightness_level"] | alarm.brightness;
+    alarm.duration = json["duration_minutes"] | alarm.duration;
+    if (json["color_preset"].is<const char *>())
+    {
+        strncpy(alarm.color_preset, json["color_preset"].as<const char *>(), sizeof(alarm.color_preset) - 1);
+        alarm.color_preset[sizeof(alarm.color_preset) - 1] = '\0';
+    }
+    alarm.zone = json["zone"] | alarm.zone;
+    return true;
+}
+
+void AlarmManager::write_alarm_fields(const Alarm &alarm, JsonObject json)
+{
+    char time_str[9];
+    snprintf(time_str, sizeof(time_str), "%02d:%02d:00", alarm.hour, alarm.minute);
+    json["time"] = time_str;
+
+    JsonArray days = json["days_of_week"].to<JsonArray>();
+    for (int i = 0; i < 7; i++)
+    {
+        if (alarm.days_of_week[i])
+            days.add(i);
+    }
+
+    json["is_enabled"] = alarm.enabled;
+    json["brightness_level"] = alarm.brightness;
+    json["duration_minutes"] = alarm.duration;
+    json["color_preset"] = alarm.color_preset;
+    json["zone"] = alarm.zone;
+}
+
+String AlarmManager::alarm_to_row_json(const Alarm &alarm)
+{
+    JsonDocument doc;
+    JsonObject row = doc.to<JsonObject>();
+    row["device_id"] = NetworkManager::get_device_id();
+    if (alarm.id < 0)
+        row["local_id"] = alarm.id;
+    write_alarm_fields(alarm, row);
+
+    String json;
+    serializeJson(doc, json);
+    return json;
+}
+
+bool AlarmManager::is_valid_alarm(const Alarm &alarm)
+{
+    return alarm.hour >= 0 && alarm.hour < 24 &&
+           alarm.minute >= 0 && alarm.minute < 60 &&
+           alarm.brightness >= 0 && alarm.brightness <= 255 &&
+           alarm.duration > 0 && alarm.duration <= 24 * 60 &&
+           alarm.zone >= 0 && alarm.zone <= UINT8_MAX;
+}
+
+int AlarmManager::find_alarm_index(int id)
+{
+    for (int i = 0; i < alarm_count; i++)
+    {
+        if (alarms[i].id == id)
+            return i;
+    }
+    return -1;
+}
+
+uint32_t AlarmManager::current_epoch()
+{
+    // Before the first NTP sync the clock starts at 1970; such edits lose every conflict
+    time_t now = time(nullptr);
+    return now > 1600000000 ? (uint32_t)now : 0;
 }
 
-void AlarmManager::trigger_sunrise_alarm(Alarm &alarm)
+// Parses PostgREST timestamptz values such as "2025-01-05T10:00:00.123456+00:00"
+uint32_t AlarmManager::parse_timestamp(const char *iso_time)
 {
-    DEBUG_PRINT("Starting sunrise alarm with preset: ");
-    DEBUG_PRINTLN(alarm.color_preset);
+    int year, month, day, hour, minute, second;
+    if (sscanf(iso_time, "%d-%d-%dT%d:%d:%d", &year, &month, &day, &hour, &minute, &second) != 6)
+        return 0;
+
+    // Days since 1970-01-01 in the proleptic Gregorian calendar; newlib has no timegm()
+    int y = year - (month <= 2);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int year_of_era = y - era * 400;
+    int day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    long days = (long)era * 146097 + day_of_era - 719468;
 
-    ColorPreset *preset = find_color_preset(alarm.color_preset);
-    if (preset == nullptr)
+    long seconds = days * 86400L + hour * 3600L + minute * 60L + second;
+
+    const char *offset = strpbrk(iso_time + 19, "+-Z");
+    if (offset != nullptr && *offset != 'Z')
     {
-        preset = &color_presets[0];
+        int offset_hours = 0, offset_minutes = 0;
+        sscanf(offset + 1, "%d:%d", &offset_hours, &offset_minutes);
+        long offset_seconds = offset_hours * 3600L + offset_minutes * 60L;
+        seconds += (*offset == '+') ? -offset_seconds : offset_seconds;
     }
 
-    LEDController::run_sunrise_animation(*preset, alarm.duration * 60000, alarm.brightness);
+    return seconds > 0 ? (uint32_t)seconds : 0;
+}
+
+// Reports occurrences between the previous check and the current minute that
+// no check ran for, e.g. because the device was off or woke up too late
+void AlarmManager::record_missed_alarms(uint32_t now)
+{
+    if (rtc_last_alarm_check == 0 || rtc_last_alarm_check >= now)
+        return;
+
+    uint32_t minute_start = now - now % 60;
+    uint32_t since = max(rtc_last_alarm_check, minute_start > 86400 ? minute_start - 86400 : (uint32_t)0);
+    TableLock lock(table_mutex);
+
+    for (int i = 0; i < alarm_count; i++)
+    {
+        if (!alarms[i].enabled)
+            continue;
+
+        // The occurrence today and yesterday covers the whole one day lookback
+        for (int days_back = 0; days_back <= 1; days_back++)
+        {
+            time_t day = now - days_back * 86400;
+            struct tm occurrence;
+            localtime_r(&day, &occurrence);
+            occurrence.tm_hour = alarms[i].hour;
+            occurrence.tm_min = alarms[i].minute;
+            occurrence.tm_sec = 0;
+            occurrence.tm_isdst = -1;
+            time_t at = mktime(&occurrence);
+
+            if (at > since && at < minute_start && at >= alarms[i].updated_at &&
+                alarms[i].days_of_week[occurrence.tm_wday])
+            {
+                LOG_WARN(LOG_MODULE_ALARM, "Alarm %d at %02d:%02d was missed", alarms[i].id,
+                         alarms[i].hour, alarms[i].minute);
+                EventQueue::record(ALARM_EVENT_MISSED, alarms[i].id);
+            }
+        }
+    }
 }
 
-ColorPreset *AlarmManager::find_color_preset(const String &name)
+ColorPreset *AlarmManager::find_color_preset(const char *name)
 {
     for (int i = 0; i < color_preset_count; i++)
     {
-        if (color_presets[i].name == name)
+        if (strcmp(color_presets[i].name, name) == 0)
         {
             return &color_presets[i];
         }
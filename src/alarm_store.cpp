@@ -0,0 +1,249 @@
+#include "alarm_store.h"
+#include "config.h"
+#include <Preferences.h>
+
+static const char *NVS_NAMESPACE = "alarms";
+static const char *KEY_ALARMS = "table";
+static const char *KEY_PENDING = "pending";
+static const char *KEY_LOCAL_ID = "local_id";
+
+// Compact image of Alarm as kept in NVS
+struct StoredAlarm
+{
+    int32_t id;
+    uint32_t updated_at;
+    uint16_t duration;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t days_mask;
+    uint8_t enabled;
+    uint8_t brightness;
+    uint8_t zone; // Zero in tables saved before alarms had zones: the whole strip
+    char color_preset[16];
+};
+
+int AlarmStore::load_alarms(Alarm alarms[], int max_count)
+{
+    StoredAlarm stored[MAX_ALARMS];
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, true))
+        return 0;
+
+    size_t length = prefs.getBytesLength(KEY_ALARMS);
+    int count = 0;
+    if (length > 0 && length <= sizeof(stored) && length % sizeof(StoredAlarm) == 0)
+    {
+        prefs.getBytes(KEY_ALARMS, stored, length);
+        count = min((int)(length / sizeof(StoredAlarm)), max_count);
+    }
+    prefs.end();
+
+    for (int i = 0; i < count; i++)
+    {
+        alarms[i].id = stored[i].id;
+        alarms[i].updated_at = stored[i].updated_at;
+        alarms[i].hour = stored[i].hour;
+        alarms[i].minute = stored[i].minute;
+        for (int day = 0; day < 7; day++)
+        {
+            alarms[i].days_of_week[day] = stored[i].days_mask & (1 << day);
+        }
+        alarms[i].enabled = stored[i].enabled;
+        alarms[i].brightness = stored[i].brightness;
+        alarms[i].duration = stored[i].duration;
+        alarms[i].zone = stored[i].zone;
+        strncpy(alarms[i].color_preset, stored[i].color_preset, sizeof(alarms[i].color_preset) - 1);
+        alarms[i].color_preset[sizeof(alarms[i].color_preset) - 1] = '\0';
+    }
+    return count;
+}
+
+bool AlarmStore::save_alarms(const Alarm alarms[], int count)
+{
+    StoredAlarm stored[MAX_ALARMS];
+    count = min(count, MAX_ALARMS);
+    memset(stored, 0, sizeof(stored));
+
+    for (int i = 0; i < count; i++)
+    {
+        stored[i].id = alarms[i].id;
+        stored[i].updated_at = alarms[i].updated_at;
+        stored[i].hour = alarms[i].hour;
+        stored[i].minute = alarms[i].minute;
+        for (int day = 0; day < 7; day++)
+        {
+            if (alarms[i].days_of_week[day])
+                stored[i].days_mask |= (1 << day);
+        }
+        stored[i].enabled = alarms[i].enabled;
+        stored[i].brightness = alarms[i].brightness;
+        stored[i].duration = alarms[i].duration;
+        stored[i].zone = alarms[i].zone;
+        strncpy(stored[i].color_preset, alarms[i].color_preset, sizeof(stored[i].color_preset) - 1);
+    }
+
+    return write_if_changed(KEY_ALARMS, stored, count * sizeof(StoredAlarm));
+}
+
+int AlarmStore::load_pending(PendingChange changes[], int max_count)
+{
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, true))
+        return 0;
+
+    size_t length = prefs.getBytesLength(KEY_PENDING);
+    int count = 0;
+    if (length > 0 && length % sizeof(PendingChange) == 0)
+    {
+        count = min((int)(length / sizeof(PendingChange)), max_count);
+        prefs.getBytes(KEY_PENDING, changes, count * sizeof(PendingChange));
+    }
+    prefs.end();
+    return count;
+}
+
+bool AlarmStore::queue_change(PendingOp op, int alarm_id, uint32_t changed_at)
+{
+    PendingChange changes[MAX_PENDING_CHANGES];
+    int count = load_pending(changes, MAX_PENDING_CHANGES);
+
+    int existing = -1;
+    for (int i = 0; i < count; i++)
+    {
+        if (changes[i].alarm_id == alarm_id)
+        {
+            existing = i;
+            break;
+        }
+    }
+
+    // Collapse repeated edits of one alarm into a single upstream operation.
+    // changed_at always moves on, so a sync that pushed the entry as it was
+    // before this edit leaves it queued (see drop_pushed()). A create is not
+    // simply dropped when the alarm is deleted: its insert may be on its way
+    // upstream, and a delete of a row that never arrived is skipped anyway.
+    if (existing >= 0)
+    {
+        if (op == PENDING_DELETE)
+            changes[existing].op = PENDING_DELETE;
+        changes[existing].changed_at = max(changed_at, changes[existing].changed_at + 1);
+    }
+    else
+    {
+        if (count >= MAX_PENDING_CHANGES)
+            return false;
+
+        changes[count].alarm_id = alarm_id;
+        changes[count].op = op;
+        changes[count].changed_at = changed_at;
+        count++;
+    }
+
+    return write_if_changed(KEY_PENDING, changes, count * sizeof(PendingChange));
+}
+
+// Removes the entries a sync pushed, matched by alarm, operation and
+// changed_at rather than position: an edit folded into an entry while it was
+// being pushed, or a change queued meanwhile, stays for the next sync
+void AlarmStore::drop_pushed(const PendingChange pushed[], int count)
+{
+    PendingChange changes[MAX_PENDING_CHANGES];
+    int stored = load_pending(changes, MAX_PENDING_CHANGES);
+    int kept = 0;
+    for (int i = 0; i < stored; i++)
+    {
+        bool was_pushed = false;
+        for (int j = 0; j < count && !was_pushed; j++)
+        {
+            was_pushed = changes[i].alarm_id == pushed[j].alarm_id && changes[i].op == pushed[j].op &&
+                         changes[i].changed_at == pushed[j].changed_at;
+        }
+        if (!was_pushed)
+            changes[kept++] = changes[i];
+    }
+
+    write_if_changed(KEY_PENDING, changes, kept * sizeof(PendingChange));
+}
+
+int AlarmStore::get_pending_count()
+{
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, true))
+        return 0;
+
+    int count = prefs.getBytesLength(KEY_PENDING) / sizeof(PendingChange);
+    prefs.end();
+    return count;
+}
+
+bool AlarmStore::find_pending(int alarm_id, PendingChange &change)
+{
+    PendingChange changes[MAX_PENDING_CHANGES];
+    int count = load_pending(changes, MAX_PENDING_CHANGES);
+    for (int i = 0; i < count; i++)
+    {
+        if (changes[i].alarm_id == alarm_id)
+        {
+            change = changes[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AlarmStore::has_pending(int alarm_id)
+{
+    PendingChange changes[MAX_PENDING_CHANGES];
+    int count = load_pending(changes, MAX_PENDING_CHANGES);
+    for (int i = 0; i < count; i++)
+    {
+        if (changes[i].alarm_id == alarm_id)
+            return true;
+    }
+    return false;
+}
+
+int AlarmStore::next_local_id()
+{
+    // Negative ids mark alarms created on the device that Supabase has not
+    // assigned an id to yet. They are also the rows' local_id, which must not
+    // repeat an earlier one, so a counter lost with the NVS starts at random.
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, false))
+        return -1;
+
+    uint32_t counter = (prefs.isKey(KEY_LOCAL_ID) ? prefs.getUInt(KEY_LOCAL_ID, 0) : esp_random() >> 8) + 1;
+    prefs.putUInt(KEY_LOCAL_ID, counter);
+    prefs.end();
+    return -(int)counter;
+}
+
+bool AlarmStore::write_if_changed(const char *key, const void *data, size_t length)
+{
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, false))
+        return false;
+
+    // Skip identical writes to spare flash on every sync
+    bool changed = true;
+    if (prefs.getBytesLength(key) == length)
+    {
+        uint8_t current[MAX_ALARMS * sizeof(StoredAlarm)];
+        if (length <= sizeof(current))
+        {
+            prefs.getBytes(key, current, length);
+            changed = memcmp(current, data, length) != 0;
+        }
+    }
+
+    bool ok = true;
+    if (changed)
+    {
+        if (length == 0)
+            prefs.remove(key);
+        else
+            ok = prefs.putBytes(key, data, length) == length;
+    }
+    prefs.end();
+    return ok;
+}
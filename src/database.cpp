@@ -1,8 +1,201 @@
 #include "database.h"
 #include "config.h"
+#include "logger.h"
+#include "tls_client.h"
+#include "metrics.h"
+#include <HTTPClient.h>
+
+String Database::base_url;
+DatabaseStats Database::stats;
+
+// Shared across requests so HTTP keep-alive can reuse the open connection
+static WiFiClient plain_client;
+static TlsClient tls_client;
+static HTTPClient http;
+
+// Lets HTTPClient::writeToStream() fill a TextWriter. Writes always succeed,
+// so a body too large for the writer is still read off the connection and
+// the kept-alive connection stays usable.
+class WriterStream : public Stream
+{
+public:
+    explicit WriterStream(TextWriter &writer) : writer(writer) {}
+    size_t write(uint8_t data)
+    {
+        writer.write(data);
+        return 1;
+    }
+    size_t write(const uint8_t *data, size_t size)
+    {
+        writer.write(data, size);
+        return size;
+    }
+    int available() { return 0; }
+    int read() { return -1; }
+    int peek() { return -1; }
+    void flush() {}
+
+private:
+    TextWriter &writer;
+};
+
+// Bodies of inserts, updates and deletes are not used, so they may be cut off
+static const size_t WRITE_RESPONSE_SIZE = 128;
 
-Supabase Database::db;
 void Database::init()
 {
-    db.begin(SUPABASE_URL, SUPABASE_KEY);
-}
\ No newline at end of file
+    init(SUPABASE_URL);
+}
+
+void Database::init(const char *url)
+{
+    base_url = url;
+    if (base_url.endsWith("/"))
+        base_url.remove(base_url.length() - 1);
+    base_url += "/rest/v1/";
+    http.setReuse(true);
+}
+
+void Database::close()
+{
+    http.end();
+    tls_client.stop();
+    plain_client.stop();
+
+    if (stats.requests > 0)
+    {
+        LOG_INFO(LOG_MODULE_NETWORK, "Supabase: %lu requests, avg %lu ms; %lu handshakes (%lu resumed), avg %lu ms",
+                 (unsigned long)stats.requests, (unsigned long)(stats.request_ms / stats.requests),
+                 (unsigned long)stats.handshakes, (unsigned long)stats.resumed_handshakes,
+                 (unsigned long)(stats.handshakes > 0 ? stats.handshake_ms / stats.handshakes : 0));
+    }
+}
+
+int Database::select_rows(const String &table, const String &query, TextWriter &response)
+{
+    return request("GET", table + "?" + query, "", response);
+}
+
+// GET only reaches STABLE functions, which is all the device calls
+int Database::call_function(const String &name, const String &query, TextWriter &response)
+{
+    return request("GET", "rpc/" + name + "?" + query, "", response);
+}
+
+// Duplicates of the on_conflict key are skipped, so a batch whose response was
+// lost can be sent again without creating duplicate rows
+int Database::insert_rows(const String &table, const String &json_array, const char *on_conflict)
+{
+    char buffer[WRITE_RESPONSE_SIZE];
+    TextWriter response(buffer, sizeof(buffer));
+    return request("POST", table + "?on_conflict=" + on_conflict, json_array, response,
+                   "resolution=ignore-duplicates,return=minimal");
+}
+
+bool Database::update_row(const String &table, int id, const String &json)
+{
+    char buffer[WRITE_RESPONSE_SIZE];
+    TextWriter response(buffer, sizeof(buffer));
+    int code = request("PATCH", table + "?id=eq." + String(id), json, response);
+    return code >= 200 && code < 300;
+}
+
+bool Database::delete_row(const String &table, int id)
+{
+    char buffer[WRITE_RESPONSE_SIZE];
+    TextWriter response(buffer, sizeof(buffer));
+    int code = request("DELETE", table + "?id=eq." + String(id), "", response);
+    return code >= 200 && code < 300;
+}
+
+void Database::append_metrics(TextWriter &out)
+{
+    Metrics::counter(out, "sunrise_db_requests_total", "Supabase REST requests", stats.requests);
+    Metrics::counter(out, "sunrise_db_request_ms_total", "Time spent in Supabase requests excluding TLS handshakes", stats.request_ms);
+    Metrics::counter(out, "sunrise_tls_handshakes_total", "TLS handshakes", stats.handshakes);
+    Metrics::counter(out, "sunrise_tls_resumed_handshakes_total", "TLS handshakes that resumed a cached session", stats.resumed_handshakes);
+    Metrics::counter(out, "sunrise_tls_handshake_ms_total", "Time spent in TLS handshakes", stats.handshake_ms);
+}
+
+int Database::request(const char *method, const String &path, const String &body, TextWriter &response,
+                      const char *prefer)
+{
+    int status = 0;
+    for (int attempt = 0; attempt <= DB_MAX_RETRIES; attempt++)
+    {
+        if (attempt > 0)
+        {
+            LOG_WARN(LOG_MODULE_NETWORK, "%s %s failed (%d), retry %d", method, path.c_str(), status, attempt);
+            delay(DB_RETRY_BACKOFF_MS << (attempt - 1));
+        }
+
+        uint32_t start = micros();
+        status = send_once(method, base_url + path, body, response, prefer);
+        uint32_t total_us = micros() - start;
+        uint32_t handshake_us = tls_client.take_handshake_us();
+        uint32_t handshake_ms = handshake_us / 1000;
+        uint32_t total_ms = total_us / 1000;
+
+        stats.requests++;
+        stats.request_ms += total_ms - handshake_ms;
+        if (handshake_us > 0)
+        {
+            stats.handshakes++;
+            stats.handshake_ms += handshake_ms;
+            if (tls_client.was_resumed())
+                stats.resumed_handshakes++;
+        }
+
+        LOG_DEBUG(LOG_MODULE_NETWORK, "%s %s -> %d in %lu ms, handshake %lu ms (%u bytes)", method, path.c_str(),
+                  status, (unsigned long)(total_ms - handshake_ms), (unsigned long)handshake_ms, (unsigned)response.length());
+
+        if (!is_retryable(method, path, status))
+            break;
+    }
+    return status;
+}
+
+int Database::send_once(const char *method, const String &url, const String &body, TextWriter &response,
+                        const char *prefer)
+{
+    response.clear();
+    WiFiClient &client = url.startsWith("https://") ? (WiFiClient &)tls_client : plain_client;
+
+    http.setConnectTimeout(DB_TIMEOUT_MS);
+    http.setTimeout(DB_TIMEOUT_MS);
+    if (!http.begin(client, url))
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+
+    http.addHeader("apikey", SUPABASE_KEY);
+    http.addHeader("Authorization", String("Bearer ") + SUPABASE_KEY);
+    http.addHeader("Content-Type", "application/json");
+    if (prefer != nullptr)
+        http.addHeader("Prefer", prefer);
+
+    int status = http.sendRequest(method, body);
+    if (status > 0)
+    {
+        // A connection lost mid-body fails here instead of passing on a truncated 200
+        WriterStream stream(response);
+        int read = http.writeToStream(&stream);
+        if (read < 0)
+            status = read;
+        else if (response.overflowed() && status < 300 && strcmp(method, "GET") == 0)
+            status = HTTPC_ERROR_TOO_LESS_RAM;
+    }
+    http.end();
+    return status;
+}
+
+// A request that timed out may still have been carried out, so only
+// requests that do the same when sent twice are retried: reads, updates and
+// deletes by id, and inserts that skip rows already stored under their
+// on_conflict key. Other inserts fail instead of storing a duplicate.
+bool Database::is_retryable(const char *method, const String &path, int status)
+{
+    if (strcmp(method, "POST") == 0 && path.indexOf("on_conflict=") < 0)
+        return false;
+    // Negative codes are transport errors (refused, timed out, connection lost);
+    // a body too large for its buffer would be just as large the next time
+    return (status <= 0 && status != HTTPC_ERROR_TOO_LESS_RAM) || status == 429 || status >= 500;
+}
@@ -0,0 +1,101 @@
+#include "energy_model.h"
+#include "network_manager.h"
+#include "metrics.h"
+#include "logger.h"
+#include "config.h"
+#include <time.h>
+
+uint32_t EnergyModel::led_mw = 0;
+unsigned long EnergyModel::led_since = 0;
+float EnergyModel::led_mwh = 0;
+float EnergyModel::sunrise_start_mwh = 0;
+
+// Totals since power on, up to the start of this boot
+RTC_DATA_ATTR static float rtc_total_mwh = 0;
+RTC_DATA_ATTR static uint32_t rtc_total_seconds = 0;
+RTC_DATA_ATTR static float rtc_last_boot_mwh = 0;
+RTC_DATA_ATTR static float rtc_last_sleep_mwh = 0;
+RTC_DATA_ATTR static float rtc_last_sunrise_mwh = 0;
+RTC_DATA_ATTR static uint32_t rtc_sleep_seconds = 0;
+RTC_DATA_ATTR static uint32_t rtc_sleep_started = 0;
+
+void EnergyModel::begin(esp_sleep_wakeup_cause_t cause)
+{
+    if (rtc_sleep_seconds == 0)
+        return;
+
+    // A button cuts the sleep short; the RTC clock tells by how much
+    uint32_t slept = rtc_sleep_seconds;
+    time_t now = time(nullptr);
+    if (cause == ESP_SLEEP_WAKEUP_EXT0 && now > 1600000000 && rtc_sleep_started != 0 && (uint32_t)now >= rtc_sleep_started)
+        slept = min(slept, (uint32_t)now - rtc_sleep_started);
+
+    rtc_last_sleep_mwh = slept * ENERGY_DEEP_SLEEP_MW / 3600.0f;
+    rtc_total_mwh += rtc_last_sleep_mwh;
+    rtc_total_seconds += slept;
+    rtc_sleep_seconds = 0;
+}
+
+void EnergyModel::set_led_power(uint32_t milliwatts)
+{
+    integrate_led();
+    led_mw = milliwatts;
+}
+
+void EnergyModel::begin_sunrise()
+{
+    sunrise_start_mwh = get_boot_mwh();
+}
+
+void EnergyModel::end_sunrise()
+{
+    rtc_last_sunrise_mwh = get_boot_mwh() - sunrise_start_mwh;
+    LOG_INFO(LOG_MODULE_LED, "Sunrise used %.1f mWh", rtc_last_sunrise_mwh);
+}
+
+void EnergyModel::end_boot(uint64_t sleep_us)
+{
+    float boot_mwh = get_boot_mwh();
+    rtc_last_boot_mwh = boot_mwh;
+    rtc_total_mwh += boot_mwh;
+    rtc_total_seconds += millis() / 1000;
+    rtc_sleep_seconds = sleep_us / 1000000ULL;
+    time_t now = time(nullptr);
+    rtc_sleep_started = now > 1600000000 ? (uint32_t)now : 0;
+
+    LOG_INFO(LOG_MODULE_SYSTEM, "Boot used %.2f mWh (%lu ms awake, %lu ms WiFi, %.2f mWh LEDs), %.1f mWh/day",
+             boot_mwh, millis(), (unsigned long)NetworkManager::get_radio_on_ms(), led_mwh, get_per_day_mwh());
+}
+
+float EnergyModel::get_boot_mwh()
+{
+    integrate_led();
+    float cpu_mwh = millis() * ENERGY_ACTIVE_MW / 3600000.0f;
+    float wifi_mwh = NetworkManager::get_radio_on_ms() * ENERGY_WIFI_MW / 3600000.0f;
+    return cpu_mwh + wifi_mwh + led_mwh;
+}
+
+float EnergyModel::get_per_day_mwh()
+{
+    uint32_t seconds = rtc_total_seconds + millis() / 1000;
+    if (seconds == 0)
+        return 0;
+    return (rtc_total_mwh + get_boot_mwh()) * 86400.0f / seconds;
+}
+
+void EnergyModel::append_metrics(TextWriter &out)
+{
+    Metrics::gauge(out, "sunrise_energy_boot_mwh", "Estimated energy used by this boot so far", get_boot_mwh());
+    Metrics::gauge(out, "sunrise_energy_last_boot_mwh", "Estimated energy used by the previous boot", rtc_last_boot_mwh);
+    Metrics::gauge(out, "sunrise_energy_last_sleep_mwh", "Estimated energy used by the last deep sleep", rtc_last_sleep_mwh);
+    Metrics::gauge(out, "sunrise_energy_last_sunrise_mwh", "Estimated energy used by the last sunrise", rtc_last_sunrise_mwh);
+    Metrics::gauge(out, "sunrise_energy_per_day_mwh", "Estimated average energy per day since power on", get_per_day_mwh());
+    Metrics::counter(out, "sunrise_energy_mwh_total", "Estimated energy used since power on", rtc_total_mwh + get_boot_mwh());
+}
+
+void EnergyModel::integrate_led()
+{
+    unsigned long now = millis();
+    led_mwh += led_mw * (float)(now - led_since) / 3600000.0f;
+    led_since = now;
+}
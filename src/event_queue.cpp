@@ -0,0 +1,337 @@
+#include "event_queue.h"
+#include "database.h"
+#include "network_manager.h"
+#include "led_controller.h"
+#include "metrics.h"
+#include "logger.h"
+#include "config.h"
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <Preferences.h>
+#include <time.h>
+
+static const char *EVENT_FILE = "/events.bin";
+static const char *EVENT_FILE_TEMP = "/events.tmp";
+static const char *NVS_NAMESPACE = "events";
+static const char *KEY_NEXT_SEQUENCE = "next_seq";
+
+RTC_DATA_ATTR static AlarmEvent rtc_events[EVENT_RTC_CAPACITY];
+RTC_DATA_ATTR static uint8_t rtc_event_count = 0;
+RTC_DATA_ATTR static uint16_t rtc_flash_count = 0;
+RTC_DATA_ATTR static uint32_t rtc_next_sequence = 0;
+RTC_DATA_ATTR static uint32_t rtc_reserved_sequence = 0; // NVS holds this, every sequence below it may be in use
+RTC_DATA_ATTR static uint8_t rtc_failed_attempts = 0;
+RTC_DATA_ATTR static uint32_t rtc_retry_at = 0;
+RTC_DATA_ATTR static uint32_t rtc_last_upload_ms = 0;
+RTC_DATA_ATTR static uint32_t rtc_uploaded_total = 0;
+RTC_DATA_ATTR static uint32_t rtc_upload_failures_total = 0;
+
+void EventQueue::record(AlarmEventType type, int alarm_id, uint16_t sunrise_seconds, uint8_t dismiss_source)
+{
+    restore_after_power_loss();
+
+    if (rtc_event_count >= EVENT_RTC_CAPACITY && !spill_to_flash())
+    {
+        LOG_WARN(LOG_MODULE_STORAGE, "Event queue full and flash unavailable, dropping event %lu",
+                 (unsigned long)rtc_events[0].sequence);
+        memmove(rtc_events, rtc_events + 1, (rtc_event_count - 1) * sizeof(AlarmEvent));
+        rtc_event_count--;
+    }
+
+    if (rtc_next_sequence >= rtc_reserved_sequence)
+        reserve_sequences();
+
+    time_t now = time(nullptr);
+    AlarmEvent &event = rtc_events[rtc_event_count++];
+    event.sequence = rtc_next_sequence++;
+    event.occurred_at = now > 1600000000 ? (uint32_t)now : 0;
+    event.alarm_id = alarm_id;
+    event.sunrise_seconds = sunrise_seconds;
+    event.type = type;
+    event.dismiss_source = dismiss_source;
+
+    LOG_INFO(LOG_MODULE_ALARM, "Alarm %d %s, %d events queued", alarm_id, type_name(type), get_depth());
+}
+
+void EventQueue::upload_if_online()
+{
+    // Telemetry is never worth powering the radio for; it rides along with syncs
+    if (!NetworkManager::wifi_connected)
+        return;
+
+    restore_after_power_loss();
+    if (get_depth() == 0)
+        return;
+
+    uint32_t now = time(nullptr);
+    if (rtc_retry_at != 0 && now < rtc_retry_at)
+    {
+        LOG_DEBUG(LOG_MODULE_NETWORK, "Event upload backing off for %lu s", (unsigned long)(rtc_retry_at - now));
+        return;
+    }
+
+    while (get_depth() > 0)
+    {
+        AlarmEvent batch[EVENT_BATCH_SIZE];
+        int from_flash = 0;
+        int count = peek_batch(batch, EVENT_BATCH_SIZE, from_flash);
+        if (count == 0)
+            break;
+
+        uint32_t start = millis();
+        int status = Database::insert_rows("alarm_events", batch_to_json(batch, count), "device_id,sequence");
+        rtc_last_upload_ms = millis() - start;
+
+        if (status < 200 || status >= 300)
+        {
+            // The batch stays at the head of the queue, so later events cannot overtake it
+            rtc_failed_attempts = min(rtc_failed_attempts + 1, 16);
+            rtc_upload_failures_total++;
+            uint32_t backoff = min((uint32_t)EVENT_RETRY_MAX_S, (uint32_t)EVENT_RETRY_BASE_S << (rtc_failed_attempts - 1));
+            rtc_retry_at = now + backoff;
+            LOG_WARN(LOG_MODULE_NETWORK, "Event upload failed (%d), retrying in %lu s", status, (unsigned long)backoff);
+            return;
+        }
+
+        drop_uploaded(count, from_flash);
+        rtc_failed_attempts = 0;
+        rtc_retry_at = 0;
+        rtc_uploaded_total += count;
+        LOG_INFO(LOG_MODULE_NETWORK, "Uploaded %d alarm events in %lu ms", count, (unsigned long)rtc_last_upload_ms);
+    }
+}
+
+int EventQueue::get_depth()
+{
+    return rtc_flash_count + rtc_event_count;
+}
+
+void EventQueue::append_metrics(TextWriter &out)
+{
+    Metrics::gauge(out, "sunrise_event_queue_depth", "Alarm events waiting for upload", get_depth());
+    Metrics::gauge(out, "sunrise_event_upload_latency_ms", "Duration of the last alarm_events bulk insert", rtc_last_upload_ms);
+    Metrics::counter(out, "sunrise_events_uploaded_total", "Alarm events uploaded since power on", rtc_uploaded_total);
+    Metrics::counter(out, "sunrise_event_upload_failures_total", "Failed alarm_events uploads since power on", rtc_upload_failures_total);
+}
+
+// RTC memory is cleared on power loss. Sequence numbers must not restart, or
+// the server would discard new events as duplicates of old ones. NVS holds
+// the end of the block handed out last, so after a power loss numbering
+// resumes past every event that may already have been uploaded.
+void EventQueue::restore_after_power_loss()
+{
+    if (rtc_next_sequence != 0)
+        return;
+
+    Preferences prefs;
+    uint32_t next = 1;
+    if (prefs.begin(NVS_NAMESPACE, true))
+    {
+        next = max(next, prefs.getUInt(KEY_NEXT_SEQUENCE, 1));
+        prefs.end();
+    }
+
+    if (mount())
+    {
+        File file = LittleFS.open(EVENT_FILE, FILE_READ);
+        if (file)
+        {
+            rtc_flash_count = file.size() / sizeof(AlarmEvent);
+            AlarmEvent last;
+            if (rtc_flash_count > 0 && file.seek((rtc_flash_count - 1) * sizeof(AlarmEvent)) &&
+                file.read((uint8_t *)&last, sizeof(last)) == sizeof(last))
+            {
+                next = max(next, last.sequence + 1);
+            }
+            file.close();
+        }
+    }
+
+    rtc_next_sequence = next;
+    rtc_reserved_sequence = next;
+}
+
+// Written once per EVENT_SEQUENCE_BLOCK events rather than once per event to
+// spare the flash. A power loss skips the unused rest of the block.
+void EventQueue::reserve_sequences()
+{
+    uint32_t reserved = rtc_next_sequence + EVENT_SEQUENCE_BLOCK;
+    Preferences prefs;
+    if (prefs.begin(NVS_NAMESPACE, false) && prefs.putUInt(KEY_NEXT_SEQUENCE, reserved) == sizeof(uint32_t))
+    {
+        rtc_reserved_sequence = reserved;
+        LOG_DEBUG(LOG_MODULE_STORAGE, "Reserved event sequences up to %lu", (unsigned long)reserved);
+    }
+    else
+    {
+        LOG_WARN(LOG_MODULE_STORAGE, "Could not reserve event sequences in NVS");
+    }
+    prefs.end();
+}
+
+bool EventQueue::spill_to_flash()
+{
+    if (!mount())
+        return false;
+
+    // Keep the file bounded by discarding its oldest events
+    int overflow = rtc_flash_count + rtc_event_count - EVENT_FILE_MAX_EVENTS;
+    if (overflow > 0)
+    {
+        LOG_WARN(LOG_MODULE_STORAGE, "Event file full, dropping %d oldest events", overflow);
+        if (!rewrite_file_from(overflow))
+            return false;
+    }
+
+    File file = LittleFS.open(EVENT_FILE, FILE_APPEND);
+    if (!file)
+        return false;
+
+    size_t length = rtc_event_count * sizeof(AlarmEvent);
+    bool ok = file.write((const uint8_t *)rtc_events, length) == length;
+    file.close();
+    if (!ok)
+        return false;
+
+    rtc_flash_count += rtc_event_count;
+    rtc_event_count = 0;
+    LOG_DEBUG(LOG_MODULE_STORAGE, "Moved alarm events to flash, %u stored", rtc_flash_count);
+    return true;
+}
+
+// Oldest first: events in flash were queued before anything still in RTC memory
+int EventQueue::peek_batch(AlarmEvent batch[], int max_count, int &from_flash)
+{
+    int count = 0;
+    from_flash = 0;
+
+    if (rtc_flash_count > 0 && mount())
+    {
+        File file = LittleFS.open(EVENT_FILE, FILE_READ);
+        if (file)
+        {
+            int wanted = min((int)rtc_flash_count, max_count);
+            from_flash = file.read((uint8_t *)batch, wanted * sizeof(AlarmEvent)) / sizeof(AlarmEvent);
+            file.close();
+        }
+        count = from_flash;
+        // An unreadable file would otherwise let RTC events jump the queue forever
+        if (from_flash < min((int)rtc_flash_count, max_count))
+            return count;
+    }
+
+    for (int i = 0; i < rtc_event_count && count < max_count; i++)
+    {
+        batch[count++] = rtc_events[i];
+    }
+    return count;
+}
+
+void EventQueue::drop_uploaded(int count, int from_flash)
+{
+    if (from_flash > 0)
+        rewrite_file_from(from_flash);
+
+    int from_rtc = count - from_flash;
+    if (from_rtc > 0)
+    {
+        memmove(rtc_events, rtc_events + from_rtc, (rtc_event_count - from_rtc) * sizeof(AlarmEvent));
+        rtc_event_count -= from_rtc;
+    }
+}
+
+bool EventQueue::rewrite_file_from(int first)
+{
+    if (first >= rtc_flash_count)
+    {
+        LittleFS.remove(EVENT_FILE);
+        rtc_flash_count = 0;
+        return true;
+    }
+
+    File source = LittleFS.open(EVENT_FILE, FILE_READ);
+    File target = LittleFS.open(EVENT_FILE_TEMP, FILE_WRITE);
+    if (!source || !target)
+        return false;
+
+    source.seek(first * sizeof(AlarmEvent));
+    uint8_t chunk[16 * sizeof(AlarmEvent)];
+    size_t length;
+    while ((length = source.read(chunk, sizeof(chunk))) > 0)
+    {
+        target.write(chunk, length);
+    }
+    source.close();
+    target.close();
+
+    LittleFS.remove(EVENT_FILE);
+    LittleFS.rename(EVENT_FILE_TEMP, EVENT_FILE);
+    rtc_flash_count -= first;
+    return true;
+}
+
+String EventQueue::batch_to_json(const AlarmEvent batch[], int count)
+{
+    JsonDocument doc;
+    JsonArray rows = doc.to<JsonArray>();
+    String device_id = NetworkManager::get_device_id();
+
+    for (int i = 0; i < count; i++)
+    {
+        const AlarmEvent &event = batch[i];
+        JsonObject row = rows.add<JsonObject>();
+        row["device_id"] = device_id;
+        row["sequence"] = event.sequence;
+        row["alarm_id"] = event.alarm_id;
+        row["event_type"] = type_name(event.type);
+
+        if (event.occurred_at != 0)
+        {
+            time_t occurred_at = event.occurred_at;
+            struct tm utc;
+            gmtime_r(&occurred_at, &utc);
+            char timestamp[26];
+            strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+            row["occurred_at"] = timestamp;
+        }
+        if (event.type == ALARM_EVENT_COMPLETED || event.type == ALARM_EVENT_DISMISSED || event.type == ALARM_EVENT_SNOOZED)
+            row["sunrise_seconds"] = event.sunrise_seconds;
+        if (event.dismiss_source == DISMISS_WEB)
+            row["dismiss_source"] = "web";
+        else if (event.dismiss_source == DISMISS_BUTTON)
+            row["dismiss_source"] = "button";
+    }
+
+    String json;
+    serializeJson(doc, json);
+    return json;
+}
+
+const char *EventQueue::type_name(uint8_t type)
+{
+    switch (type)
+    {
+    case ALARM_EVENT_FIRED:
+        return "fired";
+    case ALARM_EVENT_COMPLETED:
+        return "completed";
+    case ALARM_EVENT_DISMISSED:
+        return "dismissed";
+    case ALARM_EVENT_MISSED:
+        return "missed";
+    case ALARM_EVENT_SNOOZED:
+        return "snoozed";
+    default:
+        return "unknown";
+    }
+}
+
+bool EventQueue::mount()
+{
+    static bool mounted = false;
+    if (!mounted)
+    {
+        mounted = LittleFS.begin(true);
+    }
+    return mounted;
+}
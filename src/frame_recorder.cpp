@@ -0,0 +1,349 @@
+#include "frame_recorder.h"
+#include "sunrise_compositor.h"
+#include "alarm_manager.h"
+#include "temporal_dither.h"
+#include "logger.h"
+#include "config.h"
+#include <LittleFS.h>
+#include <mutex>
+
+bool FrameRecorder::armed = false;
+bool FrameRecorder::recording = false;
+uint16_t FrameRecorder::armed_seed = FRAME_RECORD_SEED;
+
+static File record_file;
+static FrameEncoder record_encoder;
+static uint8_t *record_buffer = nullptr;
+static size_t record_bytes = 0;
+static uint32_t record_frames = 0;
+
+static std::mutex random_mutex;
+
+// A rendered sunrise with its own strip-sized buffers, so the real strip and
+// its dither state are left alone
+struct FrameRender
+{
+    Composition composition;
+    CRGB16 *frame;
+    CRGB *leds;
+    uint16_t *dither_error;
+    FrameEncoder encoder;
+    uint8_t *pending;
+    size_t pending_length;
+    size_t pending_position;
+    uint32_t now;
+    uint16_t random_seed; // The render's random16 state between frames
+    bool finished;
+};
+
+static FrameRender *render_session = nullptr;
+
+size_t FrameRecorder::write_header(uint8_t *out, int num_leds, uint16_t seed, uint8_t flags)
+{
+    uint32_t magic = FRAME_MAGIC;
+    memcpy(out, &magic, 4);
+    out[4] = FRAME_FORMAT_VERSION;
+    out[5] = flags;
+    out[6] = num_leds & 0xFF;
+    out[7] = num_leds >> 8;
+    out[8] = seed & 0xFF;
+    out[9] = seed >> 8;
+    return FRAME_HEADER_SIZE;
+}
+
+void FrameRecorder::begin_encoder(FrameEncoder &encoder, int num_leds)
+{
+    encoder.previous = new CRGB[num_leds];
+    fill_solid(encoder.previous, num_leds, CRGB::Black);
+    encoder.num_leds = num_leds;
+    encoder.last_ms = 0;
+}
+
+void FrameRecorder::free_encoder(FrameEncoder &encoder)
+{
+    delete[] encoder.previous;
+    encoder.previous = nullptr;
+}
+
+// A 5 byte varint and the brightness, then at worst one copy run per LED
+size_t FrameRecorder::max_frame_size(int num_leds)
+{
+    return 6 + num_leds * 4;
+}
+
+size_t FrameRecorder::write_varint(uint8_t *out, uint32_t value)
+{
+    size_t length = 0;
+    while (value >= 0x80)
+    {
+        out[length++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    out[length++] = value;
+    return length;
+}
+
+uint8_t *FrameRecorder::write_color(uint8_t *out, const CRGB &color)
+{
+    out[0] = color.r;
+    out[1] = color.g;
+    out[2] = color.b;
+    return out + 3;
+}
+
+// Greedy: unchanged LEDs are skipped, two or more equal colors are a fill,
+// and a copy runs until the next of either would start. Returns the bytes
+// written to out, which must hold max_frame_size().
+size_t FrameRecorder::encode(FrameEncoder &encoder, uint32_t at_ms, uint8_t brightness, const CRGB *leds, uint8_t *out)
+{
+    uint8_t *cursor = out + write_varint(out, at_ms - encoder.last_ms);
+    encoder.last_ms = at_ms;
+    *cursor++ = brightness;
+
+    CRGB *previous = encoder.previous;
+    int count = encoder.num_leds;
+    int i = 0;
+    while (i < count)
+    {
+        int run = 1;
+        if (leds[i] == previous[i])
+        {
+            while (i + run < count && run < FRAME_RUN_MAX && leds[i + run] == previous[i + run])
+                run++;
+            *cursor++ = FRAME_OP_SKIP | (run - 1);
+            i += run;
+            continue;
+        }
+
+        while (i + run < count && run < FRAME_RUN_MAX && leds[i + run] == leds[i])
+            run++;
+        if (run > 1)
+        {
+            *cursor++ = FRAME_OP_FILL | (run - 1);
+            cursor = write_color(cursor, leds[i]);
+        }
+        else
+        {
+            while (i + run < count && run < FRAME_RUN_MAX && leds[i + run] != previous[i + run] &&
+                   !(i + run + 1 < count && leds[i + run + 1] == leds[i + run]))
+                run++;
+            *cursor++ = FRAME_OP_COPY | (run - 1);
+            for (int j = 0; j < run; j++)
+            {
+                cursor = write_color(cursor, leds[i + j]);
+            }
+        }
+        memcpy(previous + i, leds + i, run * sizeof(CRGB));
+        i += run;
+    }
+    return cursor - out;
+}
+
+void FrameRecorder::arm(uint16_t seed)
+{
+    armed = true;
+    armed_seed = seed;
+    LOG_INFO(LOG_MODULE_LED, "The next sunrise is recorded to %s with seed %u", FRAME_RECORD_FILE, (unsigned)seed);
+}
+
+// Called as the first sunrise starts, before anything draws with random8()
+void FrameRecorder::start(int num_leds)
+{
+    if (!armed)
+    {
+        random16_add_entropy(esp_random());
+        return;
+    }
+
+    armed = false;
+    random16_set_seed(armed_seed);
+    if (!mount())
+        return;
+    record_file = LittleFS.open(FRAME_RECORD_FILE, FILE_WRITE);
+    if (!record_file)
+    {
+        LOG_ERROR(LOG_MODULE_LED, "Cannot create %s", FRAME_RECORD_FILE);
+        return;
+    }
+
+    begin_encoder(record_encoder, num_leds);
+    record_encoder.last_ms = millis();
+    record_buffer = new uint8_t[max_frame_size(num_leds)];
+    record_bytes = write_header(record_buffer, num_leds, armed_seed, 0);
+    record_file.write(record_buffer, record_bytes);
+    record_frames = 0;
+    recording = true;
+}
+
+// Frames are written whole, so a recording cut short at FRAME_RECORD_MAX_BYTES still decodes
+void FrameRecorder::record(uint32_t at_ms, uint8_t brightness, const CRGB *leds)
+{
+    size_t length = encode(record_encoder, at_ms, brightness, leds, record_buffer);
+    if (record_bytes + length > FRAME_RECORD_MAX_BYTES)
+    {
+        LOG_WARN(LOG_MODULE_LED, "Frame recording reached %u bytes, stopping it", (unsigned)record_bytes);
+        stop();
+        return;
+    }
+    if (record_file.write(record_buffer, length) != length)
+    {
+        LOG_ERROR(LOG_MODULE_LED, "Writing %s failed, stopping the recording", FRAME_RECORD_FILE);
+        stop();
+        return;
+    }
+    record_bytes += length;
+    record_frames++;
+}
+
+void FrameRecorder::stop()
+{
+    if (!recording)
+        return;
+
+    recording = false;
+    record_file.close();
+    free_encoder(record_encoder);
+    delete[] record_buffer;
+    record_buffer = nullptr;
+    LOG_INFO(LOG_MODULE_LED, "Recorded %lu frames in %u bytes to %s", (unsigned long)record_frames,
+             (unsigned)record_bytes, FRAME_RECORD_FILE);
+}
+
+bool FrameRecorder::has_recording()
+{
+    return !recording && mount() && LittleFS.exists(FRAME_RECORD_FILE);
+}
+
+// Only one render runs at a time; returns false while another is streaming
+bool FrameRecorder::begin_render(const char *preset, int duration_minutes, int brightness, int zone, uint16_t seed)
+{
+    if (render_session != nullptr)
+        return false;
+
+    int num_leds = NUM_LEDS;
+    FrameRender *session = new FrameRender;
+    session->frame = new CRGB16[num_leds];
+    memset(session->frame, 0, num_leds * sizeof(CRGB16));
+    session->leds = new CRGB[num_leds];
+    session->dither_error = new uint16_t[num_leds * 3];
+    SunriseCompositor::begin_strip(session->composition, session->frame, num_leds);
+    begin_encoder(session->encoder, num_leds);
+    session->pending = new uint8_t[max_frame_size(num_leds)];
+    session->pending_length = write_header(session->pending, num_leds, seed, FRAME_RECORDING_RENDERED);
+    session->pending_position = 0;
+    session->now = 0;
+    session->finished = false;
+    render_session = session;
+
+    {
+        RandomScope random_scope;
+        uint16_t outside = random16_get_seed();
+        random16_set_seed(seed);
+        TemporalDither::reset(session->dither_error, num_leds);
+        session->random_seed = random16_get_seed();
+        random16_set_seed(outside);
+    }
+    SunriseInstance *sunrise = SunriseCompositor::claim(session->composition);
+    AlarmManager::resolve_preset(preset, sunrise->preset, *sunrise->curve);
+    sunrise->alarm_id = 0;
+    sunrise->zone = zone;
+    sunrise->duration_ms = duration_minutes * 60000;
+    sunrise->max_brightness = brightness;
+    SunriseCompositor::start(session->composition, *sunrise, 0);
+    LOG_INFO(LOG_MODULE_LED, "Rendering a %d minute sunrise with preset %s and seed %u", duration_minutes, preset,
+             (unsigned)seed);
+    return true;
+}
+
+// Composites and encodes the next frame into the pending buffer the same way
+// LEDController::output_frame() reduces it, with one dither pass per frame
+bool FrameRecorder::render_frame()
+{
+    FrameRender &session = *render_session;
+    uint32_t hold;
+    {
+        RandomScope random_scope;
+        uint16_t outside = random16_get_seed();
+        random16_set_seed(session.random_seed);
+        hold = SunriseCompositor::render(session.composition, session.now);
+        session.random_seed = random16_get_seed();
+        random16_set_seed(outside);
+    }
+    if (!SunriseCompositor::is_playing(session.composition))
+        return false;
+
+    int num_leds = session.composition.num_leds;
+    if (TemporalDither::peak_level(session.frame, num_leds) >= DITHER_MAX_LEVEL)
+        TemporalDither::quantize(session.frame, session.leds, num_leds);
+    else
+        TemporalDither::dither(session.frame, session.dither_error, session.leds, num_leds);
+
+    session.pending_length = encode(session.encoder, session.now, 255, session.leds, session.pending);
+    session.pending_position = 0;
+    session.now += hold;
+    return true;
+}
+
+// Fills buffer with the next bytes of the recording; 0 once it is complete
+size_t FrameRecorder::read_render(uint8_t *buffer, size_t length)
+{
+    if (render_session == nullptr)
+        return 0;
+
+    FrameRender &session = *render_session;
+    size_t written = 0;
+    while (written < length)
+    {
+        if (session.pending_position < session.pending_length)
+        {
+            size_t chunk = min(length - written, session.pending_length - session.pending_position);
+            memcpy(buffer + written, session.pending + session.pending_position, chunk);
+            session.pending_position += chunk;
+            written += chunk;
+            continue;
+        }
+        if (session.finished || !render_frame())
+        {
+            session.finished = true;
+            break;
+        }
+    }
+    return written;
+}
+
+void FrameRecorder::end_render()
+{
+    if (render_session == nullptr)
+        return;
+
+    FrameRender *session = render_session;
+    render_session = nullptr;
+    LOG_INFO(LOG_MODULE_LED, "Sunrise render stopped at %lu ms", (unsigned long)session->now);
+    SunriseCompositor::release(session->composition);
+    free_encoder(session->encoder);
+    delete[] session->pending;
+    delete[] session->dither_error;
+    delete[] session->leds;
+    delete[] session->frame;
+    delete session;
+}
+
+RandomScope::RandomScope()
+{
+    random_mutex.lock();
+}
+
+RandomScope::~RandomScope()
+{
+    random_mutex.unlock();
+}
+
+bool FrameRecorder::mount()
+{
+    static bool mounted = false;
+    if (!mounted)
+    {
+        mounted = LittleFS.begin(true);
+    }
+    return mounted;
+}
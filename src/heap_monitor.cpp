@@ -0,0 +1,144 @@
+#include "heap_monitor.h"
+#include "metrics.h"
+#include <esp_heap_caps.h>
+
+struct SubsystemHeapStats
+{
+    uint32_t scopes;
+    int32_t retained_bytes;      // Left allocated by the last scope
+    int32_t retained_blocks;
+    uint32_t largest_block_drop; // Most the largest free block shrank across one scope
+};
+
+static SubsystemHeapStats subsystem_stats[HEAP_SUBSYSTEM_COUNT];
+static size_t largest_block_min = SIZE_MAX;
+static volatile uint32_t alloc_failures = 0;
+
+template <typename T>
+static void append_per_subsystem(TextWriter &out, const char *name, const char *type, const char *help,
+                                 T SubsystemHeapStats::*field)
+{
+    Metrics::family(out, name, type, help);
+    for (int i = 0; i < HEAP_SUBSYSTEM_COUNT; i++)
+        Metrics::sample(out, name, "subsystem", HeapMonitor::subsystem_name((HeapSubsystem)i), subsystem_stats[i].*field);
+}
+
+static float fragmentation(const multi_heap_info_t &info)
+{
+    if (info.total_free_bytes == 0)
+        return 0;
+    return 1.0f - (float)info.largest_free_block / info.total_free_bytes;
+}
+
+void HeapMonitor::begin()
+{
+    heap_caps_register_failed_alloc_callback(alloc_failed);
+    sample();
+}
+
+// Keeps the smallest largest free block; the heap only tracks the minimum free size itself
+void HeapMonitor::sample()
+{
+    size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    if (largest < largest_block_min)
+        largest_block_min = largest;
+}
+
+void HeapMonitor::record_scope(HeapSubsystem subsystem, size_t free_before, size_t largest_before, size_t blocks_before)
+{
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+
+    SubsystemHeapStats &stats = subsystem_stats[subsystem];
+    stats.scopes++;
+    stats.retained_bytes = (int32_t)free_before - (int32_t)info.total_free_bytes;
+    stats.retained_blocks = (int32_t)info.allocated_blocks - (int32_t)blocks_before;
+    if (info.largest_free_block < largest_before)
+        stats.largest_block_drop = max(stats.largest_block_drop, (uint32_t)(largest_before - info.largest_free_block));
+    if (info.largest_free_block < largest_block_min)
+        largest_block_min = info.largest_free_block;
+}
+
+// Runs in whichever task failed to allocate, so it only counts
+void HeapMonitor::alloc_failed(size_t, uint32_t, const char *)
+{
+    alloc_failures++;
+}
+
+void HeapMonitor::append_metrics(TextWriter &out)
+{
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+    sample();
+
+    Metrics::gauge(out, "sunrise_free_heap_bytes", "Free heap", info.total_free_bytes);
+    Metrics::gauge(out, "sunrise_free_heap_min_bytes", "Lowest free heap since boot", info.minimum_free_bytes);
+    Metrics::gauge(out, "sunrise_heap_largest_free_block_bytes", "Largest block the heap can allocate", info.largest_free_block);
+    Metrics::gauge(out, "sunrise_heap_largest_free_block_min_bytes", "Smallest largest free block seen since boot", largest_block_min);
+    Metrics::gauge(out, "sunrise_heap_fragmentation_ratio", "Share of the free heap outside the largest free block", fragmentation(info));
+    Metrics::gauge(out, "sunrise_heap_allocated_blocks", "Blocks currently allocated from the heap", info.allocated_blocks);
+    Metrics::counter(out, "sunrise_heap_alloc_failures_total", "Allocations the heap could not satisfy since boot", alloc_failures);
+    append_per_subsystem(out, "sunrise_heap_scopes_total", "counter", "Units of work measured since boot",
+                         &SubsystemHeapStats::scopes);
+    append_per_subsystem(out, "sunrise_heap_retained_bytes", "gauge", "Heap bytes the last unit of work left allocated",
+                         &SubsystemHeapStats::retained_bytes);
+    append_per_subsystem(out, "sunrise_heap_retained_blocks", "gauge", "Heap blocks the last unit of work left allocated",
+                         &SubsystemHeapStats::retained_blocks);
+    append_per_subsystem(out, "sunrise_heap_largest_block_drop_bytes", "gauge",
+                         "Most one unit of work shrank the largest free block since boot", &SubsystemHeapStats::largest_block_drop);
+}
+
+// For /api/debug/heap and tools/heap_endurance.py
+void HeapMonitor::to_json(JsonObject out)
+{
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+    sample();
+
+    out["free"] = info.total_free_bytes;
+    out["free_min"] = info.minimum_free_bytes;
+    out["largest_free_block"] = info.largest_free_block;
+    out["largest_free_block_min"] = largest_block_min;
+    out["fragmentation"] = fragmentation(info);
+    out["allocated_blocks"] = info.allocated_blocks;
+    out["alloc_failures"] = alloc_failures;
+
+    JsonObject subsystems = out["subsystems"].to<JsonObject>();
+    for (int i = 0; i < HEAP_SUBSYSTEM_COUNT; i++)
+    {
+        JsonObject entry = subsystems[subsystem_name((HeapSubsystem)i)].to<JsonObject>();
+        entry["scopes"] = subsystem_stats[i].scopes;
+        entry["retained_bytes"] = subsystem_stats[i].retained_bytes;
+        entry["retained_blocks"] = subsystem_stats[i].retained_blocks;
+        entry["largest_block_drop"] = subsystem_stats[i].largest_block_drop;
+    }
+}
+
+const char *HeapMonitor::subsystem_name(HeapSubsystem subsystem)
+{
+    switch (subsystem)
+    {
+    case HEAP_WEB:
+        return "web";
+    case HEAP_SYNC:
+        return "sync";
+    case HEAP_REALTIME:
+        return "realtime";
+    default:
+        return "unknown";
+    }
+}
+
+HeapScope::HeapScope(HeapSubsystem subsystem) : subsystem(subsystem)
+{
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+    free_before = info.total_free_bytes;
+    largest_before = info.largest_free_block;
+    blocks_before = info.allocated_blocks;
+}
+
+HeapScope::~HeapScope()
+{
+    HeapMonitor::record_scope(subsystem, free_before, largest_before, blocks_before);
+}
@@ -0,0 +1,245 @@
+#include "input_engine.h"
+#include "led_controller.h"
+#include "stall_monitor.h"
+#include "metrics.h"
+#include "logger.h"
+#include "config.h"
+#include <atomic>
+#include <esp_timer.h>
+#include <soc/gpio_reg.h>
+
+static_assert((INPUT_QUEUE_SIZE & (INPUT_QUEUE_SIZE - 1)) == 0, "INPUT_QUEUE_SIZE must be a power of two");
+static_assert(BUTTON_PIN < 32, "read_button() reads BUTTON_PIN from GPIO_IN_REG");
+
+struct ButtonEdge
+{
+    uint32_t timestamp_us; // Low 32 bits of esp_timer_get_time()
+    bool pressed;
+};
+
+enum GestureState : uint8_t
+{
+    GESTURE_STATE_IDLE,
+    GESTURE_STATE_DOWN,        // First press held
+    GESTURE_STATE_UP,          // Released; pressing again now makes a double press
+    GESTURE_STATE_WAIT_RELEASE // Gesture already decided, or the button was held at boot
+};
+
+static ButtonEdge edge_queue[INPUT_QUEUE_SIZE];
+// Free-running positions; only the ISR writes the head and only poll() the tail
+static std::atomic<uint32_t> edge_head(0);
+static std::atomic<uint32_t> edge_tail(0);
+
+// Owned by poll() in the esp_timer task
+static esp_timer_handle_t poll_timer = nullptr;
+static GestureState gesture_state = GESTURE_STATE_IDLE;
+static uint32_t last_edge_us = 0;   // Any edge, bounce or not
+static uint32_t last_change_us = 0; // Last accepted change of the debounced state
+static uint32_t state_since_us = 0;
+
+static std::atomic<uint32_t> unanswered_press_us(0); // 0 once the latest press has been answered
+static std::atomic<uint8_t> pending_gesture(GESTURE_NONE);
+
+volatile bool InputEngine::stable_pressed = false;
+TaskHandle_t InputEngine::notify_task = nullptr;
+
+RTC_DATA_ATTR static uint32_t rtc_presses_total = 0;
+RTC_DATA_ATTR static uint32_t rtc_bounces_total = 0;
+RTC_DATA_ATTR static uint32_t rtc_edges_lost_total = 0;
+RTC_DATA_ATTR static uint32_t rtc_gestures_total[4] = {0, 0, 0, 0};
+RTC_DATA_ATTR static uint32_t rtc_reactions_total = 0;
+RTC_DATA_ATTR static uint32_t rtc_slow_reactions_total = 0;
+RTC_DATA_ATTR static uint32_t rtc_last_latency_us = 0;
+RTC_DATA_ATTR static uint32_t rtc_max_latency_us = 0;
+
+// The register instead of digitalRead(), which is not guaranteed to be in IRAM. The button pulls the pin low.
+static inline bool IRAM_ATTR read_button()
+{
+    return (REG_READ(GPIO_IN_REG) & (1UL << BUTTON_PIN)) == 0;
+}
+
+// Called at the start of setup(), so the loop task is the one wait() wakes
+void InputEngine::begin()
+{
+    notify_task = xTaskGetCurrentTaskHandle();
+    pinMode(BUTTON_PIN, INPUT_PULLUP);
+
+    // A button that woke the device may still be held; that press was the wake, not a gesture
+    stable_pressed = read_button();
+    gesture_state = stable_pressed ? GESTURE_STATE_WAIT_RELEASE : GESTURE_STATE_IDLE;
+    last_change_us = last_edge_us = (uint32_t)esp_timer_get_time();
+
+    attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), button_isr, CHANGE);
+
+    esp_timer_create_args_t args = {};
+    args.callback = poll;
+    args.name = "input";
+    if (esp_timer_create(&args, &poll_timer) != ESP_OK ||
+        esp_timer_start_periodic(poll_timer, INPUT_POLL_MS * 1000) != ESP_OK)
+    {
+        LOG_ERROR(LOG_MODULE_SYSTEM, "Input timer could not be started");
+    }
+}
+
+void IRAM_ATTR InputEngine::button_isr()
+{
+    uint32_t head = edge_head.load(std::memory_order_relaxed);
+    if (head - edge_tail.load(std::memory_order_acquire) >= INPUT_QUEUE_SIZE)
+    {
+        // poll() reads the pin once the bounce is over, so a lost edge costs a few ms at most
+        rtc_edges_lost_total++;
+        return;
+    }
+    ButtonEdge &edge = edge_queue[head & (INPUT_QUEUE_SIZE - 1)];
+    edge.timestamp_us = (uint32_t)esp_timer_get_time();
+    edge.pressed = read_button();
+    edge_head.store(head + 1, std::memory_order_release);
+}
+
+void InputEngine::poll(void *)
+{
+    const uint32_t debounce_us = BUTTON_DEBOUNCE_MS * 1000UL;
+
+    // The first edge of a bounce changes the state at once; the rest are dropped
+    uint32_t tail = edge_tail.load(std::memory_order_relaxed);
+    uint32_t head = edge_head.load(std::memory_order_acquire);
+    for (; tail != head; tail++)
+    {
+        ButtonEdge edge = edge_queue[tail & (INPUT_QUEUE_SIZE - 1)];
+        last_edge_us = edge.timestamp_us;
+        if (edge.pressed != stable_pressed && edge.timestamp_us - last_change_us >= debounce_us)
+            change_state(edge.pressed, edge.timestamp_us);
+        else
+            rtc_bounces_total++;
+    }
+    edge_tail.store(tail, std::memory_order_release);
+
+    // Once the pin has been quiet for the debounce time its level is the truth,
+    // which catches a release that came during the bounce of a short tap
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    if (now - last_edge_us >= debounce_us && now - last_change_us >= debounce_us && read_button() != stable_pressed)
+        change_state(!stable_pressed, now);
+
+    if (gesture_state == GESTURE_STATE_DOWN && now - state_since_us >= BUTTON_LONG_PRESS_MS * 1000UL)
+    {
+        gesture_state = GESTURE_STATE_WAIT_RELEASE;
+        emit(GESTURE_LONG);
+    }
+    else if (gesture_state == GESTURE_STATE_UP && now - state_since_us >= BUTTON_DOUBLE_PRESS_MS * 1000UL)
+    {
+        gesture_state = GESTURE_STATE_IDLE;
+        emit(GESTURE_SHORT);
+    }
+}
+
+void InputEngine::change_state(bool pressed, uint32_t at_us)
+{
+    stable_pressed = pressed;
+    last_change_us = at_us;
+
+    if (pressed)
+    {
+        rtc_presses_total++;
+        unanswered_press_us.store(at_us != 0 ? at_us : 1);
+        if (gesture_state == GESTURE_STATE_UP)
+        {
+            gesture_state = GESTURE_STATE_WAIT_RELEASE;
+            emit(GESTURE_DOUBLE);
+        }
+        else if (gesture_state == GESTURE_STATE_IDLE)
+        {
+            gesture_state = GESTURE_STATE_DOWN;
+            state_since_us = at_us;
+        }
+    }
+    else if (gesture_state == GESTURE_STATE_DOWN)
+    {
+        gesture_state = GESTURE_STATE_UP;
+        state_since_us = at_us;
+    }
+    else if (gesture_state == GESTURE_STATE_WAIT_RELEASE)
+    {
+        gesture_state = GESTURE_STATE_IDLE;
+    }
+
+    xTaskNotifyGive(notify_task);
+}
+
+// A running sunrise is dismissed or snoozed from here, as the loop task is
+// busy playing it. Everything else waits for take_gesture().
+void InputEngine::emit(InputGesture gesture)
+{
+    rtc_gestures_total[gesture]++;
+    LOG_INFO(LOG_MODULE_SYSTEM, "Button: %s press", gesture_name(gesture));
+
+    if (LEDController::is_alarm_running() && gesture != GESTURE_DOUBLE)
+        LEDController::dismiss_alarm(gesture == GESTURE_LONG ? DISMISS_SNOOZE : DISMISS_BUTTON);
+    else
+        pending_gesture.store(gesture);
+
+    xTaskNotifyGive(notify_task);
+}
+
+// Returns the time of a press nothing has answered yet, once
+bool InputEngine::take_press(uint32_t &pressed_at_us)
+{
+    pressed_at_us = unanswered_press_us.exchange(0);
+    return pressed_at_us != 0;
+}
+
+// Called right after the LEDs showed the answer to a press from take_press()
+void InputEngine::record_reaction(uint32_t pressed_at_us)
+{
+    uint32_t latency = (uint32_t)esp_timer_get_time() - pressed_at_us;
+    rtc_last_latency_us = latency;
+    rtc_max_latency_us = max(rtc_max_latency_us, latency);
+    rtc_reactions_total++;
+    if (latency > INPUT_LATENCY_BUDGET_MS * 1000UL)
+    {
+        rtc_slow_reactions_total++;
+        LOG_WARN(LOG_MODULE_SYSTEM, "Button press answered after %lu ms", (unsigned long)(latency / 1000));
+    }
+}
+
+InputGesture InputEngine::take_gesture()
+{
+    return (InputGesture)pending_gesture.exchange(GESTURE_NONE);
+}
+
+// delay() for the loop task that returns early when the button changes or a
+// gesture is recognized. Returns true if it did.
+bool InputEngine::wait(uint32_t timeout_ms)
+{
+    StallScope stall_scope(STALL_LOOP, STALL_TAG_LOOP_WAIT);
+    StallMonitor::beat(STALL_LOOP, timeout_ms);
+    return ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms)) > 0;
+}
+
+void InputEngine::append_metrics(TextWriter &out)
+{
+    Metrics::counter(out, "sunrise_button_presses_total", "Debounced button presses since power on", rtc_presses_total);
+    Metrics::counter(out, "sunrise_button_bounces_total", "Button edges dropped as contact bounce since power on", rtc_bounces_total);
+    Metrics::counter(out, "sunrise_button_edges_lost_total", "Button edges lost to a full input queue since power on", rtc_edges_lost_total);
+    Metrics::counter(out, "sunrise_button_short_presses_total", "Short presses (dismiss) since power on", rtc_gestures_total[GESTURE_SHORT]);
+    Metrics::counter(out, "sunrise_button_long_presses_total", "Long presses (snooze) since power on", rtc_gestures_total[GESTURE_LONG]);
+    Metrics::counter(out, "sunrise_button_double_presses_total", "Double presses (sync) since power on", rtc_gestures_total[GESTURE_DOUBLE]);
+    Metrics::counter(out, "sunrise_button_reactions_total", "Presses answered on the LEDs since power on", rtc_reactions_total);
+    Metrics::counter(out, "sunrise_button_slow_reactions_total", "Presses answered later than INPUT_LATENCY_BUDGET_MS", rtc_slow_reactions_total);
+    Metrics::gauge(out, "sunrise_button_latency_us", "Time from the last answered press to its answer on the LEDs", rtc_last_latency_us);
+    Metrics::gauge(out, "sunrise_button_latency_max_us", "Longest time from a press to its answer on the LEDs since power on", rtc_max_latency_us);
+}
+
+const char *InputEngine::gesture_name(InputGesture gesture)
+{
+    switch (gesture)
+    {
+    case GESTURE_SHORT:
+        return "short";
+    case GESTURE_LONG:
+        return "long";
+    case GESTURE_DOUBLE:
+        return "double";
+    default:
+        return "none";
+    }
+}
@@ -1,24 +1,42 @@
 #include "led_controller.h"
+#include "energy_model.h"
+#include "temporal_dither.h"
+#include "frame_recorder.h"
+#include "stall_monitor.h"
+#include "input_engine.h"
+#include "metrics.h"
 #include "logger.h"
 #include "config.h"
 
 CRGB *LEDController::leds = nullptr;
+CRGB16 *LEDController::frame = nullptr;
+uint16_t *LEDController::dither_error = nullptr;
 int LEDController::num_leds = NUM_LEDS;
 bool LEDController::initialized = false;
 bool LEDController::alarm_running = false;
-bool LEDController::dismiss_requested = false;
+bool LEDController::dither_enabled = true;
+Composition LEDController::composition;
+
+RTC_DATA_ATTR static uint32_t rtc_dither_refreshes_total = 0;
+RTC_DATA_ATTR static uint32_t rtc_dither_pass_us = 0;
+RTC_DATA_ATTR static uint32_t rtc_dither_over_budget_total = 0;
+static uint32_t composite_us = 0;
+static int composite_lit_leds = 0;
 
 void LEDController::init()
 {
     if (!initialized)
     {
         leds = new CRGB[num_leds];
+        frame = new CRGB16[num_leds];
+        dither_error = new uint16_t[num_leds * 3];
+        SunriseCompositor::begin_strip(composition, frame, num_leds);
         FastLED.addLeds<LED_TYPE, LED_PIN, COLOR_ORDER>(leds, num_leds);
         FastLED.setBrightness(50);
         FastLED.clear();
-        FastLED.show();
+        show();
         initialized = true;
-        WEB_LOG("LED strip initialized");
+        LOG_INFO(LOG_MODULE_LED, "LED strip initialized");
     }
 }
 
@@ -27,7 +45,7 @@ void LEDController::clear()
     if (initialized)
     {
         FastLED.clear();
-        FastLED.show();
+        show();
     }
 }
 
@@ -36,40 +54,55 @@ void LEDController::show_status_indicator()
     init();
     leds[0] = CRGB::Blue;
     FastLED.setBrightness(50);
-    FastLED.show();
-    delay(100);
+    show();
+    InputEngine::wait(100);
     clear();
 }
 
-void LEDController::show_button_feedback()
+// The answer to a press outside a sunrise; cut short by the next press or release
+void LEDController::show_button_feedback(uint32_t pressed_at_us)
 {
+    StallScope stall_scope(STALL_LOOP, STALL_TAG_BUTTON_FEEDBACK);
     init();
     fill_solid(leds, num_leds, CRGB::Blue);
     FastLED.setBrightness(100);
-    FastLED.show();
-    delay(200);
+    show();
+    InputEngine::record_reaction(pressed_at_us);
+    InputEngine::wait(200);
     clear();
 }
 
+// Called for every received chunk, so the bar is only redrawn when it grows
+// and at most every OTA_PROGRESS_INTERVAL_MS, except for the last LED
 void LEDController::show_ota_progress(unsigned int progress, unsigned int total)
 {
+    static int shown_progress = -1;
+    static uint32_t shown_at = 0;
+
     init();
-    int led_progress = (progress * num_leds) / total;
+    int led_progress = total > 0 ? (uint64_t)progress * num_leds / total : 0;
+    uint32_t now = millis();
+    if (led_progress == shown_progress || (led_progress < num_leds && now - shown_at < OTA_PROGRESS_INTERVAL_MS))
+        return;
+    shown_progress = led_progress;
+    shown_at = now;
+
     FastLED.clear();
     for (int i = 0; i < led_progress; i++)
     {
         leds[i] = CRGB::Blue;
     }
-    FastLED.show();
+    show();
 }
 
 void LEDController::show_ota_error()
 {
+    StallScope stall_scope(STALL_LOOP, STALL_TAG_OTA_ERROR);
     init();
     for (int i = 0; i < 3; i++)
     {
         fill_solid(leds, num_leds, CRGB::Red);
-        FastLED.show();
+        show();
         delay(200);
         clear();
         delay(200);
@@ -79,207 +112,250 @@ void LEDController::show_ota_error()
 void LEDController::run_test_animation()
 {
     init();
-    WEB_LOG("Running LED test animation");
+    LOG_INFO(LOG_MODULE_LED, "Running LED test animation");
 
     for (int hue = 0; hue < 256; hue += 4)
     {
         fill_rainbow(leds, num_leds, hue, 256 / num_leds);
-        FastLED.show();
+        show();
         delay(50);
     }
     clear();
 }
 
-void LEDController::run_sunrise_animation(ColorPreset &preset, int duration_ms, int max_brightness)
+SunriseInstance *LEDController::claim_sunrise()
 {
-    unsigned long start_time = millis();
-    unsigned long last_update = start_time;
-
-    DEBUG_PRINTLN("Starting advanced sunrise animation...");
     init();
-    alarm_running = true;
-    dismiss_requested = false;
+    return SunriseCompositor::claim(composition);
+}
 
-    while (millis() - start_time < duration_ms && !dismiss_requested)
+// The first sunrise starts on a dark frame; later ones join it
+void LEDController::start_sunrise(SunriseInstance &sunrise)
+{
+    if (!alarm_running)
     {
-        float progress = (float)(millis() - start_time) / (float)duration_ms;
-        if (progress > 1.0)
-            progress = 1.0;
-
-        CRGB current_color = blend_multiple_colors(preset.stages, preset.stage_count, progress);
-
-        float breathing_multiplier = 1.0f;
-        add_breathing_effect(progress, breathing_multiplier);
-
-        float brightness_progress = ease8InOutQuad(progress * 255) / 255.0f;
-        int brightness = (int)(brightness_progress * max_brightness * breathing_multiplier);
-        FastLED.setBrightness(brightness);
-
-        fill_solid(leds, num_leds, current_color);
-
-        if (progress > 0.3f && progress < 0.8f)
-        {
-            add_sparkle_effect(current_color, (progress - 0.3f) * 2.0f);
-        }
-
-        if (progress > 0.5f)
+        LOG_DEBUG(LOG_MODULE_LED, "Starting sunrise scene...");
+        memset(frame, 0, num_leds * sizeof(CRGB16));
+        dither_enabled = true;
         {
-            add_warmth_gradient(progress);
+            RandomScope random_scope;
+            FrameRecorder::start(num_leds);
+            TemporalDither::reset(dither_error, num_leds);
         }
+        FastLED.setBrightness(255);
+        alarm_running = true;
+    }
+    SunriseCompositor::start(composition, sunrise, millis());
+}
 
-        if (preset.name == "ocean")
-        {
-            add_wave_effect(current_color, progress);
-        }
-
-        FastLED.show();
-
-        int update_delay = (int)(50 + 450 * (1.0f - 4.0f * progress * (1.0f - progress)));
-        delay(update_delay);
+// Composites and shows one frame of every playing sunrise; scenes are
+// described in include/sunrise_scene.h. Returns false and clears the strip
+// once the last sunrise has ended.
+bool LEDController::play_frame()
+{
+    if (!alarm_running)
+        return false;
 
-        if ((int)(progress * 10) > (int)(((float)(last_update - start_time) / (float)duration_ms) * 10))
-        {
-            DEBUG_PRINT("Animation progress: ");
-            DEBUG_PRINT((int)(progress * 100));
-            DEBUG_PRINTLN("%");
-            last_update = millis();
-        }
+    uint32_t hold;
+    {
+        RandomScope random_scope;
+        uint32_t start = micros();
+        hold = SunriseCompositor::render(composition, millis());
+        composite_us = micros() - start;
     }
-
-    if (dismiss_requested)
+    if (!SunriseCompositor::is_playing(composition))
     {
-        DEBUG_PRINTLN("Alarm dismissed by user");
         clear();
+        FrameRecorder::stop();
+        StallMonitor::pause(STALL_RENDER);
         alarm_running = false;
-        dismiss_requested = false;
-        return;
+        return false;
     }
+    StallMonitor::beat(STALL_RENDER, hold);
 
-    DEBUG_PRINTLN("Main animation complete - entering daylight phase");
+    composite_lit_leds = SunriseCompositor::lit_leds(composition);
+    output_frame(hold);
+    return true;
+}
 
-    CRGB final_color = preset.stages[preset.stage_count - 1].color;
-    FastLED.setBrightness(max_brightness);
+SunriseInstance *LEDController::take_ended_sunrise()
+{
+    return SunriseCompositor::take_ended(composition);
+}
 
-    for (int minute = 0; minute < 5 && !dismiss_requested; minute++)
+// Shows the frame and holds it for hold_ms. Dim frames are dithered and
+// refreshed every DITHER_REFRESH_MS meanwhile; once the brightest channel
+// reaches DITHER_MAX_LEVEL a step of one is too small to see, and the frame
+// is rounded and shown once. A dither pass over DITHER_BUDGET_US (a very
+// long strip) turns dithering off for the rest of the alarm. Holds end early
+// on button input, so the next frame answers it.
+void LEDController::output_frame(uint32_t hold_ms)
+{
+    if (!dither_enabled || TemporalDither::peak_level(frame, num_leds) >= DITHER_MAX_LEVEL)
     {
-        for (int second = 0; second < 60 && !dismiss_requested; second++)
-        {
-            float variation = 0.95f + 0.1f * sin(millis() * 0.001f);
-            FastLED.setBrightness((int)(max_brightness * variation));
+        TemporalDither::quantize(frame, leds, num_leds);
+        present();
+        InputEngine::wait(hold_ms);
+        return;
+    }
 
-            CRGB day_color = final_color;
-            day_color.r = min(255, (int)(day_color.r * (0.98f + 0.04f * sin(millis() * 0.0005f))));
+    uint32_t start = millis();
+    while (true)
+    {
+        uint32_t pass_start = micros();
+        TemporalDither::dither(frame, dither_error, leds, num_leds);
+        rtc_dither_pass_us = micros() - pass_start;
+        rtc_dither_refreshes_total++;
+        present();
 
-            fill_solid(leds, num_leds, day_color);
-            FastLED.show();
-            delay(1000);
+        if (rtc_dither_pass_us > DITHER_BUDGET_US)
+        {
+            LOG_WARN(LOG_MODULE_LED, "Dither pass took %lu us, rounding frames instead", (unsigned long)rtc_dither_pass_us);
+            rtc_dither_over_budget_total++;
+            dither_enabled = false;
         }
 
-        DEBUG_PRINT("Daylight phase: ");
-        DEBUG_PRINT(minute + 1);
-        DEBUG_PRINTLN("/5 minutes");
+        uint32_t spent = millis() - start;
+        if (spent >= hold_ms || SunriseCompositor::dismiss_pending(composition))
+            return;
+        if (!dither_enabled)
+        {
+            InputEngine::wait(hold_ms - spent);
+            return;
+        }
+        delay(min((uint32_t)DITHER_REFRESH_MS, hold_ms - spent));
     }
+}
+
+void LEDController::append_metrics(TextWriter &out)
+{
+    Metrics::counter(out, "sunrise_dither_refreshes_total", "Dithered refreshes of dim sunrise frames since power on", rtc_dither_refreshes_total);
+    Metrics::gauge(out, "sunrise_dither_pass_us", "Duration of the last dither pass over the strip", rtc_dither_pass_us);
+    Metrics::counter(out, "sunrise_dither_over_budget_total", "Alarms that stopped dithering because a pass exceeded DITHER_BUDGET_US", rtc_dither_over_budget_total);
+    Metrics::gauge(out, "sunrise_composite_us", "Duration of the last composited sunrise frame", composite_us);
+    Metrics::gauge(out, "sunrise_composite_lit_leds", "LEDs drawn by the sunrises playing in the last composited frame", composite_lit_leds);
+}
 
-    if (dismiss_requested)
+// Renders sunrise frames for a strip of `count` LEDs into a scratch buffer,
+// timing the layout build and the per-frame cost without touching the strip
+void LEDController::benchmark_render(int count, int rows, int origin, int frames, RenderBenchmark &result)
+{
+    static const ColorPreset white = {{{CRGB(0, 0, 0), 1.0f}, {CRGB(255, 255, 255), 0.0f}}, 2, "benchmark", 0, 0};
+    SunriseLut *curve = new SunriseLut;
+    SunriseCurve::compile(white, *curve);
+
+    CRGB16 *buffer = new CRGB16[count];
+    CRGB *output = new CRGB[count];
+    uint16_t *error = new uint16_t[count * 3];
+    TemporalDither::reset(error, count);
+    SunriseLayout layout = {nullptr, count, 1};
+
+    uint32_t start = micros();
+    SunriseCurve::build_layout(count, rows, origin, layout);
+    result.layout_us = micros() - start;
+
+    start = micros();
+    for (int frame = 0; frame < frames; frame++)
     {
-        DEBUG_PRINTLN("Alarm dismissed during daylight phase");
-        clear();
-        alarm_running = false;
-        dismiss_requested = false;
-        return;
+        SunriseCurve::render(*curve, layout, (float)frame / frames, 255, buffer);
     }
+    result.frame_us = (float)(micros() - start) / frames;
+    result.bands = layout.band_count;
 
-    DEBUG_PRINTLN("Starting fade out...");
-    for (int brightness = max_brightness; brightness >= 0; brightness -= 2)
+    start = micros();
+    for (int frame = 0; frame < frames; frame++)
     {
-        FastLED.setBrightness(brightness);
-        FastLED.show();
-        delay(50);
+        TemporalDither::dither(buffer, error, output, count);
     }
+    result.dither_us = (float)(micros() - start) / frames;
 
-    clear();
-    alarm_running = false;
-    DEBUG_PRINTLN("Sunrise alarm completed");
-}
-
-void LEDController::dismiss_alarm()
-{
-    dismiss_requested = true;
-    WEB_LOG("Alarm dismiss requested");
+    SunriseCurve::free_layout(layout);
+    delete[] buffer;
+    delete[] output;
+    delete[] error;
+    delete curve;
 }
 
-CRGB LEDController::blend_multiple_colors(SunriseStage stages[], int stage_count, float progress)
+// Plays `zones` sunrises at once on a scratch strip of `count` LEDs, with
+// `lit` of them inside a zone, and times the composited frames. Zones split
+// the lit LEDs evenly; with overlap each one also reaches halfway into the
+// next, so the shared LEDs go through the layer.
+void LEDController::benchmark_composite(int count, int zones, int lit, bool overlap, int frames, CompositeBenchmark &result)
 {
-    if (progress <= 0.0f)
-        return stages[0].color;
-    if (progress >= 1.0f)
-        return stages[stage_count - 1].color;
-
-    float accumulated = 0.0f;
-    for (int i = 0; i < stage_count - 1; i++)
+    static const ColorPreset white = {{{CRGB(0, 0, 0), 1.0f}, {CRGB(255, 255, 255), 0.0f}}, 2, "benchmark", 0, 0};
+    zones = constrain(zones, 1, MAX_CONCURRENT_SUNRISES);
+    lit = constrain(lit, zones, count);
+
+    CRGB16 *buffer = new CRGB16[count];
+    memset(buffer, 0, count * sizeof(CRGB16));
+    Composition *bench = new Composition;
+    SunriseCompositor::begin(*bench, buffer, count, zones);
+    int width = lit / zones;
+    for (int i = 0; i < zones; i++)
     {
-        float stage_end = accumulated + stages[i].duration_percent;
-        if (progress <= stage_end)
-        {
-            float local_progress = (progress - accumulated) / stages[i].duration_percent;
-            uint8_t blend_amount = ease8InOutQuad(local_progress * 255);
-            return blend(stages[i].color, stages[i + 1].color, blend_amount);
-        }
-        accumulated = stage_end;
+        int length = i == zones - 1 ? lit - width * i : width;
+        if (overlap && i < zones - 1)
+            length += width / 2;
+        SunriseCompositor::add_zone(*bench, width * i, length, 1, SUNRISE_ORIGIN_CENTER);
     }
-    return stages[stage_count - 1].color;
-}
 
-void LEDController::add_sparkle_effect(CRGB base_color, float intensity)
-{
-    int sparkle_count = (int)(num_leds * 0.1f * intensity);
+    uint32_t now = millis();
+    for (int i = 0; i < zones; i++)
+    {
+        SunriseInstance *sunrise = SunriseCompositor::claim(*bench);
+        sunrise->alarm_id = 0;
+        sunrise->zone = i;
+        sunrise->preset = white;
+        sunrise->duration_ms = 60000;
+        sunrise->max_brightness = 255;
+        if (i == 0)
+            SunriseCurve::compile(white, *sunrise->curve);
+        else
+            *sunrise->curve = *bench->instances[0].curve;
+        SunriseCompositor::start(*bench, *sunrise, now);
+    }
+    result.lit_leds = SunriseCompositor::lit_leds(*bench);
 
-    for (int i = 0; i < sparkle_count; i++)
+    uint32_t start = micros();
+    for (int frame = 0; frame < frames; frame++)
     {
-        int pos = random16(num_leds);
-        if (random8() < 50)
-        {
-            CRGB sparkle_color = base_color;
-            sparkle_color.r = min(255, sparkle_color.r + random8(50, 100));
-            sparkle_color.g = min(255, sparkle_color.g + random8(30, 70));
-            sparkle_color.b = min(255, sparkle_color.b + random8(20, 50));
-            leds[pos] = sparkle_color;
-        }
+        SunriseCompositor::render(*bench, now + frame * 60000 / frames);
     }
+    result.frame_us = (float)(micros() - start) / frames;
+    result.ns_per_lit_led = result.lit_leds > 0 ? result.frame_us * 1000.0f / result.lit_leds : 0.0f;
+
+    SunriseCompositor::release(*bench);
+    delete bench;
+    delete[] buffer;
 }
 
-void LEDController::add_breathing_effect(float progress, float &brightness_multiplier)
+// Called from InputEngine on the esp_timer task (the button ISR only queues edges),
+// so it only sets flags; the compositor logs the dismissal. Without a zone every
+// playing sunrise is dismissed.
+void LEDController::dismiss_alarm(DismissSource source, int zone)
 {
-    float breathing_intensity = 1.0f - (progress * 0.7f);
-    float breathing_cycle = sin(millis() * 0.002f) * breathing_intensity * 0.1f;
-    brightness_multiplier = 1.0f + breathing_cycle;
+    SunriseCompositor::dismiss(composition, source, zone);
 }
 
-void LEDController::add_warmth_gradient(float progress)
+// Sunrise frames go out through here. The strip dims while the button is held,
+// which answers a press before its gesture is known.
+void LEDController::present()
 {
-    int center_led = num_leds / 2;
-    float warmth_intensity = (progress - 0.5f) * 2.0f;
-
-    for (int i = 0; i < num_leds; i++)
-    {
-        float distance_from_center = abs(i - center_led) / (float)(num_leds / 2);
-        float warmth_factor = 1.0f - (distance_from_center * warmth_intensity * 0.3f);
-
-        leds[i].r = min(255, (int)(leds[i].r * (0.8f + warmth_factor * 0.4f)));
-        leds[i].g = min(255, (int)(leds[i].g * (0.9f + warmth_factor * 0.2f)));
-    }
+    uint32_t pressed_at_us;
+    bool answering = InputEngine::take_press(pressed_at_us);
+    if (InputEngine::is_pressed())
+        nscale8(leds, num_leds, 64);
+    show();
+    if (answering)
+        InputEngine::record_reaction(pressed_at_us);
 }
 
-void LEDController::add_wave_effect(CRGB base_color, float progress)
+// Every frame goes through here so the energy model sees each change in LED
+// power, and a recording each frame the strip showed
+void LEDController::show()
 {
-    unsigned long time = millis();
-    for (int i = 0; i < num_leds; i++)
-    {
-        float wave1 = sin((i * 0.1f) + (time * 0.003f)) * 0.2f;
-        float wave2 = sin((i * 0.05f) + (time * 0.002f)) * 0.1f;
-        float wave_effect = (wave1 + wave2) * progress;
-
-        leds[i].b = min(255, (int)(leds[i].b * (1.0f + wave_effect)));
-        leds[i].g = min(255, (int)(leds[i].g * (1.0f + wave_effect * 0.5f)));
-    }
+    FastLED.show();
+    if (FrameRecorder::is_recording())
+        FrameRecorder::record(millis(), FastLED.getBrightness(), leds);
+    EnergyModel::set_led_power(calculate_unscaled_power_mW(leds, num_leds) * FastLED.getBrightness() / 256);
 }
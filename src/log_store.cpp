@@ -0,0 +1,303 @@
+#include "log_store.h"
+#include "config.h"
+#include <LittleFS.h>
+#include <Preferences.h>
+
+static_assert(LOG_MAX_MESSAGE <= 255, "Stored log records use an 8-bit length");
+
+static const char *LOG_FILE_CURRENT = "/logs.bin";
+static const char *LOG_FILE_PREVIOUS = "/logs.old.bin";
+static const uint8_t LOG_FILE_MAGIC[4] = {'S', 'L', 'G', LOG_STORE_FORMAT}; // Starts every log file
+
+RTC_DATA_ATTR static uint8_t rtc_log_buffer[LOG_RTC_BUFFER_SIZE];
+RTC_DATA_ATTR static uint16_t rtc_log_used = 0;
+RTC_DATA_ATTR static uint8_t rtc_log_format = 0;
+RTC_DATA_ATTR static uint32_t rtc_next_sequence = 0;
+RTC_DATA_ATTR static uint32_t rtc_persist_us = 0;
+RTC_DATA_ATTR static uint32_t rtc_flushed_bytes = 0;
+
+uint32_t LogStore::boot_first_sequence = 1;
+
+// Leaves the file positioned at its first record
+static bool file_format_matches(File &file)
+{
+    uint8_t magic[sizeof(LOG_FILE_MAGIC)];
+    return file.read(magic, sizeof(magic)) == sizeof(magic) && memcmp(magic, LOG_FILE_MAGIC, sizeof(magic)) == 0;
+}
+
+uint32_t LogStore::restore_sequence()
+{
+    if (rtc_log_format != LOG_STORE_FORMAT)
+    {
+        rtc_log_used = 0;
+        rtc_log_format = LOG_STORE_FORMAT;
+    }
+
+    // RTC memory is reset on power loss; fall back to the sequence saved with the last flash batch
+    if (rtc_next_sequence == 0)
+    {
+        Preferences prefs;
+        if (prefs.begin("logstore", true))
+        {
+            rtc_next_sequence = prefs.getUInt("next_seq", 1);
+            prefs.end();
+        }
+        else
+        {
+            rtc_next_sequence = 1;
+        }
+    }
+
+    boot_first_sequence = rtc_next_sequence;
+    return boot_first_sequence;
+}
+
+void LogStore::persist(int boot)
+{
+    unsigned long start = micros();
+    rtc_flushed_bytes = 0;
+
+    Logger::flush();
+    uint32_t end = Logger::get_next_sequence();
+    LogEntry entry;
+
+    for (uint32_t sequence = boot_first_sequence; sequence != end; sequence++)
+    {
+        if (Logger::read_record(sequence, entry) != LOG_READ_OK)
+            continue;
+
+        StoredLogHeader header;
+        header.sequence = entry.sequence;
+        header.wall_time = (uint32_t)Logger::to_wall_time(entry.timestamp_us);
+        header.boot = (uint16_t)boot;
+        header.level = entry.level;
+        header.module = entry.module;
+        header.length = (uint8_t)strlen(entry.text);
+        append_record(header, entry.text);
+    }
+
+    rtc_next_sequence = end;
+    boot_first_sequence = end;
+    rtc_persist_us = micros() - start;
+}
+
+void LogStore::append_record(const StoredLogHeader &header, const char *text)
+{
+    size_t size = sizeof(header) + header.length;
+    if (rtc_log_used + size > sizeof(rtc_log_buffer))
+    {
+        // Without a working file system the oldest RTC records are dropped instead
+        if (!flush_rtc_to_flash())
+            drop_oldest_rtc(size);
+    }
+
+    memcpy(&rtc_log_buffer[rtc_log_used], &header, sizeof(header));
+    memcpy(&rtc_log_buffer[rtc_log_used + sizeof(header)], text, header.length);
+    rtc_log_used += size;
+}
+
+bool LogStore::flush_rtc_to_flash()
+{
+    if (rtc_log_used == 0)
+        return true;
+    if (!mount())
+        return false;
+
+    File current = LittleFS.open(LOG_FILE_CURRENT, FILE_READ);
+    size_t current_size = 0;
+    if (current)
+    {
+        current_size = current.size();
+        bool matches = file_format_matches(current);
+        current.close();
+        // Appending to records in another layout would make the whole file unreadable
+        if (current_size > 0 && !matches)
+        {
+            LittleFS.remove(LOG_FILE_CURRENT);
+            current_size = 0;
+        }
+    }
+
+    if (current_size + rtc_log_used > LOG_FILE_MAX_SIZE)
+    {
+        LittleFS.remove(LOG_FILE_PREVIOUS);
+        LittleFS.rename(LOG_FILE_CURRENT, LOG_FILE_PREVIOUS);
+        current_size = 0;
+    }
+
+    File file = LittleFS.open(LOG_FILE_CURRENT, FILE_APPEND);
+    if (!file)
+        return false;
+
+    if (current_size == 0 && file.write(LOG_FILE_MAGIC, sizeof(LOG_FILE_MAGIC)) != sizeof(LOG_FILE_MAGIC))
+    {
+        file.close();
+        return false;
+    }
+    size_t written = file.write(rtc_log_buffer, rtc_log_used);
+    file.close();
+    if (written != rtc_log_used)
+        return false;
+
+    StoredLogHeader last = {};
+    uint16_t position = 0;
+    while (position + sizeof(last) <= rtc_log_used)
+    {
+        memcpy(&last, &rtc_log_buffer[position], sizeof(last));
+        position += sizeof(last) + last.length;
+    }
+
+    Preferences prefs;
+    if (prefs.begin("logstore", false))
+    {
+        prefs.putUInt("next_seq", last.sequence + 1);
+        prefs.end();
+    }
+
+    rtc_flushed_bytes += written;
+    rtc_log_used = 0;
+    return true;
+}
+
+// Drops whole records from the front of the RTC buffer until `needed` bytes fit
+void LogStore::drop_oldest_rtc(size_t needed)
+{
+    uint16_t position = 0;
+    StoredLogHeader oldest;
+    while (position + sizeof(oldest) <= rtc_log_used && rtc_log_used - position + needed > sizeof(rtc_log_buffer))
+    {
+        memcpy(&oldest, &rtc_log_buffer[position], sizeof(oldest));
+        position += sizeof(oldest) + oldest.length;
+    }
+    // Less than a header left over is not a record
+    if (position + sizeof(oldest) > rtc_log_used)
+        position = rtc_log_used;
+
+    memmove(rtc_log_buffer, &rtc_log_buffer[position], rtc_log_used - position);
+    rtc_log_used -= position;
+}
+
+bool LogStore::mount()
+{
+    static bool mounted = false;
+    if (!mounted)
+    {
+        mounted = LittleFS.begin(true);
+    }
+    return mounted;
+}
+
+void LogStore::log_last_persist_stats()
+{
+    if (rtc_persist_us == 0)
+        return;
+
+    LOG_INFO(LOG_MODULE_STORAGE, "Log persistence at last sleep: %lu us, %lu bytes written to flash, %u bytes held in RTC",
+             (unsigned long)rtc_persist_us, (unsigned long)rtc_flushed_bytes, rtc_log_used);
+}
+
+// Renders the LOG_PAGE_SIZE sequence numbers below `before`, oldest first,
+// drawing from flash files, the RTC buffer and the current boot in that order
+void LogStore::build_page_html(TextWriter &html, uint32_t before)
+{
+    uint32_t latest = Logger::get_next_sequence();
+    if (before == 0 || before > latest)
+        before = latest;
+    uint32_t first = before > LOG_PAGE_SIZE ? before - LOG_PAGE_SIZE : 0;
+
+    if (first < boot_first_sequence)
+    {
+        if (mount())
+        {
+            render_file(LOG_FILE_PREVIOUS, first, before, html);
+            render_file(LOG_FILE_CURRENT, first, before, html);
+        }
+        render_stored(rtc_log_buffer, rtc_log_used, first, before, html);
+    }
+
+    LogEntry entry;
+    for (uint32_t sequence = max(first, boot_first_sequence); sequence < before; sequence++)
+    {
+        if (Logger::read_record(sequence, entry) == LOG_READ_OK)
+        {
+            StoredLogHeader header = {sequence, 0, 0, entry.level, entry.module, (uint8_t)strlen(entry.text)};
+            render_line(header, Logger::to_wall_time(entry.timestamp_us), entry.text, html);
+        }
+    }
+
+    html.append("<div class='nav'>");
+    if (first > 1)
+        html.appendf("<a href='/logs?before=%lu'>&larr; Older</a> ", (unsigned long)first);
+    if (before < latest)
+        html.appendf("<a href='/logs?before=%lu'>Newer &rarr;</a>", (unsigned long)min(before + LOG_PAGE_SIZE, latest));
+    html.append("</div>");
+    html.appendf("<div class='log'>Log persistence at last sleep: %lu us, %lu bytes flushed to flash</div>",
+                 (unsigned long)rtc_persist_us, (unsigned long)rtc_flushed_bytes);
+}
+
+void LogStore::render_stored(const uint8_t *data, size_t length, uint32_t first, uint32_t before, TextWriter &html)
+{
+    size_t position = 0;
+    StoredLogHeader header;
+    while (position + sizeof(header) <= length)
+    {
+        memcpy(&header, &data[position], sizeof(header));
+        const char *text = (const char *)&data[position + sizeof(header)];
+        if (header.sequence >= first && header.sequence < before)
+        {
+            render_line(header, header.wall_time, text, html);
+        }
+        position += sizeof(header) + header.length;
+    }
+}
+
+void LogStore::render_file(const char *path, uint32_t first, uint32_t before, TextWriter &html)
+{
+    File file = LittleFS.open(path, FILE_READ);
+    if (!file)
+        return;
+    if (!file_format_matches(file))
+    {
+        file.close();
+        return;
+    }
+
+    StoredLogHeader header;
+    char text[256];
+    while (file.read((uint8_t *)&header, sizeof(header)) == sizeof(header))
+    {
+        if (header.sequence >= before)
+            break;
+
+        if (header.sequence >= first)
+        {
+            if (file.read((uint8_t *)text, header.length) != header.length)
+                break;
+            render_line(header, header.wall_time, text, html);
+        }
+        else
+        {
+            file.seek(header.length, SeekCur);
+        }
+    }
+    file.close();
+}
+
+void LogStore::render_line(const StoredLogHeader &header, time_t wall_time, const char *text, TextWriter &html)
+{
+    char prefix[64];
+    int used = snprintf(prefix, sizeof(prefix), "#%lu ", (unsigned long)header.sequence);
+    if (header.boot > 0)
+        used += snprintf(prefix + used, sizeof(prefix) - used, "[boot %u] ", header.boot);
+    if (wall_time > 0)
+    {
+        struct tm timeinfo;
+        localtime_r(&wall_time, &timeinfo);
+        used += strftime(prefix + used, sizeof(prefix) - used, "%b %d %H:%M:%S ", &timeinfo);
+    }
+    snprintf(prefix + used, sizeof(prefix) - used, "%s [%s] ", Logger::level_name(header.level), Logger::module_name(header.module));
+
+    html.appendf("<div class='log %s'>%s", Logger::level_name(header.level), prefix);
+    html.append(text, header.length);
+    html.append("</div>");
+}
@@ -1,66 +1,405 @@
 #include "logger.h"
+#include "config.h"
+#include <atomic>
+#include <esp_heap_caps.h>
 
-String *Logger::log_buffer = nullptr;
-int Logger::log_index = 0;
-bool Logger::buffer_full = false;
-int Logger::max_entries = 0;
+#define LOG_RECORD_ALIGN 4
+#define LOG_RECORD_TEXT 0
+#define LOG_RECORD_ISR 1
 
-void Logger::init(int max_entries_count)
+struct __attribute__((packed)) LogRecordHeader
 {
-    max_entries = max_entries_count;
-    log_buffer = new String[max_entries];
-    log_index = 0;
-    buffer_full = false;
+    uint32_t sequence; // 0 while the record is being written
+    int64_t timestamp_us;
+    uint16_t length;
+    uint8_t level;
+    uint8_t module;
+    uint8_t type;
+};
+
+struct __attribute__((packed)) IsrPayload
+{
+    const char *format;
+    uint32_t arg;
+};
+
+static_assert((LOG_ARENA_SIZE & (LOG_ARENA_SIZE - 1)) == 0, "LOG_ARENA_SIZE must be a power of two");
+static_assert((LOG_INDEX_SIZE & (LOG_INDEX_SIZE - 1)) == 0, "LOG_INDEX_SIZE must be a power of two");
+
+static uint8_t log_arena[LOG_ARENA_SIZE] __attribute__((aligned(LOG_RECORD_ALIGN)));
+
+// Free-running byte position of the next reservation; the arena offset is position % LOG_ARENA_SIZE
+static std::atomic<uint32_t> log_head(0);
+static std::atomic<uint32_t> next_sequence(1);
+// Start position of each recent record, indexed by sequence % LOG_INDEX_SIZE
+static std::atomic<uint32_t> record_positions[LOG_INDEX_SIZE];
+
+uint8_t Logger::module_levels[LOG_MODULE_COUNT] = {
+    LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL,
+    LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL};
+
+static const char *const MODULE_NAMES[LOG_MODULE_COUNT] = {"system", "network", "alarm", "led", "web", "storage"};
+static const char *const LEVEL_NAMES[] = {"trace", "debug", "info", "warn", "error"};
+
+TaskHandle_t Logger::drain_task_handle = nullptr;
+uint32_t Logger::drained_sequence = 1;
+
+static inline __attribute__((always_inline)) uint32_t record_size(size_t length)
+{
+    return (sizeof(LogRecordHeader) + length + LOG_RECORD_ALIGN - 1) & ~(LOG_RECORD_ALIGN - 1);
+}
+
+static inline __attribute__((always_inline)) uint32_t *sequence_slot(uint32_t position)
+{
+    return (uint32_t *)&log_arena[position & (LOG_ARENA_SIZE - 1)];
+}
+
+void Logger::init(uint32_t first_sequence)
+{
+    // Sequence numbers continue across boots so persisted logs can be paged by sequence
+    next_sequence.store(first_sequence);
+    drained_sequence = first_sequence;
+
+    if (drain_task_handle == nullptr)
+    {
+        xTaskCreatePinnedToCore(drain_task, "log_drain", LOG_DRAIN_STACK_SIZE, nullptr,
+                                tskIDLE_PRIORITY + 1, &drain_task_handle, tskNO_AFFINITY);
+    }
 }
 
-void Logger::log(const String &message)
+void Logger::logf(LogLevel level, LogModule module, const char *format, ...)
 {
-    if (log_buffer == nullptr)
+    char buffer[LOG_MAX_MESSAGE + 1];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    if (length < 0)
         return;
 
-    String timestamp = getTimestamp();
-    log_buffer[log_index] = timestamp + message;
-    log_index = (log_index + 1) % max_entries;
+    append(level, module, LOG_RECORD_TEXT, buffer, min(length, LOG_MAX_MESSAGE));
+}
+
+void IRAM_ATTR Logger::log_isr(LogModule module, const char *format, unsigned long arg)
+{
+    IsrPayload payload = {format, (uint32_t)arg};
+    append(LOG_LEVEL_INFO, module, LOG_RECORD_ISR, &payload, sizeof(payload));
+}
+
+void IRAM_ATTR Logger::append(uint8_t level, uint8_t module, uint8_t type, const void *payload, size_t length)
+{
+    if (length > LOG_MAX_MESSAGE)
+        length = LOG_MAX_MESSAGE;
+
+    uint32_t sequence = next_sequence.fetch_add(1, std::memory_order_relaxed);
+    uint32_t size = record_size(length);
+
+    // Records never straddle the end of the arena, so readers can copy them in one piece
+    uint32_t position;
+    uint32_t current = log_head.load(std::memory_order_relaxed);
+    do
+    {
+        uint32_t offset = current & (LOG_ARENA_SIZE - 1);
+        uint32_t padding = (LOG_ARENA_SIZE - offset < size) ? LOG_ARENA_SIZE - offset : 0;
+        position = current + padding;
+    } while (!log_head.compare_exchange_weak(current, position + size, std::memory_order_acq_rel,
+                                             std::memory_order_relaxed));
+
+    uint32_t offset = position & (LOG_ARENA_SIZE - 1);
+    LogRecordHeader header = {0, esp_timer_get_time(), (uint16_t)length, level, module, type};
+    memcpy(&log_arena[offset], &header, sizeof(header));
+    memcpy(&log_arena[offset + sizeof(header)], payload, length);
+
+    record_positions[sequence & (LOG_INDEX_SIZE - 1)].store(position, std::memory_order_release);
+    __atomic_store_n(sequence_slot(position), sequence, __ATOMIC_RELEASE);
+}
+
+// Copies a record out of the arena and validates it was neither unfinished
+// nor overwritten by a newer reservation while being copied
+LogReadResult Logger::read_record(uint32_t sequence, LogEntry &entry)
+{
+    uint32_t position = record_positions[sequence & (LOG_INDEX_SIZE - 1)].load(std::memory_order_acquire);
+    uint32_t committed = __atomic_load_n(sequence_slot(position), __ATOMIC_ACQUIRE);
+
+    if (committed != sequence)
+    {
+        bool still_writing = (int32_t)(committed - sequence) < 0 &&
+                             next_sequence.load(std::memory_order_relaxed) - sequence < LOG_INDEX_SIZE;
+        return still_writing ? LOG_READ_PENDING : LOG_READ_LOST;
+    }
+
+    uint32_t offset = position & (LOG_ARENA_SIZE - 1);
+    LogRecordHeader header;
+    uint8_t payload[LOG_MAX_MESSAGE];
+    memcpy(&header, &log_arena[offset], sizeof(header));
+    size_t length = min((size_t)header.length, sizeof(payload));
+    memcpy(payload, &log_arena[offset + sizeof(header)], length);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (log_head.load(std::memory_order_relaxed) - position > LOG_ARENA_SIZE ||
+        __atomic_load_n(sequence_slot(position), __ATOMIC_RELAXED) != sequence)
+    {
+        return LOG_READ_LOST;
+    }
+
+    entry.sequence = sequence;
+    entry.timestamp_us = header.timestamp_us;
+    entry.level = header.level;
+    entry.module = header.module;
+
+    if (header.type == LOG_RECORD_ISR)
+    {
+        IsrPayload isr;
+        memcpy(&isr, payload, sizeof(isr));
+        snprintf(entry.text, sizeof(entry.text), isr.format, (unsigned long)isr.arg);
+    }
+    else
+    {
+        memcpy(entry.text, payload, length);
+        entry.text[length] = '\0';
+    }
+    return LOG_READ_OK;
+}
+
+const char *Logger::module_name(uint8_t module)
+{
+    return module < LOG_MODULE_COUNT ? MODULE_NAMES[module] : "?";
+}
+
+const char *Logger::level_name(uint8_t level)
+{
+    return level <= LOG_LEVEL_ERROR ? LEVEL_NAMES[level] : "?";
+}
+
+bool Logger::parse_module(const char *name, LogModule &module)
+{
+    for (uint8_t i = 0; i < LOG_MODULE_COUNT; i++)
+    {
+        if (strcmp(name, MODULE_NAMES[i]) == 0)
+        {
+            module = (LogModule)i;
+            return true;
+        }
+    }
+    return false;
+}
 
-    if (log_index == 0)
+bool Logger::parse_level(const char *name, LogLevel &level)
+{
+    for (uint8_t i = 0; i <= LOG_LEVEL_ERROR; i++)
     {
-        buffer_full = true;
+        if (strcmp(name, LEVEL_NAMES[i]) == 0)
+        {
+            level = (LogLevel)i;
+            return true;
+        }
     }
+    return false;
+}
 
-    Serial.println(message);
+uint32_t Logger::get_next_sequence()
+{
+    return next_sequence.load(std::memory_order_acquire);
 }
 
-String Logger::getLogsHtml()
+void Logger::drain()
 {
-    if (log_buffer == nullptr)
-        return "";
+    uint32_t latest = next_sequence.load(std::memory_order_acquire);
+    uint32_t dropped = 0;
+    LogEntry entry;
+
+    while (drained_sequence != latest)
+    {
+        LogReadResult result = read_record(drained_sequence, entry);
+        if (result == LOG_READ_PENDING)
+            break;
+
+        if (result == LOG_READ_OK)
+            Serial.printf("[%c][%s] %s\n", toupper(level_name(entry.level)[0]), module_name(entry.module), entry.text);
+        else
+            dropped++;
+        drained_sequence++;
+    }
+
+    if (dropped > 0)
+    {
+        Serial.printf("... %lu log records dropped before reaching serial\n", (unsigned long)dropped);
+    }
+}
 
-    String html = "";
-    int start_index = buffer_full ? log_index : 0;
-    int count = buffer_full ? max_entries : log_index;
+void Logger::drain_task(void *)
+{
+    for (;;)
+    {
+        drain();
+        vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_INTERVAL_MS));
+    }
+}
 
-    for (int i = 0; i < count; i++)
+void Logger::flush()
+{
+    if (drain_task_handle == nullptr)
     {
-        int idx = (start_index + i) % max_entries;
-        html += "<div class='log'>" + log_buffer[idx] + "</div>";
+        drain();
+        return;
     }
 
-    return html;
+    // Give the drain task a bounded chance to catch up, e.g. before deep sleep
+    for (int i = 0; i < 20 && drained_sequence != next_sequence.load(std::memory_order_acquire); i++)
+    {
+        vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_INTERVAL_MS));
+    }
 }
 
 int Logger::getLogCount()
 {
-    return buffer_full ? max_entries : log_index;
+    uint32_t latest = next_sequence.load(std::memory_order_acquire);
+    uint32_t first = latest > LOG_INDEX_SIZE ? latest - LOG_INDEX_SIZE : 1;
+    LogEntry entry;
+    int count = 0;
+
+    for (uint32_t sequence = first; sequence != latest; sequence++)
+    {
+        if (read_record(sequence, entry) == LOG_READ_OK)
+            count++;
+    }
+    return count;
+}
+
+// Records hold uptime; map it onto wall-clock time using the current offset between the two
+time_t Logger::to_wall_time(int64_t timestamp_us)
+{
+    time_t now = time(nullptr);
+    if (now < 1600000000)
+        return 0;
+
+    return now - (time_t)((esp_timer_get_time() - timestamp_us) / 1000000);
 }
 
-String Logger::getTimestamp()
+namespace
 {
-    struct tm timeinfo;
-    if (getLocalTime(&timeinfo))
+    struct HeapSnapshot
+    {
+        size_t free_bytes;
+        size_t largest_block;
+        size_t blocks;
+        float fragmentation;
+    };
+
+    HeapSnapshot snapshot_heap()
+    {
+        multi_heap_info_t info;
+        heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+        float fragmentation = info.total_free_bytes ? 1.0f - (float)info.largest_free_block / info.total_free_bytes : 0;
+        return {info.total_free_bytes, info.largest_free_block, info.allocated_blocks, fragmentation};
+    }
+
+    void finish_run(const HeapSnapshot &before, uint32_t micros_taken, int messages, LogBenchmarkRun &run)
+    {
+        HeapSnapshot after = snapshot_heap();
+        run.logs_per_s = micros_taken ? messages * 1e6f / micros_taken : 0;
+        run.heap_held = (int32_t)before.free_bytes - (int32_t)after.free_bytes;
+        run.blocks_held = (int32_t)after.blocks - (int32_t)before.blocks;
+        run.largest_block_lost = (int32_t)before.largest_block - (int32_t)after.largest_block;
+        run.fragmentation_before = before.fragmentation;
+        run.fragmentation_after = after.fragmentation;
+    }
+
+    // Stands in for the rest of the firmware allocating while a logger runs.
+    // Freed before the heap is measured, so what is left scattered between
+    // the holes is the logger's.
+    struct HeapChurn
     {
+        uint8_t *blocks[16] = {};
+        int next = 0;
+
+        void step(int i)
+        {
+            delete[] blocks[next];
+            blocks[next] = new uint8_t[16 + (i * 37) % 112];
+            next = (next + 1) % 16;
+        }
+
+        ~HeapChurn()
+        {
+            for (uint8_t *block : blocks)
+                delete[] block;
+        }
+    };
+
+    // What Logger::log() did before the arena, minus the Serial output: a
+    // timestamp String joined to a message built with String + String(...),
+    // assigned into a ring of Strings
+    void log_to_string_ring(String *ring, int &index, int id, int hour, int minute, int duration)
+    {
+        String message = "Alarm " + String(id) + " triggered at " + String(hour) + ":" + String(minute) +
+                         ", sunrise " + String(duration) + " min";
+
         char time_str[20];
+        time_t now = time(nullptr);
+        struct tm timeinfo;
+        localtime_r(&now, &timeinfo);
         strftime(time_str, sizeof(time_str), "%H:%M:%S", &timeinfo);
-        return String(time_str) + " ";
+        String timestamp = String(time_str) + " ";
+
+        ring[index] = timestamp + message;
+        index = (index + 1) % LOG_BENCH_RING_ENTRIES;
+    }
+}
+
+// Logs the same messages through the arena and through the String ring it
+// replaced. Each logger runs twice: alone, timed, and then between stand-in
+// allocations to see what it leaves in the heap. The arena runs go into the
+// real log, so they push older records out.
+void Logger::benchmark(int messages, LogBenchmark &result)
+{
+    result.messages = messages;
+    String *ring = new String[LOG_BENCH_RING_ENTRIES];
+    int index = 0;
+    auto log_arena = [](int i)
+    {
+        logf(LOG_LEVEL_TRACE, LOG_MODULE_SYSTEM, "Alarm %d triggered at %d:%d, sunrise %d min", i, i % 24, i % 60,
+             5 + i % 56);
+    };
+    auto log_ring = [&ring, &index](int i)
+    {
+        log_to_string_ring(ring, index, i, i % 24, i % 60, 5 + i % 56);
+    };
+
+    uint32_t start = micros();
+    for (int i = 0; i < messages; i++)
+        log_arena(i);
+    uint32_t arena_us = micros() - start;
+
+    start = micros();
+    for (int i = 0; i < messages; i++)
+        log_ring(i);
+    uint32_t ring_us = micros() - start;
+    delete[] ring;
+
+    HeapSnapshot before = snapshot_heap();
+    {
+        HeapChurn churn;
+        for (int i = 0; i < messages; i++)
+        {
+            log_arena(i);
+            churn.step(i);
+        }
+    }
+    finish_run(before, arena_us, messages, result.arena);
+
+    before = snapshot_heap();
+    ring = new String[LOG_BENCH_RING_ENTRIES];
+    index = 0;
+    {
+        HeapChurn churn;
+        for (int i = 0; i < messages; i++)
+        {
+            log_ring(i);
+            churn.step(i);
+        }
     }
-    return "";
+    finish_run(before, ring_us, messages, result.string_ring);
+    delete[] ring;
 }
@@ -1,22 +1,29 @@
 #include <Arduino.h>
 #include "config.h"
 #include "logger.h"
+#include "log_store.h"
 #include "network_manager.h"
 #include "alarm_manager.h"
 #include "led_controller.h"
 #include "web_server.h"
 #include "database.h"
+#include "event_queue.h"
+#include "realtime_sync.h"
+#include "wake_planner.h"
+#include "energy_model.h"
+#include "input_engine.h"
+#include "heap_monitor.h"
+#include "scratch_pool.h"
+#include "stall_monitor.h"
+#include "ota_receiver.h"
 
 RTC_DATA_ATTR int boot_count = 0;
 
-volatile bool button_pressed = false;
-unsigned long last_button_press = 0;
 unsigned long boot_time = 0;
 
 const unsigned long OTA_WINDOW_DURATION = 300000;
 
-void IRAM_ATTR button_isr();
-void setup_button();
+bool handle_gesture();
 bool should_stay_awake();
 void enter_deep_sleep();
 
@@ -27,49 +34,68 @@ void setup()
 
   boot_time = millis();
   boot_count++;
+  ScratchPool::init();
+  HeapMonitor::begin();
+  InputEngine::begin();
 
-  Logger::init(MAX_LOG_ENTRIES);
-  WEB_LOG("=== Sunrise Alarm Clock Starting ===");
-  WEB_LOG("Boot count: " + String(boot_count));
+  Logger::init(LogStore::restore_sequence());
+  StallMonitor::begin();
+  LOG_INFO(LOG_MODULE_SYSTEM, "=== Sunrise Alarm Clock Starting ===");
+  LOG_INFO(LOG_MODULE_SYSTEM, "Boot count: %d", boot_count);
+  LogStore::log_last_persist_stats();
 
   esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
   if (wakeup_reason == ESP_SLEEP_WAKEUP_EXT0)
   {
-    WEB_LOG("Woke up from button press (EXT0)");
-    button_pressed = true;
+    LOG_INFO(LOG_MODULE_SYSTEM, "Woke up from button press (EXT0)");
   }
   else if (wakeup_reason == ESP_SLEEP_WAKEUP_TIMER)
   {
-    WEB_LOG("Woke up from timer");
+    LOG_INFO(LOG_MODULE_SYSTEM, "Woke up from timer");
   }
   else
   {
-    WEB_LOG("Woke up from other reason: " + String(wakeup_reason));
+    LOG_INFO(LOG_MODULE_SYSTEM, "Woke up from other reason: %d", (int)wakeup_reason);
   }
 
-  setup_button();
+  AlarmManager::load_cached_alarms();
+  NetworkManager::apply_timezone();
+  WakePlanner::begin(wakeup_reason);
+  EnergyModel::begin(wakeup_reason);
   Database::init();
-  if (NetworkManager::connect_wifi())
+  if (WakePlanner::needs_radio())
   {
-    if (boot_count == 1)
+    bool synced = false;
+    if (NetworkManager::connect_wifi())
     {
-      NetworkManager::setup_ota();
-      WebServerManager::init();
-    }
-
-    NetworkManager::sync_time();
+      if (boot_count == 1)
+      {
+        NetworkManager::setup_ota();
+        WebServerManager::init();
+      }
 
-    AlarmManager::fetch_alarms_from_db();
+      NetworkManager::sync_time();
 
-    AlarmManager::check_alarms();
+      synced = AlarmManager::fetch_alarms_from_db();
+    }
+    WakePlanner::record_sync(synced);
   }
+  else
+  {
+    LOG_INFO(LOG_MODULE_SYSTEM, "Alarm wake, using cached alarms with WiFi off");
+  }
+
+  AlarmManager::check_alarms();
+
+  EventQueue::upload_if_online();
 
   if (!should_stay_awake())
   {
     enter_deep_sleep();
   }
 
-  WEB_LOG("Staying awake for OTA/maintenance window");
+  LOG_INFO(LOG_MODULE_SYSTEM, "Staying awake for OTA/maintenance window");
+  RealtimeSync::start();
 }
 
 void loop()
@@ -79,66 +105,76 @@ void loop()
     NetworkManager::handle_ota();
   }
 
-  if (button_pressed)
+  RealtimeSync::loop();
+
+  uint32_t pressed_at_us;
+  if (InputEngine::take_press(pressed_at_us))
   {
-    if (millis() - last_button_press > BUTTON_DEBOUNCE_MS)
-    {
-      WEB_LOG("Button pressed - Manual sync triggered");
-      LEDController::show_button_feedback();
-      AlarmManager::fetch_alarms_from_db();
-      button_pressed = false;
-      WEB_LOG("Aborting OTA and Webserver - preparing for sleep");
-      enter_deep_sleep();
-    }
+    LEDController::show_button_feedback(pressed_at_us);
   }
 
   if (!should_stay_awake())
   {
-    WEB_LOG("OTA window expired - preparing for sleep");
+    LOG_INFO(LOG_MODULE_SYSTEM, "OTA window expired - preparing for sleep");
     enter_deep_sleep();
   }
 
+  // The progress bar of an HTTP upload takes the strip until it restarts
   static unsigned long last_status_update = 0;
-  if (millis() - last_status_update > 5000)
+  if (millis() - last_status_update > 5000 && !OtaReceiver::is_receiving())
   {
     last_status_update = millis();
     LEDController::show_status_indicator();
 
-    String reason = "Unknown reason";
     if (WebServerManager::has_recent_activity())
     {
       unsigned long time_left = 60000 - (millis() - WebServerManager::get_last_activity_time());
-      reason = "Recent web activity (expires in " + String(time_left / 1000) + "s)";
+      LOG_INFO(LOG_MODULE_SYSTEM, "Staying awake: Recent web activity (expires in %lus)", time_left / 1000);
     }
     else if (boot_count == 1 && millis() - boot_time < OTA_WINDOW_DURATION)
     {
       unsigned long time_left = OTA_WINDOW_DURATION - (millis() - boot_time);
-      reason = "OTA window (expires in " + String(time_left / 1000) + "s)";
+      LOG_INFO(LOG_MODULE_SYSTEM, "Staying awake: OTA window (expires in %lus)", time_left / 1000);
+    }
+    else
+    {
+      LOG_INFO(LOG_MODULE_SYSTEM, "Staying awake: Unknown reason");
     }
-
-    WEB_LOG("Staying awake: " + reason);
   }
 
-  delay(100);
-}
-
-void setup_button()
-{
-  pinMode(BUTTON_PIN, INPUT_PULLUP);
-  attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), button_isr, FALLING);
+  InputEngine::wait(100);
 }
 
-void IRAM_ATTR button_isr()
+// Gestures a sunrise did not take: a short press ends the maintenance window
+// and a double press syncs first. Returns true to go to sleep.
+bool handle_gesture()
 {
-  button_pressed = true;
-  last_button_press = millis();
+  InputGesture gesture = InputEngine::take_gesture();
+  if (gesture == GESTURE_NONE)
+  {
+    return false;
+  }
+  if (gesture == GESTURE_LONG)
+  {
+    LOG_INFO(LOG_MODULE_SYSTEM, "Long press without a running alarm, nothing to snooze");
+    return false;
+  }
+  if (gesture == GESTURE_DOUBLE)
+  {
+    LOG_INFO(LOG_MODULE_SYSTEM, "Double press - Manual sync triggered");
+    if (NetworkManager::wifi_connected || NetworkManager::connect_wifi())
+    {
+      WakePlanner::record_sync(AlarmManager::fetch_alarms_from_db());
+    }
+  }
+  LOG_INFO(LOG_MODULE_SYSTEM, "Aborting OTA and Webserver - preparing for sleep");
+  return true;
 }
 
 bool should_stay_awake()
 {
-  if (button_pressed)
+  if (handle_gesture())
   {
-    WEB_LOG("Aborting OTA and Webserver - preparing for sleep");
     return false;
   }
 
@@ -157,20 +193,24 @@ bool should_stay_awake()
 
 void enter_deep_sleep()
 {
-  WEB_LOG("Entering deep sleep...");
-  WEB_LOG("Disconnecting WiFi...");
+  LOG_INFO(LOG_MODULE_SYSTEM, "Entering deep sleep...");
+  RealtimeSync::stop();
+  EventQueue::upload_if_online();
+  Database::close();
+  LOG_INFO(LOG_MODULE_SYSTEM, "Disconnecting WiFi...");
   NetworkManager::disconnect_wifi();
-  WEB_LOG("Clearing LEDs...");
+  LOG_INFO(LOG_MODULE_SYSTEM, "Clearing LEDs...");
   LEDController::clear();
 
-  time_t next_wake_seconds = AlarmManager::calculate_next_alarm_time();
-  uint64_t sleep_duration = min((uint64_t)next_wake_seconds * 1000000ULL, DEEP_SLEEP_DURATION);
+  uint64_t sleep_duration = WakePlanner::plan_sleep_us();
+  EnergyModel::end_boot(sleep_duration);
 
-  WEB_LOG("Sleep duration: " + String(sleep_duration / 1000000) + " seconds");
+  LOG_INFO(LOG_MODULE_SYSTEM, "Sleep duration: %lu seconds", (unsigned long)(sleep_duration / 1000000));
 
   esp_sleep_enable_timer_wakeup(sleep_duration);
   esp_sleep_enable_ext0_wakeup(GPIO_NUM_0, 0);
 
+  LogStore::persist(boot_count);
   delay(100);
   esp_deep_sleep_start();
 }
\ No newline at end of file
@@ -0,0 +1,56 @@
+#include "metrics.h"
+
+void Metrics::gauge(TextWriter &out, const char *name, const char *help, double value)
+{
+    family(out, name, "gauge", help);
+    out.append(name);
+    append_value(out, value);
+}
+
+void Metrics::counter(TextWriter &out, const char *name, const char *help, double value)
+{
+    family(out, name, "counter", help);
+    out.append(name);
+    append_value(out, value);
+}
+
+void Metrics::family(TextWriter &out, const char *name, const char *type, const char *help)
+{
+    out.appendf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void Metrics::sample(TextWriter &out, const char *name, const char *label, const char *label_value, double value)
+{
+    out.appendf("%s{%s=\"%s\"}", name, label, label_value);
+    append_value(out, value);
+}
+
+// counts holds one more entry than bounds, for the values above the largest
+// bound; the buckets are written cumulative, as the format wants them
+void Metrics::histogram(TextWriter &out, const char *name, const char *label, const char *label_value,
+                        const uint32_t *bounds, const uint32_t *counts, int bound_count, double sum)
+{
+    uint32_t total = 0;
+    for (int i = 0; i < bound_count; i++)
+    {
+        total += counts[i];
+        out.appendf("%s_bucket{%s=\"%s\",le=\"%lu\"}", name, label, label_value, (unsigned long)bounds[i]);
+        append_value(out, total);
+    }
+    total += counts[bound_count];
+    out.appendf("%s_bucket{%s=\"%s\",le=\"+Inf\"}", name, label, label_value);
+    append_value(out, total);
+    out.appendf("%s_sum{%s=\"%s\"}", name, label, label_value);
+    append_value(out, sum);
+    out.appendf("%s_count{%s=\"%s\"}", name, label, label_value);
+    append_value(out, total);
+}
+
+void Metrics::append_value(TextWriter &out, double value)
+{
+    // Whole numbers are printed without a fraction so large counters keep every digit
+    if (value == (double)(int64_t)value)
+        out.appendf(" %lld\n", (long long)value);
+    else
+        out.appendf(" %.3f\n", value);
+}
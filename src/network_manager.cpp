@@ -1,36 +1,50 @@
 #include "network_manager.h"
 #include "led_controller.h"
+#include "ota_receiver.h"
+#include "stall_monitor.h"
 #include "logger.h"
 #include "config.h"
 
 bool NetworkManager::wifi_connected = false;
 bool NetworkManager::ota_initialized = false;
+bool NetworkManager::radio_on = false;
+unsigned long NetworkManager::radio_on_since = 0;
+uint32_t NetworkManager::radio_on_ms = 0;
 
 bool NetworkManager::connect_wifi()
 {
-    WEB_LOG("Connecting to WiFi...");
+    StallScope stall_scope(STALL_LOOP, STALL_TAG_CONNECT_WIFI);
+    LOG_INFO(LOG_MODULE_NETWORK, "Connecting to WiFi...");
+    if (!radio_on)
+    {
+        radio_on = true;
+        radio_on_since = millis();
+    }
     WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
 
     int attempts = 0;
     while (WiFi.status() != WL_CONNECTED && attempts < 20)
     {
         delay(500);
-        DEBUG_PRINT(".");
+        LOG_TRACE(LOG_MODULE_NETWORK, "Waiting for WiFi (attempt %d)", attempts + 1);
         attempts++;
     }
 
     if (WiFi.status() == WL_CONNECTED)
     {
         wifi_connected = true;
-        WEB_LOG("WiFi connected!");
-        WEB_LOG("IP address: " + WiFi.localIP().toString());
-        WEB_LOG("MAC address: " + WiFi.macAddress());
+        LOG_INFO(LOG_MODULE_NETWORK, "WiFi connected!");
+        IPAddress ip = WiFi.localIP();
+        uint8_t mac[6];
+        WiFi.macAddress(mac);
+        LOG_INFO(LOG_MODULE_NETWORK, "IP address: %u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+        LOG_INFO(LOG_MODULE_NETWORK, "MAC address: %02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
         return true;
     }
     else
     {
         wifi_connected = false;
-        WEB_LOG("WiFi connection failed!");
+        LOG_ERROR(LOG_MODULE_NETWORK, "WiFi connection failed!");
         return false;
     }
 }
@@ -40,55 +54,75 @@ void NetworkManager::disconnect_wifi()
     WiFi.disconnect();
     WiFi.mode(WIFI_OFF);
     wifi_connected = false;
+    if (radio_on)
+    {
+        radio_on = false;
+        radio_on_ms += millis() - radio_on_since;
+    }
 }
 
 void NetworkManager::setup_ota()
 {
-    WEB_LOG("Setting up OTA updates...");
+    LOG_INFO(LOG_MODULE_NETWORK, "Setting up OTA updates...");
 
     ArduinoOTA.setHostname(OTA_HOSTNAME);
     ArduinoOTA.setPassword(OTA_PASSWORD);
 
     ArduinoOTA.onStart([]()
                        {
-        String type = (ArduinoOTA.getCommand() == U_FLASH) ? "sketch" : "filesystem";
-        WEB_LOG("OTA Start updating " + type);
+        const char *type = (ArduinoOTA.getCommand() == U_FLASH) ? "sketch" : "filesystem";
+        LOG_INFO(LOG_MODULE_NETWORK, "OTA Start updating %s", type);
         LEDController::init();
         LEDController::clear(); });
 
     ArduinoOTA.onEnd([]()
-                     { WEB_LOG("OTA Update completed"); });
+                     { LOG_INFO(LOG_MODULE_NETWORK, "OTA Update completed"); });
 
     ArduinoOTA.onProgress([](unsigned int progress, unsigned int total)
                           { LEDController::show_ota_progress(progress, total); });
 
     ArduinoOTA.onError([](ota_error_t error)
                        {
-        String error_msg = "OTA Error[" + String(error) + "]: ";
-        if (error == OTA_AUTH_ERROR) error_msg += "Auth Failed";
-        else if (error == OTA_BEGIN_ERROR) error_msg += "Begin Failed";
-        else if (error == OTA_CONNECT_ERROR) error_msg += "Connect Failed";
-        else if (error == OTA_RECEIVE_ERROR) error_msg += "Receive Failed";
-        else if (error == OTA_END_ERROR) error_msg += "End Failed";
-        WEB_LOG(error_msg);
+        const char *reason = "";
+        if (error == OTA_AUTH_ERROR) reason = "Auth Failed";
+        else if (error == OTA_BEGIN_ERROR) reason = "Begin Failed";
+        else if (error == OTA_CONNECT_ERROR) reason = "Connect Failed";
+        else if (error == OTA_RECEIVE_ERROR) reason = "Receive Failed";
+        else if (error == OTA_END_ERROR) reason = "End Failed";
+        LOG_ERROR(LOG_MODULE_NETWORK, "OTA Error[%d]: %s", (int)error, reason);
         LEDController::show_ota_error(); });
 
     ArduinoOTA.begin();
     ota_initialized = true;
-    WEB_LOG("OTA Ready - Hostname: " + String(OTA_HOSTNAME));
+    LOG_INFO(LOG_MODULE_NETWORK, "OTA Ready - Hostname: %s", OTA_HOSTNAME);
 }
 
 void NetworkManager::handle_ota()
 {
     if (ota_initialized)
     {
+        // An upload runs to the end inside handle()
+        StallScope stall_scope(STALL_LOOP, STALL_TAG_OTA);
         ArduinoOTA.handle();
     }
+
+    // HTTP uploads are written by the web server's task; only the loop draws
+    uint32_t received, total;
+    if (OtaReceiver::get_progress(received, total))
+        LEDController::show_ota_progress(received, total);
+    if (OtaReceiver::take_failure())
+        LEDController::show_ota_error();
+    if (OtaReceiver::should_restart())
+    {
+        LOG_INFO(LOG_MODULE_NETWORK, "Restarting into the uploaded firmware");
+        ESP.restart();
+    }
 }
 
 void NetworkManager::sync_time()
 {
-    WEB_LOG("Syncing time with NTP server...");
+    StallScope stall_scope(STALL_LOOP, STALL_TAG_SYNC_TIME);
+    LOG_INFO(LOG_MODULE_NETWORK, "Syncing time with NTP server...");
     configTime(GMT_OFFSET_SEC, DAYLIGHT_OFFSET_SEC, NTP_SERVER);
 
     struct tm timeinfo;
@@ -103,12 +137,44 @@ void NetworkManager::sync_time()
     {
         char time_str[64];
         strftime(time_str, sizeof(time_str), "%A, %B %d %Y %H:%M:%S", &timeinfo);
-        WEB_LOG("Time synchronized: " + String(time_str));
+        LOG_INFO(LOG_MODULE_NETWORK, "Time synchronized: %s", time_str);
+    }
+    else
+    {
+        LOG_WARN(LOG_MODULE_NETWORK, "Failed to sync time");
     }
+}
+
+// Wakes that skip WiFi never call configTime(), which is what sets TZ. This
+// builds the same TZ string so local time is right without NTP.
+void NetworkManager::apply_timezone()
+{
+    long offset = -GMT_OFFSET_SEC;
+    char standard[17];
+    char daylight[17] = "DST";
+    if (offset % 3600)
+        snprintf(standard, sizeof(standard), "UTC%ld:%02u:%02u", offset / 3600, (unsigned)abs((offset % 3600) / 60), (unsigned)abs(offset % 60));
     else
+        snprintf(standard, sizeof(standard), "UTC%ld", offset / 3600);
+
+    if (DAYLIGHT_OFFSET_SEC != 3600)
     {
-        WEB_LOG("Failed to sync time");
+        long dst_offset = offset - DAYLIGHT_OFFSET_SEC;
+        if (dst_offset % 3600)
+            snprintf(daylight, sizeof(daylight), "DST%ld:%02u:%02u", dst_offset / 3600, (unsigned)abs((dst_offset % 3600) / 60), (unsigned)abs(dst_offset % 60));
+        else
+            snprintf(daylight, sizeof(daylight), "DST%ld", dst_offset / 3600);
     }
+
+    char tz[33];
+    snprintf(tz, sizeof(tz), "%s%s", standard, daylight);
+    setenv("TZ", tz, 1);
+    tzset();
+}
+
+uint32_t NetworkManager::get_radio_on_ms()
+{
+    return radio_on_ms + (radio_on ? millis() - radio_on_since : 0);
 }
 
 String NetworkManager::get_device_id()
@@ -0,0 +1,225 @@
+#include "ota_receiver.h"
+#include "logger.h"
+#include "config.h"
+#include <Update.h>
+#include <MD5Builder.h>
+#include <esp32/rom/miniz.h>
+
+#define GZIP_HEADER_SIZE 10
+#define GZIP_TRAILER_SIZE 8
+#define ESP_IMAGE_MAGIC 0xE9
+
+enum OtaFormat : uint8_t
+{
+    OTA_FORMAT_UNKNOWN,
+    OTA_FORMAT_PLAIN,
+    OTA_FORMAT_GZIP
+};
+
+// About 43 KB, allocated only while a compressed image is coming in
+struct OtaInflate
+{
+    tinfl_decompressor inflator;
+    uint8_t window[TINFL_LZ_DICT_SIZE]; // Output ring, which is also the deflate window
+    size_t window_position;
+    uint8_t header[GZIP_HEADER_SIZE];
+    size_t header_length;
+    size_t trailer_length;
+    bool done;
+};
+
+volatile bool OtaReceiver::receiving = false;
+volatile uint32_t OtaReceiver::received = 0;
+uint32_t OtaReceiver::body_size = 0;
+uint32_t OtaReceiver::written = 0;
+uint32_t OtaReceiver::started_at = 0;
+uint32_t OtaReceiver::completed_at = 0;
+const char *OtaReceiver::error = nullptr;
+volatile bool OtaReceiver::failed = false;
+
+static OtaFormat format = OTA_FORMAT_UNKNOWN;
+static OtaInflate *stream = nullptr;
+
+// The signature is the MD5 of OTA_PASSWORD followed by the image's MD5, so
+// the password is never sent and a replayed upload can only install the
+// same image again
+bool OtaReceiver::begin(size_t image_size, size_t body, const char *md5, const char *signature)
+{
+    if (receiving || Update.isRunning())
+    {
+        error = "update running";
+        return false;
+    }
+
+    MD5Builder builder;
+    builder.begin();
+    builder.add(String(OTA_PASSWORD) + md5);
+    builder.calculate();
+    if (strlen(md5) != 32 || strcasecmp(builder.toString().c_str(), signature) != 0)
+    {
+        LOG_WARN(LOG_MODULE_NETWORK, "OTA upload with a wrong signature refused");
+        error = "bad signature";
+        return false;
+    }
+    if (!Update.begin(image_size, U_FLASH) || !Update.setMD5(md5))
+    {
+        error = Update.errorString();
+        LOG_ERROR(LOG_MODULE_NETWORK, "OTA begin failed: %s", error);
+        Update.abort();
+        return false;
+    }
+
+    format = OTA_FORMAT_UNKNOWN;
+    received = 0;
+    body_size = body;
+    written = 0;
+    started_at = millis();
+    completed_at = 0;
+    error = nullptr;
+    receiving = true;
+    LOG_INFO(LOG_MODULE_NETWORK, "OTA upload started: %u byte image in %u bytes", (unsigned)image_size,
+             (unsigned)body);
+    return true;
+}
+
+bool OtaReceiver::write(const uint8_t *data, size_t length)
+{
+    if (!receiving)
+        return false;
+
+    if (format == OTA_FORMAT_UNKNOWN && length > 0)
+    {
+        if (data[0] == ESP_IMAGE_MAGIC)
+        {
+            format = OTA_FORMAT_PLAIN;
+        }
+        else
+        {
+            stream = (OtaInflate *)malloc(sizeof(OtaInflate));
+            if (stream == nullptr)
+                return fail("out of memory");
+            tinfl_init(&stream->inflator);
+            stream->window_position = 0;
+            stream->header_length = 0;
+            stream->trailer_length = 0;
+            stream->done = false;
+            format = OTA_FORMAT_GZIP;
+        }
+    }
+
+    received += length;
+    if (format == OTA_FORMAT_GZIP)
+        return inflate(data, length);
+
+    if (Update.write((uint8_t *)data, length) != length)
+        return fail(Update.errorString());
+    written += length;
+    return true;
+}
+
+// Passes everything data inflates to on to Update. Inflating stops at
+// the end of the member, which is followed by the trailer and nothing else.
+// The trailer is not checked: tinfl may already have read part of it, and
+// Update.end() checks the image's size and MD5 anyway.
+bool OtaReceiver::inflate(const uint8_t *data, size_t length)
+{
+    OtaInflate &state = *stream;
+    while (length > 0 && state.header_length < GZIP_HEADER_SIZE)
+    {
+        state.header[state.header_length++] = *data++;
+        length--;
+        if (state.header_length == GZIP_HEADER_SIZE &&
+            (state.header[0] != 0x1F || state.header[1] != 0x8B || state.header[2] != 8 || state.header[3] != 0))
+            return fail("not a plain image or a gzip member without optional fields");
+    }
+
+    while (length > 0 && !state.done)
+    {
+        size_t in_bytes = length;
+        size_t out_bytes = TINFL_LZ_DICT_SIZE - state.window_position;
+        uint8_t *out = state.window + state.window_position;
+        tinfl_status status = tinfl_decompress(&state.inflator, data, &in_bytes, state.window, out, &out_bytes,
+                                               TINFL_FLAG_HAS_MORE_INPUT);
+        data += in_bytes;
+        length -= in_bytes;
+        if (out_bytes > 0)
+        {
+            if (Update.write(out, out_bytes) != out_bytes)
+                return fail(Update.errorString());
+            written += out_bytes;
+            state.window_position = (state.window_position + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+        if (status < TINFL_STATUS_DONE)
+            return fail("corrupt deflate stream");
+        state.done = status == TINFL_STATUS_DONE;
+    }
+
+    state.trailer_length += length;
+    if (state.trailer_length > GZIP_TRAILER_SIZE)
+        return fail("data after the gzip member");
+    return true;
+}
+
+// Update.end() checks the size and the MD5 before the new image is booted
+bool OtaReceiver::end()
+{
+    if (!receiving)
+        return false;
+
+    if (format == OTA_FORMAT_GZIP && !stream->done)
+        return fail("gzip stream cut short");
+    if (!Update.end())
+        return fail(Update.errorString());
+
+    release();
+    receiving = false;
+    completed_at = max(millis(), 1UL);
+    uint32_t elapsed = completed_at - started_at;
+    LOG_INFO(LOG_MODULE_NETWORK, "OTA upload complete: %lu byte image from %lu bytes in %lu ms",
+             (unsigned long)written, (unsigned long)received, (unsigned long)elapsed);
+    return true;
+}
+
+void OtaReceiver::abort()
+{
+    if (receiving)
+        fail("upload aborted");
+}
+
+bool OtaReceiver::get_progress(uint32_t &progress, uint32_t &total)
+{
+    progress = received;
+    total = body_size;
+    return receiving;
+}
+
+// Once the response to the upload has had time to reach the client
+bool OtaReceiver::should_restart()
+{
+    return completed_at != 0 && millis() - completed_at >= OTA_RESTART_DELAY_MS;
+}
+
+// True once after an upload that had started failed
+bool OtaReceiver::take_failure()
+{
+    bool was_failed = failed;
+    failed = false;
+    return was_failed;
+}
+
+bool OtaReceiver::fail(const char *reason)
+{
+    LOG_ERROR(LOG_MODULE_NETWORK, "OTA upload failed after %lu bytes: %s", (unsigned long)received, reason);
+    Update.abort();
+    release();
+    receiving = false;
+    failed = true;
+    error = reason;
+    return false;
+}
+
+void OtaReceiver::release()
+{
+    free(stream);
+    stream = nullptr;
+}
@@ -0,0 +1,389 @@
+#include "preset_store.h"
+#include "database.h"
+#include "network_manager.h"
+#include "metrics.h"
+#include "scratch_pool.h"
+#include "logger.h"
+#include "config.h"
+#include <LittleFS.h>
+
+static const char *PRESET_DIR = "/presets";
+static const uint32_t PRESET_FILE_MAGIC = 0x31505253; // "SRP1"
+
+struct StoredStage
+{
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t reserved;
+    float duration_percent;
+};
+
+// Start of /presets/<name>.bin; the compiled curve follows it
+struct StoredPresetHeader
+{
+    uint32_t magic;
+    int32_t version;
+    char name[PRESET_NAME_LENGTH + 1];
+    uint8_t stage_count;
+    uint8_t effects;
+    uint8_t reserved[2];
+    StoredStage stages[PRESET_MAX_STAGES];
+};
+
+static const size_t PRESET_FILE_SIZE = sizeof(StoredPresetHeader) + sizeof(CRGB16) * SUNRISE_LUT_SIZE;
+
+RTC_DATA_ATTR static uint32_t rtc_downloads_total = 0;
+RTC_DATA_ATTR static uint32_t rtc_compiles_total = 0;
+RTC_DATA_ATTR static uint32_t rtc_rejected_total = 0;
+
+static bool read_header(File &file, StoredPresetHeader &header)
+{
+    return file && file.size() == PRESET_FILE_SIZE &&
+           file.read((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+           header.magic == PRESET_FILE_MAGIC && header.name[sizeof(header.name) - 1] == '\0' &&
+           header.stage_count >= 2 &&
+           header.stage_count <= PRESET_MAX_STAGES;
+}
+
+// Lists names and versions first and downloads only the rows whose version
+// differs from the compiled copy in flash. Most syncs change nothing and
+// cost one small request.
+bool PresetStore::sync()
+{
+    if (!mount())
+        return false;
+
+    ScratchText body(HEAP_SYNC);
+    if (!body.ok())
+        return false;
+
+    String device_filter = "&device_id=eq." + NetworkManager::get_device_id();
+    int status = Database::select_rows("color_presets", "select=name,version" + device_filter +
+                                                            "&order=name&limit=" + String(MAX_CUSTOM_PRESETS), body.text());
+    if (status != 200)
+    {
+        LOG_ERROR(LOG_MODULE_ALARM, "Supabase error %d listing color presets: %.80s", status, body.text().c_str());
+        return false;
+    }
+
+    JsonDocument listing;
+    DeserializationError error = deserializeJson(listing, body.text().c_str(), body.text().length());
+    if (error || !listing.is<JsonArray>())
+    {
+        LOG_WARN(LOG_MODULE_ALARM, "Unreadable color preset list (%s, %u bytes)", error.c_str(), (unsigned)body.text().length());
+        return false;
+    }
+
+    remove_deleted(listing.as<JsonArrayConst>());
+
+    // Names are limited to [a-z0-9_-], so they need no escaping inside in.()
+    String changed;
+    for (JsonObjectConst row : listing.as<JsonArrayConst>())
+    {
+        const char *name = row["name"] | "";
+        if (!is_valid_name(name) || cached_version(name) == (row["version"] | 0))
+            continue;
+
+        changed += changed.length() > 0 ? "," : "";
+        changed += name;
+    }
+
+    if (changed.length() == 0)
+        return true;
+
+    status = Database::select_rows("color_presets", "select=name,version,stages,effects" + device_filter +
+                                                        "&name=in.(" + changed + ")", body.text());
+    JsonDocument rows;
+    error = deserializeJson(rows, body.text().c_str(), body.text().length());
+    if (status != 200 || error || !rows.is<JsonArray>())
+    {
+        LOG_ERROR(LOG_MODULE_ALARM, "Downloading color presets failed (%d, %s)", status, error.c_str());
+        return false;
+    }
+
+    SunriseLut *lut = new SunriseLut;
+    bool saved_all = true;
+    for (JsonObjectConst row : rows.as<JsonArrayConst>())
+    {
+        rtc_downloads_total++;
+        ColorPreset preset;
+        if (!read_row(row, preset))
+        {
+            rtc_rejected_total++;
+            LOG_WARN(LOG_MODULE_ALARM, "Ignoring invalid color preset %s", row["name"] | "?");
+            continue;
+        }
+
+        SunriseCurve::compile(preset, *lut);
+        rtc_compiles_total++;
+        if (save(preset, *lut))
+            LOG_INFO(LOG_MODULE_ALARM, "Color preset %s version %ld cached", preset.name, (long)preset.version);
+        else
+            saved_all = false;
+    }
+    delete lut;
+    return saved_all;
+}
+
+// Reads a preset and its compiled curve from flash. The curve is only read
+// when lut does not already hold this version of the preset.
+bool PresetStore::load(const char *name, ColorPreset &preset, SunriseLut &lut)
+{
+    if (!is_valid_name(name) || !mount())
+        return false;
+
+    File file = LittleFS.open(path_for(name), FILE_READ);
+    StoredPresetHeader header;
+    if (!read_header(file, header))
+    {
+        if (file)
+            file.close();
+        return false;
+    }
+
+    memcpy(preset.name, header.name, sizeof(preset.name));
+    preset.version = header.version;
+    preset.effects = header.effects;
+    preset.stage_count = header.stage_count;
+    for (int i = 0; i < header.stage_count; i++)
+    {
+        preset.stages[i].color = CRGB(header.stages[i].r, header.stages[i].g, header.stages[i].b);
+        preset.stages[i].duration_percent = header.stages[i].duration_percent;
+    }
+
+    bool ok = true;
+    if (!SunriseCurve::is_compiled(lut, preset))
+    {
+        ok = file.read((uint8_t *)lut.entries, sizeof(lut.entries)) == sizeof(lut.entries);
+        memcpy(lut.name, header.name, sizeof(lut.name));
+        lut.version = ok ? header.version : 0;
+    }
+    file.close();
+    return ok;
+}
+
+int PresetStore::get_cached_count()
+{
+    if (!mount())
+        return 0;
+
+    int count = 0;
+    File dir = LittleFS.open(PRESET_DIR, FILE_READ);
+    if (!dir || !dir.isDirectory())
+        return 0;
+
+    for (File file = dir.openNextFile(); file; file = dir.openNextFile())
+    {
+        if (String(file.name()).endsWith(".bin"))
+            count++;
+        file.close();
+    }
+    dir.close();
+    return count;
+}
+
+void PresetStore::append_metrics(TextWriter &out)
+{
+    Metrics::gauge(out, "sunrise_color_presets_cached", "Custom color presets compiled in flash", get_cached_count());
+    Metrics::counter(out, "sunrise_color_preset_downloads_total", "color_presets rows downloaded since power on", rtc_downloads_total);
+    Metrics::counter(out, "sunrise_color_preset_compiles_total", "Custom color presets compiled since power on", rtc_compiles_total);
+    Metrics::counter(out, "sunrise_color_preset_rejected_total", "Invalid color_presets rows ignored since power on", rtc_rejected_total);
+}
+
+bool PresetStore::mount()
+{
+    static bool mounted = false;
+    if (!mounted)
+    {
+        mounted = LittleFS.begin(true);
+        if (mounted && !LittleFS.exists(PRESET_DIR))
+            LittleFS.mkdir(PRESET_DIR);
+    }
+    return mounted;
+}
+
+String PresetStore::path_for(const char *name)
+{
+    return String(PRESET_DIR) + "/" + name + ".bin";
+}
+
+// 0 when the preset is not in flash; row versions start at 1
+int32_t PresetStore::cached_version(const char *name)
+{
+    File file = LittleFS.open(path_for(name), FILE_READ);
+    StoredPresetHeader header;
+    bool ok = read_header(file, header);
+    if (file)
+        file.close();
+    return ok ? header.version : 0;
+}
+
+// Drops compiled presets whose row was deleted or renamed, and unfinished saves
+void PresetStore::remove_deleted(JsonArrayConst listing)
+{
+    String stale[MAX_CUSTOM_PRESETS];
+    int stale_count = 0;
+
+    File dir = LittleFS.open(PRESET_DIR, FILE_READ);
+    if (!dir || !dir.isDirectory())
+        return;
+
+    for (File file = dir.openNextFile(); file && stale_count < MAX_CUSTOM_PRESETS; file = dir.openNextFile())
+    {
+        String file_name = file.name();
+        file.close();
+
+        // Leftover .tmp files from an interrupted save never match a listed name
+        bool listed = false;
+        if (file_name.endsWith(".bin"))
+        {
+            String name = file_name.substring(0, file_name.length() - 4);
+            for (JsonObjectConst row : listing)
+            {
+                if (name == (row["name"] | ""))
+                {
+                    listed = true;
+                    break;
+                }
+            }
+        }
+        if (!listed)
+            stale[stale_count++] = file_name;
+    }
+    dir.close();
+
+    // Removed after the directory is closed; a remainder beyond MAX_CUSTOM_PRESETS goes on the next sync
+    for (int i = 0; i < stale_count; i++)
+    {
+        LittleFS.remove(String(PRESET_DIR) + "/" + stale[i]);
+        LOG_INFO(LOG_MODULE_ALARM, "Removed %s from the color preset cache", stale[i].c_str());
+    }
+}
+
+// A row is {"name", "version", "stages": [{"color": "#RRGGBB", "duration_percent": 0.2}, ...],
+// "effects": ["breathing", "sparkle", "warmth", "wave"]}. Durations are fractions of the
+// sunrise; the last stage is the color the sunrise ends on and its duration is ignored.
+bool PresetStore::read_row(JsonObjectConst row, ColorPreset &preset)
+{
+    const char *name = row["name"] | "";
+    int32_t version = row["version"] | 0;
+    JsonArrayConst stages = row["stages"];
+    if (!is_valid_name(name) || AlarmManager::is_builtin_preset(name) || version <= 0 ||
+        stages.size() < 2 || stages.size() > PRESET_MAX_STAGES)
+        return false;
+
+    strncpy(preset.name, name, sizeof(preset.name) - 1);
+    preset.name[sizeof(preset.name) - 1] = '\0';
+    preset.version = version;
+    preset.stage_count = stages.size();
+
+    float total = 0.0f;
+    for (int i = 0; i < preset.stage_count; i++)
+    {
+        JsonObjectConst stage = stages[i];
+        float duration = stage["duration_percent"] | -1.0f;
+        if (!parse_color(stage["color"] | "", preset.stages[i].color) || duration < 0.0f || duration > 1.0f)
+            return false;
+
+        preset.stages[i].duration_percent = duration;
+        if (i < preset.stage_count - 1)
+        {
+            if (duration <= 0.0f)
+                return false;
+            total += duration;
+        }
+    }
+    if (total > 1.001f)
+        return false;
+
+    preset.effects = 0;
+    for (JsonVariantConst effect : row["effects"].as<JsonArrayConst>())
+    {
+        const char *effect_name = effect | "";
+        if (strcmp(effect_name, "breathing") == 0)
+            preset.effects |= PRESET_EFFECT_BREATHING;
+        else if (strcmp(effect_name, "sparkle") == 0)
+            preset.effects |= PRESET_EFFECT_SPARKLE;
+        else if (strcmp(effect_name, "warmth") == 0)
+            preset.effects |= PRESET_EFFECT_WARMTH;
+        else if (strcmp(effect_name, "wave") == 0)
+            preset.effects |= PRESET_EFFECT_WAVE;
+        else
+            return false;
+    }
+    return true;
+}
+
+// Written under a temporary name so a power cut never leaves a half-written curve behind
+bool PresetStore::save(const ColorPreset &preset, const SunriseLut &lut)
+{
+    StoredPresetHeader header = {};
+    header.magic = PRESET_FILE_MAGIC;
+    header.version = preset.version;
+    memcpy(header.name, preset.name, sizeof(header.name));
+    header.stage_count = preset.stage_count;
+    header.effects = preset.effects;
+    for (int i = 0; i < preset.stage_count; i++)
+    {
+        header.stages[i].r = preset.stages[i].color.r;
+        header.stages[i].g = preset.stages[i].color.g;
+        header.stages[i].b = preset.stages[i].color.b;
+        header.stages[i].duration_percent = preset.stages[i].duration_percent;
+    }
+
+    String path = path_for(header.name);
+    String temp_path = String(PRESET_DIR) + "/" + header.name + ".tmp";
+    File file = LittleFS.open(temp_path, FILE_WRITE);
+    if (!file)
+    {
+        LOG_ERROR(LOG_MODULE_STORAGE, "Cannot write %s", temp_path.c_str());
+        return false;
+    }
+
+    bool ok = file.write((const uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+              file.write((const uint8_t *)lut.entries, sizeof(lut.entries)) == sizeof(lut.entries);
+    file.close();
+    if (ok)
+    {
+        LittleFS.remove(path);
+        ok = LittleFS.rename(temp_path.c_str(), path.c_str());
+    }
+    if (!ok)
+    {
+        LOG_ERROR(LOG_MODULE_STORAGE, "Saving color preset %s failed", header.name);
+        LittleFS.remove(temp_path);
+    }
+    return ok;
+}
+
+bool PresetStore::is_valid_name(const char *name)
+{
+    size_t length = strlen(name);
+    if (length == 0 || length > PRESET_NAME_LENGTH)
+        return false;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        char c = name[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_' || c == '-'))
+            return false;
+    }
+    return true;
+}
+
+bool PresetStore::parse_color(const char *text, CRGB &color)
+{
+    if (strlen(text) != 7 || text[0] != '#')
+        return false;
+
+    for (int i = 1; i < 7; i++)
+    {
+        if (!isxdigit((unsigned char)text[i]))
+            return false;
+    }
+
+    uint32_t value = strtoul(text + 1, nullptr, 16);
+    color = CRGB(value >> 16, (value >> 8) & 0xFF, value & 0xFF);
+    return true;
+}
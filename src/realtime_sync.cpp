@@ -0,0 +1,243 @@
+#include "realtime_sync.h"
+#include "alarm_manager.h"
+#include "database.h"
+#include "network_manager.h"
+#include "scratch_pool.h"
+#include "logger.h"
+#include "config.h"
+#include <ArduinoJson.h>
+#include <time.h>
+
+static WebSocketsClient socket;
+
+bool RealtimeSync::active = false;
+bool RealtimeSync::joined = false;
+uint32_t RealtimeSync::message_ref = 0;
+String RealtimeSync::join_ref;
+String RealtimeSync::topic;
+unsigned long RealtimeSync::last_heartbeat = 0;
+unsigned long RealtimeSync::last_poll = 0;
+char RealtimeSync::watermark[40] = "";
+
+void RealtimeSync::start()
+{
+    if (!REALTIME_ENABLED || active || !NetworkManager::wifi_connected)
+        return;
+
+    // The Realtime endpoint lives next to the REST API, so SUPABASE_URL also
+    // selects wss:// or, for the local stand-in, ws://
+    String url = SUPABASE_URL;
+    bool secure = url.startsWith("https://");
+    int host_start = url.indexOf("://") + 3;
+    int host_end = url.indexOf('/', host_start);
+    String authority = host_end < 0 ? url.substring(host_start) : url.substring(host_start, host_end);
+    int colon = authority.indexOf(':');
+    String host = colon < 0 ? authority : authority.substring(0, colon);
+    uint16_t port = colon < 0 ? (secure ? 443 : 80) : authority.substring(colon + 1).toInt();
+    String path = String("/realtime/v1/websocket?apikey=") + SUPABASE_KEY + "&vsn=1.0.0";
+
+    topic = "realtime:alarms:" + NetworkManager::get_device_id();
+
+    // Start from the newest cached row; the first delta query re-reads rows of
+    // that second and picks up their exact timestamps
+    time_t latest = AlarmManager::get_latest_update();
+    struct tm latest_tm;
+    gmtime_r(&latest, &latest_tm);
+    strftime(watermark, sizeof(watermark), "%Y-%m-%dT%H:%M:%S+00:00", &latest_tm);
+
+    socket.onEvent(on_event);
+    socket.setReconnectInterval(REALTIME_RECONNECT_MS);
+    if (secure)
+        socket.beginSSL(host.c_str(), port, path.c_str());
+    else
+        socket.begin(host.c_str(), port, path.c_str());
+
+    active = true;
+    joined = false;
+    last_poll = millis();
+    LOG_INFO(LOG_MODULE_NETWORK, "Realtime: connecting to %s:%u", host.c_str(), port);
+}
+
+void RealtimeSync::stop()
+{
+    if (!active)
+        return;
+
+    socket.disconnect();
+    active = false;
+    joined = false;
+}
+
+void RealtimeSync::loop()
+{
+    if (!active)
+        return;
+
+    socket.loop();
+
+    unsigned long now = millis();
+    if (joined && now - last_heartbeat > REALTIME_HEARTBEAT_MS)
+    {
+        send_heartbeat();
+    }
+    else if (!joined && now - last_poll > REALTIME_POLL_INTERVAL_MS)
+    {
+        last_poll = now;
+        poll_changes();
+    }
+}
+
+void RealtimeSync::on_event(WStype_t type, uint8_t *payload, size_t length)
+{
+    switch (type)
+    {
+    case WStype_CONNECTED:
+        LOG_INFO(LOG_MODULE_NETWORK, "Realtime: connected, joining %s", topic.c_str());
+        send_join();
+        break;
+    case WStype_DISCONNECTED:
+        if (joined)
+            LOG_WARN(LOG_MODULE_NETWORK, "Realtime: disconnected, polling every %d s", REALTIME_POLL_INTERVAL_MS / 1000);
+        joined = false;
+        break;
+    case WStype_TEXT:
+        handle_message(payload, length);
+        break;
+    default:
+        break;
+    }
+}
+
+void RealtimeSync::handle_message(const uint8_t *payload, size_t length)
+{
+    HeapScope heap_scope(HEAP_REALTIME);
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, payload, length);
+    if (error)
+    {
+        LOG_WARN(LOG_MODULE_NETWORK, "Realtime: unreadable message (%s)", error.c_str());
+        return;
+    }
+
+    const char *event = doc["event"] | "";
+    if (strcmp(event, "phx_reply") == 0)
+    {
+        if (join_ref != (doc["ref"] | ""))
+            return;
+
+        if (strcmp(doc["payload"]["status"] | "", "ok") == 0)
+        {
+            joined = true;
+            last_heartbeat = millis();
+            LOG_INFO(LOG_MODULE_NETWORK, "Realtime: subscribed to alarm changes");
+            // Catch up on whatever changed while there was no subscription
+            poll_changes();
+        }
+        else
+        {
+            LOG_WARN(LOG_MODULE_NETWORK, "Realtime: join rejected: %.80s", (const char *)(doc["payload"]["response"]["reason"] | ""));
+        }
+    }
+    else if (strcmp(event, "postgres_changes") == 0)
+    {
+        JsonObjectConst data = doc["payload"]["data"];
+        const char *change = data["type"] | "";
+        if (strcmp(change, "DELETE") == 0)
+        {
+            AlarmManager::remove_remote_alarm(data["old_record"]["id"] | 0);
+        }
+        else if (strcmp(change, "INSERT") == 0 || strcmp(change, "UPDATE") == 0)
+        {
+            advance_watermark(data["record"]["updated_at"] | "");
+            AlarmManager::apply_remote_row(data["record"]);
+        }
+    }
+    else if (strcmp(event, "phx_error") == 0 || strcmp(event, "phx_close") == 0)
+    {
+        LOG_WARN(LOG_MODULE_NETWORK, "Realtime: channel closed (%s), rejoining", event);
+        joined = false;
+        send_join();
+    }
+}
+
+void RealtimeSync::send_join()
+{
+    JsonDocument doc;
+    join_ref = String(++message_ref);
+    doc["topic"] = topic;
+    doc["event"] = "phx_join";
+    doc["ref"] = join_ref;
+    doc["join_ref"] = join_ref;
+
+    JsonObject payload = doc["payload"].to<JsonObject>();
+    payload["access_token"] = SUPABASE_KEY;
+    JsonObject changes = payload["config"]["postgres_changes"].add<JsonObject>();
+    changes["event"] = "*";
+    changes["schema"] = "public";
+    changes["table"] = "alarms";
+    changes["filter"] = "device_id=eq." + NetworkManager::get_device_id();
+
+    String text;
+    serializeJson(doc, text);
+    socket.sendTXT(text);
+}
+
+void RealtimeSync::send_heartbeat()
+{
+    // Phoenix drops channels that miss heartbeats, independent of WebSocket pings
+    char text[80];
+    snprintf(text, sizeof(text), "{\"topic\":\"phoenix\",\"event\":\"heartbeat\",\"payload\":{},\"ref\":\"%lu\"}",
+             (unsigned long)++message_ref);
+    socket.sendTXT(text);
+    last_heartbeat = millis();
+}
+
+void RealtimeSync::poll_changes()
+{
+    if (!NetworkManager::wifi_connected)
+        return;
+
+    HeapScope heap_scope(HEAP_REALTIME);
+    ScratchText body(HEAP_REALTIME);
+    if (!body.ok())
+        return;
+
+    String device_filter = "&device_id=eq." + NetworkManager::get_device_id();
+    String since = watermark;
+    since.replace("+", "%2B");
+
+    int status = Database::select_rows("alarms", "select=" ALARM_COLUMNS + device_filter + "&updated_at=gt." + since +
+                                                     "&order=updated_at.asc&limit=" + String(MAX_ALARMS),
+                                       body.text());
+    JsonDocument rows;
+    if (status != 200 || deserializeJson(rows, body.text().c_str(), body.text().length()) || !rows.is<JsonArray>())
+    {
+        LOG_WARN(LOG_MODULE_NETWORK, "Delta poll failed (%d)", status);
+        return;
+    }
+
+    int changed = 0;
+    for (JsonObjectConst row : rows.as<JsonArrayConst>())
+    {
+        advance_watermark(row["updated_at"] | "");
+        AlarmManager::apply_remote_row(row);
+        changed++;
+    }
+
+    // Same ordering and limit as the full fetch, so both agree on which rows the device keeps
+    status = Database::select_rows("alarms", "select=id" + device_filter + "&order=is_enabled.desc,updated_at.desc&limit=" + String(MAX_ALARMS), body.text());
+    if (status == 200 && !deserializeJson(rows, body.text().c_str(), body.text().length()) && rows.is<JsonArray>())
+        AlarmManager::retain_remote_ids(rows.as<JsonArrayConst>());
+
+    LOG_DEBUG(LOG_MODULE_NETWORK, "Delta poll: %d changed alarms since %s", changed, watermark);
+}
+
+void RealtimeSync::advance_watermark(const char *updated_at)
+{
+    // PostgREST and Realtime emit one fixed timestamp format, so later times also sort later as strings
+    if (strcmp(updated_at, watermark) > 0)
+    {
+        strncpy(watermark, updated_at, sizeof(watermark) - 1);
+        watermark[sizeof(watermark) - 1] = '\0';
+    }
+}
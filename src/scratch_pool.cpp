@@ -0,0 +1,101 @@
+#include "scratch_pool.h"
+#include "metrics.h"
+#include "logger.h"
+#include "config.h"
+#include <atomic>
+
+static_assert(SCRATCH_BLOCKS > 0 && SCRATCH_BLOCKS <= 32, "ScratchPool tracks its blocks in one 32-bit mask");
+
+static const uint32_t ALL_BLOCKS = (uint32_t)((1ULL << SCRATCH_BLOCKS) - 1);
+
+char *ScratchPool::blocks = nullptr;
+
+static std::atomic<uint32_t> busy_blocks(0);
+static uint32_t acquired_total[HEAP_SUBSYSTEM_COUNT];
+static uint32_t exhausted_total[HEAP_SUBSYSTEM_COUNT];
+static uint32_t in_use_max = 0;
+static size_t used_max = 0;
+
+// Called first thing in setup(), while the heap is still in one piece
+void ScratchPool::init()
+{
+    if (blocks != nullptr)
+        return;
+
+    blocks = (char *)malloc(SCRATCH_BLOCK_SIZE * SCRATCH_BLOCKS);
+    if (blocks == nullptr)
+        LOG_ERROR(LOG_MODULE_SYSTEM, "Scratch pool of %u bytes could not be allocated", SCRATCH_BLOCK_SIZE * SCRATCH_BLOCKS);
+}
+
+// Returns nullptr when every block is in use; callers fail the request
+// rather than fall back to the heap
+char *ScratchPool::acquire(HeapSubsystem owner)
+{
+    uint32_t busy = busy_blocks.load();
+    while (blocks != nullptr && (~busy & ALL_BLOCKS) != 0)
+    {
+        int index = __builtin_ctz(~busy & ALL_BLOCKS);
+        if (busy_blocks.compare_exchange_weak(busy, busy | (1UL << index)))
+        {
+            acquired_total[owner]++;
+            in_use_max = max(in_use_max, (uint32_t)__builtin_popcount(busy) + 1);
+            return blocks + index * SCRATCH_BLOCK_SIZE;
+        }
+    }
+
+    exhausted_total[owner]++;
+    LOG_WARN(LOG_MODULE_SYSTEM, "No scratch block free for %s", HeapMonitor::subsystem_name(owner));
+    return nullptr;
+}
+
+void ScratchPool::release(char *block, size_t used)
+{
+    if (block == nullptr)
+        return;
+
+    used_max = max(used_max, used);
+    int index = (block - blocks) / SCRATCH_BLOCK_SIZE;
+    busy_blocks.fetch_and(~(1UL << index));
+}
+
+size_t ScratchPool::block_size()
+{
+    return SCRATCH_BLOCK_SIZE;
+}
+
+void ScratchPool::append_metrics(TextWriter &out)
+{
+    Metrics::gauge(out, "sunrise_scratch_blocks_in_use", "Scratch blocks currently held", __builtin_popcount(busy_blocks.load()));
+    Metrics::gauge(out, "sunrise_scratch_blocks_in_use_max", "Most scratch blocks held at once since boot", in_use_max);
+    Metrics::gauge(out, "sunrise_scratch_used_bytes_max", "Most bytes written to one scratch block since boot", used_max);
+
+    Metrics::family(out, "sunrise_scratch_acquired_total", "counter", "Scratch blocks handed out since boot");
+    for (int i = 0; i < HEAP_SUBSYSTEM_COUNT; i++)
+        Metrics::sample(out, "sunrise_scratch_acquired_total", "subsystem", HeapMonitor::subsystem_name((HeapSubsystem)i), acquired_total[i]);
+    Metrics::family(out, "sunrise_scratch_exhausted_total", "counter", "Scratch blocks asked for while all were in use since boot");
+    for (int i = 0; i < HEAP_SUBSYSTEM_COUNT; i++)
+        Metrics::sample(out, "sunrise_scratch_exhausted_total", "subsystem", HeapMonitor::subsystem_name((HeapSubsystem)i), exhausted_total[i]);
+}
+
+void ScratchPool::to_json(JsonObject out)
+{
+    out["block_size"] = SCRATCH_BLOCK_SIZE;
+    out["blocks"] = SCRATCH_BLOCKS;
+    out["in_use"] = __builtin_popcount(busy_blocks.load());
+    out["in_use_max"] = in_use_max;
+    out["used_max"] = used_max;
+    uint32_t exhausted = 0;
+    for (int i = 0; i < HEAP_SUBSYSTEM_COUNT; i++)
+        exhausted += exhausted_total[i];
+    out["exhausted"] = exhausted;
+}
+
+ScratchText::ScratchText(HeapSubsystem owner)
+    : block(ScratchPool::acquire(owner)), writer(block, block != nullptr ? SCRATCH_BLOCK_SIZE : 0)
+{
+}
+
+ScratchText::~ScratchText()
+{
+    ScratchPool::release(block, writer.length());
+}
@@ -0,0 +1,231 @@
+#include "stall_monitor.h"
+#include "metrics.h"
+#include "logger.h"
+#include "config.h"
+
+// Upper bounds of the stall histogram buckets in ms; every stall is over STALL_BUDGET_MS
+static const uint32_t stall_bounds[] = {100, 250, 500, 1000, 2500, 5000, 10000};
+#define STALL_BUCKET_COUNT (sizeof(stall_bounds) / sizeof(stall_bounds[0]))
+
+// Sunrise frames are drawn by the loop task, so what blocks the loop makes them late
+static const StallSource tag_source[STALL_SOURCE_COUNT] = {STALL_LOOP, STALL_LOOP, STALL_ASYNC};
+
+struct StallWatch
+{
+    bool stalled;
+    uint32_t since; // When the missed beat was due
+    uint32_t beats;
+    uint16_t tag_samples[STALL_TAG_COUNT];
+};
+
+struct SourceStallStats
+{
+    uint32_t counts[STALL_BUCKET_COUNT + 1];
+    uint32_t total_ms;
+    uint32_t max_ms;
+};
+
+struct TagStallStats
+{
+    uint32_t stalls;
+    uint32_t total_ms;
+};
+
+Heartbeat StallMonitor::heartbeats[STALL_SOURCE_COUNT];
+TaskHandle_t StallMonitor::task_handle = nullptr;
+
+// Only the monitor task writes these
+static StallWatch watches[STALL_SOURCE_COUNT];
+static SourceStallStats source_stats[STALL_SOURCE_COUNT];
+static TagStallStats tag_stats[STALL_TAG_COUNT];
+
+// The calling task is the loop; sunrise frames and the web server are idle until they first beat
+void StallMonitor::begin()
+{
+    beat(STALL_LOOP);
+    pause(STALL_RENDER);
+    pause(STALL_ASYNC);
+    if (task_handle == nullptr)
+    {
+        // Above the loop task, so a loop that never yields is still seen stalling
+        xTaskCreatePinnedToCore(monitor_task, "stall_monitor", STALL_MONITOR_STACK_SIZE, nullptr,
+                                tskIDLE_PRIORITY + 2, &task_handle, tskNO_AFFINITY);
+    }
+}
+
+// The next beat of source is due within allowance_ms, plus STALL_BUDGET_MS
+void StallMonitor::beat(StallSource source, uint32_t allowance_ms)
+{
+    Heartbeat &heartbeat = heartbeats[source];
+    uint32_t now = millis();
+    if (!heartbeat.paused && (int32_t)(now - heartbeat.expected_ms) > STALL_BUDGET_MS)
+        heartbeat.resumed_ms = now;
+    heartbeat.expected_ms = now + allowance_ms;
+    heartbeat.paused = false;
+    heartbeat.beats++;
+}
+
+// A last beat, after which source is not expected to beat until it starts again
+void StallMonitor::pause(StallSource source)
+{
+    beat(source);
+    heartbeats[source].paused = true;
+}
+
+void StallMonitor::monitor_task(void *)
+{
+    for (;;)
+    {
+        vTaskDelay(pdMS_TO_TICKS(STALL_SAMPLE_MS));
+        uint32_t now = millis();
+        for (int i = 0; i < STALL_SOURCE_COUNT; i++)
+        {
+            check((StallSource)i, now);
+        }
+    }
+}
+
+// A stall ends with the first beat after it, or when its source pauses. Its
+// tag is the one its task was seen in most often while it lasted.
+void StallMonitor::check(StallSource source, uint32_t now)
+{
+    const Heartbeat &heartbeat = heartbeats[source];
+    StallWatch &watch = watches[source];
+    bool overdue = !heartbeat.paused && (int32_t)(now - heartbeat.expected_ms) > STALL_BUDGET_MS;
+
+    if (watch.stalled && (!overdue || heartbeat.beats != watch.beats))
+    {
+        uint32_t resumed = heartbeat.resumed_ms;
+        uint32_t end = (int32_t)(resumed - watch.since) > 0 ? resumed : now;
+        int tag = 0;
+        for (int i = 1; i < STALL_TAG_COUNT; i++)
+        {
+            if (watch.tag_samples[i] > watch.tag_samples[tag])
+                tag = i;
+        }
+        record(source, end - watch.since, (StallTag)tag);
+        watch.stalled = false;
+    }
+
+    if (!watch.stalled && overdue)
+    {
+        watch.stalled = true;
+        watch.since = heartbeat.expected_ms;
+        watch.beats = heartbeat.beats;
+        memset(watch.tag_samples, 0, sizeof(watch.tag_samples));
+    }
+    if (watch.stalled)
+    {
+        StallTag tag = heartbeats[tag_source[source]].tag;
+        if (watch.tag_samples[tag] < UINT16_MAX)
+            watch.tag_samples[tag]++;
+    }
+}
+
+void StallMonitor::record(StallSource source, uint32_t duration_ms, StallTag tag)
+{
+    SourceStallStats &stats = source_stats[source];
+    size_t bucket = 0;
+    while (bucket < STALL_BUCKET_COUNT && duration_ms > stall_bounds[bucket])
+        bucket++;
+    stats.counts[bucket]++;
+    stats.total_ms += duration_ms;
+    stats.max_ms = max(stats.max_ms, duration_ms);
+    tag_stats[tag].stalls++;
+    tag_stats[tag].total_ms += duration_ms;
+
+    if (duration_ms >= STALL_LOG_MS)
+        LOG_WARN(LOG_MODULE_SYSTEM, "%s stalled for %lu ms in %s", source_name(source), (unsigned long)duration_ms, tag_name(tag));
+}
+
+void StallMonitor::append_metrics(TextWriter &out)
+{
+    const char *name = "sunrise_stall_duration_ms";
+    Metrics::family(out, name, "histogram", "How late heartbeats came that were over STALL_BUDGET_MS late");
+    for (int i = 0; i < STALL_SOURCE_COUNT; i++)
+    {
+        Metrics::histogram(out, name, "source", source_name((StallSource)i), stall_bounds, source_stats[i].counts,
+                           STALL_BUCKET_COUNT, source_stats[i].total_ms);
+    }
+
+    Metrics::family(out, "sunrise_stall_max_ms", "gauge", "Longest stall since boot");
+    for (int i = 0; i < STALL_SOURCE_COUNT; i++)
+        Metrics::sample(out, "sunrise_stall_max_ms", "source", source_name((StallSource)i), source_stats[i].max_ms);
+
+    // A stall still going on is not in the histogram yet
+    uint32_t now = millis();
+    Metrics::family(out, "sunrise_stall_ongoing_ms", "gauge", "How long the current stall has lasted, 0 if none");
+    for (int i = 0; i < STALL_SOURCE_COUNT; i++)
+    {
+        uint32_t ongoing = watches[i].stalled ? now - watches[i].since : 0;
+        Metrics::sample(out, "sunrise_stall_ongoing_ms", "source", source_name((StallSource)i), ongoing);
+    }
+
+    Metrics::family(out, "sunrise_heartbeats_total", "counter", "Heartbeats since boot");
+    for (int i = 0; i < STALL_SOURCE_COUNT; i++)
+        Metrics::sample(out, "sunrise_heartbeats_total", "source", source_name((StallSource)i), heartbeats[i].beats);
+
+    Metrics::family(out, "sunrise_stalls_total", "counter", "Stalls since boot by the blocking call they happened in");
+    for (int i = 0; i < STALL_TAG_COUNT; i++)
+        Metrics::sample(out, "sunrise_stalls_total", "tag", tag_name((StallTag)i), tag_stats[i].stalls);
+
+    Metrics::family(out, "sunrise_stall_ms_total", "counter", "Time stalled since boot by the blocking call it happened in");
+    for (int i = 0; i < STALL_TAG_COUNT; i++)
+        Metrics::sample(out, "sunrise_stall_ms_total", "tag", tag_name((StallTag)i), tag_stats[i].total_ms);
+}
+
+const char *StallMonitor::source_name(StallSource source)
+{
+    switch (source)
+    {
+    case STALL_LOOP:
+        return "loop";
+    case STALL_RENDER:
+        return "render";
+    case STALL_ASYNC:
+        return "async";
+    default:
+        return "unknown";
+    }
+}
+
+const char *StallMonitor::tag_name(StallTag tag)
+{
+    switch (tag)
+    {
+    case STALL_TAG_CONNECT_WIFI:
+        return "connect_wifi";
+    case STALL_TAG_SYNC_TIME:
+        return "sync_time";
+    case STALL_TAG_BUTTON_FEEDBACK:
+        return "button_feedback";
+    case STALL_TAG_OTA:
+        return "ota";
+    case STALL_TAG_OTA_ERROR:
+        return "ota_error";
+    case STALL_TAG_LOOP_WAIT:
+        return "loop_wait";
+    case STALL_TAG_WEB_LED:
+        return "web_led";
+    default:
+        return "untagged";
+    }
+}
+
+StallScope::StallScope(StallSource source, StallTag tag) : source(source)
+{
+    Heartbeat &heartbeat = StallMonitor::heartbeats[source];
+    previous = heartbeat.tag;
+    was_paused = heartbeat.paused;
+    StallMonitor::beat(source);
+    heartbeat.tag = tag;
+}
+
+StallScope::~StallScope()
+{
+    if (was_paused)
+        StallMonitor::pause(source);
+    else
+        StallMonitor::beat(source);
+    StallMonitor::heartbeats[source].tag = previous;
+}
@@ -0,0 +1,468 @@
+#include "sunrise_compositor.h"
+#include "logger.h"
+
+// {first LED, LED count, origin} of zones 1 and up
+static const int led_zones[][3] = LED_ZONES;
+
+static CRGB16 to_crgb16(const CRGB &color)
+{
+    CRGB16 wide = {(uint16_t)(color.r * 257), (uint16_t)(color.g * 257), (uint16_t)(color.b * 257)};
+    return wide;
+}
+
+void SunriseCompositor::begin(Composition &composition, CRGB16 *frame, int num_leds, int zone_capacity)
+{
+    composition.frame = frame;
+    composition.layer = new CRGB16[num_leds];
+    composition.owner = new uint8_t[num_leds];
+    memset(composition.owner, SUNRISE_NO_OWNER, num_leds);
+    composition.num_leds = num_leds;
+    composition.zones = new SunriseZone[zone_capacity];
+    composition.zone_count = 0;
+    composition.zone_capacity = zone_capacity;
+    for (int i = 0; i < MAX_CONCURRENT_SUNRISES; i++)
+    {
+        composition.instances[i].state = SUNRISE_IDLE;
+        composition.instances[i].dismiss = DISMISS_NONE;
+        composition.instances[i].curve = nullptr;
+    }
+}
+
+// Zone 0 is the whole strip in LED_ROWS rows, the configured LED_ZONES follow
+void SunriseCompositor::begin_strip(Composition &composition, CRGB16 *frame, int num_leds)
+{
+    int zone_count = sizeof(led_zones) / sizeof(led_zones[0]);
+    begin(composition, frame, num_leds, zone_count + 1);
+    add_zone(composition, 0, num_leds, LED_ROWS, SUNRISE_ORIGIN);
+    for (int i = 0; i < zone_count; i++)
+    {
+        add_zone(composition, led_zones[i][0], led_zones[i][1], 1, led_zones[i][2]);
+    }
+}
+
+// Drops whatever is still playing without reporting it; the frame belongs to the caller
+void SunriseCompositor::release(Composition &composition)
+{
+    for (int i = 0; i < MAX_CONCURRENT_SUNRISES; i++)
+    {
+        SunriseInstance &instance = composition.instances[i];
+        if (instance.state == SUNRISE_PLAYING)
+            SunriseScene::close(instance.scene);
+        instance.state = SUNRISE_IDLE;
+        delete instance.curve;
+        instance.curve = nullptr;
+    }
+    for (int i = 0; i < composition.zone_count; i++)
+    {
+        SunriseCurve::free_layout(composition.zones[i].layout);
+    }
+    delete[] composition.zones;
+    delete[] composition.owner;
+    delete[] composition.layer;
+    composition.zones = nullptr;
+    composition.zone_count = 0;
+}
+
+// Zones that reach past the strip are cut off at its end
+bool SunriseCompositor::add_zone(Composition &composition, int first, int count, int rows, int origin)
+{
+    if (composition.zone_count >= composition.zone_capacity || first < 0 || first >= composition.num_leds || count <= 0)
+    {
+        LOG_WARN(LOG_MODULE_LED, "Ignoring LED zone %d at LED %d", composition.zone_count, first);
+        return false;
+    }
+
+    SunriseZone &zone = composition.zones[composition.zone_count++];
+    zone.first = first;
+    zone.count = min(count, composition.num_leds - first);
+    zone.layout.band = nullptr;
+    SunriseCurve::build_layout(zone.count, rows, origin, zone.layout);
+    return true;
+}
+
+// The slot's curve is allocated the first time it is used and kept, so
+// later alarms do not allocate at alarm time
+SunriseInstance *SunriseCompositor::claim(Composition &composition)
+{
+    for (int i = 0; i < MAX_CONCURRENT_SUNRISES; i++)
+    {
+        SunriseInstance &instance = composition.instances[i];
+        if (instance.state != SUNRISE_IDLE)
+            continue;
+        if (instance.curve == nullptr)
+            instance.curve = new SunriseLut();
+        return &instance;
+    }
+    return nullptr;
+}
+
+// The caller fills in the claimed instance's alarm, zone, preset, curve,
+// duration and brightness first
+void SunriseCompositor::start(Composition &composition, SunriseInstance &instance, uint32_t now)
+{
+    if (instance.zone < 0 || instance.zone >= composition.zone_count)
+    {
+        LOG_WARN(LOG_MODULE_LED, "Alarm %d has no LED zone %d, using the whole strip", instance.alarm_id, instance.zone);
+        instance.zone = 0;
+    }
+
+    instance.dismiss = DISMISS_NONE;
+    instance.started = now;
+    instance.segment_index = 0;
+    SunriseScene::open(instance.scene);
+    instance.state = SUNRISE_PLAYING;
+    if (!next_segment(instance, now))
+    {
+        end(composition, instance);
+        return;
+    }
+    update_coverage(composition);
+}
+
+// Draws one frame of every playing sunrise and returns how long it may be
+// held, the shortest hold any of them asks for. Sunrises whose scene ran out
+// or that were dismissed end here, and their LEDs go dark.
+uint32_t SunriseCompositor::render(Composition &composition, uint32_t now)
+{
+    uint32_t hold = UINT32_MAX;
+    for (int i = 0; i < MAX_CONCURRENT_SUNRISES; i++)
+    {
+        SunriseInstance &instance = composition.instances[i];
+        if (instance.state != SUNRISE_PLAYING)
+            continue;
+        if (instance.dismiss != DISMISS_NONE || (instance.segment_done && !next_segment(instance, now)))
+        {
+            end(composition, instance);
+            continue;
+        }
+
+        const SunriseZone &zone = composition.zones[instance.zone];
+        if (instance.exclusive)
+        {
+            hold = min(hold, draw(instance, zone, composition.frame + zone.first, now));
+        }
+        else
+        {
+            hold = min(hold, draw(instance, zone, composition.layer + zone.first, now));
+            blend(composition, i, zone);
+        }
+    }
+    return hold == UINT32_MAX ? 0 : hold;
+}
+
+SunriseInstance *SunriseCompositor::take_ended(Composition &composition)
+{
+    for (int i = 0; i < MAX_CONCURRENT_SUNRISES; i++)
+    {
+        if (composition.instances[i].state == SUNRISE_ENDED)
+        {
+            composition.instances[i].state = SUNRISE_IDLE;
+            return &composition.instances[i];
+        }
+    }
+    return nullptr;
+}
+
+// Only sets flags so the input engine's esp_timer task can call it mid-frame (the
+// button ISR only queues edges); zone -1 dismisses every sunrise
+void SunriseCompositor::dismiss(Composition &composition, DismissSource source, int zone)
+{
+    for (int i = 0; i < MAX_CONCURRENT_SUNRISES; i++)
+    {
+        SunriseInstance &instance = composition.instances[i];
+        if (instance.state == SUNRISE_PLAYING && (zone < 0 || instance.zone == zone))
+            instance.dismiss = source;
+    }
+}
+
+bool SunriseCompositor::is_playing(const Composition &composition)
+{
+    for (int i = 0; i < MAX_CONCURRENT_SUNRISES; i++)
+    {
+        if (composition.instances[i].state == SUNRISE_PLAYING)
+            return true;
+    }
+    return false;
+}
+
+bool SunriseCompositor::dismiss_pending(const Composition &composition)
+{
+    for (int i = 0; i < MAX_CONCURRENT_SUNRISES; i++)
+    {
+        if (composition.instances[i].state == SUNRISE_PLAYING && composition.instances[i].dismiss != DISMISS_NONE)
+            return true;
+    }
+    return false;
+}
+
+int SunriseCompositor::lit_leds(const Composition &composition)
+{
+    int lit = 0;
+    for (int i = 0; i < MAX_CONCURRENT_SUNRISES; i++)
+    {
+        if (composition.instances[i].state == SUNRISE_PLAYING)
+            lit += composition.zones[composition.instances[i].zone].count;
+    }
+    return lit;
+}
+
+bool SunriseCompositor::next_segment(SunriseInstance &instance, uint32_t now)
+{
+    SceneSegment &segment = instance.segment;
+    if (!SunriseScene::next(instance.scene, segment))
+        return false;
+
+    instance.segment_length = SunriseScene::segment_length_ms(segment, instance.duration_ms);
+    instance.segment_started = now;
+    instance.segment_done = false;
+    LOG_DEBUG(LOG_MODULE_LED, "Zone %d scene segment %d for %lu ms", instance.zone, instance.segment_index++,
+              (unsigned long)instance.segment_length);
+
+    CRGB16 curve_end = SunriseCurve::sample(*instance.curve, 1.0f);
+    instance.from = segment.from_color == SCENE_COLOR_CURVE_END ? curve_end : to_crgb16(segment.from);
+    instance.to = segment.to_color == SCENE_COLOR_CURVE_END ? curve_end : to_crgb16(segment.to);
+
+    // Opcodes other than shimmer map onto the preset effects they share code with
+    instance.effects = 0;
+    instance.shimmer = false;
+    for (int i = 0; i < segment.effect_count; i++)
+    {
+        switch (segment.effects[i])
+        {
+        case SCENE_EFFECT_PRESET:
+            instance.effects |= instance.preset.effects;
+            break;
+        case SCENE_EFFECT_BREATHING:
+            instance.effects |= PRESET_EFFECT_BREATHING;
+            break;
+        case SCENE_EFFECT_SPARKLE:
+            instance.effects |= PRESET_EFFECT_SPARKLE;
+            break;
+        case SCENE_EFFECT_WARMTH:
+            instance.effects |= PRESET_EFFECT_WARMTH;
+            break;
+        case SCENE_EFFECT_WAVE:
+            instance.effects |= PRESET_EFFECT_WAVE;
+            break;
+        case SCENE_EFFECT_SHIMMER:
+            instance.shimmer = true;
+            break;
+        }
+    }
+    return true;
+}
+
+void SunriseCompositor::end(Composition &composition, SunriseInstance &instance)
+{
+    SunriseScene::close(instance.scene);
+    instance.state = SUNRISE_ENDED;
+    update_coverage(composition);
+
+    if (instance.dismiss != DISMISS_NONE)
+    {
+        LOG_INFO(LOG_MODULE_LED, "Sunrise in zone %d %s by user (%s) in scene segment %d", instance.zone,
+                 instance.dismiss == DISMISS_SNOOZE ? "snoozed" : "dismissed",
+                 instance.dismiss == DISMISS_WEB ? "web" : "button", instance.segment_index - 1);
+    }
+    else
+    {
+        LOG_INFO(LOG_MODULE_LED, "Sunrise in zone %d completed", instance.zone);
+    }
+}
+
+// Runs only when a sunrise starts or ends. LEDs that no sunrise covers any
+// more are cleared once here, so frames never have to touch them.
+void SunriseCompositor::update_coverage(Composition &composition)
+{
+    const uint8_t uncovered = SUNRISE_NO_OWNER - 1;
+    uint8_t *owner = composition.owner;
+    for (int i = 0; i < composition.num_leds; i++)
+    {
+        if (owner[i] != SUNRISE_NO_OWNER)
+            owner[i] = uncovered;
+    }
+
+    for (int i = 0; i < MAX_CONCURRENT_SUNRISES; i++)
+    {
+        SunriseInstance &instance = composition.instances[i];
+        if (instance.state != SUNRISE_PLAYING)
+            continue;
+
+        const SunriseZone &zone = composition.zones[instance.zone];
+        instance.exclusive = true;
+        for (int led = zone.first; led < zone.first + zone.count; led++)
+        {
+            if (owner[led] == SUNRISE_NO_OWNER || owner[led] == uncovered)
+            {
+                owner[led] = i;
+            }
+            else
+            {
+                instance.exclusive = false;
+                composition.instances[owner[led]].exclusive = false;
+            }
+        }
+    }
+
+    for (int i = 0; i < composition.num_leds; i++)
+    {
+        if (owner[i] == uncovered)
+        {
+            owner[i] = SUNRISE_NO_OWNER;
+            composition.frame[i] = CRGB16();
+        }
+    }
+}
+
+// The instance that owns an LED is drawn first and stores it; the others
+// add their light, as two lamps on one spot would
+void SunriseCompositor::blend(Composition &composition, uint8_t index, const SunriseZone &zone)
+{
+    const uint8_t *owner = composition.owner + zone.first;
+    const CRGB16 *layer = composition.layer + zone.first;
+    CRGB16 *frame = composition.frame + zone.first;
+    for (int i = 0; i < zone.count; i++)
+    {
+        if (owner[i] == index)
+        {
+            frame[i] = layer[i];
+        }
+        else
+        {
+            frame[i].r = min(65535, frame[i].r + layer[i].r);
+            frame[i].g = min(65535, frame[i].g + layer[i].g);
+            frame[i].b = min(65535, frame[i].b + layer[i].b);
+        }
+    }
+}
+
+// Frames are built in 16 bits: colors are blended and scaled to the frame's
+// brightness like the curve, and effects draw over the result. Only the
+// LED controller's output reduces them to 8 bits. Effects animate on now
+// rather than millis(), so a frame depends only on its time and the random
+// seed. Returns the hold this instance asks for, 0 once its segment is over.
+uint32_t SunriseCompositor::draw(SunriseInstance &instance, const SunriseZone &zone, CRGB16 *pixels, uint32_t now)
+{
+    const SceneSegment &segment = instance.segment;
+    uint32_t length = instance.segment_length;
+    uint32_t elapsed = now - instance.segment_started;
+    float progress = length > 0 ? min(1.0f, (float)elapsed / length) : 1.0f;
+    float eased = SunriseScene::ease(segment.easing, progress);
+
+    float multiplier = (segment.from_level + (segment.to_level - segment.from_level) * eased) / 255.0f;
+    if (instance.effects & PRESET_EFFECT_BREATHING)
+    {
+        float breathing_multiplier = 1.0f;
+        add_breathing_effect(progress, now, breathing_multiplier);
+        multiplier *= breathing_multiplier;
+    }
+    if (instance.shimmer)
+        multiplier *= 0.95f + 0.1f * sin(now * 0.001f);
+
+    // Scaling in 16 bits avoids a second rounding step in setBrightness()
+    uint8_t brightness = min(255, (int)(instance.max_brightness * multiplier));
+    if (segment.flags & SCENE_SEGMENT_CURVE)
+    {
+        SunriseCurve::render(*instance.curve, zone.layout, eased, brightness, pixels);
+    }
+    else
+    {
+        const CRGB16 &from = instance.from;
+        const CRGB16 &to = instance.to;
+        CRGB16 color;
+        color.r = from.r + (int32_t)((to.r - from.r) * eased);
+        color.g = from.g + (int32_t)((to.g - from.g) * eased);
+        color.b = from.b + (int32_t)((to.b - from.b) * eased);
+        color = SunriseCurve::scale(color, brightness);
+        for (int i = 0; i < zone.count; i++)
+        {
+            pixels[i] = color;
+        }
+    }
+
+    if ((instance.effects & PRESET_EFFECT_SPARKLE) && progress > 0.3f && progress < 0.8f)
+    {
+        add_sparkle_effect(pixels, zone.count, (progress - 0.3f) * 2.0f, scale8(ease8InOutQuad(progress * 255), brightness));
+    }
+
+    if ((instance.effects & PRESET_EFFECT_WARMTH) && progress > 0.5f)
+    {
+        add_warmth_gradient(pixels, zone.count, progress);
+    }
+
+    if (instance.effects & PRESET_EFFECT_WAVE)
+    {
+        add_wave_effect(pixels, zone.count, progress, now);
+    }
+
+    if (instance.shimmer)
+    {
+        float warmth = 0.98f + 0.04f * sin(now * 0.0005f);
+        for (int i = 0; i < zone.count; i++)
+        {
+            pixels[i].r = min(65535, (int)(pixels[i].r * warmth));
+        }
+    }
+
+    if (elapsed >= length)
+    {
+        instance.segment_done = true;
+        return 0;
+    }
+
+    int update_delay = segment.frame_ms > 0 ? segment.frame_ms : (int)(50 + 450 * (1.0f - 4.0f * progress * (1.0f - progress)));
+    return min((uint32_t)update_delay, length - elapsed);
+}
+
+// level keeps sparkles in proportion to the sunrise's current brightness
+void SunriseCompositor::add_sparkle_effect(CRGB16 *pixels, int count, float intensity, uint8_t level)
+{
+    int sparkle_count = (int)(count * 0.1f * intensity);
+
+    for (int i = 0; i < sparkle_count; i++)
+    {
+        int pos = random16(count);
+        if (random8() < 50)
+        {
+            CRGB16 &sparkle_color = pixels[pos];
+            sparkle_color.r = min(65535, sparkle_color.r + scale8(random8(50, 100), level) * 257);
+            sparkle_color.g = min(65535, sparkle_color.g + scale8(random8(30, 70), level) * 257);
+            sparkle_color.b = min(65535, sparkle_color.b + scale8(random8(20, 50), level) * 257);
+        }
+    }
+}
+
+void SunriseCompositor::add_breathing_effect(float progress, uint32_t now, float &brightness_multiplier)
+{
+    float breathing_intensity = 1.0f - (progress * 0.7f);
+    float breathing_cycle = sin(now * 0.002f) * breathing_intensity * 0.1f;
+    brightness_multiplier = 1.0f + breathing_cycle;
+}
+
+void SunriseCompositor::add_warmth_gradient(CRGB16 *pixels, int count, float progress)
+{
+    int center_led = count / 2;
+    float warmth_intensity = (progress - 0.5f) * 2.0f;
+
+    for (int i = 0; i < count; i++)
+    {
+        float distance_from_center = center_led > 0 ? abs(i - center_led) / (float)center_led : 0.0f;
+        float warmth_factor = 1.0f - (distance_from_center * warmth_intensity * 0.3f);
+
+        pixels[i].r = min(65535, (int)(pixels[i].r * (0.8f + warmth_factor * 0.4f)));
+        pixels[i].g = min(65535, (int)(pixels[i].g * (0.9f + warmth_factor * 0.2f)));
+    }
+}
+
+void SunriseCompositor::add_wave_effect(CRGB16 *pixels, int count, float progress, uint32_t now)
+{
+    for (int i = 0; i < count; i++)
+    {
+        float wave1 = sin((i * 0.1f) + (now * 0.003f)) * 0.2f;
+        float wave2 = sin((i * 0.05f) + (now * 0.002f)) * 0.1f;
+        float wave_effect = (wave1 + wave2) * progress;
+
+        pixels[i].b = min(65535, (int)(pixels[i].b * (1.0f + wave_effect)));
+        pixels[i].g = min(65535, (int)(pixels[i].g * (1.0f + wave_effect * 0.5f)));
+    }
+}
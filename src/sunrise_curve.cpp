@@ -0,0 +1,194 @@
+#include "sunrise_curve.h"
+#include "logger.h"
+#include "config.h"
+#include <math.h>
+
+void SunriseCurve::compile(const ColorPreset &preset, SunriseLut &lut)
+{
+    unsigned long start = micros();
+
+    float stage_lab[PRESET_MAX_STAGES][3];
+    for (int i = 0; i < preset.stage_count; i++)
+    {
+        const CRGB &color = preset.stages[i].color;
+        float rgb[3] = {color.r / 255.0f, color.g / 255.0f, color.b / 255.0f};
+        linear_to_oklab(rgb, stage_lab[i]);
+    }
+
+    for (int i = 0; i < SUNRISE_LUT_SIZE; i++)
+    {
+        float progress = (float)i / (SUNRISE_LUT_SIZE - 1);
+
+        // Stage i covers stages[i].duration_percent of the animation, easing into stage i + 1
+        int from = preset.stage_count - 1;
+        float t = 0.0f;
+        float accumulated = 0.0f;
+        for (int s = 0; s < preset.stage_count - 1; s++)
+        {
+            float stage_end = accumulated + preset.stages[s].duration_percent;
+            if (progress <= stage_end)
+            {
+                from = s;
+                t = ease_in_out_quad((progress - accumulated) / preset.stages[s].duration_percent);
+                break;
+            }
+            accumulated = stage_end;
+        }
+        int to = min(from + 1, preset.stage_count - 1);
+
+        float lab[3];
+        for (int c = 0; c < 3; c++)
+        {
+            lab[c] = stage_lab[from][c] + (stage_lab[to][c] - stage_lab[from][c]) * t;
+        }
+
+        float rgb[3];
+        oklab_to_linear(lab, rgb);
+        float level = ease_in_out_quad(progress);
+        uint16_t *out[3] = {&lut.entries[i].r, &lut.entries[i].g, &lut.entries[i].b};
+        for (int c = 0; c < 3; c++)
+        {
+            *out[c] = (uint16_t)(constrain(rgb[c] * level, 0.0f, 1.0f) * 65535.0f + 0.5f);
+        }
+    }
+
+    strncpy(lut.name, preset.name, sizeof(lut.name) - 1);
+    lut.name[sizeof(lut.name) - 1] = '\0';
+    lut.version = preset.version;
+    LOG_DEBUG(LOG_MODULE_LED, "Compiled %s sunrise curve in %lu us", preset.name, micros() - start);
+}
+
+bool SunriseCurve::is_compiled(const SunriseLut &lut, const ColorPreset &preset)
+{
+    return lut.version == preset.version && strcmp(preset.name, lut.name) == 0;
+}
+
+CRGB16 SunriseCurve::sample(const SunriseLut &lut, float progress)
+{
+    if (progress <= 0.0f)
+        return lut.entries[0];
+    if (progress >= 1.0f)
+        return lut.entries[SUNRISE_LUT_SIZE - 1];
+
+    uint32_t position = (uint32_t)(progress * ((SUNRISE_LUT_SIZE - 1) << 8));
+    const CRGB16 &a = lut.entries[position >> 8];
+    const CRGB16 &b = lut.entries[min((position >> 8) + 1, (uint32_t)SUNRISE_LUT_SIZE - 1)];
+    int32_t fraction = position & 0xFF;
+
+    CRGB16 color;
+    color.r = a.r + (((int32_t)b.r - a.r) * fraction >> 8);
+    color.g = a.g + (((int32_t)b.g - a.g) * fraction >> 8);
+    color.b = a.b + (((int32_t)b.b - a.b) * fraction >> 8);
+    return color;
+}
+
+// Same scale as FastLED's setBrightness(), applied before rounding to 8 bits
+CRGB16 SunriseCurve::scale(CRGB16 color, uint8_t brightness)
+{
+    uint32_t factor = brightness + 1;
+    CRGB16 scaled = {(uint16_t)(color.r * factor >> 8), (uint16_t)(color.g * factor >> 8), (uint16_t)(color.b * factor >> 8)};
+    return scaled;
+}
+
+// The strip is taken as rows of LEDs wired in a serpentine, row 0 at the
+// bottom, with equal spacing along and between rows. A single row is a
+// straight strip. The sun comes up on the bottom edge and its light spreads
+// in circles, so each LED's band is its distance from the origin.
+void SunriseCurve::build_layout(int num_leds, int rows, int origin, SunriseLayout &layout)
+{
+    free_layout(layout);
+    layout.num_leds = num_leds;
+    if (origin == SUNRISE_ORIGIN_UNIFORM || num_leds < 2)
+        return;
+
+    layout.band = new uint8_t[num_leds];
+
+    rows = constrain(rows, 1, num_leds);
+    int columns = (num_leds + rows - 1) / rows;
+    float origin_x = origin == SUNRISE_ORIGIN_START ? 0.0f : origin == SUNRISE_ORIGIN_END ? columns - 1 : (columns - 1) / 2.0f;
+
+    float farthest = 0.0f;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        // Bands closer than one LED apart light the same LEDs, so a short
+        // zone samples the curve no more often than it has LEDs across
+        if (pass == 1)
+            layout.band_count = min(min(num_leds, SUNRISE_MAX_BANDS), (int)ceilf(farthest) + 1);
+        for (int i = 0; i < num_leds; i++)
+        {
+            int row = i / columns;
+            int column = row % 2 == 0 ? i % columns : columns - 1 - i % columns;
+            float distance = sqrtf((column - origin_x) * (column - origin_x) + (float)row * row);
+            if (pass == 0)
+                farthest = max(farthest, distance);
+            else
+                layout.band[i] = farthest > 0.0f ? (uint8_t)(distance / farthest * (layout.band_count - 1) + 0.5f) : 0;
+        }
+    }
+}
+
+void SunriseCurve::free_layout(SunriseLayout &layout)
+{
+    delete[] layout.band;
+    layout.band = nullptr;
+    layout.band_count = 1;
+}
+
+void SunriseCurve::render(const SunriseLut &lut, const SunriseLayout &layout, float progress, uint8_t brightness, CRGB16 *frame)
+{
+    if (layout.band_count <= 1)
+    {
+        CRGB16 color = scale(sample(lut, progress), brightness);
+        for (int i = 0; i < layout.num_leds; i++)
+        {
+            frame[i] = color;
+        }
+        return;
+    }
+
+    // Every band runs the whole curve in 1 - SUNRISE_SPREAD of the animation, starting later the farther out it is
+    CRGB16 band_colors[SUNRISE_MAX_BANDS];
+    const float spread = SUNRISE_SPREAD;
+    float delay_step = spread / (layout.band_count - 1);
+    for (int b = 0; b < layout.band_count; b++)
+    {
+        float local = (progress - b * delay_step) / (1.0f - spread);
+        band_colors[b] = scale(sample(lut, local), brightness);
+    }
+
+    for (int i = 0; i < layout.num_leds; i++)
+    {
+        frame[i] = band_colors[layout.band[i]];
+    }
+}
+
+// Matrices from Björn Ottosson, "A perceptual color space for image processing"
+void SunriseCurve::linear_to_oklab(const float rgb[3], float lab[3])
+{
+    float l = cbrtf(0.4122214708f * rgb[0] + 0.5363325363f * rgb[1] + 0.0514459929f * rgb[2]);
+    float m = cbrtf(0.2119034982f * rgb[0] + 0.6806995451f * rgb[1] + 0.1073969566f * rgb[2]);
+    float s = cbrtf(0.0883024619f * rgb[0] + 0.2817188376f * rgb[1] + 0.6299787005f * rgb[2]);
+
+    lab[0] = 0.2104542553f * l + 0.7936177850f * m - 0.0040720468f * s;
+    lab[1] = 1.9779984951f * l - 2.4285922050f * m + 0.4505937099f * s;
+    lab[2] = 0.0259040371f * l + 0.7827717662f * m - 0.8086757660f * s;
+}
+
+void SunriseCurve::oklab_to_linear(const float lab[3], float rgb[3])
+{
+    float l = lab[0] + 0.3963377774f * lab[1] + 0.2158037573f * lab[2];
+    float m = lab[0] - 0.1055613458f * lab[1] - 0.0638541728f * lab[2];
+    float s = lab[0] - 0.0894841775f * lab[1] - 1.2914855480f * lab[2];
+    l = l * l * l;
+    m = m * m * m;
+    s = s * s * s;
+
+    rgb[0] = 4.0767416621f * l - 3.3077115913f * m + 0.2309699292f * s;
+    rgb[1] = -1.2684380046f * l + 2.6097574011f * m - 0.3413193965f * s;
+    rgb[2] = -0.0041960863f * l - 0.7034186147f * m + 1.7076147010f * s;
+}
+
+float SunriseCurve::ease_in_out_quad(float t)
+{
+    return t < 0.5f ? 2.0f * t * t : 1.0f - 2.0f * (1.0f - t) * (1.0f - t);
+}
@@ -0,0 +1,210 @@
+#include "sunrise_scene.h"
+#include "default_scene.h"
+#include "logger.h"
+#include "config.h"
+
+static const char *SCENE_UPLOAD_FILE = "/scene.tmp";
+static const size_t SCENE_HEADER_SIZE = 8;
+static const size_t SCENE_SEGMENT_SIZE = 13; // Fixed part, up to and including the effect count
+
+// Plays SUNRISE_SCENE_FILE if one is installed and readable, the built-in scene otherwise
+void SunriseScene::open(SceneCursor &cursor)
+{
+    if (mount() && LittleFS.exists(SUNRISE_SCENE_FILE) && open_file(SUNRISE_SCENE_FILE, cursor))
+        return;
+
+    cursor.file = File();
+    cursor.data = default_scene;
+    cursor.size = sizeof(default_scene);
+    read_header(cursor);
+}
+
+bool SunriseScene::open_file(const char *path, SceneCursor &cursor)
+{
+    cursor.data = nullptr;
+    if (!mount())
+        return false;
+
+    cursor.file = LittleFS.open(path, FILE_READ);
+    if (!cursor.file)
+        return false;
+
+    cursor.size = cursor.file.size();
+    if (!read_header(cursor))
+    {
+        LOG_WARN(LOG_MODULE_LED, "%s is not a scene file", path);
+        close(cursor);
+        return false;
+    }
+    return true;
+}
+
+// Reads the segment at the cursor and moves past it. Returns false at the
+// end of the scene and for a segment that cannot be played.
+bool SunriseScene::next(SceneCursor &cursor, SceneSegment &segment)
+{
+    uint8_t raw[SCENE_SEGMENT_SIZE];
+    if (cursor.next_segment >= cursor.segment_count || !read(cursor, cursor.position, raw, sizeof(raw)))
+        return false;
+
+    segment.duration = raw[0] | (raw[1] << 8) | (raw[2] << 16) | ((uint32_t)raw[3] << 24);
+    segment.frame_ms = raw[4] | (raw[5] << 8);
+    segment.flags = raw[6];
+    segment.easing = raw[7];
+    segment.from_color = raw[8];
+    segment.to_color = raw[9];
+    segment.from_level = raw[10];
+    segment.to_level = raw[11];
+    segment.effect_count = raw[12];
+
+    if (segment.easing >= SCENE_EASE_COUNT || segment.effect_count > SCENE_MAX_EFFECTS ||
+        !read(cursor, cursor.position + sizeof(raw), segment.effects, segment.effect_count) ||
+        !read_color(cursor, segment.from_color, segment.from) || !read_color(cursor, segment.to_color, segment.to))
+    {
+        LOG_WARN(LOG_MODULE_LED, "Scene segment %u is invalid", cursor.next_segment);
+        return false;
+    }
+
+    for (int i = 0; i < segment.effect_count; i++)
+    {
+        if (segment.effects[i] >= SCENE_EFFECT_COUNT)
+            return false;
+    }
+
+    cursor.position += sizeof(raw) + segment.effect_count;
+    cursor.next_segment++;
+    return true;
+}
+
+void SunriseScene::close(SceneCursor &cursor)
+{
+    if (cursor.file)
+        cursor.file.close();
+    cursor.data = nullptr;
+    cursor.segment_count = 0;
+}
+
+// Reads every segment, so a scene that validates can be played to the end
+bool SunriseScene::validate_file(const char *path, int &segment_count)
+{
+    SceneCursor cursor;
+    if (!open_file(path, cursor))
+        return false;
+
+    SceneSegment segment;
+    while (next(cursor, segment))
+    {
+    }
+    bool valid = cursor.next_segment == cursor.segment_count && cursor.position == cursor.size;
+    segment_count = cursor.segment_count;
+    close(cursor);
+    return valid;
+}
+
+bool SunriseScene::append_upload(size_t index, const uint8_t *data, size_t length)
+{
+    if (!mount())
+        return false;
+
+    File file = LittleFS.open(SCENE_UPLOAD_FILE, index == 0 ? FILE_WRITE : FILE_APPEND);
+    if (!file)
+        return false;
+    bool ok = file.size() == index && file.write(data, length) == length;
+    file.close();
+    return ok;
+}
+
+bool SunriseScene::install_upload(int &segment_count)
+{
+    segment_count = 0;
+    bool valid = validate_file(SCENE_UPLOAD_FILE, segment_count);
+    if (valid)
+    {
+        LittleFS.remove(SUNRISE_SCENE_FILE);
+        valid = LittleFS.rename(SCENE_UPLOAD_FILE, SUNRISE_SCENE_FILE);
+    }
+    if (valid)
+        LOG_INFO(LOG_MODULE_LED, "Installed a scene with %d segments", segment_count);
+    else
+        LittleFS.remove(SCENE_UPLOAD_FILE);
+    return valid;
+}
+
+bool SunriseScene::uninstall()
+{
+    return mount() && (!LittleFS.exists(SUNRISE_SCENE_FILE) || LittleFS.remove(SUNRISE_SCENE_FILE));
+}
+
+float SunriseScene::ease(uint8_t easing, float t)
+{
+    switch (easing)
+    {
+    case SCENE_EASE_IN:
+        return t * t;
+    case SCENE_EASE_OUT:
+        return 1.0f - (1.0f - t) * (1.0f - t);
+    case SCENE_EASE_IN_OUT:
+        return t < 0.5f ? 2.0f * t * t : 1.0f - 2.0f * (1.0f - t) * (1.0f - t);
+    case SCENE_EASE_HOLD:
+        return 0.0f;
+    default:
+        return t;
+    }
+}
+
+uint32_t SunriseScene::segment_length_ms(const SceneSegment &segment, uint32_t sunrise_ms)
+{
+    if (segment.flags & SCENE_SEGMENT_SCALED)
+        return (uint64_t)sunrise_ms * segment.duration / 10000;
+    return segment.duration;
+}
+
+bool SunriseScene::mount()
+{
+    static bool mounted = false;
+    if (!mounted)
+    {
+        mounted = LittleFS.begin(true);
+    }
+    return mounted;
+}
+
+bool SunriseScene::read(SceneCursor &cursor, size_t offset, uint8_t *buffer, size_t length)
+{
+    if (offset + length > cursor.size)
+        return false;
+    if (cursor.data)
+    {
+        memcpy(buffer, cursor.data + offset, length);
+        return true;
+    }
+    return cursor.file.seek(offset) && cursor.file.read(buffer, length) == length;
+}
+
+bool SunriseScene::read_header(SceneCursor &cursor)
+{
+    uint8_t raw[SCENE_HEADER_SIZE];
+    if (!read(cursor, 0, raw, sizeof(raw)))
+        return false;
+
+    uint32_t magic = raw[0] | (raw[1] << 8) | (raw[2] << 16) | ((uint32_t)raw[3] << 24);
+    cursor.palette_size = raw[5];
+    cursor.segment_count = raw[6] | (raw[7] << 8);
+    cursor.palette_offset = SCENE_HEADER_SIZE;
+    cursor.position = SCENE_HEADER_SIZE + 3 * cursor.palette_size;
+    cursor.next_segment = 0;
+    return magic == SCENE_MAGIC && raw[4] == SCENE_FORMAT_VERSION && cursor.segment_count > 0;
+}
+
+// Palette entries are read when a segment starts, so the palette never has to be in RAM
+bool SunriseScene::read_color(SceneCursor &cursor, uint8_t index, CRGB &color)
+{
+    if (index == SCENE_COLOR_CURVE_END)
+        return true;
+
+    uint8_t raw[3];
+    if (index >= cursor.palette_size || !read(cursor, cursor.palette_offset + 3 * index, raw, sizeof(raw)))
+        return false;
+    color = CRGB(raw[0], raw[1], raw[2]);
+    return true;
+}
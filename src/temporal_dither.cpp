@@ -0,0 +1,54 @@
+#include "temporal_dither.h"
+
+// Fewer than one pulse in eight refreshes is seen as a twinkle rather than
+// as a dimmer light, so channels below this stay dark
+static const uint16_t DITHER_MIN_VALUE = 257 / 8;
+
+// A 16-bit value v shows as v / 257 in 8 bits; 65535 maps to 255
+static inline uint8_t dither_channel(uint16_t value, uint16_t &error)
+{
+    if (value < DITHER_MIN_VALUE)
+        return 0;
+    uint32_t total = value + error;
+    uint8_t level = total / 257;
+    error = total - level * 257;
+    return level;
+}
+
+// Random starting errors keep LEDs at the same level from switching in step,
+// which would make the whole strip pulse at the dither rate
+void TemporalDither::reset(uint16_t *error, int count)
+{
+    for (int i = 0; i < count * 3; i++)
+    {
+        error[i] = random16() % 257;
+    }
+}
+
+void TemporalDither::quantize(const CRGB16 *frame, CRGB *leds, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        leds[i] = CRGB((frame[i].r + 128) / 257, (frame[i].g + 128) / 257, (frame[i].b + 128) / 257);
+    }
+}
+
+void TemporalDither::dither(const CRGB16 *frame, uint16_t *error, CRGB *leds, int count)
+{
+    for (int i = 0; i < count; i++, error += 3)
+    {
+        leds[i].r = dither_channel(frame[i].r, error[0]);
+        leds[i].g = dither_channel(frame[i].g, error[1]);
+        leds[i].b = dither_channel(frame[i].b, error[2]);
+    }
+}
+
+uint8_t TemporalDither::peak_level(const CRGB16 *frame, int count)
+{
+    uint16_t peak = 0;
+    for (int i = 0; i < count; i++)
+    {
+        peak = max(peak, max(frame[i].r, max(frame[i].g, frame[i].b)));
+    }
+    return (peak + 128) / 257;
+}
@@ -0,0 +1,72 @@
+#include "text_writer.h"
+#include <stdarg.h>
+
+TextWriter::TextWriter(char *buffer, size_t capacity) : buffer(buffer), size(capacity), used(0), overflow(false)
+{
+    if (size > 0)
+        buffer[0] = '\0';
+}
+
+void TextWriter::append(const char *text)
+{
+    append(text, strlen(text));
+}
+
+void TextWriter::append(const char *text, size_t length)
+{
+    if (size == 0 || used + length >= size)
+    {
+        overflow = true;
+        length = size > used + 1 ? size - used - 1 : 0;
+    }
+    memcpy(buffer + used, text, length);
+    used += length;
+    if (size > 0)
+        buffer[used] = '\0';
+}
+
+void TextWriter::appendf(const char *format, ...)
+{
+    if (size == 0)
+    {
+        overflow = true;
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer + used, size - used, format, args);
+    va_end(args);
+
+    if (length < 0)
+        return;
+    if (used + length >= size)
+    {
+        overflow = true;
+        used = size - 1;
+    }
+    else
+    {
+        used += length;
+    }
+}
+
+size_t TextWriter::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t TextWriter::write(const uint8_t *data, size_t length)
+{
+    size_t before = used;
+    append((const char *)data, length);
+    return used - before;
+}
+
+void TextWriter::clear()
+{
+    used = 0;
+    overflow = false;
+    if (size > 0)
+        buffer[0] = '\0';
+}
@@ -0,0 +1,382 @@
+#include "tls_client.h"
+#include "config.h"
+#include "logger.h"
+
+#define TLS_RECORD_HEADER_SIZE 5
+#define TLS_MESSAGE_HEADER_SIZE 4
+#define TLS_CHANGE_CIPHER_SPEC 20
+#define TLS_HANDSHAKE 22
+#define TLS_CERTIFICATE 11
+
+// Serialized mbedtls session (including the server's ticket) of the last host
+RTC_DATA_ATTR static uint8_t rtc_tls_session[TLS_SESSION_CACHE_SIZE];
+RTC_DATA_ATTR static uint16_t rtc_tls_session_length = 0;
+RTC_DATA_ATTR static char rtc_tls_host[64];
+
+TlsClient::TlsClient()
+    : configured(false), tls_connected(false), peeked(-1), handshake_us(0), last_resumed(false), tracing(false)
+{
+    mbedtls_ssl_init(&ssl);
+    mbedtls_ssl_config_init(&conf);
+    mbedtls_ctr_drbg_init(&drbg);
+    mbedtls_entropy_init(&entropy);
+}
+
+TlsClient::~TlsClient()
+{
+    stop();
+    mbedtls_ssl_free(&ssl);
+    mbedtls_ssl_config_free(&conf);
+    mbedtls_ctr_drbg_free(&drbg);
+    mbedtls_entropy_free(&entropy);
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port)
+{
+    return connect(ip.toString().c_str(), port, DB_TIMEOUT_MS);
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port, int32_t timeout)
+{
+    return connect(ip.toString().c_str(), port, timeout);
+}
+
+int TlsClient::connect(const char *host, uint16_t port)
+{
+    return connect(host, port, DB_TIMEOUT_MS);
+}
+
+int TlsClient::connect(const char *host, uint16_t port, int32_t timeout)
+{
+    stop();
+    if (!configure())
+        return 0;
+
+    if (!WiFiClient::connect(host, port, timeout))
+        return 0;
+
+    if (!handshake(host, timeout))
+    {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+size_t TlsClient::write(uint8_t data)
+{
+    return write(&data, 1);
+}
+
+size_t TlsClient::write(const uint8_t *buf, size_t size)
+{
+    if (!tls_connected)
+        return 0;
+
+    size_t written = 0;
+    uint32_t start = millis();
+    while (written < size)
+    {
+        int ret = mbedtls_ssl_write(&ssl, buf + written, size - written);
+        if (ret > 0)
+        {
+            written += ret;
+        }
+        else if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+        {
+            stop();
+            break;
+        }
+        else if (millis() - start > DB_TIMEOUT_MS)
+        {
+            break;
+        }
+        else
+        {
+            delay(1);
+        }
+    }
+    return written;
+}
+
+int TlsClient::available()
+{
+    if (!tls_connected)
+        return 0;
+
+    // A zero-length read processes one pending record without consuming application data
+    int ret = mbedtls_ssl_read(&ssl, nullptr, 0);
+    if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+    {
+        if (ret != MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY)
+            LOG_DEBUG(LOG_MODULE_NETWORK, "TLS read failed: -0x%04x", -ret);
+        int buffered = mbedtls_ssl_get_bytes_avail(&ssl) + (peeked >= 0 ? 1 : 0);
+        if (buffered == 0)
+            stop();
+        return buffered;
+    }
+    return mbedtls_ssl_get_bytes_avail(&ssl) + (peeked >= 0 ? 1 : 0);
+}
+
+int TlsClient::read()
+{
+    uint8_t data;
+    return read(&data, 1) == 1 ? data : -1;
+}
+
+int TlsClient::read(uint8_t *buf, size_t size)
+{
+    if (size == 0)
+        return 0;
+
+    int copied = 0;
+    if (peeked >= 0)
+    {
+        buf[copied++] = (uint8_t)peeked;
+        peeked = -1;
+        if (size == 1)
+            return copied;
+    }
+
+    if (!tls_connected)
+        return copied > 0 ? copied : -1;
+
+    int ret = mbedtls_ssl_read(&ssl, buf + copied, size - copied);
+    if (ret > 0)
+        return copied + ret;
+    if (ret == 0 || (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE))
+        stop();
+    return copied > 0 ? copied : -1;
+}
+
+int TlsClient::peek()
+{
+    if (peeked < 0)
+    {
+        uint8_t data;
+        if (tls_connected && mbedtls_ssl_read(&ssl, &data, 1) == 1)
+            peeked = data;
+    }
+    return peeked;
+}
+
+void TlsClient::flush()
+{
+}
+
+void TlsClient::stop()
+{
+    if (tls_connected)
+    {
+        mbedtls_ssl_close_notify(&ssl);
+        tls_connected = false;
+    }
+    peeked = -1;
+    WiFiClient::stop();
+
+    // Release the record buffers; they are reallocated by the next handshake
+    mbedtls_ssl_free(&ssl);
+    mbedtls_ssl_init(&ssl);
+}
+
+uint8_t TlsClient::connected()
+{
+    if (!tls_connected)
+        return 0;
+    if (peeked >= 0 || mbedtls_ssl_get_bytes_avail(&ssl) > 0)
+        return 1;
+    return WiFiClient::connected();
+}
+
+uint32_t TlsClient::take_handshake_us()
+{
+    uint32_t duration = handshake_us;
+    handshake_us = 0;
+    return duration;
+}
+
+void TlsClient::forget_session()
+{
+    rtc_tls_session_length = 0;
+}
+
+bool TlsClient::configure()
+{
+    if (configured)
+        return true;
+
+    static const char *personalization = "sunrise_alarm";
+    int ret = mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy,
+                                    (const unsigned char *)personalization, strlen(personalization));
+    if (ret == 0)
+        ret = mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+    if (ret != 0)
+    {
+        LOG_ERROR(LOG_MODULE_NETWORK, "TLS setup failed: -0x%04x", -ret);
+        return false;
+    }
+
+    // Same trust model as the WiFiClientSecure::setInsecure() it replaces
+    mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_NONE);
+    mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &drbg);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets(&conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+    configured = true;
+    return true;
+}
+
+bool TlsClient::handshake(const char *host, int32_t timeout)
+{
+    int ret = mbedtls_ssl_setup(&ssl, &conf);
+    if (ret == 0)
+        ret = mbedtls_ssl_set_hostname(&ssl, host);
+    if (ret != 0)
+    {
+        LOG_ERROR(LOG_MODULE_NETWORK, "TLS setup failed: -0x%04x", -ret);
+        return false;
+    }
+    mbedtls_ssl_set_bio(&ssl, this, bio_send, bio_recv, nullptr);
+
+    bool offered = restore_session(host);
+    uint32_t start = micros();
+    memset(&trace, 0, sizeof(trace));
+    tracing = true;
+
+    while ((ret = mbedtls_ssl_handshake(&ssl)) != 0)
+    {
+        if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+        {
+            tracing = false;
+            LOG_WARN(LOG_MODULE_NETWORK, "TLS handshake with %s failed: -0x%04x", host, -ret);
+            // A stale ticket must not break every following connection
+            if (offered)
+                forget_session();
+            return false;
+        }
+        if (micros() - start > (uint32_t)timeout * 1000)
+        {
+            tracing = false;
+            LOG_WARN(LOG_MODULE_NETWORK, "TLS handshake with %s timed out", host);
+            return false;
+        }
+        delay(1);
+    }
+    tracing = false;
+
+    handshake_us = micros() - start;
+    last_resumed = offered && !trace.certificate_seen;
+    tls_connected = true;
+    save_session(host);
+
+    LOG_DEBUG(LOG_MODULE_NETWORK, "TLS handshake with %s: %lu ms (%s)", host,
+              (unsigned long)(handshake_us / 1000), last_resumed ? "resumed" : "full");
+    return true;
+}
+
+bool TlsClient::restore_session(const char *host)
+{
+    if (rtc_tls_session_length == 0 || strncmp(rtc_tls_host, host, sizeof(rtc_tls_host)) != 0)
+        return false;
+
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    bool restored = mbedtls_ssl_session_load(&session, rtc_tls_session, rtc_tls_session_length) == 0 &&
+                    mbedtls_ssl_set_session(&ssl, &session) == 0;
+    mbedtls_ssl_session_free(&session);
+
+    if (!restored)
+        forget_session();
+    return restored;
+}
+
+void TlsClient::save_session(const char *host)
+{
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    size_t length = 0;
+
+    if (mbedtls_ssl_get_session(&ssl, &session) == 0 &&
+        mbedtls_ssl_session_save(&session, rtc_tls_session, sizeof(rtc_tls_session), &length) == 0)
+    {
+        rtc_tls_session_length = length;
+        strncpy(rtc_tls_host, host, sizeof(rtc_tls_host) - 1);
+        rtc_tls_host[sizeof(rtc_tls_host) - 1] = '\0';
+    }
+    else
+    {
+        rtc_tls_session_length = 0;
+        LOG_DEBUG(LOG_MODULE_NETWORK, "TLS session does not fit TLS_SESSION_CACHE_SIZE, not cached");
+    }
+    mbedtls_ssl_session_free(&session);
+}
+
+int TlsClient::bio_send(void *ctx, const unsigned char *buf, size_t len)
+{
+    TlsClient *client = static_cast<TlsClient *>(ctx);
+    int written = client->WiFiClient::write(buf, len);
+    if (written > 0)
+        return written;
+    return client->WiFiClient::connected() ? MBEDTLS_ERR_SSL_WANT_WRITE : MBEDTLS_ERR_NET_SEND_FAILED;
+}
+
+int TlsClient::bio_recv(void *ctx, unsigned char *buf, size_t len)
+{
+    TlsClient *client = static_cast<TlsClient *>(ctx);
+    if (client->WiFiClient::available() <= 0)
+        return client->WiFiClient::connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+
+    int received = client->WiFiClient::read(buf, len);
+    if (received > 0 && client->tracing)
+        client->trace_records(buf, received);
+    return received > 0 ? received : MBEDTLS_ERR_SSL_WANT_READ;
+}
+
+// mbedtls has no public way to tell a resumed TLS 1.2 handshake from a full
+// one, so the plaintext part of the server's flight is followed here. A full
+// handshake sends the Certificate message, while a resumed one goes from
+// ServerHello straight to ChangeCipherSpec, after which records are encrypted.
+void TlsClient::trace_records(const unsigned char *buf, size_t len)
+{
+    HandshakeTrace &t = trace;
+    for (size_t i = 0; i < len && !t.cipher_changed; i++)
+    {
+        uint8_t byte = buf[i];
+        if (t.record_header_length < TLS_RECORD_HEADER_SIZE)
+        {
+            if (t.record_header_length == 0)
+                t.record_type = byte;
+            else if (t.record_header_length >= 3)
+                t.record_remaining = (t.record_remaining << 8) | byte;
+            if (++t.record_header_length == TLS_RECORD_HEADER_SIZE)
+            {
+                t.cipher_changed = t.record_type == TLS_CHANGE_CIPHER_SPEC;
+                if (t.record_remaining == 0)
+                    t.record_header_length = 0;
+            }
+            continue;
+        }
+
+        // Handshake messages can share a record or span several
+        if (t.record_type == TLS_HANDSHAKE)
+        {
+            if (t.message_header_length < TLS_MESSAGE_HEADER_SIZE)
+            {
+                if (t.message_header_length == 0 && byte == TLS_CERTIFICATE)
+                    t.certificate_seen = true;
+                else if (t.message_header_length > 0)
+                    t.message_remaining = (t.message_remaining << 8) | byte;
+                t.message_header_length++;
+            }
+            else
+            {
+                t.message_remaining--;
+            }
+            if (t.message_header_length == TLS_MESSAGE_HEADER_SIZE && t.message_remaining == 0)
+                t.message_header_length = 0;
+        }
+
+        if (--t.record_remaining == 0)
+            t.record_header_length = 0;
+    }
+}
@@ -0,0 +1,167 @@
+#include "wake_planner.h"
+#include "alarm_manager.h"
+#include "network_manager.h"
+#include "metrics.h"
+#include "logger.h"
+#include "config.h"
+#include <time.h>
+
+WakeKind WakePlanner::wake_kind = WAKE_COLD_BOOT;
+bool WakePlanner::radio_needed = true;
+
+RTC_DATA_ATTR static uint8_t rtc_planned_kind = WAKE_COLD_BOOT;
+RTC_DATA_ATTR static uint32_t rtc_next_sync_at = 0;
+RTC_DATA_ATTR static uint32_t rtc_wakeups_total = 0;
+RTC_DATA_ATTR static uint32_t rtc_radio_wakeups_total = 0;
+RTC_DATA_ATTR static uint32_t rtc_radio_ms_total = 0;
+RTC_DATA_ATTR static uint32_t rtc_sync_radio_ms = 0; // Average radio-on time of sync wakes, 0 until measured
+
+void WakePlanner::begin(esp_sleep_wakeup_cause_t cause)
+{
+    if (cause == ESP_SLEEP_WAKEUP_TIMER)
+        wake_kind = (WakeKind)rtc_planned_kind;
+    else if (cause == ESP_SLEEP_WAKEUP_EXT0)
+        wake_kind = WAKE_BUTTON;
+    else
+        wake_kind = WAKE_COLD_BOOT;
+
+    // An alarm wake only skips WiFi while the RTC clock can be trusted and no sync is overdue
+    time_t now = time(nullptr);
+    radio_needed = wake_kind != WAKE_ALARM || !clock_valid(now) || (uint32_t)now >= rtc_next_sync_at;
+
+    rtc_wakeups_total++;
+    if (radio_needed)
+        rtc_radio_wakeups_total++;
+
+    LOG_INFO(LOG_MODULE_SYSTEM, "Wake reason: %s, WiFi %s", kind_name(wake_kind), radio_needed ? "needed" : "not needed");
+}
+
+void WakePlanner::record_sync(bool success)
+{
+    time_t now = time(nullptr);
+    rtc_next_sync_at = now + (success ? SYNC_INTERVAL_S : SYNC_RETRY_S);
+    if (!success)
+        LOG_WARN(LOG_MODULE_SYSTEM, "Sync failed, retrying in %d s", SYNC_RETRY_S);
+}
+
+// Called with WiFi already off, so this wake's radio time is final
+uint64_t WakePlanner::plan_sleep_us()
+{
+    uint32_t radio_ms = NetworkManager::get_radio_on_ms();
+    rtc_radio_ms_total += radio_ms;
+    if (wake_kind == WAKE_SYNC && radio_ms > 0)
+        rtc_sync_radio_ms = rtc_sync_radio_ms == 0 ? radio_ms : (rtc_sync_radio_ms * 3 + radio_ms) / 4;
+
+    time_t now = time(nullptr);
+    if (!clock_valid(now))
+    {
+        rtc_planned_kind = WAKE_SYNC;
+        LOG_WARN(LOG_MODULE_SYSTEM, "Clock not set, next sync in %d s", SYNC_RETRY_S);
+        return (uint64_t)SYNC_RETRY_S * 1000000ULL;
+    }
+
+    WakeKind kind;
+    time_t wake_at = next_wake(now, rtc_next_sync_at, kind);
+    rtc_planned_kind = kind;
+
+    float wakeups, radio_seconds;
+    estimate_daily(wakeups, radio_seconds);
+    LOG_INFO(LOG_MODULE_SYSTEM, "Next wake: %s in %ld s (radio on %lu ms this wake, plan %.1f wakeups/day, %.0f radio-s/day)",
+             kind_name(kind), (long)(wake_at - now), (unsigned long)radio_ms, wakeups, radio_seconds);
+
+    return (uint64_t)(wake_at - now) * 1000000ULL;
+}
+
+// Replays the plan over the next week, assuming every sync succeeds
+void WakePlanner::estimate_daily(float &wakeups, float &radio_seconds)
+{
+    wakeups = 0;
+    radio_seconds = 0;
+
+    time_t now = time(nullptr);
+    if (!clock_valid(now))
+        return;
+
+    const int days = 7;
+    time_t end = now + days * 86400L;
+    time_t sync_at = max((time_t)rtc_next_sync_at, now);
+    int total = 0, radio = 0;
+
+    for (time_t t = now; total < 1000;)
+    {
+        WakeKind kind;
+        time_t wake_at = next_wake(t, sync_at, kind);
+        if (wake_at > end)
+            break;
+
+        total++;
+        if (wake_at >= sync_at)
+        {
+            radio++;
+            sync_at = wake_at + SYNC_INTERVAL_S;
+        }
+        // Step past the alarm's minute so it is not planned again
+        t = kind == WAKE_ALARM ? wake_at + 60 : wake_at;
+    }
+
+    uint32_t radio_ms = rtc_sync_radio_ms != 0 ? rtc_sync_radio_ms : WAKE_RADIO_ESTIMATE_S * 1000;
+    wakeups = (float)total / days;
+    radio_seconds = (float)radio * radio_ms / 1000.0f / days;
+}
+
+void WakePlanner::append_metrics(TextWriter &out)
+{
+    float wakeups, radio_seconds;
+    estimate_daily(wakeups, radio_seconds);
+    Metrics::gauge(out, "sunrise_planned_wakeups_per_day", "Wakeups per day expected from the current wake plan", wakeups);
+    Metrics::gauge(out, "sunrise_planned_radio_seconds_per_day", "WiFi-on seconds per day expected from the current wake plan", radio_seconds);
+    Metrics::counter(out, "sunrise_wakeups_total", "Boots and deep sleep wakeups since power on", rtc_wakeups_total);
+    Metrics::counter(out, "sunrise_radio_wakeups_total", "Wakeups that powered WiFi since power on", rtc_radio_wakeups_total);
+    Metrics::counter(out, "sunrise_radio_on_seconds_total", "Seconds with WiFi powered since power on",
+                     (rtc_radio_ms_total + NetworkManager::get_radio_on_ms()) / 1000.0);
+}
+
+const char *WakePlanner::kind_name(WakeKind kind)
+{
+    switch (kind)
+    {
+    case WAKE_ALARM:
+        return "alarm";
+    case WAKE_SYNC:
+        return "sync";
+    case WAKE_BUTTON:
+        return "button";
+    default:
+        return "cold boot";
+    }
+}
+
+// Earliest of the next alarm, the sync before it, the periodic sync and a snoozed alarm
+time_t WakePlanner::next_wake(time_t now, time_t sync_at, WakeKind &kind)
+{
+    time_t wake_at = max(sync_at, now + 1);
+    kind = WAKE_SYNC;
+
+    time_t alarm_at = AlarmManager::next_alarm_after(now);
+    if (alarm_at != 0)
+    {
+        time_t pre_alarm_sync = alarm_at - SYNC_BEFORE_ALARM_S;
+        if (SYNC_BEFORE_ALARM_S > 0 && pre_alarm_sync > now && pre_alarm_sync < wake_at)
+            wake_at = pre_alarm_sync;
+
+        if (alarm_at <= wake_at)
+        {
+            wake_at = alarm_at;
+            kind = WAKE_ALARM;
+        }
+    }
+
+    // A snoozed alarm comes back on the alarms it already has, without a sync before it
+    time_t snoozed_at = AlarmManager::get_snooze_time();
+    if (snoozed_at > now && snoozed_at <= wake_at)
+    {
+        wake_at = snoozed_at;
+        kind = WAKE_ALARM;
+    }
+    return wake_at;
+}
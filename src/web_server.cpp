@@ -1,15 +1,45 @@
 #include "web_server.h"
 #include "logger.h"
+#include "log_store.h"
 #include "led_controller.h"
 #include "network_manager.h"
 #include "alarm_manager.h"
+#include "alarm_store.h"
+#include "database.h"
+#include "event_queue.h"
+#include "preset_store.h"
+#include "metrics.h"
+#include "realtime_sync.h"
+#include "wake_planner.h"
+#include "energy_model.h"
+#include "input_engine.h"
+#include "heap_monitor.h"
+#include "stall_monitor.h"
+#include "scratch_pool.h"
+#include "sunrise_curve.h"
+#include "sunrise_scene.h"
+#include "frame_recorder.h"
+#include "ota_receiver.h"
 #include "config.h"
 #include <WiFi.h>
+#include <LittleFS.h>
+#include <AsyncJson.h>
+#include <esp_heap_caps.h>
 
 AsyncWebServer *WebServerManager::server = nullptr;
 unsigned long WebServerManager::last_web_request = 0;
 bool WebServerManager::initialized = false;
 
+// The PUT /api/scene that owns SCENE_UPLOAD_FILE. Every handler runs on the
+// AsyncTCP task, so a second upload arriving meanwhile is turned away rather
+// than writing into the same file.
+struct SceneUpload
+{
+    AsyncWebServerRequest *request;
+    bool failed;
+};
+static SceneUpload scene_upload = {nullptr, false};
+
 void WebServerManager::init()
 {
     if (initialized)
@@ -19,7 +49,8 @@ void WebServerManager::init()
     setup_routes();
     server->begin();
     initialized = true;
-    WEB_LOG("Web server started on http://" + WiFi.localIP().toString());
+    IPAddress ip = WiFi.localIP();
+    LOG_INFO(LOG_MODULE_WEB, "Web server started on http://%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
 }
 
 void WebServerManager::track_activity()
@@ -27,9 +58,11 @@ void WebServerManager::track_activity()
     last_web_request = millis();
 }
 
+// last_web_request starts at 0, which would otherwise count the first minute
+// after every boot as activity and keep each wake up with WiFi on
 bool WebServerManager::has_recent_activity()
 {
-    return (millis() - last_web_request < 60000);
+    return last_web_request != 0 && millis() - last_web_request < 60000;
 }
 
 unsigned long WebServerManager::get_last_activity_time()
@@ -37,29 +70,60 @@ unsigned long WebServerManager::get_last_activity_time()
     return last_web_request;
 }
 
+// Builds a response in a scratch block and sends it from there without a
+// copy. The server closes every connection after its response, and the
+// block goes back to the pool then. When no block is free the client is
+// asked to come back rather than the page being built on the heap.
+template <typename Builder>
+void WebServerManager::send_scratch(AsyncWebServerRequest *request, int code, const char *content_type, Builder build)
+{
+    char *block = ScratchPool::acquire(HEAP_WEB);
+    if (block == nullptr)
+    {
+        request->send(503, "text/plain", "Busy, try again");
+        return;
+    }
+
+    TextWriter out(block, ScratchPool::block_size());
+    {
+        HeapScope heap_scope(HEAP_WEB);
+        build(out);
+    }
+    if (out.overflowed())
+        LOG_WARN(LOG_MODULE_WEB, "Response to %s cut off at %u bytes", request->url().c_str(), (unsigned)out.length());
+
+    size_t length = out.length();
+    request->onDisconnect([block, length]()
+                          { ScratchPool::release(block, length); });
+    request->send(request->beginResponse(code, content_type, (const uint8_t *)block, length));
+}
+
 void WebServerManager::setup_routes()
 {
     server->on("/", HTTP_GET, [](AsyncWebServerRequest *request)
                {
         track_activity();
-        request->send(200, "text/html", build_dashboard_html()); });
+        send_scratch(request, 200, "text/html", build_dashboard_html); });
 
     server->on("/logs", HTTP_GET, [](AsyncWebServerRequest *request)
                {
         track_activity();
-        request->send(200, "text/html", build_logs_html()); });
+        uint32_t before = request->hasParam("before") ? request->getParam("before")->value().toInt() : 0;
+        send_scratch(request, 200, "text/html", [before](TextWriter &html)
+                     { build_logs_html(html, before); }); });
 
     server->on("/test", HTTP_GET, [](AsyncWebServerRequest *request)
                {
         track_activity();
-        WEB_LOG("LED test triggered via web");
+        LOG_INFO(LOG_MODULE_WEB, "LED test triggered via web");
+        StallScope stall_scope(STALL_ASYNC, STALL_TAG_WEB_LED);
         LEDController::run_test_animation();
         request->send(200, "text/plain", "LED test completed!"); });
 
     server->on("/sync", HTTP_GET, [](AsyncWebServerRequest *request)
                {
         track_activity();
-        WEB_LOG("Manual sync triggered via web");
+        LOG_INFO(LOG_MODULE_WEB, "Manual sync triggered via web");
         AlarmManager::fetch_alarms_from_db();
             request->send(200, "text/plain", "Alarm sync started. Check logs for details!"); });
 
@@ -67,81 +131,527 @@ void WebServerManager::setup_routes()
                {
         track_activity();
         if (LEDController::is_alarm_running()) {
-            WEB_LOG("Alarm dismissed via web interface");
-            LEDController::dismiss_alarm();
+            // ?zone=n dismisses only the sunrise in that zone
+            int zone = request->hasParam("zone") ? request->getParam("zone")->value().toInt() : -1;
+            LOG_INFO(LOG_MODULE_WEB, "Alarm dismissed via web interface");
+            LEDController::dismiss_alarm(DISMISS_WEB, zone);
             request->send(200, "text/plain", "Alarm dismissed!");
         } else {
-            WEB_LOG("Dismiss requested but no alarm is running");
+            LOG_INFO(LOG_MODULE_WEB, "Dismiss requested but no alarm is running");
             request->send(200, "text/plain", "No alarm is currently running.");
         } });
+
+    server->on("/api/alarms", HTTP_GET, [](AsyncWebServerRequest *request)
+               {
+        track_activity();
+        send_scratch(request, 200, "application/json", [](TextWriter &out)
+                     {
+            JsonDocument doc;
+            AlarmManager::alarms_to_json(doc.to<JsonArray>());
+            serializeJson(doc, out); }); });
+
+    server->on("/api/alarms", HTTP_DELETE, [](AsyncWebServerRequest *request)
+               {
+        track_activity();
+        int id = get_alarm_id_param(request);
+        send_alarm_edit_result(request, AlarmManager::delete_alarm(id), id); });
+
+    AsyncCallbackJsonWebHandler *alarm_edit_handler = new AsyncCallbackJsonWebHandler("/api/alarms", [](AsyncWebServerRequest *request, JsonVariant &json)
+                                                                                      {
+        track_activity();
+        JsonObjectConst fields = json.as<JsonObjectConst>();
+        if (request->method() == HTTP_POST) {
+            int new_id = 0;
+            send_alarm_edit_result(request, AlarmManager::create_alarm(fields, new_id), new_id);
+        } else {
+            int id = get_alarm_id_param(request);
+            send_alarm_edit_result(request, AlarmManager::update_alarm(id, fields), id);
+        } });
+    alarm_edit_handler->setMethod(HTTP_POST | HTTP_PUT);
+    server->addHandler(alarm_edit_handler);
+
+    server->on("/api/log_levels", HTTP_GET, [](AsyncWebServerRequest *request)
+               {
+        track_activity();
+        send_scratch(request, 200, "application/json", [](TextWriter &out)
+                     {
+            JsonDocument doc;
+            for (uint8_t i = 0; i < LOG_MODULE_COUNT; i++) {
+                doc[Logger::module_name(i)] = Logger::level_name(Logger::get_module_level((LogModule)i));
+            }
+            serializeJson(doc, out); }); });
+
+    server->on("/api/log_levels", HTTP_POST | HTTP_PUT, [](AsyncWebServerRequest *request)
+               {
+        track_activity();
+        LogModule module;
+        LogLevel level;
+        if (!request->hasParam("module") || !request->hasParam("level") ||
+            !Logger::parse_module(request->getParam("module")->value().c_str(), module) ||
+            !Logger::parse_level(request->getParam("level")->value().c_str(), level)) {
+            request->send(400, "application/json", "{\"error\":\"expected ?module=<name>&level=<trace|debug|info|warn|error>\"}");
+            return;
+        }
+        Logger::set_module_level(module, level);
+        LOG_INFO(LOG_MODULE_WEB, "Log level of %s set to %s", Logger::module_name(module), Logger::level_name(level));
+        request->send(200, "application/json", "{}"); });
+
+    // Installs a scene compiled by tools/compile_scene.py. The body goes straight to
+    // flash, so a scene's size is limited by SCENE_MAX_FILE_SIZE and not by the heap.
+    server->on("/api/scene", HTTP_PUT, [](AsyncWebServerRequest *request)
+               {
+        track_activity();
+        if (request->contentLength() > SCENE_MAX_FILE_SIZE) {
+            request->send(413, "application/json", "{\"error\":\"scene too large\"}");
+            return;
+        }
+        bool owner = scene_upload.request == request;
+        bool failed = !owner || scene_upload.failed;
+        if (owner)
+            scene_upload = {nullptr, false};
+        if (LEDController::is_alarm_running()) {
+            request->send(409, "application/json", "{\"error\":\"sunrise running\"}");
+            return;
+        }
+        if (scene_upload.request != nullptr) {
+            request->send(409, "application/json", "{\"error\":\"scene upload running\"}");
+            return;
+        }
+        int segments = 0;
+        if (failed || !SunriseScene::install_upload(segments)) {
+            request->send(400, "application/json", "{\"error\":\"invalid scene\"}");
+            return;
+        }
+        char body[32];
+        snprintf(body, sizeof(body), "{\"segments\":%d}", segments);
+        request->send(200, "application/json", body); }, nullptr, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+               {
+        // A playing sunrise reads its scene segment by segment, so no upload starts during one
+        if (index == 0) {
+            if (total > SCENE_MAX_FILE_SIZE || scene_upload.request != nullptr || LEDController::is_alarm_running())
+                return;
+            scene_upload = {request, false};
+            request->onDisconnect([request]()
+                                  {
+                if (scene_upload.request == request)
+                    scene_upload = {nullptr, false}; });
+        }
+        if (scene_upload.request != request || scene_upload.failed)
+            return;
+        if (!SunriseScene::append_upload(index, data, len))
+            scene_upload.failed = true; });
+
+    server->on("/api/scene", HTTP_DELETE, [](AsyncWebServerRequest *request)
+               {
+        track_activity();
+        if (LEDController::is_alarm_running()) {
+            request->send(409, "application/json", "{\"error\":\"sunrise running\"}");
+            return;
+        }
+        if (!SunriseScene::uninstall()) {
+            request->send(500, "application/json", "{\"error\":\"removing the scene failed\"}");
+            return;
+        }
+        request->send(200, "application/json", "{}"); });
+
+    // Firmware from tools/ota_upload.py, inflated into the inactive partition as it
+    // arrives; the loop restarts into it after the response has been sent
+    server->on("/api/ota", HTTP_POST, [](AsyncWebServerRequest *request)
+               {
+        track_activity();
+        if (LEDController::is_alarm_running()) {
+            request->send(409, "application/json", "{\"error\":\"sunrise running\"}");
+            return;
+        }
+        if (!OtaReceiver::end()) {
+            send_scratch(request, 400, "application/json", [](TextWriter &out)
+                         {
+                JsonDocument doc;
+                doc["error"] = OtaReceiver::get_error() ? OtaReceiver::get_error() : "no upload";
+                serializeJson(doc, out); });
+            return;
+        }
+        request->send(200, "application/json", "{\"status\":\"restarting\"}"); }, nullptr, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+               {
+        StallScope stall_scope(STALL_ASYNC, STALL_TAG_OTA);
+        track_activity();
+        if (index == 0) {
+            if (LEDController::is_alarm_running())
+                return;
+            size_t image_size = request->hasParam("size") ? request->getParam("size")->value().toInt() : 0;
+            String md5 = request->hasParam("md5") ? request->getParam("md5")->value() : "";
+            String signature = request->hasParam("signature") ? request->getParam("signature")->value() : "";
+            if (!OtaReceiver::begin(image_size, total, md5.c_str(), signature.c_str()))
+                return;
+            request->onDisconnect([]()
+                                  { OtaReceiver::abort(); });
+        }
+        OtaReceiver::write(data, len); });
+
+    // Runs a PostgREST response body through the alarm parser without applying it,
+    // to time the parser on the device (see "Parser Fuzzing" in README.md)
+    server->on("/api/debug/parse_alarms", HTTP_POST, [](AsyncWebServerRequest *request)
+               {
+        track_activity();
+        if (request->contentLength() > PARSE_BENCH_MAX_BODY) {
+            request->send(413, "application/json", "{\"error\":\"body too large\"}");
+            return;
+        }
+        const char *body = (const char *)request->_tempObject;
+        int iterations = request->hasParam("iterations") ? request->getParam("iterations")->value().toInt() : 1;
+        iterations = constrain(iterations, 1, 1000);
+        // format=packed takes a device_schedule() result instead of alarm rows
+        bool packed = request->hasParam("format") && request->getParam("format")->value() == "packed";
+
+        ParseBenchmark result;
+        bool ok = body && (packed ? AlarmManager::benchmark_schedule(body, request->contentLength(), iterations, result)
+                                  : AlarmManager::benchmark_parse(body, request->contentLength(), iterations, result));
+        if (!ok) {
+            send_scratch(request, 400, "application/json", [&result](TextWriter &out)
+                         {
+                JsonDocument doc;
+                doc["error"] = result.error ? result.error : "empty body";
+                serializeJson(doc, out); });
+            return;
+        }
+
+        send_scratch(request, 200, "application/json", [&result, iterations](TextWriter &out)
+                     {
+            JsonDocument doc;
+            doc["rows"] = result.rows;
+            doc["skipped"] = result.skipped;
+            doc["total_rows"] = result.total_rows;
+            doc["iterations"] = iterations;
+            doc["micros_per_parse"] = result.micros / iterations;
+            doc["bytes_allocated"] = result.bytes_allocated;
+            doc["heap_leaked"] = result.heap_leaked;
+            doc["free_heap"] = ESP.getFreeHeap();
+            serializeJson(doc, out); }); }, nullptr, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+               {
+        // The server frees _tempObject with the request
+        if (total > PARSE_BENCH_MAX_BODY)
+            return;
+        if (index == 0)
+            request->_tempObject = malloc(total + 1);
+        char *body = (char *)request->_tempObject;
+        if (body && index + len <= total) {
+            memcpy(body + index, data, len);
+            body[index + len] = '\0';
+        } });
+
+    // Times SunriseCurve::render() and a dither pass for other strip lengths and layouts, for tools/sunrise_curves.py --bench
+    server->on("/api/debug/render_benchmark", HTTP_GET, [](AsyncWebServerRequest *request)
+               {
+        track_activity();
+        if (LEDController::is_alarm_running()) {
+            request->send(409, "application/json", "{\"error\":\"sunrise running\"}");
+            return;
+        }
+        int count = request->hasParam("leds") ? request->getParam("leds")->value().toInt() : NUM_LEDS;
+        int rows = request->hasParam("rows") ? request->getParam("rows")->value().toInt() : LED_ROWS;
+        int frames = request->hasParam("frames") ? request->getParam("frames")->value().toInt() : 100;
+        String origin_name = request->hasParam("origin") ? request->getParam("origin")->value() : "";
+        int origin = origin_name == "uniform" ? SUNRISE_ORIGIN_UNIFORM : origin_name == "start" ? SUNRISE_ORIGIN_START
+                   : origin_name == "end"     ? SUNRISE_ORIGIN_END     : origin_name == "center" ? SUNRISE_ORIGIN_CENTER
+                                                                                               : SUNRISE_ORIGIN;
+        count = constrain(count, 1, 4096);
+        frames = constrain(frames, 1, 1000);
+
+        RenderBenchmark result;
+        StallScope stall_scope(STALL_ASYNC, STALL_TAG_WEB_LED);
+        LEDController::benchmark_render(count, max(rows, 1), origin, frames, result);
+
+        send_scratch(request, 200, "application/json", [&result, count, frames](TextWriter &out)
+                     {
+            JsonDocument doc;
+            doc["leds"] = count;
+            doc["bands"] = result.bands;
+            doc["frames"] = frames;
+            doc["layout_us"] = result.layout_us;
+            doc["frame_us"] = result.frame_us;
+            doc["dither_us"] = result.dither_us;
+            serializeJson(doc, out); }); });
+
+    // Times composited frames of several sunrises at once, for tools/sunrise_curves.py --bench --zones
+    server->on("/api/debug/zone_benchmark", HTTP_GET, [](AsyncWebServerRequest *request)
+               {
+        track_activity();
+        if (LEDController::is_alarm_running()) {
+            request->send(409, "application/json", "{\"error\":\"sunrise running\"}");
+            return;
+        }
+        int count = request->hasParam("leds") ? request->getParam("leds")->value().toInt() : NUM_LEDS;
+        int zones = request->hasParam("zones") ? request->getParam("zones")->value().toInt() : MAX_CONCURRENT_SUNRISES;
+        int lit = request->hasParam("lit") ? request->getParam("lit")->value().toInt() : count;
+        int frames = request->hasParam("frames") ? request->getParam("frames")->value().toInt() : 100;
+        bool overlap = request->hasParam("overlap") && request->getParam("overlap")->value() == "1";
+        count = constrain(count, 1, 4096);
+        frames = constrain(frames, 1, 1000);
+
+        CompositeBenchmark result;
+        StallScope stall_scope(STALL_ASYNC, STALL_TAG_WEB_LED);
+        LEDController::benchmark_composite(count, zones, lit, overlap, frames, result);
+
+        send_scratch(request, 200, "application/json", [&result, count, zones, overlap, frames](TextWriter &out)
+                     {
+            JsonDocument doc;
+            doc["leds"] = count;
+            doc["zones"] = constrain(zones, 1, MAX_CONCURRENT_SUNRISES);
+            doc["overlap"] = overlap;
+            doc["lit_leds"] = result.lit_leds;
+            doc["frames"] = frames;
+            doc["frame_us"] = result.frame_us;
+            doc["ns_per_lit_led"] = result.ns_per_lit_led;
+            serializeJson(doc, out); }); });
+
+    // Logs messages through the arena and through the String ring it replaced, comparing
+    // logs/s and the heap each holds afterwards. The arena run pushes older records out of /logs.
+    server->on("/api/debug/log_benchmark", HTTP_GET, [](AsyncWebServerRequest *request)
+               {
+        track_activity();
+        int messages = request->hasParam("messages") ? request->getParam("messages")->value().toInt() : 1000;
+        messages = constrain(messages, 1, 10000);
+
+        LogBenchmark result;
+        Logger::benchmark(messages, result);
+
+        send_scratch(request, 200, "application/json", [&result](TextWriter &out)
+                     {
+            JsonDocument doc;
+            doc["messages"] = result.messages;
+            const LogBenchmarkRun *runs[] = {&result.arena, &result.string_ring};
+            const char *names[] = {"arena", "string_ring"};
+            for (int i = 0; i < 2; i++) {
+                JsonObject run = doc[names[i]].to<JsonObject>();
+                run["logs_per_s"] = runs[i]->logs_per_s;
+                run["heap_held"] = runs[i]->heap_held;
+                run["blocks_held"] = runs[i]->blocks_held;
+                run["largest_block_lost"] = runs[i]->largest_block_lost;
+                run["fragmentation_before"] = runs[i]->fragmentation_before;
+                run["fragmentation_after"] = runs[i]->fragmentation_after;
+            }
+            serializeJson(doc, out); }); });
+
+    // Records the next sunrise with a fixed random seed, for tools/frame_diff.py
+    server->on("/api/debug/frames/record", HTTP_POST, [](AsyncWebServerRequest *request)
+               {
+        track_activity();
+        if (LEDController::is_alarm_running()) {
+            request->send(409, "application/json", "{\"error\":\"sunrise running\"}");
+            return;
+        }
+        uint16_t seed = request->hasParam("seed") ? request->getParam("seed")->value().toInt() : FRAME_RECORD_SEED;
+        FrameRecorder::arm(seed);
+        send_scratch(request, 200, "application/json", [seed](TextWriter &out)
+                     {
+            JsonDocument doc;
+            doc["armed"] = true;
+            doc["seed"] = seed;
+            doc["file"] = FRAME_RECORD_FILE;
+            serializeJson(doc, out); }); });
+
+    // Streams a whole sunrise rendered on a virtual clock, the same on every run with the same seed.
+    // A render would slow a playing sunrise's frames, so none starts during one; an alarm that
+    // starts during a render leaves it alone, as the render has its own random16 state.
+    server->on("/api/debug/frames/render", HTTP_GET, [](AsyncWebServerRequest *request)
+               {
+        track_activity();
+        if (LEDController::is_alarm_running()) {
+            request->send(409, "application/json", "{\"error\":\"sunrise running\"}");
+            return;
+        }
+        String preset = request->hasParam("preset") ? request->getParam("preset")->value() : "sunrise";
+        int minutes = request->hasParam("minutes") ? request->getParam("minutes")->value().toInt() : 30;
+        int brightness = request->hasParam("brightness") ? request->getParam("brightness")->value().toInt() : 255;
+        int zone = request->hasParam("zone") ? request->getParam("zone")->value().toInt() : 0;
+        uint16_t seed = request->hasParam("seed") ? request->getParam("seed")->value().toInt() : FRAME_RECORD_SEED;
+        if (!FrameRecorder::begin_render(preset.c_str(), constrain(minutes, 1, 24 * 60), constrain(brightness, 0, 255), zone, seed)) {
+            request->send(409, "application/json", "{\"error\":\"render running\"}");
+            return;
+        }
+        request->onDisconnect([]()
+                              { FrameRecorder::end_render(); });
+        request->send(request->beginChunkedResponse("application/octet-stream", [](uint8_t *buffer, size_t max_length, size_t index) -> size_t
+                                                    {
+            StallScope stall_scope(STALL_ASYNC, STALL_TAG_WEB_LED);
+            return FrameRecorder::read_render(buffer, max_length); })); });
+
+    // The last recorded sunrise
+    server->on("/api/debug/frames", HTTP_GET, [](AsyncWebServerRequest *request)
+               {
+        track_activity();
+        if (FrameRecorder::is_recording()) {
+            request->send(409, "application/json", "{\"error\":\"recording\"}");
+            return;
+        }
+        if (!FrameRecorder::has_recording()) {
+            request->send(404, "application/json", "{\"error\":\"no recording\"}");
+            return;
+        }
+        request->send(LittleFS, FRAME_RECORD_FILE, "application/octet-stream"); });
+
+    // Heap and scratch pool state, sampled by tools/heap_endurance.py between its requests
+    server->on("/api/debug/heap", HTTP_GET, [](AsyncWebServerRequest *request)
+               {
+        track_activity();
+        send_scratch(request, 200, "application/json", [](TextWriter &out)
+                     {
+            JsonDocument doc;
+            HeapMonitor::to_json(doc.to<JsonObject>());
+            doc["uptime_s"] = millis() / 1000;
+            ScratchPool::to_json(doc["scratch"].to<JsonObject>());
+            serializeJson(doc, out); }); });
+
+    // No track_activity(): a scraper polling this must not keep the device awake
+    server->on("/metrics", HTTP_GET, [](AsyncWebServerRequest *request)
+               { send_scratch(request, 200, "text/plain; version=0.0.4", build_metrics_text); });
+}
+
+void WebServerManager::build_metrics_text(TextWriter &out)
+{
+    Metrics::gauge(out, "sunrise_uptime_seconds", "Seconds since this boot", millis() / 1000);
+    HeapMonitor::append_metrics(out);
+    ScratchPool::append_metrics(out);
+    Database::append_metrics(out);
+    EventQueue::append_metrics(out);
+    PresetStore::append_metrics(out);
+    LEDController::append_metrics(out);
+    InputEngine::append_metrics(out);
+    StallMonitor::append_metrics(out);
+    WakePlanner::append_metrics(out);
+    EnergyModel::append_metrics(out);
+}
+
+int WebServerManager::get_alarm_id_param(AsyncWebServerRequest *request)
+{
+    if (!request->hasParam("id"))
+        return 0;
+    return request->getParam("id")->value().toInt();
+}
+
+void WebServerManager::send_alarm_edit_result(AsyncWebServerRequest *request, AlarmEditResult result, int id)
+{
+    switch (result)
+    {
+    case ALARM_EDIT_OK:
+    {
+        char body[32];
+        snprintf(body, sizeof(body), "{\"id\":%d}", id);
+        request->send(request->method() == HTTP_POST ? 201 : 200, "application/json", body);
+        break;
+    }
+    case ALARM_EDIT_NOT_FOUND:
+        request->send(404, "application/json", "{\"error\":\"alarm not found\"}");
+        break;
+    case ALARM_EDIT_INVALID:
+        request->send(400, "application/json", "{\"error\":\"invalid alarm fields\"}");
+        break;
+    case ALARM_EDIT_FULL:
+        request->send(507, "application/json", "{\"error\":\"alarm table or sync queue full\"}");
+        break;
+    }
 }
 
-String WebServerManager::build_dashboard_html()
+void WebServerManager::build_dashboard_html(TextWriter &html)
 {
-    String html = "<!DOCTYPE html><html><head>";
-    html += "<meta charset='UTF-8'>";
-    html += "<title>Sunrise Alarm</title>";
-    html += "<meta name='viewport' content='width=device-width, initial-scale=1'>";
-    html += "<style>body{font-family:Arial;margin:20px;background:#f0f0f0}";
-    html += ".card{background:white;padding:20px;margin:10px 0;border-radius:8px;box-shadow:0 2px 4px rgba(0,0,0,0.1)}";
-    html += ".btn{background:#007bff;color:white;padding:10px 20px;border:none;border-radius:4px;cursor:pointer;margin:5px}";
-    html += ".btn:hover{background:#0056b3}";
-    html += ".btn-danger{background:#dc3545}";
-    html += ".btn-danger:hover{background:#c82333}";
-    html += ".status{padding:10px;border-radius:4px;margin:10px 0}";
-    html += ".success{background:#d4edda;color:#155724;border:1px solid #c3e6cb}";
-    html += ".info{background:#d1ecf1;color:#0c5460;border:1px solid #bee5eb}";
-    html += ".warning{background:#fff3cd;color:#856404;border:1px solid #ffeaa7}</style></head><body>";
-
-    html += "<h1>🌅 Sunrise Alarm Control</h1>";
-
-    html += "<div class='card'><h2>System Status</h2>";
-    html += "<div class='status info'>Device: " + String(OTA_HOSTNAME) + "</div>";
-    html += "<div class='status info'>IP: " + WiFi.localIP().toString() + "</div>";
-    html += "<div class='status info'>MAC: " + WiFi.macAddress() + "</div>";
+    html.append("<!DOCTYPE html><html><head>");
+    html.append("<meta charset='UTF-8'>");
+    html.append("<title>Sunrise Alarm</title>");
+    html.append("<meta name='viewport' content='width=device-width, initial-scale=1'>");
+    html.append("<style>body{font-family:Arial;margin:20px;background:#f0f0f0}");
+    html.append(".card{background:white;padding:20px;margin:10px 0;border-radius:8px;box-shadow:0 2px 4px rgba(0,0,0,0.1)}");
+    html.append(".btn{background:#007bff;color:white;padding:10px 20px;border:none;border-radius:4px;cursor:pointer;margin:5px}");
+    html.append(".btn:hover{background:#0056b3}");
+    html.append(".btn-danger{background:#dc3545}");
+    html.append(".btn-danger:hover{background:#c82333}");
+    html.append(".status{padding:10px;border-radius:4px;margin:10px 0}");
+    html.append(".success{background:#d4edda;color:#155724;border:1px solid #c3e6cb}");
+    html.append(".info{background:#d1ecf1;color:#0c5460;border:1px solid #bee5eb}");
+    html.append(".warning{background:#fff3cd;color:#856404;border:1px solid #ffeaa7}</style></head><body>");
+
+    html.append("<h1>🌅 Sunrise Alarm Control</h1>");
+
+    html.append("<div class='card'><h2>System Status</h2>");
+    html.append("<div class='status info'>Device: " OTA_HOSTNAME "</div>");
+    IPAddress ip = WiFi.localIP();
+    html.appendf("<div class='status info'>IP: %u.%u.%u.%u</div>", ip[0], ip[1], ip[2], ip[3]);
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    html.appendf("<div class='status info'>MAC: %02X:%02X:%02X:%02X:%02X:%02X</div>",
+                 mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
 
     struct tm timeinfo;
     if (getLocalTime(&timeinfo))
     {
         char time_str[64];
         strftime(time_str, sizeof(time_str), "%A, %B %d %Y %H:%M:%S", &timeinfo);
-        html += "<div class='status success'>Time: " + String(time_str) + "</div>";
+        html.appendf("<div class='status success'>Time: %s</div>", time_str);
     }
 
-    html += "<div class='status info'>Free Heap: " + String(ESP.getFreeHeap()) + " bytes</div>";
-    html += "<div class='status info'>Alarms Loaded: " + String(AlarmManager::get_alarm_count()) + "</div>";
-    html += "</div>";
+    html.appendf("<div class='status info'>Free Heap: %u bytes (largest block %u, lowest %u)</div>",
+                 (unsigned)heap_caps_get_free_size(MALLOC_CAP_8BIT), (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+                 (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
+    html.appendf("<div class='status info'>Alarms Loaded: %d</div>", AlarmManager::get_alarm_count());
+    html.appendf("<div class='status info'>Local Edits Pending Sync: %d</div>", AlarmStore::get_pending_count());
+    html.appendf("<div class='status info'>Alarm Events Pending Upload: %d</div>", EventQueue::get_depth());
+
+    float planned_wakeups, planned_radio_seconds;
+    WakePlanner::estimate_daily(planned_wakeups, planned_radio_seconds);
+    html.appendf("<div class='status info'>Wake Plan: %.1f wakeups/day, %.0f s WiFi/day</div>",
+                 planned_wakeups, planned_radio_seconds);
+    html.appendf("<div class='status info'>Energy: %.1f mWh this boot, %.0f mWh/day average</div>",
+                 EnergyModel::get_boot_mwh(), EnergyModel::get_per_day_mwh());
+
+    if (RealtimeSync::is_subscribed())
+        html.append("<div class='status success'>Alarm Updates: Realtime</div>");
+    else if (RealtimeSync::is_active())
+        html.appendf("<div class='status warning'>Alarm Updates: Polling every %d s</div>", REALTIME_POLL_INTERVAL_MS / 1000);
 
-    html += "<div class='card'><h2>Controls</h2>";
+    const DatabaseStats &db_stats = Database::get_stats();
+    if (db_stats.requests > 0)
+    {
+        html.appendf("<div class='status info'>Supabase Requests: %lu (avg %lu ms)</div>",
+                     (unsigned long)db_stats.requests, (unsigned long)(db_stats.request_ms / db_stats.requests));
+    }
+    if (db_stats.handshakes > 0)
+    {
+        html.appendf("<div class='status info'>TLS Handshakes: %lu (%lu resumed, avg %lu ms)</div>",
+                     (unsigned long)db_stats.handshakes, (unsigned long)db_stats.resumed_handshakes,
+                     (unsigned long)(db_stats.handshake_ms / db_stats.handshakes));
+    }
+    html.append("</div>");
+
+    html.append("<div class='card'><h2>Controls</h2>");
     
     if (LEDController::is_alarm_running()) {
-        html += "<div class='status warning'>⚠️ Alarm is currently running!</div>";
-        html += "<button class='btn btn-danger' onclick=\"if(confirm('Dismiss the current alarm?')) location.href='/alarm/dismiss'\">❌ Dismiss Alarm</button><br>";
+        html.append("<div class='status warning'>⚠️ Alarm is currently running!</div>");
+        html.append("<button class='btn btn-danger' onclick=\"if(confirm('Dismiss the current alarm?')) location.href='/alarm/dismiss'\">❌ Dismiss Alarm</button><br>");
     }
     
-    html += "<button class='btn' onclick=\"location.href='/logs'\">📋 View Logs</button>";
-    html += "<button class='btn' onclick=\"location.href='/test'\">🌈 Test LEDs</button>";
-    html += "<button class='btn' onclick=\"location.href='/sync'\">🔄 Sync Alarms</button>";
-    html += "</div>";
+    html.append("<button class='btn' onclick=\"location.href='/logs'\">📋 View Logs</button>");
+    html.append("<button class='btn' onclick=\"location.href='/test'\">🌈 Test LEDs</button>");
+    html.append("<button class='btn' onclick=\"location.href='/sync'\">🔄 Sync Alarms</button>");
+    html.append("</div>");
 
-    html += "</body></html>";
-    return html;
+    html.append("</body></html>");
 }
 
-String WebServerManager::build_logs_html()
+void WebServerManager::build_logs_html(TextWriter &html, uint32_t before)
 {
-    String html = "<!DOCTYPE html><html><head>";
-    html += "<meta charset='UTF-8'>";
-    html += "<title>System Logs</title>";
-    html += "<meta name='viewport' content='width=device-width, initial-scale=1'>";
-    html += "<meta http-equiv='refresh' content='5'>";
-    html += "<style>body{font-family:monospace;margin:20px;background:#000;color:#0f0}";
-    html += ".log{padding:2px 0;border-bottom:1px solid #333}</style></head><body>";
-    html += "<h2>📋 System Logs (Auto-refresh: 5s)</h2>";
-    html += "<a href='/' style='color:#0ff'>← Back to Dashboard</a><br><br>";
-
-    html += Logger::getLogsHtml();
-
-    html += "</body></html>";
-    return html;
+    html.append("<!DOCTYPE html><html><head>");
+    html.append("<meta charset='UTF-8'>");
+    html.append("<title>System Logs</title>");
+    html.append("<meta name='viewport' content='width=device-width, initial-scale=1'>");
+    if (before == 0)
+    {
+        html.append("<meta http-equiv='refresh' content='5'>");
+    }
+    html.append("<style>body{font-family:monospace;margin:20px;background:#000;color:#0f0}");
+    html.append(".log{padding:2px 0;border-bottom:1px solid #333}.nav{padding:10px 0}.nav a{color:#0ff}</style></head><body>");
+    html.append(before == 0 ? "<h2>📋 System Logs (Auto-refresh: 5s)</h2>" : "<h2>📋 System Logs</h2>");
+    html.append("<a href='/' style='color:#0ff'>← Back to Dashboard</a><br><br>");
+
+    LogStore::build_page_html(html, before);
+
+    html.append("</body></html>");
 }
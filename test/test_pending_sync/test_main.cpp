@@ -0,0 +1,216 @@
+// Local alarm edits made through the web API while a sync pushes the queue
+// (pio test -e native_test). The sync runs on the loop task against the
+// native build's FakeSupabase; a second task stands in for the AsyncTCP task
+// and edits the table while a push request is on the wire.
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unity.h>
+#include "config.h"
+#include "alarm_manager.h"
+#include "alarm_store.h"
+#include "database.h"
+#include "fake_supabase.h"
+#include "heap_monitor.h"
+#include "native_host.h"
+#include "network_manager.h"
+#include "scratch_pool.h"
+
+static const uint32_t REQUEST_MS = 100;
+static const int64_t START_US = 1767600000LL * 1000000; // 2026-01-05 08:00 UTC
+
+static FakeSupabase supabase;
+
+// What the web task does once the sync's request count reaches edit_after.
+// Assertions stay on the test's own task, so the edit only reports failure.
+static bool (*web_edit)() = nullptr;
+static uint32_t edit_after = 0;
+static bool web_edit_ok = false;
+
+static int remove_entry(const char *path, const struct stat *, int, struct FTW *)
+{
+    return remove(path);
+}
+
+static void web_task(void *)
+{
+    while (supabase.requests < edit_after)
+        delay(1);
+    web_edit_ok = web_edit();
+}
+
+// Runs edit on the web task while the push's first request is on its way
+static void edit_during_push(bool (*edit)())
+{
+    web_edit = edit;
+    web_edit_ok = false;
+    // The sync reads the rows first, then starts pushing
+    edit_after = supabase.requests + 1;
+    xTaskCreate(web_task, "async_tcp", 4096, nullptr, 1, nullptr);
+}
+
+static void seed_row(int id, int hour, int minute)
+{
+    FakeAlarmRow &row = supabase.alarms[supabase.alarm_count++];
+    memset(&row, 0, sizeof(row));
+    row.id = id;
+    row.hour = hour;
+    row.minute = minute;
+    row.days_mask = 0x3e;
+    row.enabled = true;
+    row.brightness = 255;
+    row.duration_minutes = 30;
+    strlcpy(row.color_preset, "sunrise", sizeof(row.color_preset));
+    row.updated_at = START_US / 1000000 - 3600;
+    supabase.next_id = max(supabase.next_id, id + 1);
+}
+
+static const FakeAlarmRow *remote_at(int hour, int minute)
+{
+    for (int i = 0; i < supabase.alarm_count; i++)
+    {
+        if (supabase.alarms[i].hour == hour && supabase.alarms[i].minute == minute)
+            return &supabase.alarms[i];
+    }
+    return nullptr;
+}
+
+// The local table's time of alarm id, "" when the device has no such alarm
+static String local_time(int id)
+{
+    JsonDocument doc;
+    AlarmManager::alarms_to_json(doc.to<JsonArray>());
+    for (JsonObjectConst alarm : doc.as<JsonArrayConst>())
+    {
+        if ((alarm["id"] | 0) == id)
+            return String(alarm["time"] | "");
+    }
+    return "";
+}
+
+static int local_id_at(const char *time)
+{
+    JsonDocument doc;
+    AlarmManager::alarms_to_json(doc.to<JsonArray>());
+    for (JsonObjectConst alarm : doc.as<JsonArrayConst>())
+    {
+        if (strcmp(alarm["time"] | "", time) == 0)
+            return alarm["id"] | 0;
+    }
+    return 0;
+}
+
+static AlarmEditResult set_time(int id, const char *time)
+{
+    JsonDocument fields;
+    fields["time"] = time;
+    return AlarmManager::update_alarm(id, fields.as<JsonObjectConst>());
+}
+
+static AlarmEditResult create_at(const char *time)
+{
+    JsonDocument fields;
+    fields["time"] = time;
+    fields["days_of_week"].to<JsonArray>().add(1);
+    int id;
+    return AlarmManager::create_alarm(fields.as<JsonObjectConst>(), id);
+}
+
+void setUp(void)
+{
+    String flash = NativeHost::flash_dir();
+    nftw(flash.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    mkdir(flash.c_str(), 0700);
+    NativeHost::set_clock_us(START_US);
+
+    memset(&supabase, 0, sizeof(supabase));
+    supabase.schedule_function = true;
+    supabase.request_ms = REQUEST_MS;
+    supabase.next_id = 1;
+    FakeSupabaseHost::attach(&supabase);
+
+    // The device starts out with alarm 5 synced
+    seed_row(5, 7, 0);
+    AlarmManager::load_cached_alarms();
+    TEST_ASSERT_TRUE(AlarmManager::fetch_alarms_from_db());
+    TEST_ASSERT_EQUAL_STRING("07:00:00", local_time(5).c_str());
+}
+
+void tearDown(void)
+{
+}
+
+// An edit folded into the entry being pushed must not be dropped with it
+static void test_edit_during_push_is_kept()
+{
+    TEST_ASSERT_EQUAL(ALARM_EDIT_OK, set_time(5, "06:00"));
+    edit_during_push([]()
+                     { return set_time(5, "06:30") == ALARM_EDIT_OK; });
+    AlarmManager::fetch_alarms_from_db();
+    TEST_ASSERT_TRUE(web_edit_ok);
+
+    TEST_ASSERT_NOT_NULL(remote_at(6, 0));
+    TEST_ASSERT_EQUAL_STRING("06:30:00", local_time(5).c_str());
+    TEST_ASSERT_TRUE(AlarmStore::has_pending(5));
+
+    TEST_ASSERT_TRUE(AlarmManager::fetch_alarms_from_db());
+    TEST_ASSERT_NOT_NULL(remote_at(6, 30));
+    TEST_ASSERT_EQUAL_STRING("06:30:00", local_time(5).c_str());
+    TEST_ASSERT_EQUAL(0, AlarmStore::get_pending_count());
+}
+
+// Deleting an alarm whose create is being pushed used to shift the queue, so
+// the change queued after it was dropped without being pushed
+static void test_change_queued_during_push_is_kept()
+{
+    TEST_ASSERT_EQUAL(ALARM_EDIT_OK, create_at("08:00"));
+    TEST_ASSERT_EQUAL(ALARM_EDIT_OK, set_time(5, "06:00"));
+    edit_during_push([]()
+                     { return AlarmManager::delete_alarm(local_id_at("08:00:00")) == ALARM_EDIT_OK &&
+                              create_at("09:00") == ALARM_EDIT_OK; });
+    AlarmManager::fetch_alarms_from_db();
+    TEST_ASSERT_TRUE(web_edit_ok);
+
+    TEST_ASSERT_NOT_NULL(remote_at(6, 0));
+    TEST_ASSERT_TRUE(AlarmStore::has_pending(local_id_at("09:00:00")));
+
+    TEST_ASSERT_TRUE(AlarmManager::fetch_alarms_from_db());
+    TEST_ASSERT_NOT_NULL(remote_at(9, 0));
+    // 08:00 was inserted before its delete; the delete finds the row by its local_id
+    TEST_ASSERT_NULL(remote_at(8, 0));
+    TEST_ASSERT_EQUAL(0, AlarmStore::get_pending_count());
+}
+
+// An insert that was carried out but whose answer was lost is sent again,
+// and the row's local_id keeps it from becoming a second alarm
+static void test_lost_insert_response_is_not_duplicated()
+{
+    TEST_ASSERT_EQUAL(ALARM_EDIT_OK, create_at("08:00"));
+    // The sync reads the rows first, then inserts
+    supabase.lost_request = supabase.requests + 2;
+    TEST_ASSERT_TRUE(AlarmManager::fetch_alarms_from_db());
+
+    TEST_ASSERT_EQUAL(2, supabase.alarm_count);
+    TEST_ASSERT_NOT_NULL(remote_at(8, 0));
+    TEST_ASSERT_EQUAL(0, AlarmStore::get_pending_count());
+}
+
+int main(int, char **)
+{
+    NativeHost::set_serial(nullptr);
+    ScratchPool::init();
+    HeapMonitor::begin();
+    NetworkManager::wifi_connected = true;
+    NetworkManager::apply_timezone();
+    Database::init();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_edit_during_push_is_kept);
+    RUN_TEST(test_change_queued_during_push_is_kept);
+    RUN_TEST(test_lost_insert_response_is_not_duplicated);
+    String flash = NativeHost::flash_dir();
+    nftw(flash.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    return UNITY_END();
+}
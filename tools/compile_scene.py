@@ -0,0 +1,293 @@
+#!/usr/bin/env python3
+"""Compiles JSON sunrise scenes into the binary format SunriseScene plays.
+
+A scene is a list of segments played in order when an alarm goes off. Each
+segment runs for a fixed time or a share of the alarm's sunrise duration,
+blends between two colors (or follows the color preset's sunrise curve),
+ramps the brightness and applies effects. The format is documented in
+include/sunrise_scene.h. tools/scenes/default.json is the scene the
+firmware plays when no scene file is installed:
+
+    python3 tools/compile_scene.py tools/scenes/default.json -o scene.bin
+    python3 tools/compile_scene.py --dump scene.bin
+
+Segment fields:
+
+    duration   seconds, or "N%" of the alarm's duration_minutes
+    curve      true to take colors from the alarm's color preset
+    color      "#RRGGBB", a name from "palette", or "curve_end" (the
+               preset's final color); "from" and "to" blend between two
+    level      brightness relative to the alarm's, 0-255 or [from, to]
+    easing     linear, in, out, in_out or hold
+    frame_ms   milliseconds between frames, or "adaptive"
+    effects    preset, breathing, sparkle, warmth, wave, shimmer
+
+--upload installs a compiled scene on a device (PUT /api/scene), and
+--header regenerates the built-in default in include/default_scene.h:
+
+    python3 tools/compile_scene.py tools/scenes/wake.json --upload sunrise-alarm.local
+    python3 tools/compile_scene.py tools/scenes/default.json --header include/default_scene.h
+"""
+
+import argparse
+import http.client
+import json
+import os
+import re
+import struct
+import sys
+
+MAGIC = 0x314E4353  # SCENE_MAGIC, "SCN1"
+FORMAT_VERSION = 1
+MAX_EFFECTS = 8  # SCENE_MAX_EFFECTS
+MAX_PALETTE = 255  # Index 255 is SCENE_COLOR_CURVE_END
+CURVE_END = 0xFF
+FLAG_SCALED, FLAG_CURVE = 1, 2
+EASINGS = ("linear", "in", "out", "in_out", "hold")
+EFFECTS = ("preset", "breathing", "sparkle", "warmth", "wave", "shimmer")
+
+HEADER = struct.Struct("<IBBH")
+SEGMENT = struct.Struct("<IHBBBBBBB")
+
+
+class SceneError(Exception):
+    pass
+
+
+def parse_color(text, palette_names):
+    if text == "curve_end":
+        return None
+    if text in palette_names:
+        return palette_names[text]
+    if isinstance(text, str) and re.fullmatch(r"#[0-9A-Fa-f]{6}", text):
+        value = int(text[1:], 16)
+        return (value >> 16, (value >> 8) & 0xFF, value & 0xFF)
+    raise SceneError(f"unknown color {text!r}")
+
+
+def parse_scene(description):
+    """JSON scene -> {"palette": [(r, g, b)], "segments": [dict]} with the binary's field values."""
+    palette_names = {name: parse_color(value, {}) for name, value in description.get("palette", {}).items()}
+    palette = []
+    segments = []
+
+    def palette_index(color):
+        if color is None:
+            return CURVE_END
+        if color not in palette:
+            palette.append(color)
+        return palette.index(color)
+
+    raw_segments = description.get("segments")
+    if not isinstance(raw_segments, list) or not raw_segments:
+        raise SceneError("a scene needs a non-empty \"segments\" list")
+    if len(raw_segments) > 0xFFFF:
+        raise SceneError("too many segments")
+
+    for number, raw in enumerate(raw_segments):
+        label = raw.get("name", f"segment {number}")
+        try:
+            segment = {"name": label, "flags": 0}
+
+            duration = raw.get("duration")
+            if isinstance(duration, str) and duration.endswith("%"):
+                segment["flags"] |= FLAG_SCALED
+                segment["duration"] = round(float(duration[:-1]) * 100)
+            elif isinstance(duration, (int, float)) and duration >= 0:
+                segment["duration"] = round(duration * 1000)
+            else:
+                raise SceneError("duration must be seconds or \"N%\"")
+            if not 0 <= segment["duration"] <= 0xFFFFFFFF:
+                raise SceneError("duration out of range")
+
+            frame_ms = raw.get("frame_ms", 50)
+            if frame_ms == "adaptive":
+                frame_ms = 0
+            if not isinstance(frame_ms, int) or not 0 <= frame_ms <= 0xFFFF:
+                raise SceneError("frame_ms must be 1-65535 or \"adaptive\"")
+            segment["frame_ms"] = frame_ms
+
+            if raw.get("curve"):
+                segment["flags"] |= FLAG_CURVE
+                colors = (None, None)
+            elif "color" in raw:
+                color = parse_color(raw["color"], palette_names)
+                colors = (color, color)
+            elif "from" in raw and "to" in raw:
+                colors = (parse_color(raw["from"], palette_names), parse_color(raw["to"], palette_names))
+            else:
+                raise SceneError("needs \"curve\", \"color\" or \"from\" and \"to\"")
+            segment["from_color"], segment["to_color"] = (palette_index(c) for c in colors)
+
+            level = raw.get("level", 255)
+            levels = level if isinstance(level, list) else [level, level]
+            if len(levels) != 2 or not all(isinstance(v, int) and 0 <= v <= 255 for v in levels):
+                raise SceneError("level must be 0-255 or [from, to]")
+            segment["from_level"], segment["to_level"] = levels
+
+            easing = raw.get("easing", "linear")
+            if easing not in EASINGS:
+                raise SceneError(f"unknown easing {easing!r}")
+            segment["easing"] = EASINGS.index(easing)
+
+            effects = raw.get("effects", [])
+            if len(effects) > MAX_EFFECTS or any(e not in EFFECTS for e in effects):
+                raise SceneError(f"effects must be at most {MAX_EFFECTS} of {', '.join(EFFECTS)}")
+            segment["effects"] = [EFFECTS.index(e) for e in effects]
+        except SceneError as error:
+            raise SceneError(f"{label}: {error}")
+        segments.append(segment)
+
+    if len(palette) > MAX_PALETTE:
+        raise SceneError(f"more than {MAX_PALETTE} distinct colors")
+    return {"palette": palette, "segments": segments}
+
+
+def encode(scene):
+    out = bytearray(HEADER.pack(MAGIC, FORMAT_VERSION, len(scene["palette"]), len(scene["segments"])))
+    for color in scene["palette"]:
+        out += bytes(color)
+    for s in scene["segments"]:
+        out += SEGMENT.pack(s["duration"], s["frame_ms"], s["flags"], s["easing"], s["from_color"],
+                            s["to_color"], s["from_level"], s["to_level"], len(s["effects"]))
+        out += bytes(s["effects"])
+    return bytes(out)
+
+
+def decode(data):
+    """The checks SunriseScene::validate_file() makes, returning the scene."""
+    if len(data) < HEADER.size:
+        raise SceneError("shorter than the header")
+    magic, version, palette_size, segment_count = HEADER.unpack_from(data)
+    if magic != MAGIC or version != FORMAT_VERSION or segment_count == 0:
+        raise SceneError("not a version 1 scene")
+    offset = HEADER.size
+    palette = [tuple(data[offset + 3 * i:offset + 3 * i + 3]) for i in range(palette_size)]
+    offset += 3 * palette_size
+    segments = []
+    for number in range(segment_count):
+        if offset + SEGMENT.size > len(data):
+            raise SceneError(f"segment {number} is truncated")
+        fields = SEGMENT.unpack_from(data, offset)
+        offset += SEGMENT.size
+        duration, frame_ms, flags, easing, from_color, to_color, from_level, to_level, effect_count = fields
+        effects = list(data[offset:offset + effect_count])
+        offset += effect_count
+        if (easing >= len(EASINGS) or effect_count > MAX_EFFECTS or len(effects) != effect_count
+                or any(e >= len(EFFECTS) for e in effects)
+                or any(c != CURVE_END and c >= palette_size for c in (from_color, to_color))):
+            raise SceneError(f"segment {number} is invalid")
+        segments.append({"name": f"segment {number}", "duration": duration, "frame_ms": frame_ms, "flags": flags,
+                         "easing": easing, "from_color": from_color, "to_color": to_color,
+                         "from_level": from_level, "to_level": to_level, "effects": effects})
+    if offset != len(data):
+        raise SceneError(f"{len(data) - offset} bytes after the last segment")
+    return {"palette": palette, "segments": segments}
+
+
+def load(path):
+    with open(path, "rb") as handle:
+        data = handle.read()
+    if data[:4] == struct.pack("<I", MAGIC):
+        return decode(data)
+    return parse_scene(json.loads(data))
+
+
+def segment_seconds(segment, sunrise_s):
+    if segment["flags"] & FLAG_SCALED:
+        return sunrise_s * segment["duration"] / 10000
+    return segment["duration"] / 1000
+
+
+def ease(easing, t):
+    """SunriseScene::ease()"""
+    name = EASINGS[easing]
+    if name == "in":
+        return t * t
+    if name == "out":
+        return 1 - (1 - t) * (1 - t)
+    if name == "in_out":
+        return 2 * t * t if t < 0.5 else 1 - 2 * (1 - t) * (1 - t)
+    if name == "hold":
+        return 0.0
+    return t
+
+
+def describe(scene):
+    def color_name(index):
+        if index == CURVE_END:
+            return "curve end"
+        return "#%02X%02X%02X" % scene["palette"][index]
+
+    for s in scene["segments"]:
+        length = f"{s['duration'] / 100:g}%" if s["flags"] & FLAG_SCALED else f"{s['duration'] / 1000:g} s"
+        colors = "preset curve" if s["flags"] & FLAG_CURVE else f"{color_name(s['from_color'])} -> {color_name(s['to_color'])}"
+        frames = f"{s['frame_ms']} ms" if s["frame_ms"] else "adaptive"
+        effects = ", ".join(EFFECTS[e] for e in s["effects"]) or "none"
+        print(f"{s['name']:12} {length:>9}  {colors:24} level {s['from_level']:3}->{s['to_level']:3}  "
+              f"{EASINGS[s['easing']]:7} frames {frames:9} effects {effects}")
+
+
+def write_header(path, data, source):
+    lines = [
+        "#ifndef DEFAULT_SCENE_H",
+        "#define DEFAULT_SCENE_H",
+        "",
+        "#include <Arduino.h>",
+        "",
+        f"// Generated by tools/compile_scene.py from {source}; played when no scene file is installed",
+        "static const uint8_t default_scene[] = {",
+    ]
+    for start in range(0, len(data), 12):
+        lines.append("    " + ", ".join("0x%02X" % b for b in data[start:start + 12]) + ",")
+    lines += ["};", "", "#endif", ""]
+    with open(path, "w") as handle:
+        handle.write("\n".join(lines))
+
+
+def upload(host, port, data):
+    connection = http.client.HTTPConnection(host, port, timeout=30)
+    connection.request("PUT", "/api/scene", body=data, headers={"Content-Type": "application/octet-stream"})
+    response = connection.getresponse()
+    body = response.read().decode(errors="replace")
+    connection.close()
+    print(f"device answered {response.status}: {body}")
+    return 0 if response.status == 200 else 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("scene", nargs="?", help="JSON scene description")
+    parser.add_argument("-o", "--output", help="write the compiled scene to this file")
+    parser.add_argument("--header", help="write the compiled scene as a C header (the built-in default)")
+    parser.add_argument("--dump", metavar="FILE", help="check and describe a compiled scene")
+    parser.add_argument("--upload", metavar="HOST", help="install the compiled scene on the device at HOST")
+    parser.add_argument("--port", type=int, default=80)
+    args = parser.parse_args()
+
+    try:
+        if args.dump:
+            describe(load(args.dump))
+            return 0
+        if not args.scene:
+            parser.error("a scene description is needed")
+        scene = load(args.scene)
+        data = encode(scene)
+        decode(data)
+    except (OSError, ValueError, SceneError) as error:
+        sys.exit(f"error: {error}")
+
+    describe(scene)
+    print(f"{len(data)} bytes, {len(scene['palette'])} palette colors, {len(scene['segments'])} segments")
+    if args.output:
+        with open(args.output, "wb") as handle:
+            handle.write(data)
+    if args.header:
+        write_header(args.header, data, os.path.relpath(args.scene, os.path.dirname(os.path.dirname(os.path.abspath(__file__)))))
+    if args.upload:
+        return upload(args.upload, args.port, data)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
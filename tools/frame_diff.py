@@ -0,0 +1,255 @@
+#!/usr/bin/env python3
+"""Replays and compares sunrise frame recordings.
+
+The firmware records what the strip shows in the format documented in
+include/frame_recorder.h. Two builds that should look the same are compared
+by rendering the same sunrise with the same seed on each and diffing the
+results; a render runs on a virtual clock, so it takes seconds and is the
+same on every run:
+
+    python3 tools/frame_diff.py render sunrise-alarm.local -o before.sfr --preset sunrise --minutes 30
+    (flash the new build)
+    python3 tools/frame_diff.py render sunrise-alarm.local -o after.sfr --preset sunrise --minutes 30
+    python3 tools/frame_diff.py diff before.sfr after.sfr
+
+The native build renders the same way without a device, which is how CI
+compares a change with its base:
+
+    .pio/build/native/program render --preset sunrise --minutes 30 -o after.sfr
+
+A real alarm can be recorded as well. "arm" makes the next sunrise record
+every frame it shows, dithered refreshes and button dimming included, on
+the real clock; "fetch" downloads it once the sunrise has ended. Recordings
+of real alarms only match each other up to timing:
+
+    python3 tools/frame_diff.py arm sunrise-alarm.local --seed 7
+    python3 tools/frame_diff.py fetch sunrise-alarm.local -o alarm.sfr
+    python3 tools/frame_diff.py info alarm.sfr
+
+diff pairs frames by index and reports per-channel maximum and mean
+absolute error, frames whose time or brightness differ and the first frame
+that differs. It exits 1 when the recordings differ by more than
+--tolerance levels, or differ in length or timing.
+"""
+
+import argparse
+import http.client
+import struct
+import sys
+import urllib.parse
+
+MAGIC = b"SFR1"
+FORMAT_VERSION = 1
+FLAG_RENDERED = 1
+OP_SKIP, OP_FILL, OP_COPY = 0x00, 0x40, 0x80
+
+
+class Recording:
+    def __init__(self, leds, seed, flags, frames):
+        self.leds = leds
+        self.seed = seed
+        self.flags = flags
+        self.frames = frames  # (ms since start, brightness, bytes r g b per LED)
+
+
+def read_varint(data, pos):
+    value = shift = 0
+    while True:
+        if pos >= len(data):
+            raise ValueError("recording ends inside a varint")
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def decode(data):
+    if len(data) < 10 or data[:4] != MAGIC:
+        raise ValueError("not a frame recording")
+    version, flags, leds, seed = struct.unpack_from("<BBHH", data, 4)
+    if version != FORMAT_VERSION:
+        raise ValueError(f"format version {version}, expected {FORMAT_VERSION}")
+
+    pixels = bytearray(leds * 3)
+    frames = []
+    at = 0
+    pos = 10
+    while pos < len(data):
+        delta, pos = read_varint(data, pos)
+        if pos >= len(data):
+            raise ValueError(f"frame {len(frames)} has no brightness")
+        at += delta
+        brightness = data[pos]
+        pos += 1
+        led = 0
+        while led < leds:
+            if pos >= len(data):
+                raise ValueError(f"frame {len(frames)} is cut off at LED {led}")
+            op = data[pos] & 0xC0
+            run = (data[pos] & 0x3F) + 1
+            pos += 1
+            if led + run > leds:
+                raise ValueError(f"frame {len(frames)} runs past LED {leds}")
+            if op == OP_FILL:
+                pixels[led * 3:(led + run) * 3] = data[pos:pos + 3] * run
+                pos += 3
+            elif op == OP_COPY:
+                pixels[led * 3:(led + run) * 3] = data[pos:pos + run * 3]
+                pos += run * 3
+            elif op != OP_SKIP:
+                raise ValueError(f"frame {len(frames)} has unknown op 0x{op:02x}")
+            led += run
+        frames.append((at, brightness, bytes(pixels)))
+    return Recording(leds, seed, flags, frames)
+
+
+def load(path):
+    with open(path, "rb") as handle:
+        data = handle.read()
+    try:
+        return decode(data), len(data)
+    except ValueError as error:
+        sys.exit(f"{path}: {error}")
+
+
+def info(path):
+    recording, size = load(path)
+    frames = recording.frames
+    kind = "rendered" if recording.flags & FLAG_RENDERED else "recorded"
+    print(f"{path}: {kind}, {recording.leds} LEDs, seed {recording.seed}")
+    if not frames:
+        print("no frames")
+        return 0
+    raw = len(frames) * (recording.leds * 3 + 5)
+    peak = max(max(pixels) for _, _, pixels in frames)
+    print(f"{len(frames)} frames over {frames[-1][0] / 1000:.1f} s, peak level {peak}")
+    print(f"{size} bytes, {size / len(frames):.1f} per frame, {raw / max(size, 1):.1f}x smaller than raw frames")
+    return 0
+
+
+def diff(path_a, path_b, tolerance, show_frames):
+    a, _ = load(path_a)
+    b, _ = load(path_b)
+    if a.leds != b.leds:
+        sys.exit(f"{path_a} has {a.leds} LEDs, {path_b} has {b.leds}")
+
+    count = min(len(a.frames), len(b.frames))
+    errors = [0, 0, 0]
+    largest = [0, 0, 0]
+    differing_pixels = 0
+    differing_frames = 0
+    timing = 0
+    brightness = 0
+    first = None
+    for index in range(count):
+        at_a, level_a, pixels_a = a.frames[index]
+        at_b, level_b, pixels_b = b.frames[index]
+        timing += at_a != at_b
+        brightness += level_a != level_b
+        if pixels_a == pixels_b and level_a == level_b:
+            continue
+
+        frame_largest = 0
+        frame_pixels = 0
+        for led in range(a.leds):
+            changed = False
+            for channel in range(3):
+                error = abs(pixels_a[led * 3 + channel] - pixels_b[led * 3 + channel])
+                if error:
+                    changed = True
+                    errors[channel] += error
+                    largest[channel] = max(largest[channel], error)
+                    frame_largest = max(frame_largest, error)
+            frame_pixels += changed
+        differing_pixels += frame_pixels
+        differing_frames += 1
+        if first is None:
+            first = index
+        if show_frames:
+            print(f"frame {index:6} at {at_a:8} ms: {frame_pixels:4} LEDs differ, max error {frame_largest}, "
+                  f"brightness {level_a}/{level_b}")
+
+    print(f"{count} frames compared ({len(a.frames)} vs {len(b.frames)}), {a.leds} LEDs")
+    samples = max(count * a.leds, 1)
+    for name, channel in (("red", 0), ("green", 1), ("blue", 2)):
+        print(f"  {name:6} max error {largest[channel]:3}, mean error {errors[channel] / samples:.5f}")
+    print(f"  {differing_frames} frames and {differing_pixels} LED frames differ, "
+          f"{timing} timestamps and {brightness} brightness values differ")
+    if first is not None:
+        print(f"  first difference in frame {first} at {a.frames[first][0]} ms")
+
+    failed = len(a.frames) != len(b.frames) or timing or brightness or max(largest) > tolerance
+    print("DIFFERENT" if failed else "MATCH")
+    return 1 if failed else 0
+
+
+def request(host, port, method, path, output=None):
+    connection = http.client.HTTPConnection(host, port, timeout=120)
+    connection.request(method, path)
+    response = connection.getresponse()
+    body = response.read()
+    connection.close()
+    if response.status != 200:
+        sys.exit(f"device answered {response.status}: {body.decode(errors='replace')}")
+    if output:
+        with open(output, "wb") as handle:
+            handle.write(body)
+        print(f"wrote {len(body)} bytes to {output}")
+    else:
+        print(body.decode(errors="replace"))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    command = commands.add_parser("info", help="summarize a recording")
+    command.add_argument("recording")
+
+    command = commands.add_parser("diff", help="compare two recordings frame by frame")
+    command.add_argument("a")
+    command.add_argument("b")
+    command.add_argument("--tolerance", type=int, default=0, help="largest channel error that still matches")
+    command.add_argument("--frames", action="store_true", help="list every differing frame")
+
+    command = commands.add_parser("render", help="render a sunrise on a device")
+    command.add_argument("host")
+    command.add_argument("-o", "--output", required=True)
+    command.add_argument("--preset", default="sunrise")
+    command.add_argument("--minutes", type=int, default=30)
+    command.add_argument("--brightness", type=int, default=255)
+    command.add_argument("--zone", type=int, default=0)
+    command.add_argument("--seed", type=int, default=1337)
+    command.add_argument("--port", type=int, default=80)
+
+    command = commands.add_parser("arm", help="record the next sunrise on a device")
+    command.add_argument("host")
+    command.add_argument("--seed", type=int, default=1337)
+    command.add_argument("--port", type=int, default=80)
+
+    command = commands.add_parser("fetch", help="download the last recorded sunrise")
+    command.add_argument("host")
+    command.add_argument("-o", "--output", required=True)
+    command.add_argument("--port", type=int, default=80)
+    args = parser.parse_args()
+
+    if args.command == "info":
+        return info(args.recording)
+    if args.command == "diff":
+        return diff(args.a, args.b, args.tolerance, args.frames)
+    if args.command == "render":
+        query = urllib.parse.urlencode({"preset": args.preset, "minutes": args.minutes, "brightness": args.brightness,
+                                        "zone": args.zone, "seed": args.seed})
+        request(args.host, args.port, "GET", "/api/debug/frames/render?" + query, args.output)
+        return info(args.output)
+    if args.command == "arm":
+        request(args.host, args.port, "POST", f"/api/debug/frames/record?seed={args.seed}")
+        return 0
+    request(args.host, args.port, "GET", "/api/debug/frames", args.output)
+    return info(args.output)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
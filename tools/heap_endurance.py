@@ -0,0 +1,220 @@
+#!/usr/bin/env python3
+"""Heap endurance test for the firmware's web and JSON paths.
+
+Sends a long run of requests to an awake device, by default 10,000, cycling
+through the dashboard, a /logs page, /metrics, /api/alarms, /api/log_levels
+and a parse of tools/corpus/alarms/typical.json. Every --sample-every
+requests it reads /api/debug/heap: free heap, the largest free block,
+fragmentation, allocated heap blocks and the scratch pool.
+
+Once the first --warmup requests are done, free heap and largest free block
+must stay flat. The run fails if a least-squares fit of either falls by more
+than --max-slope bytes per 1000 requests, if the largest free block ends
+more than --tolerance bytes below where it stood after the warm-up, if the
+heap refused an allocation or if the device rebooted:
+
+    python3 tools/heap_endurance.py --host 192.168.2.40
+    python3 tools/heap_endurance.py --host 192.168.2.40 --clients 4 --csv heap.csv
+
+With more --clients than SCRATCH_BLOCKS, some requests are answered with
+503 while every block is busy. Those are counted separately and are not
+failures.
+"""
+
+import argparse
+import http.client
+import json
+import os
+import sys
+import threading
+import time
+
+CORPUS_FILE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "corpus", "alarms", "typical.json")
+
+REQUESTS = [
+    ("GET", "/", None),
+    ("GET", "/logs", None),
+    ("GET", "/metrics", None),
+    ("GET", "/api/alarms", None),
+    ("GET", "/api/log_levels", None),
+    ("POST", "/api/debug/parse_alarms", "corpus"),
+]
+
+
+class Device:
+    def __init__(self, host, port, timeout):
+        self.host, self.port, self.timeout = host, port, timeout
+
+    def request(self, method, path, body=None):
+        connection = http.client.HTTPConnection(self.host, self.port, timeout=self.timeout)
+        try:
+            headers = {"Content-Type": "application/json"} if body is not None else {}
+            connection.request(method, path, body=body, headers=headers)
+            response = connection.getresponse()
+            return response.status, response.read()
+        finally:
+            connection.close()
+
+    def heap(self):
+        status, body = self.request("GET", "/api/debug/heap")
+        if status != 200:
+            raise RuntimeError("/api/debug/heap answered %d" % status)
+        return json.loads(body)
+
+
+def slope_per_1000(points):
+    """Least-squares slope of (requests, value) points, in value per 1000 requests."""
+    if len(points) < 2:
+        return 0.0
+    n = len(points)
+    mean_x = sum(x for x, _ in points) / n
+    mean_y = sum(y for _, y in points) / n
+    variance = sum((x - mean_x) ** 2 for x, _ in points)
+    if variance == 0:
+        return 0.0
+    covariance = sum((x - mean_x) * (y - mean_y) for x, y in points)
+    return covariance / variance * 1000
+
+
+class Run:
+    def __init__(self, args):
+        self.args = args
+        self.device = Device(args.host, args.port, args.timeout)
+        with open(args.corpus, "rb") as corpus:
+            self.corpus = corpus.read()
+        self.lock = threading.Lock()
+        self.sent = 0
+        self.limit = 0
+        self.busy = 0
+        self.errors = []
+        self.samples = []
+
+    def next_index(self):
+        with self.lock:
+            if self.sent >= self.limit:
+                return None
+            self.sent += 1
+            return self.sent - 1
+
+    def client(self):
+        while True:
+            index = self.next_index()
+            if index is None:
+                return
+            method, path, body = REQUESTS[index % len(REQUESTS)]
+            try:
+                status, _ = self.device.request(method, path, self.corpus if body == "corpus" else None)
+            except (OSError, http.client.HTTPException) as error:
+                status = str(error)
+            with self.lock:
+                if status == 503:
+                    self.busy += 1
+                elif status != 200:
+                    self.errors.append((index, path, status))
+
+    def sample(self, requests):
+        heap = self.device.heap()
+        heap["requests"] = requests
+        self.samples.append(heap)
+        scratch = heap.get("scratch", {})
+        print("%8d %9d %9d %7.3f %7d %5d %7d" % (
+            requests, heap["free"], heap["largest_free_block"], heap["fragmentation"],
+            heap["allocated_blocks"], scratch.get("in_use_max", 0), scratch.get("used_max", 0)))
+
+    def run(self):
+        print("%8s %9s %9s %7s %7s %5s %7s" % ("requests", "free", "largest", "frag", "blocks", "pool", "pool_b"))
+        self.sample(0)
+        # Requests pause while the heap is sampled, so a sample sees no request in flight
+        while self.limit < self.args.requests:
+            self.limit = min(self.limit + self.args.sample_every, self.args.requests)
+            threads = [threading.Thread(target=self.client) for _ in range(self.args.clients)]
+            for thread in threads:
+                thread.start()
+            for thread in threads:
+                thread.join()
+            self.sample(self.limit)
+
+    def verdict(self):
+        args = self.args
+        failures = []
+        steady = [s for s in self.samples if s["requests"] >= args.warmup]
+        if len(steady) < 2:
+            return ["not enough samples after the warm-up; lower --warmup or --sample-every"]
+
+        for earlier, later in zip(self.samples, self.samples[1:]):
+            if later["uptime_s"] < earlier["uptime_s"]:
+                failures.append("device rebooted before request %d" % later["requests"])
+        if self.samples[-1]["alloc_failures"] > self.samples[0]["alloc_failures"]:
+            failures.append("%d heap allocations failed" %
+                            (self.samples[-1]["alloc_failures"] - self.samples[0]["alloc_failures"]))
+
+        for key, label in (("free", "free heap"), ("largest_free_block", "largest free block")):
+            slope = slope_per_1000([(s["requests"], s[key]) for s in steady])
+            print("%s: %+.1f bytes per 1000 requests" % (label, slope))
+            if slope < -args.max_slope:
+                failures.append("%s falls by %.1f bytes per 1000 requests" % (label, -slope))
+
+        baseline = steady[0]["largest_free_block"]
+        final = steady[-1]["largest_free_block"]
+        print("largest free block: %d after warm-up, %d at the end, lowest ever %d" %
+              (baseline, final, self.samples[-1]["largest_free_block_min"]))
+        if final < baseline - args.tolerance:
+            failures.append("largest free block shrank from %d to %d bytes" % (baseline, final))
+
+        fragmentation = [s["fragmentation"] for s in steady]
+        print("fragmentation: %.3f to %.3f" % (min(fragmentation), max(fragmentation)))
+        print("requests: %d, answered 503 while the scratch pool was busy: %d, errors: %d" %
+              (args.requests, self.busy, len(self.errors)))
+        for index, path, status in self.errors[:10]:
+            failures.append("request %d to %s: %s" % (index, path, status))
+        if len(self.errors) > 10:
+            failures.append("... and %d more failed requests" % (len(self.errors) - 10))
+        return failures
+
+    def write_csv(self, path):
+        columns = ["requests", "uptime_s", "free", "free_min", "largest_free_block", "largest_free_block_min",
+                   "fragmentation", "allocated_blocks", "alloc_failures"]
+        with open(path, "w") as out:
+            out.write(",".join(columns + ["scratch_in_use_max", "scratch_used_max"]) + "\n")
+            for s in self.samples:
+                scratch = s.get("scratch", {})
+                values = [s[c] for c in columns] + [scratch.get("in_use_max", 0), scratch.get("used_max", 0)]
+                out.write(",".join(str(v) for v in values) + "\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--host", required=True)
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--timeout", type=float, default=10)
+    parser.add_argument("--requests", type=int, default=10000)
+    parser.add_argument("--clients", type=int, default=1, help="requests in flight at once")
+    parser.add_argument("--sample-every", type=int, default=250)
+    parser.add_argument("--warmup", type=int, default=500, help="requests before the heap must be flat")
+    parser.add_argument("--max-slope", type=float, default=16, help="bytes per 1000 requests")
+    parser.add_argument("--tolerance", type=int, default=1024, help="bytes the largest free block may end lower")
+    parser.add_argument("--corpus", default=CORPUS_FILE)
+    parser.add_argument("--csv", help="write the heap samples to this file")
+    args = parser.parse_args()
+
+    run = Run(args)
+    start = time.time()
+    try:
+        run.run()
+    except (OSError, http.client.HTTPException, RuntimeError) as error:
+        print("device stopped answering: %s" % error)
+        return 1
+    print("%d requests in %.0f s" % (args.requests, time.time() - start))
+
+    failures = run.verdict()
+    if args.csv:
+        run.write_csv(args.csv)
+    for failure in failures:
+        print("FAIL: %s" % failure)
+    if not failures:
+        print("PASS: heap flat over %d requests" % args.requests)
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
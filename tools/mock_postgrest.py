@@ -0,0 +1,930 @@
+#!/usr/bin/env python3
+"""Local stand-in for the Supabase PostgREST API used by the firmware.
+
+Implements the `alarms`, `alarm_events` and `color_presets` tables and the
+device_schedule() function from database_setup.sql in memory: eq/neq/gt/gte/lt/lte/in/is filters, `select` projection, `order`,
+`limit`/`offset`, single and bulk inserts (with `on_conflict` and
+`Prefer: resolution=ignore-duplicates`), updates (with the updated_at
+trigger) and deletes, including the CHECK and UNIQUE constraints. Latency, 5xx responses, truncated bodies and hung
+requests can be injected to exercise the sync path's error handling.
+
+Serve it and point the device at it by setting SUPABASE_URL in config.h to
+"http://<host>:<port>":
+
+    python3 tools/mock_postgrest.py serve --rows 100 --device-id 24:0A:C4:12:34:56
+
+Faults can be changed while running:
+
+    curl -X POST localhost:54321/_mock/faults -d '{"error_rate": 0.3}'
+
+The same port serves a Supabase Realtime stand-in at /realtime/v1/websocket:
+Phoenix channel joins with postgres_changes filters, heartbeats, and a
+change message for every insert, update and delete made through the REST
+API. Dropping or refusing sockets exercises the device's polling fallback:
+
+    curl -X POST localhost:54321/_mock/realtime -d '{"drop": true, "enabled": false}'
+
+`bench` runs the firmware's alarm query against an in-process server for
+10, 100 and 1000 rows, next to `select=*` and the packed schedule of the
+device_schedule() function, and checks that every injected failure is
+visible to the client. With --device it also posts each body to the
+device's parse benchmark and reports the time to decode it:
+
+    python3 tools/mock_postgrest.py bench
+    python3 tools/mock_postgrest.py bench --device sunrise-alarm.local
+
+The firmware's own sync runs against a served mock in the native_sync
+PlatformIO environment (native/sync/main.cpp), which times it for the same
+row counts and checks the same failures end to end. It sets
+`schedule_function` in the faults to serve a database without
+device_schedule().
+"""
+
+import argparse
+import base64
+import datetime
+import hashlib
+import http.client
+import json
+import random
+import re
+import socket
+import statistics
+import struct
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qsl, urlsplit
+
+COLOR_PRESETS = ("sunrise", "ocean", "forest", "lavender")
+PRESET_EFFECTS = ("breathing", "sparkle", "warmth", "wave")
+
+# Column name -> (type, default); None marks NOT NULL columns without default
+ALARM_COLUMNS = {
+    "id": ("int", None),
+    "device_id": ("text", None),
+    "local_id": ("int", "null"),
+    "time": ("text", None),
+    "days_of_week": ("int[]", None),
+    "is_enabled": ("bool", True),
+    "brightness_level": ("int", 255),
+    "duration_minutes": ("int", 30),
+    "color_preset": ("text", "sunrise"),
+    "zone": ("int", 0),
+    "created_at": ("timestamptz", "now"),
+    "updated_at": ("timestamptz", "now"),
+}
+
+ALARM_EVENT_COLUMNS = {
+    "id": ("int", None),
+    "device_id": ("text", None),
+    "sequence": ("int", None),
+    "alarm_id": ("int", None),
+    "event_type": ("text", None),
+    "occurred_at": ("timestamptz", "null"),
+    "sunrise_seconds": ("int", "null"),
+    "dismiss_source": ("text", "null"),
+    "received_at": ("timestamptz", "now"),
+}
+
+COLOR_PRESET_COLUMNS = {
+    "id": ("int", None),
+    "device_id": ("text", None),
+    "name": ("text", None),
+    "stages": ("jsonb", None),
+    "effects": ("text[]", "{}"),
+    "version": ("int", 0),
+    "created_at": ("timestamptz", "now"),
+    "updated_at": ("timestamptz", "now"),
+}
+
+# The query the firmware sends from AlarmManager::fetch_remote_rows
+DEVICE_SELECT = ("select=id,local_id,time,days_of_week,is_enabled,brightness_level,duration_minutes,"
+                 "color_preset,zone,updated_at&device_id=eq.{device_id}&order=is_enabled.desc,updated_at.desc&limit=10")
+
+
+def pack_schedule(table, device_id, version="", limit=10):
+    """Mirrors device_schedule() in database_setup.sql: the device's alarms as
+    fixed-size big-endian records in base64, or "" when version is current."""
+    with table.lock:
+        rows = [dict(r) for r in table.rows if r["device_id"] == device_id]
+    rows = [r for r in rows
+            if 0 <= (255 if r["brightness_level"] is None else r["brightness_level"]) <= 255
+            and 1 <= (30 if r["duration_minutes"] is None else r["duration_minutes"]) <= 1440]
+    rows.sort(key=lambda r: r["id"])
+    rows.sort(key=lambda r: r["updated_at"], reverse=True)
+    rows.sort(key=lambda r: r["is_enabled"] is not False, reverse=True)
+    rows = rows[:limit]
+
+    presets = []
+    names = b""
+    records = b""
+    for row in rows:
+        name = (row["color_preset"] or "sunrise").encode()[:15]
+        if name not in presets:
+            presets.append(name)
+            names += bytes([len(name)]) + name
+        hour, minute = (int(part) for part in row["time"].split(":")[:2])
+        days = 0
+        for day in row["days_of_week"]:
+            if 0 <= day <= 6:
+                days |= 1 << day
+        updated_at = int(datetime.datetime.fromisoformat(row["updated_at"]).timestamp()) if row["updated_at"] else 0
+        records += struct.pack(">iIHHBBBBB", row["id"], updated_at & 0xFFFFFFFF,
+                               30 if row["duration_minutes"] is None else row["duration_minutes"],
+                               hour * 60 + minute, days, 0 if row["is_enabled"] is False else 1,
+                               255 if row["brightness_level"] is None else row["brightness_level"],
+                               row["zone"] or 0, presets.index(name))
+
+    body = names + records
+    digest = hashlib.md5(body).hexdigest()[:8]
+    if digest == version:
+        return ""
+    header = struct.pack(">BBBB", 1, len(rows), len(presets), 0) + bytes.fromhex(digest)
+    return base64.b64encode(header + body).decode()
+
+
+def now_timestamp():
+    # Same shape PostgREST returns for timestamptz
+    return datetime.datetime.now(datetime.timezone.utc).isoformat(timespec="microseconds")
+
+
+class PostgrestError(Exception):
+    def __init__(self, status, code, message):
+        super().__init__(message)
+        self.status = status
+        self.body = {"code": code, "details": None, "hint": None, "message": message}
+
+
+class Table:
+    name = None
+    columns = None
+    unique = ()
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.rows = []
+        self.next_id = 1
+        self.listeners = []
+
+    def notify(self, change_type, record, old_record):
+        for listener in self.listeners:
+            listener(change_type, record, old_record)
+
+    def check(self, row):
+        pass
+
+    def select(self, query):
+        with self.lock:
+            rows = [r for r in self.rows if matches(r, query["filters"])]
+        for column, descending in reversed(query["order"]):
+            rows.sort(key=lambda r: (r[column] is None, r[column]), reverse=descending)
+        rows = rows[query["offset"]:]
+        if query["limit"] is not None:
+            rows = rows[:query["limit"]]
+        return [project(r, query["select"]) for r in rows]
+
+    def insert(self, payload, ignore_duplicates=False):
+        items = payload if isinstance(payload, list) else [payload]
+        created = []
+        with self.lock:
+            for item in items:
+                row = self.validated(dict(item), insert=True)
+                if self.unique and self.find_duplicate(row, created):
+                    if ignore_duplicates:
+                        continue
+                    raise PostgrestError(409, "23505", "duplicate key value violates unique constraint \"%s_%s_key\""
+                                         % (self.name, "_".join(self.unique)))
+                row["id"] = self.next_id
+                self.next_id += 1
+                created.append(row)
+            self.rows.extend(created)
+        for row in created:
+            self.notify("INSERT", dict(row), None)
+        return created
+
+    def update(self, filters, changes):
+        if "id" in changes:
+            raise PostgrestError(400, "428C9", "column \"id\" can only be updated to DEFAULT")
+        with self.lock:
+            updated = []
+            for row in self.rows:
+                if matches(row, filters):
+                    candidate = self.validated(dict(row, **changes), insert=False)
+                    if "updated_at" in self.columns:
+                        candidate["updated_at"] = now_timestamp()
+                    row.update(candidate)
+                    updated.append(dict(row))
+        for row in updated:
+            self.notify("UPDATE", row, {"id": row["id"]})
+        return updated
+
+    def delete(self, filters):
+        with self.lock:
+            deleted = [r for r in self.rows if matches(r, filters)]
+            self.rows = [r for r in self.rows if not matches(r, filters)]
+        for row in deleted:
+            self.notify("DELETE", None, {"id": row["id"]})
+        return deleted
+
+    def find_duplicate(self, row, pending):
+        key = tuple(row[c] for c in self.unique)
+        # NULLs never conflict, as in a Postgres unique index
+        if None in key:
+            return False
+        return any(tuple(r[c] for c in self.unique) == key for r in self.rows + pending)
+
+    def validated(self, row, insert):
+        for column in row:
+            if column not in self.columns:
+                raise PostgrestError(400, "PGRST204",
+                                     "Could not find the '%s' column of '%s' in the schema cache" % (column, self.name))
+        if insert:
+            for column, (_, default) in self.columns.items():
+                if column == "id" or column in row:
+                    continue
+                if default is None:
+                    raise PostgrestError(400, "23502",
+                                         "null value in column \"%s\" violates not-null constraint" % column)
+                row[column] = {"now": now_timestamp(), "null": None}.get(default, default)
+        self.check(row)
+        return row
+
+
+class AlarmTable(Table):
+    name = "alarms"
+    columns = ALARM_COLUMNS
+    unique = ("device_id", "local_id")
+
+    def seed(self, count, device_id, seed=0):
+        rng = random.Random(seed)
+        base = datetime.datetime(2025, 1, 1, tzinfo=datetime.timezone.utc)
+        with self.lock:
+            self.rows = []
+            self.next_id = 1
+            for i in range(count):
+                stamp = (base + datetime.timedelta(minutes=i)).isoformat(timespec="microseconds")
+                self.rows.append({
+                    "id": self.next_id,
+                    "device_id": device_id,
+                    "local_id": None,
+                    "time": "%02d:%02d:00" % (rng.randrange(24), rng.randrange(60)),
+                    "days_of_week": sorted(rng.sample(range(7), rng.randint(1, 7))),
+                    "is_enabled": rng.random() < 0.8,
+                    "brightness_level": rng.randint(1, 255),
+                    "duration_minutes": rng.randint(5, 60),
+                    "color_preset": rng.choice(COLOR_PRESETS),
+                    "zone": rng.choice((0, 0, 1, 2)),
+                    "created_at": stamp,
+                    "updated_at": stamp,
+                })
+                self.next_id += 1
+
+    def check(self, row):
+        brightness = row["brightness_level"]
+        if not isinstance(brightness, int) or not 0 <= brightness <= 255:
+            raise PostgrestError(400, "23514", "new row violates check constraint \"alarms_brightness_level_check\"")
+        if not isinstance(row["duration_minutes"], int) or row["duration_minutes"] <= 0:
+            raise PostgrestError(400, "23514", "new row violates check constraint \"alarms_duration_minutes_check\"")
+        preset = row["color_preset"]
+        if not isinstance(preset, str) or not 0 < len(preset) <= 50:
+            raise PostgrestError(400, "23514", "new row violates check constraint \"alarms_color_preset_check\"")
+        zone = row["zone"]
+        if not isinstance(zone, int) or not 0 <= zone <= 255:
+            raise PostgrestError(400, "23514", "new row violates check constraint \"alarms_zone_check\"")
+
+
+class AlarmEventTable(Table):
+    name = "alarm_events"
+    columns = ALARM_EVENT_COLUMNS
+    unique = ("device_id", "sequence")
+
+    def check(self, row):
+        if row["event_type"] not in ("fired", "completed", "dismissed", "missed", "snoozed"):
+            raise PostgrestError(400, "23514", "new row violates check constraint \"alarm_events_event_type_check\"")
+        if row["dismiss_source"] not in (None, "web", "button"):
+            raise PostgrestError(400, "23514",
+                                 "new row violates check constraint \"alarm_events_dismiss_source_check\"")
+
+
+class ColorPresetTable(Table):
+    name = "color_presets"
+    columns = COLOR_PRESET_COLUMNS
+    unique = ("device_id", "name")
+
+    def __init__(self):
+        super().__init__()
+        self.next_version = 1
+
+    # Stands in for the color_preset_versions sequence and the bump_color_presets_version trigger
+    def validated(self, row, insert):
+        if insert:
+            row.setdefault("effects", [])
+        row = super().validated(row, insert)
+        row["version"] = self.next_version
+        self.next_version += 1
+        return row
+
+    def check(self, row):
+        name = row["name"]
+        if (not isinstance(name, str) or not re.fullmatch(r"[a-z0-9_-]{1,15}", name)
+                or name in COLOR_PRESETS):
+            raise PostgrestError(400, "23514", "new row violates check constraint \"color_presets_name_check\"")
+        stages = row["stages"]
+        if not isinstance(stages, list) or not 2 <= len(stages) <= 6:
+            raise PostgrestError(400, "23514", "new row violates check constraint \"color_presets_stages_check\"")
+        effects = row["effects"]
+        if not isinstance(effects, list) or any(e not in PRESET_EFFECTS for e in effects):
+            raise PostgrestError(400, "23514", "new row violates check constraint \"color_presets_effects_check\"")
+
+
+def coerce(columns, column, text):
+    kind = columns[column][0]
+    if kind == "int":
+        try:
+            return int(text)
+        except ValueError:
+            raise PostgrestError(400, "22P02", "invalid input syntax for type integer: \"%s\"" % text)
+    if kind == "bool":
+        return text.lower() in ("true", "t", "1")
+    return text
+
+
+def matches(row, filters):
+    for column, negate, op, value in filters:
+        current = row.get(column)
+        if op == "eq":
+            result = current == value
+        elif op == "neq":
+            result = current != value
+        elif op == "gt":
+            result = current is not None and current > value
+        elif op == "gte":
+            result = current is not None and current >= value
+        elif op == "lt":
+            result = current is not None and current < value
+        elif op == "lte":
+            result = current is not None and current <= value
+        elif op == "in":
+            result = current in value
+        else:  # is
+            result = current is value
+        if result == negate:
+            return False
+    return True
+
+
+def project(row, columns):
+    if columns is None:
+        return dict(row)
+    return {c: row[c] for c in columns}
+
+
+def parse_query(query_string, table):
+    query = {"select": None, "filters": [], "order": [], "limit": None, "offset": 0}
+    for key, value in parse_qsl(query_string, keep_blank_values=True):
+        if key == "select":
+            columns = [c.strip() for c in value.split(",") if c.strip()]
+            if "*" not in columns:
+                for column in columns:
+                    check_column(table, column)
+                query["select"] = columns
+        elif key == "order":
+            for term in value.split(","):
+                parts = term.split(".")
+                check_column(table, parts[0])
+                query["order"].append((parts[0], len(parts) > 1 and parts[1] == "desc"))
+        elif key in ("limit", "offset"):
+            query[key] = int(value)
+        else:
+            if key == "on_conflict":
+                continue
+            check_column(table, key)
+            negate = value.startswith("not.")
+            if negate:
+                value = value[4:]
+            op, _, operand = value.partition(".")
+            if op in ("eq", "neq", "gt", "gte", "lt", "lte"):
+                operand = coerce(table.columns, key, operand)
+            elif op == "in":
+                operand = [coerce(table.columns, key, v.strip().strip('"')) for v in operand.strip("()").split(",")]
+            elif op == "is":
+                operand = {"null": None, "true": True, "false": False}[operand.lower()]
+            else:
+                raise PostgrestError(400, "PGRST100", "unknown operator \"%s\"" % op)
+            query["filters"].append((key, negate, op, operand))
+    return query
+
+
+def check_column(table, column):
+    if column not in table.columns:
+        raise PostgrestError(400, "42703", "column %s.%s does not exist" % (table.name, column))
+
+
+class Faults:
+    def __init__(self, latency_ms=0, jitter_ms=0, error_rate=0.0, error_status=503,
+                 truncate_rate=0.0, hang_rate=0.0, hang_ms=30000, schedule_function=True, seed=None):
+        self.latency_ms = latency_ms
+        self.jitter_ms = jitter_ms
+        self.error_rate = error_rate
+        self.error_status = error_status
+        self.truncate_rate = truncate_rate
+        self.hang_rate = hang_rate
+        self.hang_ms = hang_ms
+        # False answers device_schedule() with a 404, as a database without the migration
+        self.schedule_function = schedule_function
+        self.rng = random.Random(seed)
+
+    def update(self, values):
+        for key, value in values.items():
+            if key in self.as_dict():
+                setattr(self, key, type(getattr(self, key))(value))
+
+    def as_dict(self):
+        return {k: v for k, v in vars(self).items() if k != "rng"}
+
+
+class WebSocket:
+    """Server side of RFC 6455, enough for one text-message client."""
+
+    GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+    def __init__(self, handler):
+        self.handler = handler
+        self.send_lock = threading.Lock()
+        self.closed = False
+
+    @classmethod
+    def accept_key(cls, key):
+        return base64.b64encode(hashlib.sha1((key + cls.GUID).encode()).digest()).decode()
+
+    def send(self, opcode, payload):
+        header = bytes([0x80 | opcode])
+        if len(payload) < 126:
+            header += bytes([len(payload)])
+        elif len(payload) < 65536:
+            header += bytes([126]) + struct.pack(">H", len(payload))
+        else:
+            header += bytes([127]) + struct.pack(">Q", len(payload))
+        with self.send_lock:
+            if self.closed:
+                return
+            try:
+                self.handler.wfile.write(header + payload)
+                self.handler.wfile.flush()
+            except OSError:
+                self.closed = True
+
+    def send_json(self, message):
+        self.send(0x1, json.dumps(message, separators=(",", ":")).encode())
+
+    def receive(self):
+        """Returns the next text message, or None once the connection is gone."""
+        while not self.closed:
+            try:
+                header = self.handler.rfile.read(2)
+                if len(header) < 2:
+                    break
+                opcode = header[0] & 0x0F
+                length = header[1] & 0x7F
+                if length == 126:
+                    length = struct.unpack(">H", self.handler.rfile.read(2))[0]
+                elif length == 127:
+                    length = struct.unpack(">Q", self.handler.rfile.read(8))[0]
+                mask = self.handler.rfile.read(4) if header[1] & 0x80 else b"\0\0\0\0"
+                payload = bytes(b ^ mask[i % 4] for i, b in enumerate(self.handler.rfile.read(length)))
+            except OSError:
+                break
+            if opcode == 0x8:
+                self.send(0x8, payload[:2])
+                break
+            if opcode == 0x9:
+                self.send(0xA, payload)
+            elif opcode == 0x1:
+                return payload.decode("utf-8", "replace")
+        self.close()
+        return None
+
+    def close(self):
+        with self.send_lock:
+            if self.closed:
+                return
+            self.closed = True
+        try:
+            self.handler.connection.shutdown(socket.SHUT_RDWR)
+        except OSError:
+            pass
+
+
+class RealtimeHub:
+    """Phoenix channel side of Supabase Realtime, limited to postgres_changes."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.enabled = True
+        self.sockets = set()
+        self.subscriptions = {}  # (socket, topic) -> (join_ref, [(id, event, filters)])
+        self.next_subscription_id = 1
+
+    def subscribe(self, ws, topic, join_ref, config):
+        specs = []
+        response = []
+        for change in config.get("postgres_changes", []):
+            if change.get("table", "*") not in ("*", "alarms"):
+                raise PostgrestError(400, "RT001", "unknown table %s" % change.get("table"))
+            filters = parse_query(change["filter"], AlarmTable)["filters"] if change.get("filter") else []
+            with self.lock:
+                subscription_id = self.next_subscription_id
+                self.next_subscription_id += 1
+            specs.append((subscription_id, change.get("event", "*").upper(), filters))
+            response.append(dict(change, id=subscription_id))
+        with self.lock:
+            self.subscriptions[(ws, topic)] = (join_ref, specs)
+        return {"postgres_changes": response}
+
+    def unsubscribe(self, ws, topic=None):
+        with self.lock:
+            for key in list(self.subscriptions):
+                if key[0] is ws and (topic is None or key[1] == topic):
+                    del self.subscriptions[key]
+
+    def publish(self, change_type, record, old_record):
+        with self.lock:
+            targets = list(self.subscriptions.items())
+        for (ws, topic), (join_ref, specs) in targets:
+            # Like Supabase, DELETE events ignore filters: the old row only carries the primary key
+            ids = [sid for sid, event, filters in specs
+                   if event in ("*", change_type) and (record is None or matches(record, filters))]
+            if not ids:
+                continue
+            data = {"schema": "public", "table": "alarms", "commit_timestamp": now_timestamp(),
+                    "type": change_type, "errors": None,
+                    "columns": [{"name": c, "type": t} for c, (t, _) in ALARM_COLUMNS.items()]}
+            if record is not None:
+                data["record"] = record
+            if old_record is not None:
+                data["old_record"] = old_record
+            ws.send_json({"topic": topic, "event": "postgres_changes", "payload": {"data": data, "ids": ids},
+                          "ref": None, "join_ref": join_ref})
+
+    def drop_all(self):
+        with self.lock:
+            sockets = list(self.sockets)
+        for ws in sockets:
+            ws.close()
+        return len(sockets)
+
+
+class MockServer(ThreadingHTTPServer):
+    daemon_threads = True
+
+    def __init__(self, address, table, faults, api_key=None, quiet=False):
+        super().__init__(address, Handler)
+        self.table = table
+        self.tables = {"alarms": table, "alarm_events": AlarmEventTable(), "color_presets": ColorPresetTable()}
+        self.faults = faults
+        self.api_key = api_key
+        self.quiet = quiet
+        self.request_count = 0
+        self.realtime = RealtimeHub()
+        table.listeners.append(self.realtime.publish)
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    server_version = "postgrest-mock"
+    # Headers and body go out in separate writes; with Nagle the body would wait for the client's delayed ACK
+    disable_nagle_algorithm = True
+
+    def log_message(self, fmt, *args):
+        if not self.server.quiet:
+            sys.stderr.write("%s %s\n" % (self.log_date_time_string(), fmt % args))
+
+    def do_GET(self):
+        if (urlsplit(self.path).path == "/realtime/v1/websocket"
+                and self.headers.get("Upgrade", "").lower() == "websocket"):
+            return self.handle_websocket()
+        self.dispatch()
+
+    def do_POST(self):
+        self.dispatch()
+
+    def do_PATCH(self):
+        self.dispatch()
+
+    def do_DELETE(self):
+        self.dispatch()
+
+    def dispatch(self):
+        url = urlsplit(self.path)
+        length = int(self.headers.get("Content-Length") or 0)
+        raw_body = self.rfile.read(length) if length else b""
+
+        if url.path.startswith("/_mock/"):
+            return self.handle_control(url.path, raw_body)
+
+        self.server.request_count += 1
+        faults = self.server.faults
+        delay = faults.latency_ms + (faults.rng.uniform(0, faults.jitter_ms) if faults.jitter_ms else 0)
+        if faults.rng.random() < faults.hang_rate:
+            delay += faults.hang_ms
+        if delay:
+            time.sleep(delay / 1000.0)
+        if faults.rng.random() < faults.error_rate:
+            return self.send_json(faults.error_status, {"message": "injected failure"})
+
+        try:
+            status, payload = self.handle_rest(url, raw_body)
+        except PostgrestError as error:
+            status, payload = error.status, error.body
+        except (ValueError, KeyError) as error:
+            status, payload = 400, {"code": "PGRST100", "message": str(error)}
+
+        truncate = faults.rng.random() < faults.truncate_rate
+        self.send_json(status, payload, truncate=truncate)
+
+    def handle_rest(self, url, raw_body):
+        if self.server.api_key and self.headers.get("apikey") != self.server.api_key:
+            raise PostgrestError(401, "PGRST301", "Invalid API key")
+
+        parts = url.path.strip("/").split("/")
+        if len(parts) == 4 and parts[:3] == ["rest", "v1", "rpc"]:
+            return self.handle_rpc(parts[3], url, raw_body)
+        if len(parts) != 3 or parts[:2] != ["rest", "v1"]:
+            raise PostgrestError(404, "PGRST125", "Invalid path specified in request URL")
+        table = self.server.tables.get(parts[2])
+        if table is None:
+            raise PostgrestError(404, "42P01", "relation \"public.%s\" does not exist" % parts[2])
+
+        query = parse_query(url.query, table)
+        prefer = self.headers.get("Prefer") or ""
+        representation = "return=representation" in prefer
+
+        if self.command == "GET":
+            return 200, table.select(query)
+        if self.command == "POST":
+            rows = table.insert(json.loads(raw_body or b"null"), "resolution=ignore-duplicates" in prefer)
+            return 201, [project(r, query["select"]) for r in rows] if representation else None
+        if not query["filters"]:
+            raise PostgrestError(400, "21000", "%s requires a WHERE clause" % self.command)
+        if self.command == "PATCH":
+            rows = table.update(query["filters"], json.loads(raw_body or b"{}"))
+        else:
+            rows = table.delete(query["filters"])
+        if representation:
+            return 200, [project(r, query["select"]) for r in rows]
+        return 204, None
+
+    def handle_rpc(self, function, url, raw_body):
+        params = dict(parse_qsl(url.query))
+        if self.command == "POST":
+            params = json.loads(raw_body or b"{}")
+        if (function != "device_schedule" or "p_device_id" not in params
+                or not self.server.faults.schedule_function):
+            raise PostgrestError(404, "PGRST202", "Could not find the function public.%s in the schema cache"
+                                 % function)
+        return 200, pack_schedule(self.server.table, params["p_device_id"], params.get("p_version", ""),
+                                  int(params.get("p_limit", 10)))
+
+    def handle_websocket(self):
+        hub = self.server.realtime
+        params = dict(parse_qsl(urlsplit(self.path).query))
+        if not hub.enabled:
+            return self.send_json(503, {"message": "realtime disabled"})
+        if self.server.api_key and params.get("apikey") != self.server.api_key:
+            return self.send_json(401, {"message": "Invalid API key"})
+
+        self.send_response(101, "Switching Protocols")
+        self.send_header("Upgrade", "websocket")
+        self.send_header("Connection", "Upgrade")
+        self.send_header("Sec-WebSocket-Accept", WebSocket.accept_key(self.headers.get("Sec-WebSocket-Key", "")))
+        self.end_headers()
+        self.close_connection = True
+
+        ws = WebSocket(self)
+        with hub.lock:
+            hub.sockets.add(ws)
+        try:
+            while True:
+                text = ws.receive()
+                if text is None:
+                    break
+                try:
+                    message = json.loads(text)
+                except ValueError:
+                    continue
+                self.handle_phoenix(ws, message)
+        finally:
+            hub.unsubscribe(ws)
+            with hub.lock:
+                hub.sockets.discard(ws)
+
+    def handle_phoenix(self, ws, message):
+        topic = message.get("topic")
+        event = message.get("event")
+        status, response = "ok", {}
+        try:
+            if event == "phx_join":
+                config = (message.get("payload") or {}).get("config") or {}
+                response = self.server.realtime.subscribe(ws, topic, message.get("join_ref"), config)
+            elif event == "phx_leave":
+                self.server.realtime.unsubscribe(ws, topic)
+            elif event != "heartbeat":
+                status, response = "error", {"reason": "unknown event %s" % event}
+        except (PostgrestError, KeyError, ValueError) as error:
+            status, response = "error", {"reason": str(error)}
+        ws.send_json({"topic": topic, "event": "phx_reply", "payload": {"status": status, "response": response},
+                      "ref": message.get("ref"), "join_ref": message.get("join_ref")})
+
+    def handle_control(self, path, raw_body):
+        values = json.loads(raw_body) if raw_body else {}
+        if path == "/_mock/faults":
+            self.server.faults.update(values)
+            return self.send_json(200, self.server.faults.as_dict())
+        if path == "/_mock/seed":
+            self.server.table.seed(int(values.get("rows", 10)), values.get("device_id", "24:0A:C4:00:00:00"))
+            return self.send_json(200, {"rows": len(self.server.table.rows)})
+        if path == "/_mock/realtime":
+            hub = self.server.realtime
+            hub.enabled = bool(values.get("enabled", hub.enabled))
+            dropped = hub.drop_all() if values.get("drop") else 0
+            return self.send_json(200, {"enabled": hub.enabled, "dropped": dropped})
+        if path == "/_mock/stats":
+            return self.send_json(200, {"requests": self.server.request_count,
+                                        "rows": len(self.server.table.rows),
+                                        "alarm_events": len(self.server.tables["alarm_events"].rows),
+                                        "realtime_sockets": len(self.server.realtime.sockets)})
+        return self.send_json(404, {"message": "unknown control endpoint"})
+
+    def send_json(self, status, payload, truncate=False):
+        body = b"" if payload is None else json.dumps(payload, separators=(",", ":")).encode()
+        self.send_response(status)
+        if body:
+            self.send_header("Content-Type", "application/json; charset=utf-8")
+        if status == 200 and isinstance(payload, list):
+            end = len(payload) - 1
+            self.send_header("Content-Range", "0-%d/*" % end if end >= 0 else "*/*")
+        self.send_header("Content-Length", str(len(body)))
+        if truncate:
+            # Advertise the full length but drop the connection halfway through the body
+            self.send_header("Connection", "close")
+            self.end_headers()
+            self.wfile.write(body[:len(body) // 2])
+            self.close_connection = True
+            return
+        self.end_headers()
+        self.wfile.write(body)
+
+
+def serve(args):
+    table = AlarmTable()
+    table.seed(args.rows, args.device_id, args.seed)
+    faults = Faults(args.latency_ms, args.jitter_ms, args.error_rate, args.error_status,
+                    args.truncate_rate, args.hang_rate, args.hang_ms, not args.no_schedule_function, args.seed)
+    server = MockServer((args.host, args.port), table, faults, args.api_key, args.quiet)
+    print("Mock PostgREST on http://%s:%d/rest/v1/ (%d alarms for %s)"
+          % (args.host, server.server_port, args.rows, args.device_id))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+def fetch(port, path, timeout):
+    """Issues one request the way the firmware does; returns (status, body, ms)."""
+    start = time.perf_counter()
+    connection = http.client.HTTPConnection("127.0.0.1", port, timeout=timeout)
+    try:
+        connection.request("GET", path, headers={"apikey": "bench", "Authorization": "Bearer bench"})
+        response = connection.getresponse()
+        body = response.read()
+        return response.status, body, (time.perf_counter() - start) * 1000
+    finally:
+        connection.close()
+
+
+def bench(args):
+    device_id = "24:0A:C4:00:00:01"
+    table = AlarmTable()
+    faults = Faults(latency_ms=args.latency_ms, seed=1)
+    server = MockServer(("127.0.0.1", 0), table, faults, quiet=True)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    port = server.server_port
+    limited = "/rest/v1/alarms?" + DEVICE_SELECT.format(device_id=device_id)
+    unlimited = "/rest/v1/alarms?select=*&device_id=eq." + device_id
+    schedule = "/rest/v1/rpc/device_schedule?p_device_id=%s&p_limit=10" % device_id
+
+    print("%-6s %-22s %10s %10s %10s" % ("rows", "query", "median ms", "p95 ms", "bytes"))
+    for rows in (10, 100, 1000):
+        table.seed(rows, device_id)
+        _, body, _ = fetch(port, schedule, timeout=5)
+        unchanged = schedule + "&p_version=" + base64.b64decode(json.loads(body))[4:8].hex()
+        for label, path in (("device (projected)", limited), ("select=* unlimited", unlimited),
+                            ("rpc device_schedule", schedule), ("rpc unchanged", unchanged)):
+            samples = []
+            size = 0
+            for _ in range(args.iterations):
+                status, body, ms = fetch(port, path, timeout=5)
+                assert status == 200, status
+                json.loads(body)
+                samples.append(ms)
+                size = len(body)
+            samples.sort()
+            p95 = samples[min(len(samples) - 1, int(len(samples) * 0.95))]
+            print("%-6d %-22s %10.2f %10.2f %10d" % (rows, label, statistics.median(samples), p95, size))
+
+    table.seed(10, device_id)
+    if args.device:
+        compare_decode(args, port, device_id)
+    failures = 0
+
+    faults.update({"error_rate": 1.0, "error_status": 503})
+    status, _, _ = fetch(port, limited, timeout=5)
+    failures += report("5xx response", status == 503, "status %d" % status)
+    faults.update({"error_rate": 0.0})
+
+    faults.update({"truncate_rate": 1.0})
+    try:
+        _, body, _ = fetch(port, limited, timeout=5)
+        json.loads(body)
+        failures += report("truncated JSON", False, "complete body received")
+    except (http.client.IncompleteRead, ValueError) as error:
+        failures += report("truncated JSON", True, type(error).__name__)
+    faults.update({"truncate_rate": 0.0})
+
+    faults.update({"hang_rate": 1.0, "hang_ms": 1500})
+    try:
+        fetch(port, limited, timeout=0.5)
+        failures += report("timeout", False, "response arrived")
+    except socket.timeout:
+        failures += report("timeout", True, "client gave up after 500 ms")
+    faults.update({"hang_rate": 0.0})
+
+    server.shutdown()
+    return 1 if failures else 0
+
+
+def compare_decode(args, port, device_id):
+    """Times the device decoding the same 10 alarms as rows and as a packed schedule."""
+    bodies = (("select=*", "/rest/v1/alarms?select=*&device_id=eq.%s&order=updated_at.desc&limit=10" % device_id,
+               "rows"),
+              ("device (projected)", "/rest/v1/alarms?" + DEVICE_SELECT.format(device_id=device_id), "rows"),
+              ("rpc device_schedule", "/rest/v1/rpc/device_schedule?p_device_id=%s&p_limit=10" % device_id,
+               "packed"))
+    print("\n%-22s %10s %10s %14s" % ("decode on " + args.device, "bytes", "us/parse", "bytes alloc"))
+    for label, path, body_format in bodies:
+        _, body, _ = fetch(port, path, timeout=5)
+        connection = http.client.HTTPConnection(args.device, args.device_port, timeout=30)
+        connection.request("POST", "/api/debug/parse_alarms?iterations=%d&format=%s" % (args.iterations, body_format),
+                           body)
+        response = connection.getresponse()
+        result = json.loads(response.read())
+        connection.close()
+        if response.status != 200:
+            print("%-22s device answered %d: %s" % (label, response.status, result))
+            continue
+        print("%-22s %10d %10d %14d" % (label, len(body), result["micros_per_parse"], result["bytes_allocated"]))
+
+
+def report(name, ok, detail):
+    print("%-16s %s (%s)" % (name, "ok" if ok else "FAILED", detail))
+    return 0 if ok else 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    serve_parser = commands.add_parser("serve", help="run the mock server")
+    serve_parser.add_argument("--host", default="0.0.0.0")
+    serve_parser.add_argument("--port", type=int, default=54321)
+    serve_parser.add_argument("--rows", type=int, default=3, help="alarms seeded for --device-id")
+    serve_parser.add_argument("--device-id", default="24:0A:C4:00:00:00")
+    serve_parser.add_argument("--api-key", help="reject requests without this apikey header")
+    serve_parser.add_argument("--latency-ms", type=float, default=0)
+    serve_parser.add_argument("--jitter-ms", type=float, default=0)
+    serve_parser.add_argument("--error-rate", type=float, default=0.0)
+    serve_parser.add_argument("--error-status", type=int, default=503)
+    serve_parser.add_argument("--truncate-rate", type=float, default=0.0)
+    serve_parser.add_argument("--hang-rate", type=float, default=0.0)
+    serve_parser.add_argument("--hang-ms", type=float, default=30000)
+    serve_parser.add_argument("--no-schedule-function", action="store_true",
+                              help="answer device_schedule() with a 404")
+    serve_parser.add_argument("--seed", type=int, default=0)
+    serve_parser.add_argument("--quiet", action="store_true")
+    serve_parser.set_defaults(handler=serve)
+
+    bench_parser = commands.add_parser("bench", help="benchmark and failure-mode checks")
+    bench_parser.add_argument("--iterations", type=int, default=50)
+    bench_parser.add_argument("--latency-ms", type=float, default=0, help="simulated network latency")
+    bench_parser.add_argument("--device", help="also time decoding rows and the packed schedule on this device")
+    bench_parser.add_argument("--device-port", type=int, default=80)
+    bench_parser.set_defaults(handler=bench)
+
+    args = parser.parse_args()
+    sys.exit(args.handler(args) or 0)
+
+
+if __name__ == "__main__":
+    main()
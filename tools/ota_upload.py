@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+"""Compresses firmware images and uploads them to POST /api/ota.
+
+ArduinoOTA sends the whole image uncompressed. The firmware's HTTP update
+path (src/ota_receiver.cpp) also takes a gzip member and inflates it while it
+streams into the inactive app partition, so only the compressed bytes cross
+the WiFi link. Images are compressed with a 32 KB window, the largest the
+ROM's inflater handles, and without a file name in the gzip header:
+
+    python3 tools/ota_upload.py compress .pio/build/esp32dev/firmware.bin
+    python3 tools/ota_upload.py upload sunrise-alarm.local .pio/build/esp32dev/firmware.bin
+
+`upload` reports the transfer time, the throughput and how long the same
+link would take for the uncompressed image. --plain sends the image as is,
+for comparing both on the device. The device checks the image's MD5 and a
+signature made from OTA_PASSWORD, which is read from include/config.h unless
+--password is given. Uploads are accepted while the web server runs, i.e.
+in the maintenance window after power-on, and not during a sunrise.
+"""
+
+import argparse
+import gzip
+import hashlib
+import http.client
+import os
+import re
+import sys
+import time
+import urllib.parse
+
+DEFAULT_IMAGE = os.path.join(".pio", "build", "esp32dev", "firmware.bin")
+CONFIG_H = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "include", "config.h")
+ESP_IMAGE_MAGIC = 0xE9
+CHUNK = 4096
+
+
+def read_image(path):
+    with open(path, "rb") as handle:
+        image = handle.read()
+    if not image or image[0] != ESP_IMAGE_MAGIC:
+        sys.exit(f"{path} is not an ESP32 app image")
+    return image
+
+
+def compress(image):
+    # mtime=0 and no file name leave the header flags at 0, which the device requires
+    return gzip.compress(image, compresslevel=9, mtime=0)
+
+
+def config_password():
+    try:
+        with open(CONFIG_H) as handle:
+            match = re.search(r'#define\s+OTA_PASSWORD\s+"([^"]*)"', handle.read())
+    except OSError:
+        return None
+    return match.group(1) if match else None
+
+
+def summarize(image, body):
+    saved = 1 - len(body) / len(image)
+    print(f"image {len(image)} bytes, compressed {len(body)} bytes ({saved:.1%} smaller)")
+
+
+def command_compress(args):
+    image = read_image(args.image)
+    body = compress(image)
+    output = args.output or args.image + ".gz"
+    with open(output, "wb") as handle:
+        handle.write(body)
+    summarize(image, body)
+    print(f"wrote {output}")
+    return 0
+
+
+def command_upload(args):
+    password = args.password if args.password is not None else config_password()
+    if password is None:
+        sys.exit("no --password given and no OTA_PASSWORD in include/config.h")
+
+    image = read_image(args.image)
+    body = image if args.plain else compress(image)
+    md5 = hashlib.md5(image).hexdigest()
+    signature = hashlib.md5((password + md5).encode()).hexdigest()
+    query = urllib.parse.urlencode({"size": len(image), "md5": md5, "signature": signature})
+    if args.plain:
+        print(f"image {len(image)} bytes, sent uncompressed")
+    else:
+        summarize(image, body)
+
+    def chunks():
+        for offset in range(0, len(body), CHUNK):
+            yield body[offset:offset + CHUNK]
+            sys.stderr.write(f"\r{min(offset + CHUNK, len(body)) * 100 // len(body):3d}%")
+        sys.stderr.write("\n")
+
+    connection = http.client.HTTPConnection(args.host, args.port, timeout=args.timeout)
+    start = time.perf_counter()
+    connection.request("POST", "/api/ota?" + query, body=chunks(),
+                       headers={"Content-Type": "application/octet-stream", "Content-Length": str(len(body))})
+    response = connection.getresponse()
+    answer = response.read().decode(errors="replace")
+    elapsed = time.perf_counter() - start
+    connection.close()
+
+    if response.status != 200:
+        print(f"device answered {response.status}: {answer}")
+        return 1
+    rate = len(body) / elapsed
+    print(f"sent {len(body)} bytes in {elapsed:.1f} s ({rate / 1024:.1f} KB/s, writing to flash included)")
+    if not args.plain:
+        estimate = len(image) / rate
+        print(f"the uncompressed image would take about {estimate:.1f} s at this rate, "
+              f"{estimate - elapsed:.1f} s more")
+    print("device is restarting into the new firmware")
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    command = commands.add_parser("compress", help="write a compressed image and report the savings")
+    command.add_argument("image", nargs="?", default=DEFAULT_IMAGE)
+    command.add_argument("-o", "--output", help="defaults to the image path with .gz added")
+
+    command = commands.add_parser("upload", help="upload an image to a device")
+    command.add_argument("host")
+    command.add_argument("image", nargs="?", default=DEFAULT_IMAGE)
+    command.add_argument("--password", help="OTA_PASSWORD, read from include/config.h by default")
+    command.add_argument("--plain", action="store_true", help="send the image uncompressed")
+    command.add_argument("--port", type=int, default=80)
+    command.add_argument("--timeout", type=float, default=120)
+    args = parser.parse_args()
+
+    if args.command == "compress":
+        return command_compress(args)
+    return command_upload(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
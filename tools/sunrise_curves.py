@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+"""Draws the sunrise curves the native build dumps from the firmware's presets.
+
+`program curves` (native/sim/curves.cpp) compiles the built-in presets with
+SunriseCurve from src/sunrise_curve.cpp and prints a summary per preset. Its
+--csv and --spatial dumps are drawn here as PNGs, as the emitted light would
+look on an sRGB screen. A --csv dump becomes a strip with one column per
+frame: each frame rounded to 8 bits in the top band, and the light the eye
+averages over dithered refreshes in the bottom band:
+
+    .pio/build/native/program curves --preset ocean --brightness 40 --csv ocean.csv
+    python3 tools/sunrise_curves.py ocean.csv ocean.png
+
+A --spatial dump becomes an image with one column per LED and one row per
+moment, top to bottom:
+
+    .pio/build/native/program curves --preset sunrise --spatial rise.csv --origin center --leds 120
+    python3 tools/sunrise_curves.py rise.csv rise.png
+
+--bench asks a device to time SunriseCurve::render() and a dither pass for
+several strip lengths and layouts (GET /api/debug/render_benchmark) and
+fails if rendering and dithering a 1000-LED frame takes 1 ms or more. The
+native build's `program bench-render` runs the same benchmark on the host:
+
+    python3 tools/sunrise_curves.py --bench sunrise-alarm.local
+
+With --zones it times the compositor instead (GET /api/debug/zone_benchmark):
+up to --zones sunrises playing at once in their own zones, side by side and
+overlapping, over a 960-LED strip. It fails if 8 zones cost more than twice
+what one zone costs over the same lit LEDs, or if lighting an eighth of the
+strip costs more than half of lighting all of it, as either means frames
+scale with zones or with the strip rather than with the lit LEDs. The native
+build's `program bench-zones` runs the same check on the host:
+
+    python3 tools/sunrise_curves.py --bench sunrise-alarm.local --zones 8
+"""
+
+import argparse
+import csv
+import http.client
+import json
+import struct
+import sys
+import zlib
+
+
+def linear_to_srgb(value):
+    v = min(max(value, 0.0), 1.0)
+    return 12.92 * v if v <= 0.0031308 else 1.055 * v ** (1 / 2.4) - 0.055
+
+
+def write_png(path, rows):
+    """rows: list of lists of (r, g, b) 8-bit sRGB."""
+    height, width = len(rows), len(rows[0])
+    raw = b"".join(b"\x00" + bytes(channel for pixel in row for channel in pixel) for row in rows)
+
+    def chunk(kind, data):
+        return struct.pack(">I", len(data)) + kind + data + struct.pack(">I", zlib.crc32(kind + data) & 0xFFFFFFFF)
+
+    with open(path, "wb") as handle:
+        handle.write(b"\x89PNG\r\n\x1a\n")
+        handle.write(chunk(b"IHDR", struct.pack(">IIBBBBB", width, height, 8, 2, 0, 0, 0)))
+        handle.write(chunk(b"IDAT", zlib.compress(raw, 9)))
+        handle.write(chunk(b"IEND", b""))
+
+
+def display(frames):
+    """8-bit PWM, which is linear light, as sRGB pixels."""
+    return [tuple(int(linear_to_srgb(c / 255.0) * 255 + 0.5) for c in frame) for frame in frames]
+
+
+def read_dump(path):
+    """(header, rows of floats) of a program curves dump."""
+    with open(path, newline="") as handle:
+        reader = csv.reader(handle)
+        header = next(reader)
+        return header, [[float(value) for value in row] for row in reader]
+
+
+def draw(dump, png):
+    header, rows = read_dump(dump)
+    if header[:2] == ["progress", "lut_r"]:
+        rounded = [tuple(row[header.index("rounded_r"):][:3]) for row in rows]
+        dithered = [tuple(row[header.index("dithered_r"):][:3]) for row in rows]
+        write_png(png, [display(rounded)] * 40 + [display(dithered)] * 40)
+    elif header[:2] == ["progress", "r0"]:
+        write_png(png, [display(zip(row[1::3], row[2::3], row[3::3])) for row in rows])
+    else:
+        sys.exit(f"{dump} is not a program curves dump")
+
+
+def bench(host, port):
+    print(f"{'leds':>6} {'rows':>5} {'origin':8} {'bands':>6} {'layout us':>10} {'frame us':>9} {'dither us':>10}")
+    slow = False
+    for leds, rows in ((60, 1), (300, 1), (1000, 1), (1000, 20), (2000, 1)):
+        for origin in ("uniform", "center"):
+            connection = http.client.HTTPConnection(host, port, timeout=30)
+            connection.request("GET", f"/api/debug/render_benchmark?leds={leds}&rows={rows}&origin={origin}&frames=200")
+            response = connection.getresponse()
+            body = response.read()
+            connection.close()
+            if response.status != 200:
+                sys.exit(f"device answered {response.status}: {body.decode(errors='replace')}")
+            result = json.loads(body)
+            print(f"{leds:6} {rows:5} {origin:8} {result['bands']:6} {result['layout_us']:10} "
+                  f"{result['frame_us']:9.1f} {result['dither_us']:10.1f}")
+            slow = slow or (leds == 1000 and result["frame_us"] + result["dither_us"] >= 1000)
+    if slow:
+        print("rendering and dithering a 1000-LED frame took 1 ms or more")
+    return 1 if slow else 0
+
+
+def get_json(host, port, path):
+    connection = http.client.HTTPConnection(host, port, timeout=30)
+    connection.request("GET", path)
+    response = connection.getresponse()
+    body = response.read()
+    connection.close()
+    if response.status != 200:
+        sys.exit(f"device answered {response.status}: {body.decode(errors='replace')}")
+    return json.loads(body)
+
+
+def bench_zones(host, port, max_zones, leds=960):
+    print(f"{'zones':>6} {'overlap':>8} {'lit':>6} {'frame us':>9} {'ns/lit LED':>11}")
+    results = {}
+    for lit in (leds // 8, leds):
+        for zones in sorted({1, 2, 4, max_zones}):
+            for overlap in (0, 1):
+                result = get_json(host, port, f"/api/debug/zone_benchmark?leds={leds}&zones={zones}&lit={lit}"
+                                              f"&overlap={overlap}&frames=200")
+                results[lit, zones, overlap] = result
+                print(f"{result['zones']:6} {'yes' if overlap else 'no':>8} {result['lit_leds']:6} "
+                      f"{result['frame_us']:9.1f} {result['ns_per_lit_led']:11.1f}")
+
+    failures = []
+    one, many = results[leds, 1, 0], results[leds, max_zones, 0]
+    if many["frame_us"] > 2 * one["frame_us"]:
+        failures.append(f"{max_zones} zones take {many['frame_us']:.1f} us per frame, one zone over the same "
+                        f"LEDs {one['frame_us']:.1f} us")
+    for zones in sorted({1, max_zones}):
+        eighth, full = results[leds // 8, zones, 0], results[leds, zones, 0]
+        if eighth["frame_us"] > full["frame_us"] / 2:
+            failures.append(f"{zones} zones over {eighth['lit_leds']} LEDs take {eighth['frame_us']:.1f} us, "
+                            f"over {full['lit_leds']} LEDs {full['frame_us']:.1f} us")
+    for failure in failures:
+        print(failure)
+    return 1 if failures else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("dump", nargs="?", help="a --csv or --spatial dump of program curves")
+    parser.add_argument("png", nargs="?", help="where the image goes")
+    parser.add_argument("--bench", metavar="HOST", help="time the renderer on the device at HOST")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--zones", type=int, help="with --bench: time the compositor with up to this many zones")
+    args = parser.parse_args()
+
+    if args.bench and args.zones:
+        return bench_zones(args.bench, args.port, args.zones)
+    if args.bench:
+        return bench(args.bench, args.port)
+    if not args.dump or not args.png:
+        parser.error("need a dump and a PNG path, or --bench")
+    draw(args.dump, args.png)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())